@@ -0,0 +1,167 @@
+#include "allocator.h"
+
+#include <assert.h>
+#include <stdio.h>
+
+static usize align_up(usize value, usize alignment) {
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+//
+// Arena
+//
+void arena_init(Arena* arena, const char* name, usize capacity) {
+    memset(arena, 0, sizeof(Arena));
+    arena->name = name;
+    arena->capacity = align_up(capacity, ARENA_ALIGNMENT);
+    arena->base = ogl_malloc(arena->capacity);
+}
+
+void arena_destroy(Arena* arena) {
+    free(arena->base);
+    arena->base = NULL;
+    arena->capacity = arena->offset = 0;
+}
+
+void arena_reserve(Arena* arena, usize capacity) {
+    assert(arena->offset == 0);
+    capacity = align_up(capacity, ARENA_ALIGNMENT);
+    if (capacity <= arena->capacity) return;
+
+    free(arena->base);
+    arena->base = ogl_malloc(capacity);
+    arena->capacity = capacity;
+}
+
+static void arena_overflow(const Arena* arena, usize size) {
+    fprintf(stderr,
+            "Arena `%s` is full: capacity=%zu offset=%zu requested=%zu\n",
+            arena->name, arena->capacity, arena->offset, size);
+    exit(ENOMEM);
+}
+
+void* arena_alloc(Arena* arena, usize size) {
+    const usize aligned = align_up(size, ARENA_ALIGNMENT);
+    if (aligned > arena->capacity - arena->offset)
+        arena_overflow(arena, size);
+
+    void* const data = arena->base + arena->offset;
+    arena->last_offset = arena->offset;
+    arena->offset += aligned;
+    if (arena->offset > arena->high_water) arena->high_water = arena->offset;
+    arena->allocation_count += 1;
+    return data;
+}
+
+void* arena_grow(Arena* arena, void* data, usize old_size, usize new_size) {
+    if (data && (u8*)data == arena->base + arena->last_offset) {
+        const usize aligned = align_up(new_size, ARENA_ALIGNMENT);
+        if (aligned > arena->capacity - arena->last_offset)
+            arena_overflow(arena, new_size);
+
+        arena->offset = arena->last_offset + aligned;
+        if (arena->offset > arena->high_water)
+            arena->high_water = arena->offset;
+        return data;
+    }
+
+    void* const grown = arena_alloc(arena, new_size);
+    if (data) memcpy(grown, data, MIN(old_size, new_size));
+    return grown;
+}
+
+void arena_reset(Arena* arena) {
+    arena->offset = arena->last_offset = 0;
+    arena->reset_count += 1;
+}
+
+ArenaMark arena_mark(const Arena* arena) { return arena->offset; }
+
+void arena_release(Arena* arena, ArenaMark mark) {
+    assert(mark <= arena->offset);
+    arena->offset = arena->last_offset = mark;
+}
+
+void arena_print(const Arena* arena) {
+    printf("Arena: name=%s capacity=%zu high_water=%zu allocations=%" PRIu64
+           " resets=%" PRIu64 "\n",
+           arena->name, arena->capacity, arena->high_water,
+           arena->allocation_count, arena->reset_count);
+}
+
+//
+// Pool
+//
+struct PoolChunk {
+    PoolChunk* next;
+    // Blocks follow, aligned
+};
+
+#define POOL_CHUNK_HEADER align_up(sizeof(PoolChunk), ARENA_ALIGNMENT)
+
+void pool_init(Pool* pool, const char* name, usize block_size,
+               u32 blocks_per_chunk) {
+    assert(blocks_per_chunk > 0);
+
+    memset(pool, 0, sizeof(Pool));
+    pool->name = name;
+    // A free block holds the next one
+    pool->block_size = align_up(MAX(block_size, sizeof(void*)),
+                                ARENA_ALIGNMENT);
+    pool->blocks_per_chunk = blocks_per_chunk;
+}
+
+void pool_destroy(Pool* pool) {
+    PoolChunk* chunk = pool->chunks;
+    while (chunk) {
+        PoolChunk* const next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    pool->chunks = NULL;
+    pool->free_list = NULL;
+}
+
+static void pool_grow(Pool* pool) {
+    PoolChunk* const chunk = ogl_malloc(
+        POOL_CHUNK_HEADER + pool->block_size * pool->blocks_per_chunk);
+    chunk->next = pool->chunks;
+    pool->chunks = chunk;
+    pool->chunk_count += 1;
+
+    // Lowest addresses handed out first
+    u8* const blocks = (u8*)chunk + POOL_CHUNK_HEADER;
+    for (u32 i = pool->blocks_per_chunk; i-- > 0;) {
+        void** const block = (void**)(blocks + pool->block_size * i);
+        *block = pool->free_list;
+        pool->free_list = block;
+    }
+}
+
+void* pool_alloc(Pool* pool) {
+    if (!pool->free_list) pool_grow(pool);
+
+    void** const block = pool->free_list;
+    pool->free_list = *block;
+
+    pool->in_use += 1;
+    if (pool->in_use > pool->high_water) pool->high_water = pool->in_use;
+    pool->allocation_count += 1;
+    return block;
+}
+
+void pool_free(Pool* pool, void* block) {
+    assert(pool->in_use > 0);
+
+    *(void**)block = pool->free_list;
+    pool->free_list = block;
+    pool->in_use -= 1;
+}
+
+void pool_print(const Pool* pool) {
+    printf("Pool: name=%s block_size=%zu chunks=%u blocks=%u high_water=%u "
+           "allocations=%" PRIu64 "\n",
+           pool->name, pool->block_size, pool->chunk_count,
+           pool->chunk_count * pool->blocks_per_chunk, pool->high_water,
+           pool->allocation_count);
+}
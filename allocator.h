@@ -0,0 +1,68 @@
+#pragma once
+#include "utils.h"
+
+// Allocators with a predictable peak, reported with `arena_print` and
+// `pool_print`. Running out of space is fatal, like `ogl_malloc`.
+//
+// Arena: linear, sized once. Everything is freed at once with
+// `arena_reset`, e.g. per frame scratch or the assets of a scene. Scoped
+// scratch space is taken back with `arena_mark` and `arena_release`.
+//
+// Pool: blocks of a single size, allocated and freed one by one, e.g.
+// render packets. It grows by chunks, which are kept for reuse: once warm,
+// allocating never calls `malloc`.
+
+// Of every allocation, as `malloc`
+#define ARENA_ALIGNMENT 16
+
+typedef struct {
+    const char* name;
+    u8* base;
+    usize capacity;
+    usize offset;
+    usize last_offset;  // Of the last allocation, which can grow in place
+
+    usize high_water;
+    u64 allocation_count;
+    u64 reset_count;
+} Arena;
+
+typedef usize ArenaMark;
+
+void arena_init(Arena* arena, const char* name, usize capacity);
+void arena_destroy(Arena* arena);
+// Grows an empty arena to hold at least `capacity` bytes, e.g. the frame
+// scratch once the scene is known
+void arena_reserve(Arena* arena, usize capacity);
+void* arena_alloc(Arena* arena, usize size);
+// Grows the last allocation in place, otherwise copies it
+void* arena_grow(Arena* arena, void* data, usize old_size, usize new_size);
+void arena_reset(Arena* arena);
+ArenaMark arena_mark(const Arena* arena);
+void arena_release(Arena* arena, ArenaMark mark);
+void arena_print(const Arena* arena);
+
+#define ARENA_ALLOC(arena, type, count) \
+    ((type*)arena_alloc((arena), sizeof(type) * (count)))
+
+typedef struct PoolChunk PoolChunk;
+
+typedef struct {
+    const char* name;
+    usize block_size;
+    u32 blocks_per_chunk;
+    PoolChunk* chunks;
+    void* free_list;  // Intrusive, through the free blocks
+
+    u32 chunk_count;
+    u32 in_use;
+    u32 high_water;
+    u64 allocation_count;
+} Pool;
+
+void pool_init(Pool* pool, const char* name, usize block_size,
+               u32 blocks_per_chunk);
+void pool_destroy(Pool* pool);
+void* pool_alloc(Pool* pool);
+void pool_free(Pool* pool, void* block);
+void pool_print(const Pool* pool);
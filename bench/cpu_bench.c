@@ -0,0 +1,138 @@
+// CPU microbenchmarks of the loaders and of the per object math, hot and
+// cold. Run from the root of the repository: `make bench_cpu`.
+// `MICROBENCH=<substring>` only runs the matching benchmarks.
+
+#include <cglm/cglm.h>
+#include <stdio.h>
+
+#include "../bmp.h"
+#include "../utils.h"
+#include "microbench.h"
+
+#define OBJECT_COUNT 1000
+
+typedef struct {
+    const char* path;
+    u8* buffer;
+    usize capacity;
+} FileBench;
+
+typedef struct {
+    vec3 positions[OBJECT_COUNT];
+    mat4 models[OBJECT_COUNT];
+    mat4 view_projection;
+    f32 angle;
+} TransformBench;
+
+static void bench_file_read(void* data) {
+    FileBench* const bench = data;
+    usize len = 0;
+    if (file_read(bench->path, bench->buffer, bench->capacity, &len) != 0)
+        exit(1);
+}
+
+static void bench_bmp_load(void* data) {
+    FileBench* const bench = data;
+    usize len = 0, width = 0, height = 0, img_size = 0, data_pos = 0;
+    bmp_load(bench->path, &bench->buffer, bench->capacity, &len, &width,
+             &height, &img_size, &data_pos);
+}
+
+// The I/O half of `shader_compile`: read into its 1000 bytes buffer and
+// terminate the source
+static void bench_shader_source(void* data) {
+    FileBench* const bench = data;
+    usize len = 0;
+    if (file_read(bench->path, bench->buffer, bench->capacity, &len) != 0)
+        exit(1);
+    nul_terminate(bench->buffer, len);
+}
+
+// The model matrices of `scene_update`
+static void bench_transform(void* data) {
+    TransformBench* const bench = data;
+    vec3 rotation_axis = {1.0f, 0.3f, 0.5f};
+    for (u32 i = 0; i < OBJECT_COUNT; i++) {
+        glm_mat4_identity(bench->models[i]);
+        glm_translate(bench->models[i], bench->positions[i]);
+        glm_rotate(bench->models[i],
+                   glm_rad((0.8f + (f32)i) * bench->angle * 20.0f),
+                   rotation_axis);
+    }
+    bench->angle += 0.01f;
+}
+
+// One MVP per object, as `gl_loop` used to compute
+static void bench_mvp(void* data) {
+    TransformBench* const bench = data;
+    mat4 mvp;
+    for (u32 i = 0; i < OBJECT_COUNT; i++) {
+        glm_mat4_mul(bench->view_projection, bench->models[i], mvp);
+        // Keep the result alive
+        bench->models[i][3][3] = mvp[3][3];
+    }
+}
+
+static usize file_size(const char path[]) {
+    FILE* const file = fopen(path, "r");
+    if (!file) {
+        fprintf(stderr, "Could not open %s: %s\n", path, strerror(errno));
+        exit(errno);
+    }
+    fseek(file, 0, SEEK_END);
+    const usize size = (usize)ftell(file);
+    fclose(file);
+    return size;
+}
+
+int main(void) {
+    const usize image_capacity = 10 * 1000 * 1000;
+    FileBench crate = {.path = "resources/crate.bmp",
+                       .buffer = ogl_malloc(image_capacity),
+                       .capacity = image_capacity};
+    u8 shader_buffer[1000];
+    FileBench shader = {.path = "resources/instanced_vertex.glsl",
+                        .buffer = shader_buffer,
+                        .capacity = sizeof(shader_buffer)};
+
+    TransformBench* const transform = ogl_malloc(sizeof(TransformBench));
+    memset(transform, 0, sizeof(TransformBench));
+    for (u32 i = 0; i < OBJECT_COUNT; i++) {
+        transform->positions[i][0] = (f32)(i % 32) * 3.0f;
+        transform->positions[i][1] = (f32)(i / 32) * 3.0f;
+        transform->positions[i][2] = -20.0f;
+    }
+    glm_perspective(glm_rad(45.0f), 1024.0f / 768.0f, 0.1f, 100.0f,
+                    transform->view_projection);
+
+    const u64 crate_size = file_size(crate.path);
+    const u64 shader_size = file_size(shader.path);
+    const Microbench kernels[] = {
+        {"file_read", bench_file_read, &crate, 1, crate_size, false},
+        {"bmp_load", bench_bmp_load, &crate, 1, crate_size, false},
+        {"shader_source", bench_shader_source, &shader, 1, shader_size,
+         false},
+        {"transform", bench_transform, transform, OBJECT_COUNT,
+         sizeof(mat4) * OBJECT_COUNT, false},
+        {"mvp", bench_mvp, transform, OBJECT_COUNT,
+         sizeof(mat4) * OBJECT_COUNT, false},
+    };
+
+    const char* const filter = getenv("MICROBENCH");
+    microbench_print_header();
+    for (u32 i = 0; i < ARR_SIZE(kernels); i++) {
+        if (filter && !strstr(kernels[i].name, filter)) continue;
+
+        // Hot, then cold
+        Microbench bench = kernels[i];
+        for (u32 cold = 0; cold < 2; cold++) {
+            bench.cold = cold;
+            MicrobenchResult result;
+            microbench_run(&bench, &result);
+            microbench_print(&bench, &result);
+        }
+    }
+
+    free(transform);
+    free(crate.buffer);
+}
@@ -0,0 +1,148 @@
+#include "microbench.h"
+
+#include <SDL2/SDL.h>
+#include <stdio.h>
+
+// Time stamp counter on x86. Elsewhere (arm64 macOS), the ticks of the
+// performance counter: mach_absolute_time, 24 MHz on Apple silicon.
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define MICROBENCH_HAS_TSC 1
+#define MICROBENCH_TICKS_LABEL "cycles/op"
+#else
+#define MICROBENCH_HAS_TSC 0
+#define MICROBENCH_TICKS_LABEL "ticks/op"
+#endif
+
+#define MICROBENCH_WARMUP_MS 50.0
+#define MICROBENCH_BATCH_MS 2.0
+#define MICROBENCH_SAMPLES 31
+// Cold calls: as many as fit in this budget, within the bounds below
+#define MICROBENCH_COLD_MS 300.0
+#define MICROBENCH_COLD_MIN_SAMPLES 5
+#define MICROBENCH_COLD_MAX_SAMPLES 1000
+// Larger than the last level cache of desktop CPUs
+#define MICROBENCH_EVICT_SIZE (64 * 1024 * 1024)
+
+static u64 microbench_cycles(void) {
+#if MICROBENCH_HAS_TSC
+    return __rdtsc();
+#else
+    return SDL_GetPerformanceCounter();
+#endif
+}
+
+static f64 microbench_ns(u64 start, u64 end) {
+    return (f64)(end - start) * 1e9 / (f64)SDL_GetPerformanceFrequency();
+}
+
+static void microbench_evict(void) {
+    static u8* buffer = NULL;
+    if (!buffer) {
+        buffer = ogl_malloc(MICROBENCH_EVICT_SIZE);
+        memset(buffer, 1, MICROBENCH_EVICT_SIZE);
+    }
+
+    // Read and write every cache line so dirty lines of the benchmark are
+    // written back too
+    volatile u8* const lines = buffer;
+    for (usize i = 0; i < MICROBENCH_EVICT_SIZE; i += 64) lines[i] += 1;
+}
+
+static int microbench_f64_compare(const void* a, const void* b) {
+    const f64 x = *(const f64*)a, y = *(const f64*)b;
+    return (x > y) - (x < y);
+}
+
+// Times `count` calls, returns ns per op and the counter ticks per op
+static f64 microbench_batch(const Microbench* bench, u64 count,
+                            f64* cycles_per_op) {
+    const u64 cycles_start = microbench_cycles();
+    const u64 start = SDL_GetPerformanceCounter();
+    for (u64 i = 0; i < count; i++) bench->run(bench->data);
+    const u64 end = SDL_GetPerformanceCounter();
+    const u64 cycles_end = microbench_cycles();
+
+    const f64 ops = (f64)(count * bench->ops_per_run);
+    *cycles_per_op = (f64)(cycles_end - cycles_start) / ops;
+    return microbench_ns(start, end) / ops;
+}
+
+void microbench_run(const Microbench* bench, MicrobenchResult* result) {
+    memset(result, 0, sizeof(MicrobenchResult));
+
+    // Warmup: page faults, lazy initializations, branch predictors
+    const u64 warmup_start = SDL_GetPerformanceCounter();
+    do {
+        bench->run(bench->data);
+    } while (microbench_ns(warmup_start, SDL_GetPerformanceCounter()) <
+             MICROBENCH_WARMUP_MS * 1e6);
+
+    f64 ns[MICROBENCH_COLD_MAX_SAMPLES], cycles[MICROBENCH_COLD_MAX_SAMPLES];
+    u32 samples = 0;
+
+    if (bench->cold) {
+        f64 budget_ns = MICROBENCH_COLD_MS * 1e6;
+        while (samples < MICROBENCH_COLD_MAX_SAMPLES &&
+               (budget_ns > 0.0 || samples < MICROBENCH_COLD_MIN_SAMPLES)) {
+            microbench_evict();
+            ns[samples] = microbench_batch(bench, 1, &cycles[samples]);
+            budget_ns -= ns[samples] * (f64)bench->ops_per_run;
+            samples++;
+        }
+        result->runs = samples;
+    } else {
+        // Adaptive batch size
+        u64 count = 1;
+        for (;;) {
+            const u64 start = SDL_GetPerformanceCounter();
+            for (u64 i = 0; i < count; i++) bench->run(bench->data);
+            if (microbench_ns(start, SDL_GetPerformanceCounter()) >=
+                MICROBENCH_BATCH_MS * 1e6)
+                break;
+            count *= 2;
+        }
+
+        for (; samples < MICROBENCH_SAMPLES; samples++)
+            ns[samples] = microbench_batch(bench, count, &cycles[samples]);
+        result->runs = count * samples;
+    }
+    result->samples = samples;
+
+    f64 sum = 0.0;
+    for (u32 i = 0; i < samples; i++) sum += ns[i];
+    result->ns_mean = sum / samples;
+    f64 variance = 0.0;
+    for (u32 i = 0; i < samples; i++)
+        variance += (ns[i] - result->ns_mean) * (ns[i] - result->ns_mean);
+    result->ns_stddev = sqrt(variance / samples);
+
+    qsort(ns, samples, sizeof(f64), microbench_f64_compare);
+    qsort(cycles, samples, sizeof(f64), microbench_f64_compare);
+    result->ns_min = ns[0];
+    result->ns_median = ns[samples / 2];
+    result->cycles_median = cycles[samples / 2];
+}
+
+void microbench_print_header(void) {
+    printf("%-28s %10s %12s %12s %10s %12s %10s\n", "benchmark", "runs",
+           "median ns/op", "min ns/op", "stddev %", MICROBENCH_TICKS_LABEL,
+           "MB/s");
+}
+
+void microbench_print(const Microbench* bench,
+                      const MicrobenchResult* result) {
+    char name[64];
+    snprintf(name, sizeof(name), "%s%s", bench->name,
+             bench->cold ? "/cold" : "/hot");
+
+    // Bytes over the median time of a call
+    const f64 run_ns = result->ns_median * (f64)bench->ops_per_run;
+    const f64 mb_per_s =
+        bench->bytes_per_run ? (f64)bench->bytes_per_run / run_ns * 1e3 : 0.0;
+
+    printf("%-28s %10" PRIu64 " %12.1f %12.1f %10.1f %12.1f %10.1f\n", name,
+           result->runs, result->ns_median, result->ns_min,
+           result->ns_stddev / result->ns_mean * 100.0,
+           result->cycles_median, mb_per_s);
+}
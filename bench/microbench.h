@@ -0,0 +1,36 @@
+#pragma once
+#include "../utils.h"
+
+// CPU microbenchmark harness. A benchmark is a function doing some number
+// of operations (e.g. one file read, 1000 matrices). It is warmed up, then
+// batched: the batch size doubles until one batch lasts long enough to
+// dwarf the timer overhead, and the statistics are computed over several
+// batches.
+//
+// Cold runs evict the CPU caches (not the page cache) before every call and
+// time the calls one by one, the eviction itself is not measured.
+
+typedef void (*MicrobenchFn)(void* data);
+
+typedef struct {
+    const char* name;
+    MicrobenchFn run;
+    void* data;
+    u64 ops_per_run;    // For ns/op
+    u64 bytes_per_run;  // For throughput, 0 if meaningless
+    _Bool cold;
+} Microbench;
+
+typedef struct {
+    u64 runs;  // Measured calls, all samples
+    u32 samples;
+    f64 ns_min, ns_median, ns_mean, ns_stddev;  // Per op
+    // Time stamp counter ticks per op, on x86, else performance counter ticks
+    f64 cycles_median;
+} MicrobenchResult;
+
+void microbench_run(const Microbench* bench, MicrobenchResult* result);
+
+void microbench_print_header(void);
+void microbench_print(const Microbench* bench,
+                      const MicrobenchResult* result);
@@ -0,0 +1,346 @@
+// Rendering benchmark suite. Every scene is generated from a fixed seed and
+// rendered headless, uncapped, for a fixed number of frames. Results are
+// written as JSON, one scene per line, and two result files can be compared
+// to flag regressions.
+//
+// Usage, from the root of the repository:
+//   render_bench [results.json]
+//   render_bench compare <baseline.json> <results.json> [threshold %]
+// Environment:
+//   BACKEND=gl|vulkan, FRAMES=<count> overrides the frame count of every
+//   scene, SCENES=<substring> only runs the matching scenes.
+// OpenGL needs a video driver even when hidden: SDL_VIDEODRIVER=offscreen
+// (EGL) or Xvfb with llvmpipe. Vulkan runs without one, e.g. on lavapipe.
+
+#include <SDL2/SDL.h>
+#include <assert.h>
+#include <stdio.h>
+
+#include "../renderer.h"
+#include "../scene.h"
+#include "../utils.h"
+#include "../world_file.h"
+
+#define BENCH_WARMUP_FRAMES 10
+#define BENCH_MAX_SCENES 32
+#define BENCH_LINE_CAPACITY 1024
+// Written before the scenes streaming it
+#define BENCH_WORLD_PATH "bench_world.bin"
+
+typedef struct {
+    SceneDesc desc;
+    u32 frames;
+} BenchScene;
+
+// 64x64 chunks of 32 units, about 650k cubes
+static const WorldDesc bench_world = {
+    .grid_width = 64,
+    .grid_depth = 64,
+    .chunk_size = 32.0f,
+    .chunk_instances = 256,
+    .material_count = 4,
+    .seed = 11,
+};
+
+static const BenchScene bench_scenes[] = {
+    {{.name = "instances_10", .instance_count = 10, .seed = 1,
+      .material_count = 1}, 600},
+    {{.name = "instances_100", .instance_count = 100, .seed = 1,
+      .material_count = 1}, 600},
+    {{.name = "instances_1k", .instance_count = 1000, .seed = 1,
+      .material_count = 1}, 300},
+    {{.name = "instances_10k", .instance_count = 10 * 1000, .seed = 1,
+      .material_count = 1}, 200},
+    {{.name = "instances_100k", .instance_count = 100 * 1000, .seed = 1,
+      .material_count = 1}, 60},
+    {{.name = "instances_1m", .instance_count = 1000 * 1000, .seed = 1,
+      .material_count = 1}, 20},
+    {{.name = "instances_1m_quantized", .instance_count = 1000 * 1000,
+      .seed = 1, .material_count = 1, .quantized_vertices = true}, 20},
+    {{.name = "lights_256", .instance_count = 10 * 1000, .seed = 6,
+      .material_count = 1, .light_count = 256}, 200},
+    {{.name = "lights_4k", .instance_count = 10 * 1000, .seed = 6,
+      .material_count = 1, .light_count = RENDERER_MAX_LIGHTS}, 200},
+    {{.name = "static_10k", .instance_count = 100, .seed = 8,
+      .material_count = 4, .static_count = 10 * 1000}, 200},
+    {{.name = "static_10k_quantized", .instance_count = 100, .seed = 8,
+      .material_count = 4, .static_count = 10 * 1000,
+      .quantized_vertices = true}, 200},
+    {{.name = "graph_100k_moving_1", .instance_count = 100 * 1000,
+      .seed = 10, .material_count = 1, .scene_graph = true,
+      .moving_percent = 1}, 60},
+    {{.name = "graph_100k_moving_100", .instance_count = 100 * 1000,
+      .seed = 10, .material_count = 1, .scene_graph = true,
+      .moving_percent = 100}, 60},
+    {{.name = "world_stream_4mb", .instance_count = 10, .seed = 11,
+      .material_count = 4, .world_path = BENCH_WORLD_PATH,
+      .world_budget_mb = 4}, 300},
+    {{.name = "spheres_10k", .instance_count = 10 * 1000, .seed = 9,
+      .material_count = 4, .spheres = true}, 100},
+    {{.name = "spheres_10k_lod", .instance_count = 10 * 1000, .seed = 9,
+      .material_count = 4, .spheres = true, .lod = true}, 100},
+    {{.name = "particles_100k", .instance_count = 1000, .seed = 7,
+      .material_count = 1, .particle_count = 100 * 1000}, 200},
+    {{.name = "particles_1m", .instance_count = 1000, .seed = 7,
+      .material_count = 1, .particle_count = 1000 * 1000}, 100},
+    {{.name = "overdraw", .instance_count = 200, .seed = 2,
+      .material_count = 1, .overdraw = true}, 200},
+    {{.name = "many_materials", .instance_count = 10 * 1000, .seed = 3,
+      .material_count = SCENE_MAX_MATERIALS, .texture_size = 64}, 200},
+    {{.name = "many_materials_array", .instance_count = 10 * 1000,
+      .seed = 3, .material_count = SCENE_MAX_MATERIALS, .texture_size = 64,
+      .texture_array = true}, 200},
+    {{.name = "mixed_textures", .instance_count = 10 * 1000, .seed = 5,
+      .material_count = SCENE_MAX_MATERIALS, .texture_size = 256,
+      .mixed_texture_sizes = true}, 200},
+    {{.name = "mixed_textures_atlas", .instance_count = 10 * 1000, .seed = 5,
+      .material_count = SCENE_MAX_MATERIALS, .texture_size = 256,
+      .mixed_texture_sizes = true, .texture_array = true}, 200},
+    {{.name = "texture_heavy", .instance_count = 1000, .seed = 4,
+      .material_count = 32, .texture_size = 1024}, 200},
+};
+
+typedef struct {
+    char name[64];
+    u32 instances, materials, frames;
+    f64 mean_ms, p50_ms, p95_ms, p99_ms, max_ms;
+    f64 cpu_mean_ms;  // Renderer only, frame begin to end
+    f64 draw_calls;   // Per frame
+    f64 triangles;    // Per frame
+    f64 bytes_uploaded;
+    u64 setup_bytes_uploaded;  // Before the first frame
+    // Mean, below 1 when run with DYNAMIC_RESOLUTION
+    f64 resolution_scale;
+} BenchResult;
+
+static f64 bench_ms(u64 start, u64 end) {
+    return (f64)(end - start) * 1000.0 / (f64)SDL_GetPerformanceFrequency();
+}
+
+static int bench_f64_compare(const void* a, const void* b) {
+    const f64 x = *(const f64*)a, y = *(const f64*)b;
+    return (x > y) - (x < y);
+}
+
+// Nearest rank, `samples` must be sorted
+static f64 bench_percentile(const f64* samples, u32 count, f64 percentile) {
+    u32 rank = (u32)ceil(percentile / 100.0 * count);
+    if (rank == 0) rank = 1;
+    return samples[rank - 1];
+}
+
+static _Bool bench_run(RendererBackend backend, const BenchScene* bench,
+                       u32 frames, BenchResult* result) {
+    if (bench->desc.world_path &&
+        world_file_write(bench->desc.world_path, &bench_world))
+        return false;
+
+    Renderer renderer;
+    if (!renderer_init(&renderer, backend, true)) return false;
+
+    Scene scene;
+    scene_create(&scene, &renderer, &bench->desc);
+    const u64 setup_bytes_uploaded = renderer.stats.bytes_uploaded;
+
+    f64* const samples = ogl_malloc(sizeof(f64) * frames);
+    u64 start = 0;
+    for (u32 i = 0; i < BENCH_WARMUP_FRAMES + frames; i++) {
+        if (i == BENCH_WARMUP_FRAMES) {
+            // Measure the steady state only
+            renderer_finish(&renderer);
+            memset(&renderer.stats, 0, sizeof(RendererStats));
+            start = SDL_GetPerformanceCounter();
+        }
+        const u64 frame_start = SDL_GetPerformanceCounter();
+
+        scene_update(&scene);
+        RendererFrame frame;
+        scene_frame(&scene.pose, &renderer, &frame);
+        renderer_frame_begin(&renderer, &frame);
+        scene_draw(&scene, &scene.pose, &renderer);
+        renderer_frame_submit(&renderer);
+        renderer_frame_end(&renderer);
+
+        if (i >= BENCH_WARMUP_FRAMES)
+            samples[i - BENCH_WARMUP_FRAMES] =
+                bench_ms(frame_start, SDL_GetPerformanceCounter());
+    }
+    // The frames still in flight count in the mean
+    renderer_finish(&renderer);
+    const f64 total_ms = bench_ms(start, SDL_GetPerformanceCounter());
+
+    qsort(samples, frames, sizeof(f64), bench_f64_compare);
+
+    const RendererStats* const stats = &renderer.stats;
+    memset(result, 0, sizeof(BenchResult));
+    snprintf(result->name, sizeof(result->name), "%s", bench->desc.name);
+    result->instances = bench->desc.instance_count;
+    result->materials = bench->desc.material_count;
+    result->frames = frames;
+    result->mean_ms = total_ms / frames;
+    result->p50_ms = bench_percentile(samples, frames, 50.0);
+    result->p95_ms = bench_percentile(samples, frames, 95.0);
+    result->p99_ms = bench_percentile(samples, frames, 99.0);
+    result->max_ms = samples[frames - 1];
+    result->cpu_mean_ms = stats->total_cpu_ms / (f64)stats->frame_count;
+    result->draw_calls =
+        (f64)stats->total_draw_calls / (f64)stats->frame_count;
+    result->triangles = (f64)stats->total_triangles / (f64)stats->frame_count;
+    result->bytes_uploaded =
+        (f64)stats->total_bytes_uploaded / (f64)stats->frame_count;
+    result->setup_bytes_uploaded = setup_bytes_uploaded;
+    result->resolution_scale =
+        stats->total_resolution_scale / (f64)stats->frame_count;
+
+    free(samples);
+    scene_destroy(&scene);
+    renderer_destroy(&renderer);
+    return true;
+}
+
+static void bench_result_write(FILE* file, const BenchResult* r, _Bool last) {
+    fprintf(file,
+            "    {\"name\": \"%s\", \"instances\": %u, \"materials\": %u, "
+            "\"frames\": %u, \"mean_ms\": %.4f, \"p50_ms\": %.4f, "
+            "\"p95_ms\": %.4f, \"p99_ms\": %.4f, \"max_ms\": %.4f, "
+            "\"cpu_mean_ms\": %.4f, \"draw_calls\": %.1f, "
+            "\"triangles\": %.1f, \"bytes_uploaded\": %.1f, "
+            "\"setup_bytes_uploaded\": %" PRIu64
+            ", \"resolution_scale\": %.3f}%s\n",
+            r->name, r->instances, r->materials, r->frames, r->mean_ms,
+            r->p50_ms, r->p95_ms, r->p99_ms, r->max_ms, r->cpu_mean_ms,
+            r->draw_calls, r->triangles, r->bytes_uploaded,
+            r->setup_bytes_uploaded,
+            r->resolution_scale, last ? "" : ",");
+}
+
+//
+// Comparison
+//
+// Only reads the files written above: one result per line
+static f64 bench_json_number(const char* line, const char* key) {
+    char pattern[64];
+    snprintf(pattern, sizeof(pattern), "\"%s\": ", key);
+    const char* const value = strstr(line, pattern);
+    return value ? strtod(value + strlen(pattern), NULL) : (f64)NAN;
+}
+
+static u32 bench_results_read(const char* path, BenchResult* results) {
+    FILE* const file = fopen(path, "r");
+    if (!file) {
+        fprintf(stderr, "Could not open %s: %s\n", path, strerror(errno));
+        exit(errno);
+    }
+
+    u32 count = 0;
+    char line[BENCH_LINE_CAPACITY];
+    while (count < BENCH_MAX_SCENES && fgets(line, sizeof(line), file)) {
+        const char* const name = strstr(line, "\"name\": \"");
+        if (!name) continue;
+
+        BenchResult* const r = &results[count++];
+        memset(r, 0, sizeof(BenchResult));
+        sscanf(name + strlen("\"name\": \""), "%63[^\"]", r->name);
+        r->mean_ms = bench_json_number(line, "mean_ms");
+        r->p95_ms = bench_json_number(line, "p95_ms");
+        r->draw_calls = bench_json_number(line, "draw_calls");
+        r->triangles = bench_json_number(line, "triangles");
+        r->bytes_uploaded = bench_json_number(line, "bytes_uploaded");
+    }
+    fclose(file);
+    return count;
+}
+
+static _Bool bench_regressed(const char* name, const char* metric,
+                             f64 baseline, f64 value, f64 threshold) {
+    const f64 change = baseline > 0.0 ? (value - baseline) / baseline : 0.0;
+    const _Bool regressed = change * 100.0 > threshold;
+    printf("%-16s %-15s %12.4f %12.4f %+8.2f%%%s\n", name, metric, baseline,
+           value, change * 100.0, regressed ? "  REGRESSION" : "");
+    return regressed;
+}
+
+static int bench_compare(const char* baseline_path, const char* results_path,
+                         f64 threshold) {
+    BenchResult baseline[BENCH_MAX_SCENES], results[BENCH_MAX_SCENES];
+    const u32 baseline_count = bench_results_read(baseline_path, baseline);
+    const u32 result_count = bench_results_read(results_path, results);
+
+    printf("%-16s %-15s %12s %12s %9s\n", "scene", "metric", "baseline",
+           "result", "change");
+    u32 regressions = 0;
+    for (u32 i = 0; i < result_count; i++) {
+        const BenchResult* const r = &results[i];
+        const BenchResult* b = NULL;
+        for (u32 j = 0; j < baseline_count; j++)
+            if (strcmp(baseline[j].name, r->name) == 0) b = &baseline[j];
+        if (!b) {
+            printf("%-16s not in the baseline\n", r->name);
+            continue;
+        }
+
+        regressions += bench_regressed(r->name, "mean_ms", b->mean_ms,
+                                       r->mean_ms, threshold);
+        regressions += bench_regressed(r->name, "p95_ms", b->p95_ms,
+                                       r->p95_ms, threshold);
+        // Deterministic, any increase is a regression
+        regressions += bench_regressed(r->name, "draw_calls", b->draw_calls,
+                                       r->draw_calls, 0.0);
+        regressions += bench_regressed(r->name, "triangles", b->triangles,
+                                       r->triangles, 0.0);
+        regressions +=
+            bench_regressed(r->name, "bytes_uploaded", b->bytes_uploaded,
+                            r->bytes_uploaded, 0.0);
+    }
+
+    printf("Regressions: %u (threshold %.1f%%)\n", regressions, threshold);
+    return regressions ? 1 : 0;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc >= 4 && strcmp(argv[1], "compare") == 0) {
+        const f64 threshold = argc >= 5 ? strtod(argv[4], NULL) : 5.0;
+        return bench_compare(argv[2], argv[3], threshold);
+    }
+
+    const RendererBackend backend = renderer_backend_from_env();
+    const char* const frames_env = getenv("FRAMES");
+    const u32 frames_override =
+        frames_env ? (u32)strtoul(frames_env, NULL, 10) : 0;
+    const char* const filter = getenv("SCENES");
+
+    BenchResult results[ARR_SIZE(bench_scenes)];
+    u32 result_count = 0;
+    for (u32 i = 0; i < ARR_SIZE(bench_scenes); i++) {
+        const BenchScene* const bench = &bench_scenes[i];
+        if (filter && !strstr(bench->desc.name, filter)) continue;
+
+        const u32 frames = frames_override ? frames_override : bench->frames;
+        BenchResult* const result = &results[result_count];
+        if (!bench_run(backend, bench, frames, result)) return 1;
+        result_count++;
+
+        printf("%-16s mean=%.3fms p95=%.3fms p99=%.3fms draw_calls=%.0f "
+               "triangles=%.0f bytes_uploaded=%.0f\n",
+               result->name, result->mean_ms, result->p95_ms, result->p99_ms,
+               result->draw_calls, result->triangles,
+               result->bytes_uploaded);
+    }
+
+    const char* const path = argc >= 2 ? argv[1] : "bench_results.json";
+    FILE* const file = fopen(path, "w");
+    if (!file) {
+        fprintf(stderr, "Could not open %s: %s\n", path, strerror(errno));
+        return errno;
+    }
+    fprintf(file, "{\n  \"backend\": \"%s\",\n  \"warmup_frames\": %u,\n",
+            renderer_backend_name(backend), BENCH_WARMUP_FRAMES);
+    fprintf(file, "  \"scenes\": [\n");
+    for (u32 i = 0; i < result_count; i++)
+        bench_result_write(file, &results[i], i + 1 == result_count);
+    fprintf(file, "  ]\n}\n");
+    fclose(file);
+
+    printf("Results written to %s\n", path);
+    return 0;
+}
@@ -36,3 +36,46 @@ void bmp_load(const char file_path[], u8** data, usize data_capacity,
     if (*img_size == 0) *img_size = *width * *height * 3;
     if (*data_pos == 0) *data_pos = header_len;
 }
+
+static void bmp_put_u16(u8* at, u16 value) {
+    at[0] = (u8)value;
+    at[1] = (u8)(value >> 8);
+}
+
+static void bmp_put_u32(u8* at, u32 value) {
+    for (u32 i = 0; i < 4; i++) at[i] = (u8)(value >> (8 * i));
+}
+
+i32 bmp_write(const char file_path[], u32 width, u32 height, const u8* bgr) {
+    const u8 header_len = 54;
+    const u32 img_size = (width * 3 + 3) / 4 * 4 * height;
+
+    // BITMAPFILEHEADER then BITMAPINFOHEADER, little endian
+    u8 header[54] = {'B', 'M'};
+    bmp_put_u32(&header[0x02], header_len + img_size);
+    bmp_put_u32(&header[0x0a], header_len);
+    bmp_put_u32(&header[0x0e], 40);
+    bmp_put_u32(&header[0x12], width);
+    bmp_put_u32(&header[0x16], height);
+    bmp_put_u16(&header[0x1a], 1);
+    bmp_put_u16(&header[0x1c], 24);
+    bmp_put_u32(&header[0x22], img_size);
+    bmp_put_u32(&header[0x26], 2835);  // 72 DPI
+    bmp_put_u32(&header[0x2a], 2835);
+
+    FILE* const file = fopen(file_path, "wb");
+    if (!file) {
+        fprintf(stderr, "Could not open the file `%s`: errno=%d error=%s\n",
+                file_path, errno, strerror(errno));
+        return errno;
+    }
+    _Bool written = fwrite(header, 1, header_len, file) == header_len &&
+                    fwrite(bgr, 1, img_size, file) == img_size;
+    written = fclose(file) == 0 && written;
+    if (!written) {
+        fprintf(stderr, "Could not write the file `%s`: errno=%d error=%s\n",
+                file_path, errno, strerror(errno));
+        return errno ? errno : EIO;
+    }
+    return 0;
+}
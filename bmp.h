@@ -5,3 +5,7 @@ void bmp_load(const char file_path[], u8** data, usize data_capacity,
               usize* data_len, usize* width, usize* height, usize* img_size,
               usize* data_pos);
 
+// 24 bits BGR pixels, bottom row first, rows padded to 4 bytes: the layout
+// of glReadPixels with GL_BGR. Returns 0 or errno.
+i32 bmp_write(const char file_path[], u32 width, u32 height, const u8* bgr);
+
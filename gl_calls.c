@@ -0,0 +1,986 @@
+// The wrappers call the real entry points
+#define GL_CALLS_IMPLEMENTATION
+#include "gl_calls.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gl_capture.h"
+
+#ifdef GL_CALLS_WRAPPERS
+
+#define GL_CALLS_MAX_ATTRIBS 16
+#define GL_CALLS_MAX_TEXTURE_UNITS 16
+#define GL_CALLS_MAX_CAPABILITIES 16
+#define GL_CALLS_MAX_UNIFORMS 32
+// A binding which was never set through the wrappers, any call changes it
+#define GL_CALLS_UNKNOWN 0xffffffffu
+
+typedef enum {
+    GL_CALLS_BUFFER_ARRAY,
+    GL_CALLS_BUFFER_ELEMENT_ARRAY,  // Vertex array state
+    GL_CALLS_BUFFER_PIXEL_PACK,
+    GL_CALLS_BUFFER_PIXEL_UNPACK,
+    GL_CALLS_BUFFER_UNIFORM,
+    GL_CALLS_BUFFER_TRANSFORM_FEEDBACK,
+    GL_CALLS_BUFFER_COPY_READ,
+    GL_CALLS_BUFFER_COPY_WRITE,
+    GL_CALLS_BUFFER_TEXTURE,
+    GL_CALLS_BUFFER_TARGET_COUNT,
+} GlCallsBufferTarget;
+
+typedef enum {
+    GL_CALLS_TEXTURE_2D,
+    GL_CALLS_TEXTURE_2D_ARRAY,
+    GL_CALLS_TEXTURE_3D,
+    GL_CALLS_TEXTURE_CUBE_MAP,
+    GL_CALLS_TEXTURE_BUFFER,
+    GL_CALLS_TEXTURE_TARGET_COUNT,
+} GlCallsTextureTarget;
+
+// Vertex array state
+typedef struct {
+    _Bool enabled_known, enabled;
+    _Bool pointer_known;
+    GLuint buffer;
+    GLint size;
+    GLenum type;
+    GLboolean normalized;
+    GLsizei stride;
+    const void* pointer;
+    _Bool divisor_known;
+    GLuint divisor;
+} GlCallsAttrib;
+
+typedef struct {
+    GLuint program;
+    GLint location;
+    GLboolean transpose;
+    GLfloat value[16];
+} GlCallsUniform;
+
+typedef struct {
+    GLenum capability;
+    _Bool enabled;
+} GlCallsCapability;
+
+static struct {
+    u32 report_interval;
+    u64 frame_count;
+    GlCallsFrame frame;
+    GlCallsFrame total;
+
+    // Shadowed state
+    GLuint buffers[GL_CALLS_BUFFER_TARGET_COUNT];
+    GLuint textures[GL_CALLS_MAX_TEXTURE_UNITS][GL_CALLS_TEXTURE_TARGET_COUNT];
+    u32 texture_unit;
+    GLuint vertex_array;
+    GLuint program;
+    GLuint draw_framebuffer, read_framebuffer;
+    GLuint renderbuffer;
+    GlCallsAttrib attribs[GL_CALLS_MAX_ATTRIBS];
+
+    // Last values, replaced in turn when full
+    GlCallsUniform uniforms[GL_CALLS_MAX_UNIFORMS];
+    u32 uniform_count, uniform_next;
+
+    GlCallsCapability capabilities[GL_CALLS_MAX_CAPABILITIES];
+    u32 capability_count;
+
+    _Bool viewport_known;
+    GLint viewport[4];
+    _Bool clear_color_known;
+    GLfloat clear_color[4];
+    _Bool blend_func_known;
+    GLenum blend_func[2];
+    _Bool depth_mask_known;
+    GLboolean depth_mask;
+} gl_calls = {
+    .buffers = {GL_CALLS_UNKNOWN, GL_CALLS_UNKNOWN, GL_CALLS_UNKNOWN,
+                GL_CALLS_UNKNOWN, GL_CALLS_UNKNOWN, GL_CALLS_UNKNOWN,
+                GL_CALLS_UNKNOWN, GL_CALLS_UNKNOWN, GL_CALLS_UNKNOWN},
+    .vertex_array = GL_CALLS_UNKNOWN,
+    .program = GL_CALLS_UNKNOWN,
+    .draw_framebuffer = GL_CALLS_UNKNOWN,
+    .read_framebuffer = GL_CALLS_UNKNOWN,
+    .renderbuffer = GL_CALLS_UNKNOWN,
+};
+
+static void gl_calls_forget_textures(void) {
+    for (u32 i = 0; i < GL_CALLS_MAX_TEXTURE_UNITS; i++) {
+        for (u32 j = 0; j < GL_CALLS_TEXTURE_TARGET_COUNT; j++)
+            gl_calls.textures[i][j] = GL_CALLS_UNKNOWN;
+    }
+}
+
+static void gl_calls_forget_vertex_array(void) {
+    memset(gl_calls.attribs, 0, sizeof(gl_calls.attribs));
+    gl_calls.buffers[GL_CALLS_BUFFER_ELEMENT_ARRAY] = GL_CALLS_UNKNOWN;
+}
+
+void gl_calls_init(void) {
+    gl_calls_forget_textures();
+    gl_capture_init();
+
+#ifndef GL_CALLS_DISABLE
+    const char* const interval = getenv("GL_CALLS");
+    if (interval) {
+        const i32 n = atoi(interval);
+        gl_calls.report_interval = n > 0 ? (u32)n : 1;
+    }
+#endif
+}
+
+#ifdef GL_CALLS_DISABLE
+// Capture only, nothing is counted
+#define gl_calls_count(category) ((void)0)
+#define gl_calls_redundant(category) ((void)0)
+#else
+void gl_calls_count(GlCallsCategory category) {
+    gl_calls.frame.calls[category] += 1;
+}
+
+static void gl_calls_redundant(GlCallsCategory category) {
+    gl_calls.frame.redundant[category] += 1;
+}
+#endif
+
+static void gl_calls_capture_names(GlCaptureOp op, GLsizei count,
+                                   const GLuint* names) {
+    if (gl_capture_state != GL_CAPTURE_IDLE)
+        gl_capture_call(op, names, (u32)count, NULL, 0);
+}
+
+//
+// Bindings
+//
+static i32 gl_calls_buffer_target(GLenum target) {
+    switch (target) {
+        case GL_ARRAY_BUFFER: return GL_CALLS_BUFFER_ARRAY;
+        case GL_ELEMENT_ARRAY_BUFFER: return GL_CALLS_BUFFER_ELEMENT_ARRAY;
+        case GL_PIXEL_PACK_BUFFER: return GL_CALLS_BUFFER_PIXEL_PACK;
+        case GL_PIXEL_UNPACK_BUFFER: return GL_CALLS_BUFFER_PIXEL_UNPACK;
+        case GL_UNIFORM_BUFFER: return GL_CALLS_BUFFER_UNIFORM;
+        case GL_TRANSFORM_FEEDBACK_BUFFER:
+            return GL_CALLS_BUFFER_TRANSFORM_FEEDBACK;
+        case GL_COPY_READ_BUFFER: return GL_CALLS_BUFFER_COPY_READ;
+        case GL_COPY_WRITE_BUFFER: return GL_CALLS_BUFFER_COPY_WRITE;
+        case GL_TEXTURE_BUFFER: return GL_CALLS_BUFFER_TEXTURE;
+        default: return -1;
+    }
+}
+
+// Name bound to `target`, GL_CALLS_UNKNOWN if not shadowed
+static GLuint gl_calls_bound_buffer(GLenum target) {
+    const i32 index = gl_calls_buffer_target(target);
+    return index >= 0 ? gl_calls.buffers[index] : GL_CALLS_UNKNOWN;
+}
+
+static i32 gl_calls_texture_target(GLenum target) {
+    switch (target) {
+        case GL_TEXTURE_2D: return GL_CALLS_TEXTURE_2D;
+        case GL_TEXTURE_2D_ARRAY: return GL_CALLS_TEXTURE_2D_ARRAY;
+        case GL_TEXTURE_3D: return GL_CALLS_TEXTURE_3D;
+        case GL_TEXTURE_CUBE_MAP: return GL_CALLS_TEXTURE_CUBE_MAP;
+        case GL_TEXTURE_BUFFER: return GL_CALLS_TEXTURE_BUFFER;
+        default: return -1;
+    }
+}
+
+void gl_calls_bind_buffer(GLenum target, GLuint buffer) {
+    gl_calls_count(GL_CALLS_BIND);
+
+    const i32 index = gl_calls_buffer_target(target);
+    if (index >= 0) {
+        if (gl_calls.buffers[index] == buffer)
+            gl_calls_redundant(GL_CALLS_BIND);
+        gl_calls.buffers[index] = buffer;
+    }
+    GL_CAPTURE_CALL(GL_CAPTURE_BIND_BUFFER, NULL, 0, target, buffer);
+    glBindBuffer(target, buffer);
+}
+
+void gl_calls_bind_texture(GLenum target, GLuint texture) {
+    gl_calls_count(GL_CALLS_BIND);
+
+    const i32 index = gl_calls_texture_target(target);
+    if (index >= 0 && gl_calls.texture_unit < GL_CALLS_MAX_TEXTURE_UNITS) {
+        GLuint* const bound = &gl_calls.textures[gl_calls.texture_unit][index];
+        if (*bound == texture) gl_calls_redundant(GL_CALLS_BIND);
+        *bound = texture;
+    }
+    GL_CAPTURE_CALL(GL_CAPTURE_BIND_TEXTURE, NULL, 0, target, texture);
+    glBindTexture(target, texture);
+}
+
+void gl_calls_active_texture(GLenum unit) {
+    gl_calls_count(GL_CALLS_BIND);
+
+    if (unit - GL_TEXTURE0 == gl_calls.texture_unit)
+        gl_calls_redundant(GL_CALLS_BIND);
+    gl_calls.texture_unit = unit - GL_TEXTURE0;
+    GL_CAPTURE_CALL(GL_CAPTURE_ACTIVE_TEXTURE, NULL, 0, unit);
+    glActiveTexture(unit);
+}
+
+void gl_calls_bind_vertex_array(GLuint vertex_array) {
+    gl_calls_count(GL_CALLS_BIND);
+
+    if (gl_calls.vertex_array == vertex_array) {
+        gl_calls_redundant(GL_CALLS_BIND);
+    } else {
+        gl_calls_forget_vertex_array();
+    }
+    gl_calls.vertex_array = vertex_array;
+    GL_CAPTURE_CALL(GL_CAPTURE_BIND_VERTEX_ARRAY, NULL, 0, vertex_array);
+    glBindVertexArray(vertex_array);
+}
+
+void gl_calls_use_program(GLuint program) {
+    gl_calls_count(GL_CALLS_BIND);
+
+    if (gl_calls.program == program) gl_calls_redundant(GL_CALLS_BIND);
+    gl_calls.program = program;
+    GL_CAPTURE_CALL(GL_CAPTURE_USE_PROGRAM, NULL, 0, program);
+    glUseProgram(program);
+}
+
+void gl_calls_bind_framebuffer(GLenum target, GLuint framebuffer) {
+    gl_calls_count(GL_CALLS_BIND);
+
+    const _Bool draw = target != GL_READ_FRAMEBUFFER;
+    const _Bool read = target != GL_DRAW_FRAMEBUFFER;
+    if ((!draw || gl_calls.draw_framebuffer == framebuffer) &&
+        (!read || gl_calls.read_framebuffer == framebuffer))
+        gl_calls_redundant(GL_CALLS_BIND);
+    if (draw) gl_calls.draw_framebuffer = framebuffer;
+    if (read) gl_calls.read_framebuffer = framebuffer;
+    GL_CAPTURE_CALL(GL_CAPTURE_BIND_FRAMEBUFFER, NULL, 0, target,
+                    framebuffer);
+    glBindFramebuffer(target, framebuffer);
+}
+
+void gl_calls_bind_renderbuffer(GLenum target, GLuint renderbuffer) {
+    gl_calls_count(GL_CALLS_BIND);
+
+    if (gl_calls.renderbuffer == renderbuffer)
+        gl_calls_redundant(GL_CALLS_BIND);
+    gl_calls.renderbuffer = renderbuffer;
+    GL_CAPTURE_CALL(GL_CAPTURE_BIND_RENDERBUFFER, NULL, 0, target,
+                    renderbuffer);
+    glBindRenderbuffer(target, renderbuffer);
+}
+
+// Binds the generic target too, the indexed bindings are not shadowed
+void gl_calls_bind_buffer_base(GLenum target, GLuint index, GLuint buffer) {
+    gl_calls_count(GL_CALLS_BIND);
+
+    const i32 generic = gl_calls_buffer_target(target);
+    if (generic >= 0) gl_calls.buffers[generic] = buffer;
+    GL_CAPTURE_CALL(GL_CAPTURE_BIND_BUFFER_BASE, NULL, 0, target, index,
+                    buffer);
+    glBindBufferBase(target, index, buffer);
+}
+
+// Deleted names are unbound, and may be handed out again
+void gl_calls_delete_buffers(GLsizei count, const GLuint* buffers) {
+    gl_calls_count(GL_CALLS_OTHER);
+
+    for (GLsizei i = 0; i < count; i++) {
+        for (u32 j = 0; j < GL_CALLS_BUFFER_TARGET_COUNT; j++) {
+            if (gl_calls.buffers[j] == buffers[i]) gl_calls.buffers[j] = 0;
+        }
+        for (u32 j = 0; j < GL_CALLS_MAX_ATTRIBS; j++) {
+            if (gl_calls.attribs[j].buffer == buffers[i])
+                gl_calls.attribs[j].pointer_known = false;
+        }
+    }
+    gl_calls_capture_names(GL_CAPTURE_DELETE_BUFFERS, count, buffers);
+    gl_capture_buffers_deleted(count, buffers);
+    glDeleteBuffers(count, buffers);
+}
+
+void gl_calls_delete_textures(GLsizei count, const GLuint* textures) {
+    gl_calls_count(GL_CALLS_OTHER);
+
+    for (GLsizei i = 0; i < count; i++) {
+        for (u32 j = 0; j < GL_CALLS_MAX_TEXTURE_UNITS; j++) {
+            for (u32 k = 0; k < GL_CALLS_TEXTURE_TARGET_COUNT; k++) {
+                if (gl_calls.textures[j][k] == textures[i])
+                    gl_calls.textures[j][k] = 0;
+            }
+        }
+    }
+    gl_calls_capture_names(GL_CAPTURE_DELETE_TEXTURES, count, textures);
+    glDeleteTextures(count, textures);
+}
+
+void gl_calls_delete_vertex_arrays(GLsizei count, const GLuint* arrays) {
+    gl_calls_count(GL_CALLS_OTHER);
+
+    for (GLsizei i = 0; i < count; i++) {
+        if (gl_calls.vertex_array == arrays[i]) {
+            gl_calls.vertex_array = 0;
+            gl_calls_forget_vertex_array();
+        }
+    }
+    gl_calls_capture_names(GL_CAPTURE_DELETE_VERTEX_ARRAYS, count, arrays);
+    glDeleteVertexArrays(count, arrays);
+}
+
+void gl_calls_delete_program(GLuint program) {
+    gl_calls_count(GL_CALLS_OTHER);
+
+    for (u32 i = 0; i < gl_calls.uniform_count; i++) {
+        if (gl_calls.uniforms[i].program == program)
+            gl_calls.uniforms[i].program = GL_CALLS_UNKNOWN;
+    }
+    GL_CAPTURE_CALL(GL_CAPTURE_DELETE_PROGRAM, NULL, 0, program);
+    glDeleteProgram(program);
+}
+
+void gl_calls_delete_framebuffers(GLsizei count, const GLuint* framebuffers) {
+    gl_calls_count(GL_CALLS_OTHER);
+
+    for (GLsizei i = 0; i < count; i++) {
+        if (gl_calls.draw_framebuffer == framebuffers[i])
+            gl_calls.draw_framebuffer = 0;
+        if (gl_calls.read_framebuffer == framebuffers[i])
+            gl_calls.read_framebuffer = 0;
+    }
+    gl_calls_capture_names(GL_CAPTURE_DELETE_FRAMEBUFFERS, count,
+                           framebuffers);
+    glDeleteFramebuffers(count, framebuffers);
+}
+
+void gl_calls_delete_renderbuffers(GLsizei count,
+                                   const GLuint* renderbuffers) {
+    gl_calls_count(GL_CALLS_OTHER);
+
+    for (GLsizei i = 0; i < count; i++) {
+        if (gl_calls.renderbuffer == renderbuffers[i])
+            gl_calls.renderbuffer = 0;
+    }
+    gl_calls_capture_names(GL_CAPTURE_DELETE_RENDERBUFFERS, count,
+                           renderbuffers);
+    glDeleteRenderbuffers(count, renderbuffers);
+}
+
+//
+// Uniforms
+//
+void gl_calls_uniform_matrix4fv(GLint location, GLsizei count,
+                                GLboolean transpose, const GLfloat* value) {
+    gl_calls_count(GL_CALLS_UNIFORM);
+    GL_CAPTURE_CALL(GL_CAPTURE_UNIFORM_MATRIX4FV, value,
+                    (u32)(sizeof(GLfloat) * 16 * (u32)count), (u32)location,
+                    (u32)count, transpose);
+    glUniformMatrix4fv(location, count, transpose, value);
+
+    // Arrays are only counted
+    if (count != 1 || gl_calls.program == GL_CALLS_UNKNOWN) return;
+
+    GlCallsUniform* uniform = NULL;
+    for (u32 i = 0; i < gl_calls.uniform_count; i++) {
+        GlCallsUniform* const u = &gl_calls.uniforms[i];
+        if (u->program == gl_calls.program && u->location == location) {
+            uniform = u;
+            break;
+        }
+    }
+
+    if (uniform) {
+        if (uniform->transpose == transpose &&
+            memcmp(uniform->value, value, sizeof(uniform->value)) == 0)
+            gl_calls_redundant(GL_CALLS_UNIFORM);
+    } else if (gl_calls.uniform_count < GL_CALLS_MAX_UNIFORMS) {
+        uniform = &gl_calls.uniforms[gl_calls.uniform_count++];
+    } else {
+        uniform = &gl_calls.uniforms[gl_calls.uniform_next];
+        gl_calls.uniform_next =
+            (gl_calls.uniform_next + 1) % GL_CALLS_MAX_UNIFORMS;
+    }
+
+    uniform->program = gl_calls.program;
+    uniform->location = location;
+    uniform->transpose = transpose;
+    memcpy(uniform->value, value, sizeof(uniform->value));
+}
+
+// Vectors and samplers are only counted
+void gl_calls_uniform_4fv(GLint location, GLsizei count,
+                          const GLfloat* value) {
+    gl_calls_count(GL_CALLS_UNIFORM);
+    GL_CAPTURE_CALL(GL_CAPTURE_UNIFORM_4FV, value,
+                    (u32)(sizeof(GLfloat) * 4 * (u32)count), (u32)location,
+                    (u32)count);
+    glUniform4fv(location, count, value);
+}
+
+void gl_calls_uniform_1i(GLint location, GLint value) {
+    gl_calls_count(GL_CALLS_UNIFORM);
+    GL_CAPTURE_CALL(GL_CAPTURE_UNIFORM_1I, NULL, 0, (u32)location,
+                    (u32)value);
+    glUniform1i(location, value);
+}
+
+//
+// Uploads
+//
+void gl_calls_buffer_data(GLenum target, GLsizeiptr size, const void* data,
+                          GLenum usage) {
+    gl_calls_count(GL_CALLS_BUFFER_UPLOAD);
+    // Without data, only allocates (or orphans)
+    if (data) gl_calls.frame.buffer_bytes += (u64)size;
+
+    if (!gl_capture_buffer_data(gl_calls_bound_buffer(target), usage,
+                                (u64)size, data)) {
+        GL_CAPTURE_CALL(GL_CAPTURE_BUFFER_DATA, data, data ? (u32)size : 0,
+                        target, GL_CAPTURE_U64(size), usage);
+    }
+    glBufferData(target, size, data, usage);
+}
+
+void gl_calls_buffer_sub_data(GLenum target, GLintptr offset,
+                              GLsizeiptr size, const void* data) {
+    gl_calls_count(GL_CALLS_BUFFER_UPLOAD);
+    gl_calls.frame.buffer_bytes += (u64)size;
+
+    if (!gl_capture_buffer_sub_data(gl_calls_bound_buffer(target),
+                                    (u64)offset, (u64)size, data)) {
+        GL_CAPTURE_CALL(GL_CAPTURE_BUFFER_SUB_DATA, data, (u32)size, target,
+                        GL_CAPTURE_U64(offset));
+    }
+    glBufferSubData(target, offset, size, data);
+}
+
+static u32 gl_calls_pixel_size(GLenum format, GLenum type) {
+    u32 components = 4;
+    switch (format) {
+        case GL_RED:
+        case GL_DEPTH_COMPONENT: components = 1; break;
+        case GL_RG: components = 2; break;
+        case GL_RGB:
+        case GL_BGR: components = 3; break;
+        default: break;
+    }
+    switch (type) {
+        case GL_UNSIGNED_SHORT:
+        case GL_HALF_FLOAT: return components * 2;
+        case GL_FLOAT:
+        case GL_UNSIGNED_INT: return components * 4;
+        default: return components;
+    }
+}
+
+void gl_calls_tex_image_2d(GLenum target, GLint level, GLint internal_format,
+                           GLsizei width, GLsizei height, GLint border,
+                           GLenum format, GLenum type, const void* pixels) {
+    gl_calls_count(GL_CALLS_TEXTURE_UPLOAD);
+
+    // Rows are aligned to 4 bytes, the default unpack alignment
+    const u64 row_size =
+        ((u64)width * gl_calls_pixel_size(format, type) + 3) & ~(u64)3;
+    const u64 size = row_size * (u64)height;
+    // From the unpack buffer, `pixels` is an offset in it
+    const GLuint unpack = gl_calls.buffers[GL_CALLS_BUFFER_PIXEL_UNPACK];
+    const _Bool from_buffer = unpack != 0 && unpack != GL_CALLS_UNKNOWN;
+    if (pixels && !from_buffer) gl_calls.frame.texture_bytes += size;
+
+    const void* const data = from_buffer ? NULL : pixels;
+    GL_CAPTURE_CALL(GL_CAPTURE_TEX_IMAGE_2D, data, data ? (u32)size : 0,
+                    target, (u32)level, (u32)internal_format, (u32)width,
+                    (u32)height, (u32)border, format, type,
+                    GL_CAPTURE_U64(from_buffer ? (uintptr_t)pixels : 0));
+    glTexImage2D(target, level, internal_format, width, height, border, format,
+                 type, pixels);
+}
+
+void gl_calls_tex_image_3d(GLenum target, GLint level, GLint internal_format,
+                           GLsizei width, GLsizei height, GLsizei depth,
+                           GLint border, GLenum format, GLenum type,
+                           const void* pixels) {
+    gl_calls_count(GL_CALLS_TEXTURE_UPLOAD);
+
+    // Layers of rows aligned to 4 bytes
+    const u64 row_size =
+        ((u64)width * gl_calls_pixel_size(format, type) + 3) & ~(u64)3;
+    const u64 size = row_size * (u64)height * (u64)depth;
+    const GLuint unpack = gl_calls.buffers[GL_CALLS_BUFFER_PIXEL_UNPACK];
+    const _Bool from_buffer = unpack != 0 && unpack != GL_CALLS_UNKNOWN;
+    if (pixels && !from_buffer) gl_calls.frame.texture_bytes += size;
+
+    const void* const data = from_buffer ? NULL : pixels;
+    GL_CAPTURE_CALL(GL_CAPTURE_TEX_IMAGE_3D, data, data ? (u32)size : 0,
+                    target, (u32)level, (u32)internal_format, (u32)width,
+                    (u32)height, (u32)depth, (u32)border, format, type,
+                    GL_CAPTURE_U64(from_buffer ? (uintptr_t)pixels : 0));
+    glTexImage3D(target, level, internal_format, width, height, depth, border,
+                 format, type, pixels);
+}
+
+//
+// Fixed function and vertex array state
+//
+static GlCallsCapability* gl_calls_capability(GLenum capability) {
+    for (u32 i = 0; i < gl_calls.capability_count; i++) {
+        if (gl_calls.capabilities[i].capability == capability)
+            return &gl_calls.capabilities[i];
+    }
+    if (gl_calls.capability_count == GL_CALLS_MAX_CAPABILITIES) return NULL;
+
+    GlCallsCapability* const c =
+        &gl_calls.capabilities[gl_calls.capability_count++];
+    c->capability = capability;
+    c->enabled = glIsEnabled(capability) == GL_TRUE;
+    return c;
+}
+
+static void gl_calls_set_capability(GLenum capability, _Bool enabled) {
+    gl_calls_count(GL_CALLS_STATE);
+
+    GlCallsCapability* const c = gl_calls_capability(capability);
+    if (!c) return;
+    if (c->enabled == enabled) gl_calls_redundant(GL_CALLS_STATE);
+    c->enabled = enabled;
+}
+
+void gl_calls_enable(GLenum capability) {
+    gl_calls_set_capability(capability, true);
+    GL_CAPTURE_CALL(GL_CAPTURE_ENABLE, NULL, 0, capability);
+    glEnable(capability);
+}
+
+void gl_calls_disable(GLenum capability) {
+    gl_calls_set_capability(capability, false);
+    GL_CAPTURE_CALL(GL_CAPTURE_DISABLE, NULL, 0, capability);
+    glDisable(capability);
+}
+
+void gl_calls_viewport(GLint x, GLint y, GLsizei width, GLsizei height) {
+    gl_calls_count(GL_CALLS_STATE);
+
+    const GLint viewport[4] = {x, y, width, height};
+    if (gl_calls.viewport_known &&
+        memcmp(gl_calls.viewport, viewport, sizeof(viewport)) == 0)
+        gl_calls_redundant(GL_CALLS_STATE);
+    memcpy(gl_calls.viewport, viewport, sizeof(viewport));
+    gl_calls.viewport_known = true;
+    GL_CAPTURE_CALL(GL_CAPTURE_VIEWPORT, NULL, 0, (u32)x, (u32)y,
+                    (u32)width, (u32)height);
+    glViewport(x, y, width, height);
+}
+
+void gl_calls_clear_color(GLfloat r, GLfloat g, GLfloat b, GLfloat a) {
+    gl_calls_count(GL_CALLS_STATE);
+
+    const GLfloat color[4] = {r, g, b, a};
+    if (gl_calls.clear_color_known &&
+        memcmp(gl_calls.clear_color, color, sizeof(color)) == 0)
+        gl_calls_redundant(GL_CALLS_STATE);
+    memcpy(gl_calls.clear_color, color, sizeof(color));
+    gl_calls.clear_color_known = true;
+    GL_CAPTURE_CALL(GL_CAPTURE_CLEAR_COLOR, NULL, 0, gl_capture_f32(r),
+                    gl_capture_f32(g), gl_capture_f32(b), gl_capture_f32(a));
+    glClearColor(r, g, b, a);
+}
+
+void gl_calls_enable_vertex_attrib_array(GLuint index) {
+    gl_calls_count(GL_CALLS_STATE);
+
+    if (index < GL_CALLS_MAX_ATTRIBS) {
+        GlCallsAttrib* const a = &gl_calls.attribs[index];
+        if (a->enabled_known && a->enabled)
+            gl_calls_redundant(GL_CALLS_STATE);
+        a->enabled_known = a->enabled = true;
+    }
+    GL_CAPTURE_CALL(GL_CAPTURE_ENABLE_VERTEX_ATTRIB_ARRAY, NULL, 0, index);
+    glEnableVertexAttribArray(index);
+}
+
+void gl_calls_vertex_attrib_pointer(GLuint index, GLint size, GLenum type,
+                                    GLboolean normalized, GLsizei stride,
+                                    const void* pointer) {
+    gl_calls_count(GL_CALLS_STATE);
+
+    // The pointer is relative to the bound array buffer
+    const GLuint buffer = gl_calls.buffers[GL_CALLS_BUFFER_ARRAY];
+    if (index < GL_CALLS_MAX_ATTRIBS && buffer != GL_CALLS_UNKNOWN) {
+        GlCallsAttrib* const a = &gl_calls.attribs[index];
+        if (a->pointer_known && a->buffer == buffer && a->size == size &&
+            a->type == type && a->normalized == normalized &&
+            a->stride == stride && a->pointer == pointer)
+            gl_calls_redundant(GL_CALLS_STATE);
+
+        a->pointer_known = true;
+        a->buffer = buffer;
+        a->size = size;
+        a->type = type;
+        a->normalized = normalized;
+        a->stride = stride;
+        a->pointer = pointer;
+    }
+    GL_CAPTURE_CALL(GL_CAPTURE_VERTEX_ATTRIB_POINTER, NULL, 0, index,
+                    (u32)size, type, normalized, (u32)stride,
+                    GL_CAPTURE_U64((uintptr_t)pointer));
+    glVertexAttribPointer(index, size, type, normalized, stride, pointer);
+}
+
+void gl_calls_vertex_attrib_divisor(GLuint index, GLuint divisor) {
+    gl_calls_count(GL_CALLS_STATE);
+
+    if (index < GL_CALLS_MAX_ATTRIBS) {
+        GlCallsAttrib* const a = &gl_calls.attribs[index];
+        if (a->divisor_known && a->divisor == divisor)
+            gl_calls_redundant(GL_CALLS_STATE);
+        a->divisor_known = true;
+        a->divisor = divisor;
+    }
+    GL_CAPTURE_CALL(GL_CAPTURE_VERTEX_ATTRIB_DIVISOR, NULL, 0, index,
+                    divisor);
+    glVertexAttribDivisor(index, divisor);
+}
+
+void gl_calls_blend_func(GLenum source, GLenum destination) {
+    gl_calls_count(GL_CALLS_STATE);
+
+    if (gl_calls.blend_func_known && gl_calls.blend_func[0] == source &&
+        gl_calls.blend_func[1] == destination)
+        gl_calls_redundant(GL_CALLS_STATE);
+    gl_calls.blend_func[0] = source;
+    gl_calls.blend_func[1] = destination;
+    gl_calls.blend_func_known = true;
+    GL_CAPTURE_CALL(GL_CAPTURE_BLEND_FUNC, NULL, 0, source, destination);
+    glBlendFunc(source, destination);
+}
+
+void gl_calls_depth_mask(GLboolean flag) {
+    gl_calls_count(GL_CALLS_STATE);
+
+    if (gl_calls.depth_mask_known && gl_calls.depth_mask == flag)
+        gl_calls_redundant(GL_CALLS_STATE);
+    gl_calls.depth_mask = flag;
+    gl_calls.depth_mask_known = true;
+    GL_CAPTURE_CALL(GL_CAPTURE_DEPTH_MASK, NULL, 0, flag);
+    glDepthMask(flag);
+}
+
+//
+// Work
+//
+void gl_calls_clear(GLbitfield mask) {
+    gl_calls_count(GL_CALLS_DRAW);
+    GL_CAPTURE_CALL(GL_CAPTURE_CLEAR, NULL, 0, mask);
+    glClear(mask);
+}
+
+void gl_calls_draw_arrays(GLenum mode, GLint first, GLsizei count) {
+    gl_calls_count(GL_CALLS_DRAW);
+    GL_CAPTURE_CALL(GL_CAPTURE_DRAW_ARRAYS, NULL, 0, mode, (u32)first,
+                    (u32)count);
+    glDrawArrays(mode, first, count);
+}
+
+void gl_calls_draw_arrays_instanced(GLenum mode, GLint first, GLsizei count,
+                                    GLsizei instance_count) {
+    gl_calls_count(GL_CALLS_DRAW);
+    GL_CAPTURE_CALL(GL_CAPTURE_DRAW_ARRAYS_INSTANCED, NULL, 0, mode,
+                    (u32)first, (u32)count, (u32)instance_count);
+    glDrawArraysInstanced(mode, first, count, instance_count);
+}
+
+void gl_calls_begin_transform_feedback(GLenum mode) {
+    gl_calls_count(GL_CALLS_STATE);
+    GL_CAPTURE_CALL(GL_CAPTURE_BEGIN_TRANSFORM_FEEDBACK, NULL, 0, mode);
+    glBeginTransformFeedback(mode);
+}
+
+void gl_calls_end_transform_feedback(void) {
+    gl_calls_count(GL_CALLS_STATE);
+    if (gl_capture_state != GL_CAPTURE_IDLE) {
+        gl_capture_call(GL_CAPTURE_END_TRANSFORM_FEEDBACK, NULL, 0, NULL,
+                        0);
+    }
+    glEndTransformFeedback();
+}
+
+void gl_calls_flush(void) {
+    gl_calls_count(GL_CALLS_OTHER);
+    if (gl_capture_state != GL_CAPTURE_IDLE)
+        gl_capture_call(GL_CAPTURE_FLUSH, NULL, 0, NULL, 0);
+    glFlush();
+}
+
+void gl_calls_finish(void) {
+    gl_calls_count(GL_CALLS_OTHER);
+    if (gl_capture_state != GL_CAPTURE_IDLE)
+        gl_capture_call(GL_CAPTURE_FINISH, NULL, 0, NULL, 0);
+    glFinish();
+}
+
+void gl_calls_blit_framebuffer(GLint src_x0, GLint src_y0, GLint src_x1,
+                               GLint src_y1, GLint dst_x0, GLint dst_y0,
+                               GLint dst_x1, GLint dst_y1, GLbitfield mask,
+                               GLenum filter) {
+    gl_calls_count(GL_CALLS_DRAW);
+    GL_CAPTURE_CALL(GL_CAPTURE_BLIT_FRAMEBUFFER, NULL, 0, (u32)src_x0,
+                    (u32)src_y0, (u32)src_x1, (u32)src_y1, (u32)dst_x0,
+                    (u32)dst_y0, (u32)dst_x1, (u32)dst_y1, mask, filter);
+    glBlitFramebuffer(src_x0, src_y0, src_x1, src_y1, dst_x0, dst_y0, dst_x1,
+                      dst_y1, mask, filter);
+}
+
+void gl_calls_read_pixels(GLint x, GLint y, GLsizei width, GLsizei height,
+                          GLenum format, GLenum type, void* pixels) {
+    gl_calls_count(GL_CALLS_OTHER);
+    // Only into a pixel pack buffer, where `pixels` is an offset
+    if (gl_calls_bound_buffer(GL_PIXEL_PACK_BUFFER) != 0) {
+        GL_CAPTURE_CALL(GL_CAPTURE_READ_PIXELS, NULL, 0, (u32)x, (u32)y,
+                        (u32)width, (u32)height, format, type,
+                        GL_CAPTURE_U64((uintptr_t)pixels));
+    }
+    glReadPixels(x, y, width, height, format, type, pixels);
+}
+
+//
+// Textures
+//
+void gl_calls_tex_parameteri(GLenum target, GLenum parameter, GLint value) {
+    gl_calls_count(GL_CALLS_STATE);
+    GL_CAPTURE_CALL(GL_CAPTURE_TEX_PARAMETERI, NULL, 0, target, parameter,
+                    (u32)value);
+    glTexParameteri(target, parameter, value);
+}
+
+void gl_calls_generate_mipmap(GLenum target) {
+    gl_calls_count(GL_CALLS_TEXTURE_UPLOAD);
+    GL_CAPTURE_CALL(GL_CAPTURE_GENERATE_MIPMAP, NULL, 0, target);
+    glGenerateMipmap(target);
+}
+
+void gl_calls_tex_buffer(GLenum target, GLenum internal_format,
+                         GLuint buffer) {
+    gl_calls_count(GL_CALLS_STATE);
+    GL_CAPTURE_CALL(GL_CAPTURE_TEX_BUFFER, NULL, 0, target, internal_format,
+                    buffer);
+    glTexBuffer(target, internal_format, buffer);
+}
+
+//
+// Objects, counted and captured only
+//
+void gl_calls_gen_buffers(GLsizei count, GLuint* buffers) {
+    gl_calls_count(GL_CALLS_OTHER);
+    glGenBuffers(count, buffers);
+    gl_calls_capture_names(GL_CAPTURE_GEN_BUFFERS, count, buffers);
+}
+
+void gl_calls_gen_textures(GLsizei count, GLuint* textures) {
+    gl_calls_count(GL_CALLS_OTHER);
+    glGenTextures(count, textures);
+    gl_calls_capture_names(GL_CAPTURE_GEN_TEXTURES, count, textures);
+}
+
+void gl_calls_gen_vertex_arrays(GLsizei count, GLuint* arrays) {
+    gl_calls_count(GL_CALLS_OTHER);
+    glGenVertexArrays(count, arrays);
+    gl_calls_capture_names(GL_CAPTURE_GEN_VERTEX_ARRAYS, count, arrays);
+}
+
+void gl_calls_gen_framebuffers(GLsizei count, GLuint* framebuffers) {
+    gl_calls_count(GL_CALLS_OTHER);
+    glGenFramebuffers(count, framebuffers);
+    gl_calls_capture_names(GL_CAPTURE_GEN_FRAMEBUFFERS, count, framebuffers);
+}
+
+void gl_calls_gen_renderbuffers(GLsizei count, GLuint* renderbuffers) {
+    gl_calls_count(GL_CALLS_OTHER);
+    glGenRenderbuffers(count, renderbuffers);
+    gl_calls_capture_names(GL_CAPTURE_GEN_RENDERBUFFERS, count,
+                           renderbuffers);
+}
+
+void gl_calls_renderbuffer_storage(GLenum target, GLenum internal_format,
+                                   GLsizei width, GLsizei height) {
+    gl_calls_count(GL_CALLS_OTHER);
+    GL_CAPTURE_CALL(GL_CAPTURE_RENDERBUFFER_STORAGE, NULL, 0, target,
+                    internal_format, (u32)width, (u32)height);
+    glRenderbufferStorage(target, internal_format, width, height);
+}
+
+void gl_calls_framebuffer_renderbuffer(GLenum target, GLenum attachment,
+                                       GLenum renderbuffer_target,
+                                       GLuint renderbuffer) {
+    gl_calls_count(GL_CALLS_OTHER);
+    GL_CAPTURE_CALL(GL_CAPTURE_FRAMEBUFFER_RENDERBUFFER, NULL, 0, target,
+                    attachment, renderbuffer_target, renderbuffer);
+    glFramebufferRenderbuffer(target, attachment, renderbuffer_target,
+                              renderbuffer);
+}
+
+GLint gl_calls_get_uniform_location(GLuint program, const GLchar* name) {
+    gl_calls_count(GL_CALLS_OTHER);
+    const GLint location = glGetUniformLocation(program, name);
+    GL_CAPTURE_CALL(GL_CAPTURE_GET_UNIFORM_LOCATION, name,
+                    (u32)strlen(name) + 1, program, (u32)location);
+    return location;
+}
+
+GLuint gl_calls_create_shader(GLenum type) {
+    gl_calls_count(GL_CALLS_OTHER);
+    const GLuint shader = glCreateShader(type);
+    GL_CAPTURE_CALL(GL_CAPTURE_CREATE_SHADER, NULL, 0, type, shader);
+    return shader;
+}
+
+void gl_calls_shader_source(GLuint shader, GLsizei count,
+                            const GLchar* const* sources,
+                            const GLint* lengths) {
+    gl_calls_count(GL_CALLS_OTHER);
+    glShaderSource(shader, count, sources, lengths);
+    if (gl_capture_state == GL_CAPTURE_IDLE) return;
+
+    // Captured as a single string, NUL terminated
+    usize size = 1;
+    for (GLsizei i = 0; i < count; i++)
+        size += lengths && lengths[i] >= 0 ? (usize)lengths[i]
+                                           : strlen(sources[i]);
+    GLchar* const source = ogl_malloc(size);
+    usize offset = 0;
+    for (GLsizei i = 0; i < count; i++) {
+        const usize length = lengths && lengths[i] >= 0
+                                 ? (usize)lengths[i]
+                                 : strlen(sources[i]);
+        memcpy(source + offset, sources[i], length);
+        offset += length;
+    }
+    source[offset] = '\0';
+
+    GL_CAPTURE_CALL(GL_CAPTURE_SHADER_SOURCE, source, (u32)size, shader);
+    free(source);
+}
+
+void gl_calls_compile_shader(GLuint shader) {
+    gl_calls_count(GL_CALLS_OTHER);
+    GL_CAPTURE_CALL(GL_CAPTURE_COMPILE_SHADER, NULL, 0, shader);
+    glCompileShader(shader);
+}
+
+void gl_calls_delete_shader(GLuint shader) {
+    gl_calls_count(GL_CALLS_OTHER);
+    GL_CAPTURE_CALL(GL_CAPTURE_DELETE_SHADER, NULL, 0, shader);
+    glDeleteShader(shader);
+}
+
+GLuint gl_calls_create_program(void) {
+    gl_calls_count(GL_CALLS_OTHER);
+    const GLuint program = glCreateProgram();
+    GL_CAPTURE_CALL(GL_CAPTURE_CREATE_PROGRAM, NULL, 0, program);
+    return program;
+}
+
+void gl_calls_attach_shader(GLuint program, GLuint shader) {
+    gl_calls_count(GL_CALLS_OTHER);
+    GL_CAPTURE_CALL(GL_CAPTURE_ATTACH_SHADER, NULL, 0, program, shader);
+    glAttachShader(program, shader);
+}
+
+void gl_calls_detach_shader(GLuint program, GLuint shader) {
+    gl_calls_count(GL_CALLS_OTHER);
+    GL_CAPTURE_CALL(GL_CAPTURE_DETACH_SHADER, NULL, 0, program, shader);
+    glDetachShader(program, shader);
+}
+
+void gl_calls_link_program(GLuint program) {
+    gl_calls_count(GL_CALLS_OTHER);
+    GL_CAPTURE_CALL(GL_CAPTURE_LINK_PROGRAM, NULL, 0, program);
+    glLinkProgram(program);
+}
+
+void gl_calls_transform_feedback_varyings(GLuint program, GLsizei count,
+                                          const GLchar* const* varyings,
+                                          GLenum buffer_mode) {
+    gl_calls_count(GL_CALLS_OTHER);
+    glTransformFeedbackVaryings(program, count, varyings, buffer_mode);
+    if (gl_capture_state == GL_CAPTURE_IDLE) return;
+
+    // Captured as the names one after the other, each NUL terminated
+    usize size = 0;
+    for (GLsizei i = 0; i < count; i++) size += strlen(varyings[i]) + 1;
+    GLchar* const names = ogl_malloc(size);
+    usize offset = 0;
+    for (GLsizei i = 0; i < count; i++) {
+        const usize length = strlen(varyings[i]) + 1;
+        memcpy(names + offset, varyings[i], length);
+        offset += length;
+    }
+    GL_CAPTURE_CALL(GL_CAPTURE_TRANSFORM_FEEDBACK_VARYINGS, names, (u32)size,
+                    program, buffer_mode);
+    free(names);
+}
+
+//
+// Reports
+//
+#ifndef GL_CALLS_DISABLE
+static void gl_calls_print(const char* label, const GlCallsFrame* frame,
+                           f64 frame_count) {
+    const f64 n = frame_count > 0.0 ? frame_count : 1.0;
+    f64 calls[GL_CALLS_CATEGORY_COUNT], redundant[GL_CALLS_CATEGORY_COUNT];
+    for (u32 i = 0; i < GL_CALLS_CATEGORY_COUNT; i++) {
+        calls[i] = (f64)frame->calls[i] / n;
+        redundant[i] = (f64)frame->redundant[i] / n;
+    }
+
+    printf("GL calls: %s draws=%.1f binds=%.1f (redundant %.1f) "
+           "uniforms=%.1f (redundant %.1f) state=%.1f (redundant %.1f) "
+           "buffer_uploads=%.1f (%.0fB) texture_uploads=%.1f (%.0fB) "
+           "other=%.1f\n",
+           label, calls[GL_CALLS_DRAW], calls[GL_CALLS_BIND],
+           redundant[GL_CALLS_BIND], calls[GL_CALLS_UNIFORM],
+           redundant[GL_CALLS_UNIFORM], calls[GL_CALLS_STATE],
+           redundant[GL_CALLS_STATE], calls[GL_CALLS_BUFFER_UPLOAD],
+           (f64)frame->buffer_bytes / n, calls[GL_CALLS_TEXTURE_UPLOAD],
+           (f64)frame->texture_bytes / n, calls[GL_CALLS_OTHER]);
+}
+#endif
+
+void gl_calls_frame_end(void) {
+    GlCallsFrame* const frame = &gl_calls.frame;
+#ifndef GL_CALLS_DISABLE
+    GlCallsFrame* const total = &gl_calls.total;
+    for (u32 i = 0; i < GL_CALLS_CATEGORY_COUNT; i++) {
+        total->calls[i] += frame->calls[i];
+        total->redundant[i] += frame->redundant[i];
+    }
+    total->buffer_bytes += frame->buffer_bytes;
+    total->texture_bytes += frame->texture_bytes;
+
+    if (gl_calls.report_interval > 0 &&
+        gl_calls.frame_count % gl_calls.report_interval == 0) {
+        char label[32];
+        snprintf(label, sizeof(label), "frame=%" PRIu64, gl_calls.frame_count);
+        gl_calls_print(label, frame, 1.0);
+    }
+#endif
+
+    gl_capture_frame_end(gl_calls.frame_count,
+                         gl_calls.buffers[GL_CALLS_BUFFER_ARRAY]);
+    gl_calls.frame_count += 1;
+    memset(frame, 0, sizeof(GlCallsFrame));
+}
+
+void gl_calls_shutdown(void) {
+    gl_capture_shutdown();
+#ifndef GL_CALLS_DISABLE
+    if (gl_calls.frame_count == 0) return;
+
+    char label[32];
+    snprintf(label, sizeof(label), "frames=%" PRIu64 " mean",
+             gl_calls.frame_count);
+    gl_calls_print(label, &gl_calls.total, (f64)gl_calls.frame_count);
+#endif
+}
+#endif
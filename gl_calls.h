@@ -0,0 +1,230 @@
+#pragma once
+#include "opengl.h"
+#include "utils.h"
+
+// Accounting of the OpenGL calls, per frame and per category, which also
+// flags the calls setting state which is already current (binding the bound
+// buffer, enabling an enabled array...).
+//
+// Include it after the GL headers: the entry points used by the renderer
+// are replaced with counting wrappers. The state is shadowed per context,
+// there must be only one. Defining GL_CALLS_DISABLE, as release builds do,
+// removes the accounting, and the wrappers entirely unless GL_CAPTURE is
+// defined too: they then only shadow the state the capture needs.
+//
+// `GL_CALLS=<n>` prints the counts of every n-th frame. The timer queries of
+// the trace are not counted. The wrappers also feed the command stream
+// capture, see gl_capture.h.
+
+typedef enum {
+    GL_CALLS_DRAW,
+    GL_CALLS_BIND,
+    GL_CALLS_UNIFORM,
+    GL_CALLS_STATE,
+    GL_CALLS_BUFFER_UPLOAD,
+    GL_CALLS_TEXTURE_UPLOAD,
+    GL_CALLS_OTHER,
+    GL_CALLS_CATEGORY_COUNT,
+} GlCallsCategory;
+
+typedef struct {
+    u64 calls[GL_CALLS_CATEGORY_COUNT];
+    // Calls which did not change anything
+    u64 redundant[GL_CALLS_CATEGORY_COUNT];
+    u64 buffer_bytes;
+    u64 texture_bytes;
+} GlCallsFrame;
+
+#if !defined(GL_CALLS_DISABLE) || defined(GL_CAPTURE)
+#define GL_CALLS_WRAPPERS
+#endif
+
+#ifndef GL_CALLS_WRAPPERS
+#define gl_calls_init() ((void)0)
+#define gl_calls_frame_end() ((void)0)
+#define gl_calls_shutdown() ((void)0)
+#else
+void gl_calls_init(void);
+// Closes the counts of the frame, and prints them when requested
+void gl_calls_frame_end(void);
+// Prints the means per frame since startup, completes the capture
+void gl_calls_shutdown(void);
+
+#ifndef GL_CALLS_DISABLE
+void gl_calls_count(GlCallsCategory category);
+#endif
+
+void gl_calls_bind_buffer(GLenum target, GLuint buffer);
+void gl_calls_bind_texture(GLenum target, GLuint texture);
+void gl_calls_active_texture(GLenum unit);
+void gl_calls_bind_vertex_array(GLuint vertex_array);
+void gl_calls_use_program(GLuint program);
+void gl_calls_bind_framebuffer(GLenum target, GLuint framebuffer);
+void gl_calls_bind_renderbuffer(GLenum target, GLuint renderbuffer);
+void gl_calls_bind_buffer_base(GLenum target, GLuint index, GLuint buffer);
+void gl_calls_delete_buffers(GLsizei count, const GLuint* buffers);
+void gl_calls_delete_textures(GLsizei count, const GLuint* textures);
+void gl_calls_delete_vertex_arrays(GLsizei count, const GLuint* arrays);
+void gl_calls_delete_program(GLuint program);
+void gl_calls_delete_framebuffers(GLsizei count, const GLuint* framebuffers);
+void gl_calls_delete_renderbuffers(GLsizei count,
+                                   const GLuint* renderbuffers);
+
+void gl_calls_uniform_matrix4fv(GLint location, GLsizei count,
+                                GLboolean transpose, const GLfloat* value);
+void gl_calls_uniform_4fv(GLint location, GLsizei count,
+                          const GLfloat* value);
+void gl_calls_uniform_1i(GLint location, GLint value);
+
+void gl_calls_buffer_data(GLenum target, GLsizeiptr size, const void* data,
+                          GLenum usage);
+void gl_calls_buffer_sub_data(GLenum target, GLintptr offset,
+                              GLsizeiptr size, const void* data);
+void gl_calls_tex_image_2d(GLenum target, GLint level, GLint internal_format,
+                           GLsizei width, GLsizei height, GLint border,
+                           GLenum format, GLenum type, const void* pixels);
+void gl_calls_tex_image_3d(GLenum target, GLint level, GLint internal_format,
+                           GLsizei width, GLsizei height, GLsizei depth,
+                           GLint border, GLenum format, GLenum type,
+                           const void* pixels);
+
+void gl_calls_enable(GLenum capability);
+void gl_calls_disable(GLenum capability);
+void gl_calls_viewport(GLint x, GLint y, GLsizei width, GLsizei height);
+void gl_calls_clear_color(GLfloat r, GLfloat g, GLfloat b, GLfloat a);
+void gl_calls_enable_vertex_attrib_array(GLuint index);
+void gl_calls_vertex_attrib_pointer(GLuint index, GLint size, GLenum type,
+                                    GLboolean normalized, GLsizei stride,
+                                    const void* pointer);
+void gl_calls_vertex_attrib_divisor(GLuint index, GLuint divisor);
+void gl_calls_blend_func(GLenum source, GLenum destination);
+void gl_calls_depth_mask(GLboolean flag);
+
+void gl_calls_clear(GLbitfield mask);
+void gl_calls_draw_arrays(GLenum mode, GLint first, GLsizei count);
+void gl_calls_draw_arrays_instanced(GLenum mode, GLint first, GLsizei count,
+                                    GLsizei instance_count);
+void gl_calls_begin_transform_feedback(GLenum mode);
+void gl_calls_end_transform_feedback(void);
+void gl_calls_flush(void);
+void gl_calls_finish(void);
+void gl_calls_blit_framebuffer(GLint src_x0, GLint src_y0, GLint src_x1,
+                               GLint src_y1, GLint dst_x0, GLint dst_y0,
+                               GLint dst_x1, GLint dst_y1, GLbitfield mask,
+                               GLenum filter);
+void gl_calls_read_pixels(GLint x, GLint y, GLsizei width, GLsizei height,
+                          GLenum format, GLenum type, void* pixels);
+
+void gl_calls_tex_parameteri(GLenum target, GLenum parameter, GLint value);
+void gl_calls_generate_mipmap(GLenum target);
+void gl_calls_tex_buffer(GLenum target, GLenum internal_format,
+                         GLuint buffer);
+
+void gl_calls_gen_buffers(GLsizei count, GLuint* buffers);
+void gl_calls_gen_textures(GLsizei count, GLuint* textures);
+void gl_calls_gen_vertex_arrays(GLsizei count, GLuint* arrays);
+void gl_calls_gen_framebuffers(GLsizei count, GLuint* framebuffers);
+void gl_calls_gen_renderbuffers(GLsizei count, GLuint* renderbuffers);
+void gl_calls_renderbuffer_storage(GLenum target, GLenum internal_format,
+                                   GLsizei width, GLsizei height);
+void gl_calls_framebuffer_renderbuffer(GLenum target, GLenum attachment,
+                                       GLenum renderbuffer_target,
+                                       GLuint renderbuffer);
+GLint gl_calls_get_uniform_location(GLuint program, const GLchar* name);
+GLuint gl_calls_create_shader(GLenum type);
+void gl_calls_shader_source(GLuint shader, GLsizei count,
+                            const GLchar* const* sources,
+                            const GLint* lengths);
+void gl_calls_compile_shader(GLuint shader);
+void gl_calls_delete_shader(GLuint shader);
+GLuint gl_calls_create_program(void);
+void gl_calls_attach_shader(GLuint program, GLuint shader);
+void gl_calls_detach_shader(GLuint program, GLuint shader);
+void gl_calls_link_program(GLuint program);
+void gl_calls_transform_feedback_varyings(GLuint program, GLsizei count,
+                                          const GLchar* const* varyings,
+                                          GLenum buffer_mode);
+
+#ifndef GL_CALLS_IMPLEMENTATION
+#ifndef GL_CALLS_DISABLE
+// Queries, counted only as they change nothing
+#define GL_CALLS_COUNTED(call) (gl_calls_count(GL_CALLS_OTHER), call)
+
+#define glGetShaderiv(...) GL_CALLS_COUNTED(glGetShaderiv(__VA_ARGS__))
+#define glGetShaderInfoLog(...) \
+    GL_CALLS_COUNTED(glGetShaderInfoLog(__VA_ARGS__))
+#define glGetProgramiv(...) GL_CALLS_COUNTED(glGetProgramiv(__VA_ARGS__))
+#define glGetProgramInfoLog(...) \
+    GL_CALLS_COUNTED(glGetProgramInfoLog(__VA_ARGS__))
+#define glCheckFramebufferStatus(...) \
+    GL_CALLS_COUNTED(glCheckFramebufferStatus(__VA_ARGS__))
+// Synchronization and mapping, not captured as a replay has nothing to read
+#define glFenceSync(...) GL_CALLS_COUNTED(glFenceSync(__VA_ARGS__))
+#define glClientWaitSync(...) GL_CALLS_COUNTED(glClientWaitSync(__VA_ARGS__))
+#define glDeleteSync(...) GL_CALLS_COUNTED(glDeleteSync(__VA_ARGS__))
+#define glMapBufferRange(...) GL_CALLS_COUNTED(glMapBufferRange(__VA_ARGS__))
+#define glUnmapBuffer(...) GL_CALLS_COUNTED(glUnmapBuffer(__VA_ARGS__))
+#endif
+
+// Counted, captured, and checked against the shadowed state when possible
+#define glBindBuffer gl_calls_bind_buffer
+#define glBindTexture gl_calls_bind_texture
+#define glActiveTexture gl_calls_active_texture
+#define glBindVertexArray gl_calls_bind_vertex_array
+#define glUseProgram gl_calls_use_program
+#define glBindFramebuffer gl_calls_bind_framebuffer
+#define glBindRenderbuffer gl_calls_bind_renderbuffer
+#define glBindBufferBase gl_calls_bind_buffer_base
+#define glDeleteBuffers gl_calls_delete_buffers
+#define glDeleteTextures gl_calls_delete_textures
+#define glDeleteVertexArrays gl_calls_delete_vertex_arrays
+#define glDeleteProgram gl_calls_delete_program
+#define glDeleteFramebuffers gl_calls_delete_framebuffers
+#define glDeleteRenderbuffers gl_calls_delete_renderbuffers
+#define glUniformMatrix4fv gl_calls_uniform_matrix4fv
+#define glUniform4fv gl_calls_uniform_4fv
+#define glUniform1i gl_calls_uniform_1i
+#define glBufferData gl_calls_buffer_data
+#define glBufferSubData gl_calls_buffer_sub_data
+#define glTexImage2D gl_calls_tex_image_2d
+#define glTexImage3D gl_calls_tex_image_3d
+#define glEnable gl_calls_enable
+#define glDisable gl_calls_disable
+#define glViewport gl_calls_viewport
+#define glClearColor gl_calls_clear_color
+#define glEnableVertexAttribArray gl_calls_enable_vertex_attrib_array
+#define glVertexAttribPointer gl_calls_vertex_attrib_pointer
+#define glVertexAttribDivisor gl_calls_vertex_attrib_divisor
+#define glBlendFunc gl_calls_blend_func
+#define glDepthMask gl_calls_depth_mask
+#define glClear gl_calls_clear
+#define glDrawArrays gl_calls_draw_arrays
+#define glDrawArraysInstanced gl_calls_draw_arrays_instanced
+#define glBeginTransformFeedback gl_calls_begin_transform_feedback
+#define glEndTransformFeedback gl_calls_end_transform_feedback
+#define glFlush gl_calls_flush
+#define glFinish gl_calls_finish
+#define glBlitFramebuffer gl_calls_blit_framebuffer
+#define glReadPixels gl_calls_read_pixels
+#define glTexParameteri gl_calls_tex_parameteri
+#define glGenerateMipmap gl_calls_generate_mipmap
+#define glTexBuffer gl_calls_tex_buffer
+#define glGenBuffers gl_calls_gen_buffers
+#define glGenTextures gl_calls_gen_textures
+#define glGenVertexArrays gl_calls_gen_vertex_arrays
+#define glGenFramebuffers gl_calls_gen_framebuffers
+#define glGenRenderbuffers gl_calls_gen_renderbuffers
+#define glRenderbufferStorage gl_calls_renderbuffer_storage
+#define glFramebufferRenderbuffer gl_calls_framebuffer_renderbuffer
+#define glGetUniformLocation gl_calls_get_uniform_location
+#define glCreateShader gl_calls_create_shader
+#define glShaderSource gl_calls_shader_source
+#define glCompileShader gl_calls_compile_shader
+#define glDeleteShader gl_calls_delete_shader
+#define glCreateProgram gl_calls_create_program
+#define glAttachShader gl_calls_attach_shader
+#define glDetachShader gl_calls_detach_shader
+#define glLinkProgram gl_calls_link_program
+#define glTransformFeedbackVaryings gl_calls_transform_feedback_varyings
+#endif
+#endif
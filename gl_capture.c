@@ -0,0 +1,241 @@
+#include "gl_capture.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if !defined(GL_CALLS_DISABLE) || defined(GL_CAPTURE)
+// Contents of a buffer uploaded before the range, written when it starts
+typedef struct {
+    u8* data;  // NULL when allocated without data
+    u64 size;
+    GLenum usage;
+    _Bool folded;  // Otherwise its uploads are recorded as they come
+} GlCaptureBuffer;
+
+GlCaptureState gl_capture_state = GL_CAPTURE_IDLE;
+
+static struct {
+    const char* path;
+    FILE* file;
+    u64 first_frame;
+    u32 frame_count;
+    u32 frames_recorded;
+    u64 bytes_written;
+
+    // Indexed by buffer name
+    GlCaptureBuffer* buffers;
+    u32 buffer_capacity;
+} gl_capture;
+
+static void gl_capture_write(const void* data, usize size) {
+    if (size > 0 && fwrite(data, 1, size, gl_capture.file) != size) {
+        fprintf(stderr, "GL capture: could not write to %s: %s\n",
+                gl_capture.path, strerror(errno));
+        exit(1);
+    }
+    gl_capture.bytes_written += size;
+}
+
+static void gl_capture_range_begin(GLuint array_buffer);
+
+void gl_capture_init(void) {
+    gl_capture.path = getenv("GL_CAPTURE");
+    if (!gl_capture.path) return;
+
+    gl_capture.frame_count = 1;
+    const char* const frames = getenv("GL_CAPTURE_FRAMES");
+    if (frames) {
+        char* end = NULL;
+        gl_capture.first_frame = strtoull(frames, &end, 10);
+        if (*end == ':')
+            gl_capture.frame_count = (u32)strtoul(end + 1, NULL, 10);
+        if (gl_capture.frame_count == 0) gl_capture.frame_count = 1;
+    }
+
+    gl_capture.file = fopen(gl_capture.path, "wb");
+    if (!gl_capture.file) {
+        fprintf(stderr, "Could not open %s: %s\n", gl_capture.path,
+                strerror(errno));
+        exit(errno);
+    }
+
+    // The frame count is patched at the end
+    GlCaptureHeader header = {
+        .version = GL_CAPTURE_VERSION,
+        .first_frame = (u32)gl_capture.first_frame,
+    };
+    memcpy(header.magic, GL_CAPTURE_MAGIC, sizeof(header.magic));
+    gl_capture_write(&header, sizeof(header));
+
+    gl_capture_state = GL_CAPTURE_SETUP;
+    if (gl_capture.first_frame == 0) gl_capture_range_begin(0xffffffff);
+
+    printf("GL capture: path=%s first_frame=%" PRIu64 " frame_count=%u\n",
+           gl_capture.path, gl_capture.first_frame, gl_capture.frame_count);
+}
+
+static _Bool gl_capture_is_work(GlCaptureOp op) {
+    return op >= GL_CAPTURE_CLEAR && op < GL_CAPTURE_OP_COUNT;
+}
+
+void gl_capture_call(GlCaptureOp op, const u32* args, u32 arg_count,
+                     const void* data, u32 data_size) {
+    if (gl_capture_state == GL_CAPTURE_SETUP && gl_capture_is_work(op))
+        return;
+
+    const GlCaptureRecord record = {
+        .op = (u16)op,
+        .arg_count = (u16)arg_count,
+        .data_size = data_size,
+    };
+    gl_capture_write(&record, sizeof(record));
+    gl_capture_write(args, sizeof(u32) * arg_count);
+    if (data_size > 0) {
+        static const u8 padding[4] = {0};
+        gl_capture_write(data, data_size);
+        gl_capture_write(padding, (4 - data_size % 4) % 4);
+    }
+}
+
+//
+// Folded uploads
+//
+static GlCaptureBuffer* gl_capture_buffer(GLuint buffer) {
+    if (buffer >= gl_capture.buffer_capacity) {
+        u32 capacity = gl_capture.buffer_capacity > 0
+                           ? gl_capture.buffer_capacity * 2
+                           : 64;
+        while (capacity <= buffer) capacity *= 2;
+
+        gl_capture.buffers =
+            realloc(gl_capture.buffers, sizeof(GlCaptureBuffer) * capacity);
+        if (!gl_capture.buffers) exit(ENOMEM);
+        memset(gl_capture.buffers + gl_capture.buffer_capacity, 0,
+               sizeof(GlCaptureBuffer) *
+                   (capacity - gl_capture.buffer_capacity));
+        gl_capture.buffer_capacity = capacity;
+    }
+    return &gl_capture.buffers[buffer];
+}
+
+_Bool gl_capture_buffer_data(GLuint buffer, GLenum usage, u64 size,
+                             const void* data) {
+    if (gl_capture_state != GL_CAPTURE_SETUP || buffer == 0 ||
+        buffer == 0xffffffff)
+        return false;
+
+    GlCaptureBuffer* const b = gl_capture_buffer(buffer);
+    free(b->data);
+    b->data = NULL;
+    if (data) {
+        b->data = ogl_malloc(size);
+        memcpy(b->data, data, size);
+    }
+    b->size = size;
+    b->usage = usage;
+    b->folded = true;
+    return true;
+}
+
+_Bool gl_capture_buffer_sub_data(GLuint buffer, u64 offset, u64 size,
+                                 const void* data) {
+    if (gl_capture_state != GL_CAPTURE_SETUP || buffer == 0 ||
+        buffer == 0xffffffff)
+        return false;
+
+    GlCaptureBuffer* const b = gl_capture_buffer(buffer);
+    if (!b->folded || offset + size > b->size) return false;
+
+    if (!b->data) {
+        b->data = ogl_malloc(b->size);
+        memset(b->data, 0, b->size);
+    }
+    memcpy(b->data + offset, data, size);
+    return true;
+}
+
+void gl_capture_buffers_deleted(GLsizei count, const GLuint* buffers) {
+    for (GLsizei i = 0; i < count; i++) {
+        if (buffers[i] >= gl_capture.buffer_capacity) continue;
+
+        GlCaptureBuffer* const b = &gl_capture.buffers[buffers[i]];
+        free(b->data);
+        memset(b, 0, sizeof(GlCaptureBuffer));
+    }
+}
+
+//
+// Frames
+//
+static void gl_capture_range_begin(GLuint array_buffer) {
+    // Switched first for the folded uploads to be recorded, they end the
+    // setup part
+    gl_capture_state = GL_CAPTURE_RANGE;
+
+    _Bool rebound = false;
+    for (u32 i = 0; i < gl_capture.buffer_capacity; i++) {
+        GlCaptureBuffer* const b = &gl_capture.buffers[i];
+        if (!b->folded) continue;
+
+        GL_CAPTURE_CALL(GL_CAPTURE_BIND_BUFFER, NULL, 0, GL_ARRAY_BUFFER, i);
+        GL_CAPTURE_CALL(GL_CAPTURE_BUFFER_DATA, b->data,
+                        b->data ? (u32)b->size : 0, GL_ARRAY_BUFFER,
+                        GL_CAPTURE_U64(b->size), b->usage);
+        free(b->data);
+        memset(b, 0, sizeof(GlCaptureBuffer));
+        rebound = true;
+    }
+    if (rebound && array_buffer != 0xffffffff)
+        GL_CAPTURE_CALL(GL_CAPTURE_BIND_BUFFER, NULL, 0, GL_ARRAY_BUFFER,
+                        array_buffer);
+
+    free(gl_capture.buffers);
+    gl_capture.buffers = NULL;
+    gl_capture.buffer_capacity = 0;
+
+    gl_capture_call(GL_CAPTURE_RANGE_BEGIN, NULL, 0, NULL, 0);
+}
+
+void gl_capture_shutdown(void) {
+    if (gl_capture_state == GL_CAPTURE_IDLE) return;
+    if (gl_capture.frames_recorded < gl_capture.frame_count) {
+        fprintf(stderr, "GL capture: stopped after %u of %u frames\n",
+                gl_capture.frames_recorded, gl_capture.frame_count);
+    }
+
+    const u64 bytes = gl_capture.bytes_written;
+
+    // Patch the header
+    GlCaptureHeader header = {
+        .version = GL_CAPTURE_VERSION,
+        .first_frame = (u32)gl_capture.first_frame,
+        .frame_count = gl_capture.frames_recorded,
+    };
+    memcpy(header.magic, GL_CAPTURE_MAGIC, sizeof(header.magic));
+    rewind(gl_capture.file);
+    gl_capture_write(&header, sizeof(header));
+    fclose(gl_capture.file);
+    gl_capture.file = NULL;
+    gl_capture_state = GL_CAPTURE_IDLE;
+
+    printf("GL capture: wrote %u frames (%" PRIu64 " bytes) to %s\n",
+           gl_capture.frames_recorded, bytes, gl_capture.path);
+}
+
+void gl_capture_frame_end(u64 frame, GLuint array_buffer) {
+    switch (gl_capture_state) {
+        case GL_CAPTURE_IDLE: return;
+        case GL_CAPTURE_SETUP:
+            if (frame + 1 == gl_capture.first_frame)
+                gl_capture_range_begin(array_buffer);
+            return;
+        case GL_CAPTURE_RANGE:
+            gl_capture_call(GL_CAPTURE_FRAME_END, NULL, 0, NULL, 0);
+            gl_capture.frames_recorded += 1;
+            if (gl_capture.frames_recorded == gl_capture.frame_count)
+                gl_capture_shutdown();
+            return;
+    }
+}
+#endif
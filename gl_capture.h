@@ -0,0 +1,174 @@
+#pragma once
+#include "opengl.h"
+#include "utils.h"
+
+// Capture of the OpenGL command stream for a range of frames, replayed
+// headless by `tools/gl_replay.c`.
+//
+// `GL_CAPTURE=<path>` records every call going through the wrappers of
+// gl_calls.h, with the buffer, texture and shader data they reference.
+// `GL_CAPTURE_FRAMES=<first>[:<count>]` selects the frames (default 0:1).
+// Before the first one, only what creates the state of the range is kept:
+// draws and clears are dropped and the buffer uploads are folded into one
+// upload per buffer, written when the range starts. The results of GPU work
+// before the range (render to texture, transform feedback) are not kept.
+//
+// File: a GlCaptureHeader, then records. A record is a GlCaptureRecord,
+// `arg_count` u32 arguments, then `data_size` bytes padded to 4. Names
+// returned by GL (glGen*, glCreate*) and uniform locations are arguments
+// too, the replayer maps them to its own. Native endianness.
+
+#define GL_CAPTURE_MAGIC "GLCP"
+#define GL_CAPTURE_VERSION 5
+
+typedef struct {
+    char magic[4];
+    u32 version;
+    u32 first_frame;
+    u32 frame_count;  // Recorded ones
+} GlCaptureHeader;
+
+typedef struct {
+    u16 op;
+    u16 arg_count;
+    u32 data_size;
+} GlCaptureRecord;
+
+// Arguments in parentheses, `names` are returned by GL
+typedef enum {
+    // Frames markers
+    GL_CAPTURE_RANGE_BEGIN,
+    GL_CAPTURE_FRAME_END,
+
+    // Objects
+    GL_CAPTURE_GEN_BUFFERS,        // names...
+    GL_CAPTURE_GEN_TEXTURES,       // names...
+    GL_CAPTURE_GEN_VERTEX_ARRAYS,  // names...
+    GL_CAPTURE_DELETE_BUFFERS,     // names...
+    GL_CAPTURE_DELETE_TEXTURES,    // names...
+    GL_CAPTURE_DELETE_VERTEX_ARRAYS,  // names...
+    GL_CAPTURE_CREATE_SHADER,      // (type, name)
+    GL_CAPTURE_SHADER_SOURCE,      // (shader), source
+    GL_CAPTURE_COMPILE_SHADER,     // (shader)
+    GL_CAPTURE_DELETE_SHADER,      // (shader)
+    GL_CAPTURE_CREATE_PROGRAM,     // (name)
+    GL_CAPTURE_ATTACH_SHADER,      // (program, shader)
+    GL_CAPTURE_DETACH_SHADER,      // (program, shader)
+    GL_CAPTURE_LINK_PROGRAM,       // (program)
+    // (program, buffer mode), the names of the varyings, NUL separated
+    GL_CAPTURE_TRANSFORM_FEEDBACK_VARYINGS,
+    GL_CAPTURE_DELETE_PROGRAM,     // (program)
+    GL_CAPTURE_GET_UNIFORM_LOCATION,  // (program, location), name
+    GL_CAPTURE_GEN_FRAMEBUFFERS,      // names...
+    GL_CAPTURE_DELETE_FRAMEBUFFERS,   // names...
+    GL_CAPTURE_GEN_RENDERBUFFERS,     // names...
+    GL_CAPTURE_DELETE_RENDERBUFFERS,  // names...
+    // (target, internal format, width, height)
+    GL_CAPTURE_RENDERBUFFER_STORAGE,
+    // (target, attachment, renderbuffer target, renderbuffer)
+    GL_CAPTURE_FRAMEBUFFER_RENDERBUFFER,
+
+    // Bindings
+    GL_CAPTURE_BIND_BUFFER,        // (target, buffer)
+    GL_CAPTURE_BIND_TEXTURE,       // (target, texture)
+    GL_CAPTURE_ACTIVE_TEXTURE,     // (unit)
+    GL_CAPTURE_BIND_VERTEX_ARRAY,  // (vertex array)
+    GL_CAPTURE_USE_PROGRAM,        // (program)
+    GL_CAPTURE_BIND_FRAMEBUFFER,   // (target, framebuffer)
+    GL_CAPTURE_BIND_RENDERBUFFER,  // (target, renderbuffer)
+    GL_CAPTURE_BIND_BUFFER_BASE,   // (target, index, buffer)
+
+    // Uniforms
+    GL_CAPTURE_UNIFORM_MATRIX4FV,  // (location, count, transpose), values
+    GL_CAPTURE_UNIFORM_4FV,        // (location, count), values
+    GL_CAPTURE_UNIFORM_1I,         // (location, value)
+
+    // Uploads
+    GL_CAPTURE_BUFFER_DATA,      // (target, size lo, size hi, usage), data
+    GL_CAPTURE_BUFFER_SUB_DATA,  // (target, offset lo, offset hi), data
+    // (target, level, internal format, width, height, border, format, type,
+    // offset lo, offset hi), pixels. Without pixels, the offset in the
+    // unpack buffer.
+    GL_CAPTURE_TEX_IMAGE_2D,
+    // (target, level, internal format, width, height, depth, border, format,
+    // type, offset lo, offset hi), pixels, like GL_CAPTURE_TEX_IMAGE_2D
+    GL_CAPTURE_TEX_IMAGE_3D,
+    GL_CAPTURE_TEX_PARAMETERI,  // (target, parameter, value)
+    GL_CAPTURE_GENERATE_MIPMAP,  // (target)
+    GL_CAPTURE_TEX_BUFFER,       // (target, internal format, buffer)
+
+    // State
+    GL_CAPTURE_ENABLE,                      // (capability)
+    GL_CAPTURE_DISABLE,                     // (capability)
+    GL_CAPTURE_VIEWPORT,                    // (x, y, width, height)
+    GL_CAPTURE_CLEAR_COLOR,                 // (r, g, b, a)
+    GL_CAPTURE_ENABLE_VERTEX_ATTRIB_ARRAY,  // (index)
+    // (index, size, type, normalized, stride, offset lo, offset hi)
+    GL_CAPTURE_VERTEX_ATTRIB_POINTER,
+    GL_CAPTURE_VERTEX_ATTRIB_DIVISOR,  // (index, divisor)
+    GL_CAPTURE_BLEND_FUNC,             // (source, destination)
+    GL_CAPTURE_DEPTH_MASK,             // (flag)
+
+    // Work, dropped before the range
+    GL_CAPTURE_CLEAR,                   // (mask)
+    GL_CAPTURE_DRAW_ARRAYS,             // (mode, first, count)
+    GL_CAPTURE_DRAW_ARRAYS_INSTANCED,   // (mode, first, count, instances)
+    GL_CAPTURE_BEGIN_TRANSFORM_FEEDBACK,  // (mode)
+    GL_CAPTURE_END_TRANSFORM_FEEDBACK,
+    GL_CAPTURE_FLUSH,
+    GL_CAPTURE_FINISH,
+    // (source x0, y0, x1, y1, destination x0, y0, x1, y1, mask, filter)
+    GL_CAPTURE_BLIT_FRAMEBUFFER,
+    // (x, y, width, height, format, type, offset lo, offset hi), into the
+    // bound pixel pack buffer
+    GL_CAPTURE_READ_PIXELS,
+
+    GL_CAPTURE_OP_COUNT,
+} GlCaptureOp;
+
+static inline u32 gl_capture_f32(f32 value) {
+    u32 bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+// Splits a 64 bits argument into two
+#define GL_CAPTURE_U64(value) \
+    (u32)(u64)(value), (u32)((u64)(value) >> 32)
+
+// Fed by the wrappers of gl_calls.h, when they are built
+#if !defined(GL_CALLS_DISABLE) || defined(GL_CAPTURE)
+typedef enum {
+    GL_CAPTURE_IDLE,
+    GL_CAPTURE_SETUP,  // Before the range
+    GL_CAPTURE_RANGE,
+} GlCaptureState;
+
+extern GlCaptureState gl_capture_state;
+
+void gl_capture_init(void);
+// Completes the file, even when the range was not reached
+void gl_capture_shutdown(void);
+void gl_capture_call(GlCaptureOp op, const u32* args, u32 arg_count,
+                     const void* data, u32 data_size);
+// `frame` just ended. `array_buffer` is the current binding, restored after
+// the folded uploads, or 0xffffffff when unknown.
+void gl_capture_frame_end(u64 frame, GLuint array_buffer);
+
+// Before the range, uploads to a known buffer are folded: false when the
+// call must be recorded as is
+_Bool gl_capture_buffer_data(GLuint buffer, GLenum usage, u64 size,
+                             const void* data);
+_Bool gl_capture_buffer_sub_data(GLuint buffer, u64 offset, u64 size,
+                                 const void* data);
+void gl_capture_buffers_deleted(GLsizei count, const GLuint* buffers);
+
+#define GL_CAPTURE_CALL(op, data, data_size, ...)                       \
+    do {                                                                \
+        if (gl_capture_state != GL_CAPTURE_IDLE) {                      \
+            const u32 capture_args[] = {__VA_ARGS__};                   \
+            gl_capture_call(op, capture_args, ARR_SIZE(capture_args),   \
+                            data, data_size);                           \
+        }                                                               \
+    } while (0)
+#endif
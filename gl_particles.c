@@ -0,0 +1,238 @@
+#include "gl_particles.h"
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdio.h>
+
+#include "gl_calls.h"
+#include "resource_registry.h"
+#include "shader.h"
+#include "trace.h"
+
+// vec4s per emitter in the simulation uniforms
+#define GL_PARTICLES_EMITTER_VEC4S 3
+
+static void gl_particles_attributes(void) {
+    glEnableVertexAttribArray(0);
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(GlParticle),
+                          (void*)offsetof(GlParticle, position));
+    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(GlParticle),
+                          (void*)offsetof(GlParticle, velocity));
+}
+
+void gl_particles_init(GlParticles* particles, u32 capacity, u32 gpu_track) {
+    memset(particles, 0, sizeof(GlParticles));
+    particles->capacity = capacity;
+    particles->gpu_track = gpu_track;
+
+    const char* const varyings[2] = {"out_position_age",
+                                     "out_velocity_lifetime"};
+    particles->simulation_program = shader_load_feedback(
+        "resources/particles_simulation_vertex.glsl", varyings, 2);
+    particles->draw_program =
+        shader_load("resources/particles_vertex.glsl",
+                    "resources/particles_fragment.glsl");
+
+    const GLuint simulation = particles->simulation_program;
+    particles->simulation_location =
+        glGetUniformLocation(simulation, "simulation");
+    particles->gravity_location = glGetUniformLocation(simulation, "gravity");
+    particles->emitters_location =
+        glGetUniformLocation(simulation, "emitters");
+    const GLuint draw = particles->draw_program;
+    particles->view_projection_location = glGetUniformLocation(draw, "VP");
+    particles->camera_right_location =
+        glGetUniformLocation(draw, "camera_right");
+    particles->camera_up_location = glGetUniformLocation(draw, "camera_up");
+    particles->pool_location = glGetUniformLocation(draw, "pool");
+    particles->colors_location = glGetUniformLocation(draw, "colors");
+
+    const GLuint programs[2] = {simulation, draw};
+    for (u32 i = 0; i < 2; i++) {
+        GLint binary_length = 0;
+        glGetProgramiv(programs[i], GL_PROGRAM_BINARY_LENGTH, &binary_length);
+        resource_track(RESOURCE_GL_PROGRAM, programs[i], RESOURCE_SHADER,
+                       (u64)binary_length, "particles");
+    }
+
+    // Zeroed particles are dead. The second buffer is written by the first
+    // step before it is read.
+    const usize size = sizeof(GlParticle) * capacity;
+    GlParticle* const dead = ogl_malloc(size);
+    memset(dead, 0, size);
+    glGenBuffers(2, particles->buffers);
+    for (u32 i = 0; i < 2; i++) {
+        glBindBuffer(GL_ARRAY_BUFFER, particles->buffers[i]);
+        glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)size, i == 0 ? dead : NULL,
+                     GL_DYNAMIC_COPY);
+        resource_track(RESOURCE_GL_BUFFER, particles->buffers[i],
+                       RESOURCE_BUFFER, size, "particles");
+    }
+    free(dead);
+
+    // The same attributes, per vertex to simulate, per instance to draw
+    glGenVertexArrays(2, particles->simulation_arrays);
+    glGenVertexArrays(2, particles->draw_arrays);
+    for (u32 i = 0; i < 2; i++) {
+        glBindBuffer(GL_ARRAY_BUFFER, particles->buffers[i]);
+        glBindVertexArray(particles->simulation_arrays[i]);
+        gl_particles_attributes();
+        glBindVertexArray(particles->draw_arrays[i]);
+        gl_particles_attributes();
+        glVertexAttribDivisor(0, 1);
+        glVertexAttribDivisor(1, 1);
+    }
+
+    glGenQueries(GL_PARTICLES_QUERY_LAG * 3, &particles->queries[0][0]);
+}
+
+void gl_particles_destroy(GlParticles* particles) {
+    glDeleteQueries(GL_PARTICLES_QUERY_LAG * 3, &particles->queries[0][0]);
+    glDeleteVertexArrays(2, particles->draw_arrays);
+    glDeleteVertexArrays(2, particles->simulation_arrays);
+    for (u32 i = 0; i < 2; i++)
+        resource_untrack(RESOURCE_GL_BUFFER, particles->buffers[i]);
+    glDeleteBuffers(2, particles->buffers);
+    resource_untrack(RESOURCE_GL_PROGRAM, particles->simulation_program);
+    resource_untrack(RESOURCE_GL_PROGRAM, particles->draw_program);
+    glDeleteProgram(particles->simulation_program);
+    glDeleteProgram(particles->draw_program);
+}
+
+// Times of the step which used the slot, if its timestamps are ready
+static void gl_particles_timers_read(GlParticles* particles) {
+    if (particles->step < GL_PARTICLES_QUERY_LAG) return;
+
+    GLuint* const queries =
+        particles->queries[particles->step % GL_PARTICLES_QUERY_LAG];
+    GLint available = 0;
+    glGetQueryObjectiv(queries[2], GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available) return;
+
+    GLuint64 timestamps[3] = {0};
+    for (u32 i = 0; i < 3; i++)
+        glGetQueryObjectui64v(queries[i], GL_QUERY_RESULT, &timestamps[i]);
+    if (trace_enabled) {
+        trace_gpu_zone(particles->gpu_track, "particles_simulation",
+                       timestamps[0], timestamps[1]);
+        trace_gpu_zone(particles->gpu_track, "particles_draw", timestamps[1],
+                       timestamps[2]);
+    }
+
+    const f64 simulation_ms = (f64)(timestamps[1] - timestamps[0]) / 1e6;
+    const f64 draw_ms = (f64)(timestamps[2] - timestamps[1]) / 1e6;
+    particles->timed_steps += 1;
+    particles->total_simulation_ms += simulation_ms;
+    particles->total_draw_ms += draw_ms;
+    particles->max_simulation_ms =
+        MAX(particles->max_simulation_ms, simulation_ms);
+    particles->max_draw_ms = MAX(particles->max_draw_ms, draw_ms);
+}
+
+// Emitter uniforms of the step, advances the rings
+static void gl_particles_emit(GlParticles* particles,
+                              const RendererParticles* frame, u32 share,
+                              vec4* emitters, vec4* colors) {
+    for (u32 i = 0; i < frame->emitter_count; i++) {
+        const RendererEmitter* const e = &frame->emitters[i];
+        vec4* const uniforms = &emitters[i * GL_PARTICLES_EMITTER_VEC4S];
+
+        particles->carry[i] += e->rate * frame->dt;
+        const u32 count = MIN((u32)particles->carry[i], share);
+        particles->carry[i] -= (f32)(u32)particles->carry[i];
+        // The share changes with the number of emitters
+        const u32 first = particles->cursors[i] % share;
+        particles->cursors[i] = (first + count) % share;
+        particles->total_spawned += count;
+
+        glm_vec4_copy((vec4){e->position[0], e->position[1], e->position[2],
+                             e->lifetime},
+                      uniforms[0]);
+        glm_vec4_copy((vec4){e->velocity[0], e->velocity[1], e->velocity[2],
+                             e->spread},
+                      uniforms[1]);
+        glm_vec4_copy((vec4){(f32)first, (f32)count, 0.0f, 0.0f},
+                      uniforms[2]);
+        glm_vec4_copy((vec4){e->color[0], e->color[1], e->color[2], e->size},
+                      colors[i]);
+    }
+}
+
+void gl_particles_draw(GlParticles* particles,
+                       const RendererParticles* frame, mat4 view_projection) {
+    gl_particles_timers_read(particles);
+    GLuint* const queries =
+        particles->queries[particles->step % GL_PARTICLES_QUERY_LAG];
+
+    const u32 share = particles->capacity / frame->emitter_count;
+    assert(share > 0);
+    vec4 emitters[RENDERER_MAX_EMITTERS * GL_PARTICLES_EMITTER_VEC4S];
+    vec4 colors[RENDERER_MAX_EMITTERS];
+    gl_particles_emit(particles, frame, share, emitters, colors);
+
+    // Simulation, from the current buffer into the other. The seed stays
+    // exact as a float.
+    glQueryCounter(queries[0], GL_TIMESTAMP);
+    const u32 next = 1 - particles->current;
+    glEnable(GL_RASTERIZER_DISCARD);
+    glUseProgram(particles->simulation_program);
+    const vec4 simulation = {frame->dt, (f32)share,
+                             (f32)frame->emitter_count,
+                             (f32)(particles->step & 0xffffff)};
+    glUniform4fv(particles->simulation_location, 1, simulation);
+    const vec4 gravity = {frame->gravity[0], frame->gravity[1],
+                          frame->gravity[2], 0.0f};
+    glUniform4fv(particles->gravity_location, 1, gravity);
+    glUniform4fv(particles->emitters_location,
+                 (GLsizei)(frame->emitter_count * GL_PARTICLES_EMITTER_VEC4S),
+                 emitters[0]);
+    glBindVertexArray(particles->simulation_arrays[particles->current]);
+    glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0,
+                     particles->buffers[next]);
+    glBeginTransformFeedback(GL_POINTS);
+    glDrawArrays(GL_POINTS, 0, (GLsizei)particles->capacity);
+    glEndTransformFeedback();
+    glDisable(GL_RASTERIZER_DISCARD);
+    particles->current = next;
+
+    // Billboards, added to what is behind them and tested against the
+    // scene depth
+    glQueryCounter(queries[1], GL_TIMESTAMP);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_ONE, GL_ONE);
+    glDepthMask(GL_FALSE);
+    glUseProgram(particles->draw_program);
+    glUniformMatrix4fv(particles->view_projection_location, 1, GL_FALSE,
+                       (const f32*)view_projection);
+    const vec4 right = {frame->camera_right[0], frame->camera_right[1],
+                        frame->camera_right[2], 0.0f};
+    const vec4 up = {frame->camera_up[0], frame->camera_up[1],
+                     frame->camera_up[2], 0.0f};
+    glUniform4fv(particles->camera_right_location, 1, right);
+    glUniform4fv(particles->camera_up_location, 1, up);
+    const vec4 pool = {(f32)share, (f32)frame->emitter_count, 0.0f, 0.0f};
+    glUniform4fv(particles->pool_location, 1, pool);
+    glUniform4fv(particles->colors_location, (GLsizei)frame->emitter_count,
+                 colors[0]);
+    glBindVertexArray(particles->draw_arrays[particles->current]);
+    glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4,
+                          (GLsizei)particles->capacity);
+    glDepthMask(GL_TRUE);
+    glDisable(GL_BLEND);
+    glQueryCounter(queries[2], GL_TIMESTAMP);
+
+    particles->step += 1;
+}
+
+void gl_particles_print(const GlParticles* particles) {
+    const f64 steps =
+        particles->timed_steps ? (f64)particles->timed_steps : 1.0;
+    printf("GL particles: capacity=%u steps=%" PRIu64 " spawned=%" PRIu64
+           " simulation_gpu_mean=%.3fms simulation_gpu_max=%.3fms "
+           "draw_gpu_mean=%.3fms draw_gpu_max=%.3fms\n",
+           particles->capacity, particles->step, particles->total_spawned,
+           particles->total_simulation_ms / steps,
+           particles->max_simulation_ms, particles->total_draw_ms / steps,
+           particles->max_draw_ms);
+}
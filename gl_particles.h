@@ -0,0 +1,72 @@
+#pragma once
+#include <cglm/cglm.h>
+
+#include "opengl.h"
+#include "renderer.h"
+#include "utils.h"
+
+// GPU particles of the OpenGL backend, simulated with transform feedback.
+//
+// The pool is in two buffers. Every frame, a vertex shader runs once per
+// particle of one buffer, rasterization off, and writes it to the other:
+// the particles an emitter spawns this frame are reset at the emitter, the
+// others fall and age. The written buffer is then drawn as billboards, a
+// 4 vertices instance per particle, dead ones collapsed. The two buffers
+// swap roles every frame, the CPU only sets the emitter uniforms whatever
+// the number of particles.
+//
+// Every emitter owns an equal share of the pool, a ring in which it spawns
+// over its oldest particles.
+//
+// The GPU time of the simulation and of the draw is measured with timestamp
+// queries, read GL_PARTICLES_QUERY_LAG frames later, printed on exit and
+// emitted as GPU zones of the trace.
+
+#define GL_PARTICLES_QUERY_LAG 4
+
+// A vertex of the simulation, an instance of the draw
+typedef struct {
+    f32 position[3];
+    f32 age;  // Seconds
+    f32 velocity[3];
+    f32 lifetime;  // Dead from `age >= lifetime`, 0 at first
+} GlParticle;
+
+typedef struct {
+    u32 capacity;
+    GLuint buffers[2];
+    // Reading each buffer, to simulate and to draw
+    GLuint simulation_arrays[2];
+    GLuint draw_arrays[2];
+    u32 current;  // Buffer of the last step
+
+    GLuint simulation_program, draw_program;
+    GLint simulation_location, gravity_location, emitters_location;
+    GLint view_projection_location, camera_right_location,
+        camera_up_location, pool_location, colors_location;
+
+    // Per emitter: next particle of its ring, and the fraction of particle
+    // left to spawn
+    u32 cursors[RENDERER_MAX_EMITTERS];
+    f32 carry[RENDERER_MAX_EMITTERS];
+    u64 step;
+
+    // Simulation begin, draw begin, draw end, per step in flight
+    GLuint queries[GL_PARTICLES_QUERY_LAG][3];
+    u32 gpu_track;  // Of the trace, when enabled
+
+    // Of the measured steps
+    u64 timed_steps;
+    f64 total_simulation_ms, total_draw_ms;
+    f64 max_simulation_ms, max_draw_ms;
+    u64 total_spawned;
+} GlParticles;
+
+void gl_particles_init(GlParticles* particles, u32 capacity, u32 gpu_track);
+void gl_particles_destroy(GlParticles* particles);
+// Steps then draws into the bound framebuffer, changes the program and the
+// vertex array
+void gl_particles_draw(GlParticles* particles,
+                       const RendererParticles* frame, mat4 view_projection);
+// GPU times of the simulation and of the draw
+void gl_particles_print(const GlParticles* particles);
@@ -0,0 +1,208 @@
+#include "gl_readback.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bmp.h"
+#include "gl_calls.h"
+#include "resource_registry.h"
+#include "trace.h"
+
+// Waiting for the frames in flight on shutdown, in nanoseconds per try
+#define GL_READBACK_DRAIN_TIMEOUT 100000000
+
+static GlReadbackSlot* gl_readback_slot(GlReadback* readback, u64 count) {
+    return &readback->slots[count % GL_READBACK_SLOTS];
+}
+
+static void gl_readback_write(GlReadback* readback,
+                              const GlReadbackSlot* slot) {
+    char path[512];
+    i32 err = 0;
+    if (readback->raw) {
+        snprintf(path, sizeof(path), "%s/frame_%06" PRIu64 "_%ux%u.raw",
+                 readback->directory, slot->frame, readback->width,
+                 readback->height);
+        FILE* const file = fopen(path, "wb");
+        _Bool written =
+            file && fwrite(slot->data, 1, readback->size, file) ==
+                        readback->size;
+        if (file) written = fclose(file) == 0 && written;
+        if (!written) {
+            err = errno ? errno : EIO;
+            fprintf(stderr,
+                    "Could not write the file `%s`: errno=%d error=%s\n",
+                    path, err, strerror(err));
+        }
+    } else {
+        snprintf(path, sizeof(path), "%s/frame_%06" PRIu64 ".bmp",
+                 readback->directory, slot->frame);
+        err = bmp_write(path, readback->width, readback->height, slot->data);
+    }
+
+    if (err)
+        readback->write_errors += 1;
+    else
+        readback->written += 1;
+}
+
+static int gl_readback_worker(void* data) {
+    GlReadback* const readback = data;
+    trace_thread_name("readback");
+
+    for (u64 i = 0;; i++) {
+        GlReadbackSlot* const slot = gl_readback_slot(readback, i);
+
+        SDL_LockMutex(readback->mutex);
+        while (SDL_AtomicGet(&slot->state) != GL_READBACK_MAPPED &&
+               SDL_AtomicGet(&readback->running))
+            SDL_CondWait(readback->cond, readback->mutex);
+        SDL_UnlockMutex(readback->mutex);
+        // Stopped once every frame was written
+        if (SDL_AtomicGet(&slot->state) != GL_READBACK_MAPPED) return 0;
+
+        TRACE_BEGIN("readback_write");
+        gl_readback_write(readback, slot);
+        TRACE_END();
+        SDL_AtomicSet(&slot->state, GL_READBACK_WRITTEN);
+    }
+}
+
+void gl_readback_init(GlReadback* readback, u32 width, u32 height) {
+    memset(readback, 0, sizeof(GlReadback));
+    readback->directory = getenv("READBACK_DIR");
+    if (!readback->directory) return;
+
+    const char* const format = getenv("READBACK_FORMAT");
+    readback->raw = format && strcmp(format, "raw") == 0;
+    readback->enabled = true;
+    readback->width = width;
+    readback->height = height;
+    // GL_PACK_ALIGNMENT is 4, as the rows of BMP files
+    readback->size = (usize)(width * 3 + 3) / 4 * 4 * height;
+
+    for (u32 i = 0; i < GL_READBACK_SLOTS; i++) {
+        GlReadbackSlot* const slot = &readback->slots[i];
+        glGenBuffers(1, &slot->buffer);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot->buffer);
+        glBufferData(GL_PIXEL_PACK_BUFFER, (GLsizeiptr)readback->size, NULL,
+                     GL_STREAM_READ);
+        resource_track(RESOURCE_GL_BUFFER, slot->buffer, RESOURCE_STAGING,
+                       readback->size, "readback");
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    readback->mutex = SDL_CreateMutex();
+    readback->cond = SDL_CreateCond();
+    SDL_AtomicSet(&readback->running, 1);
+    readback->thread =
+        SDL_CreateThread(gl_readback_worker, "readback", readback);
+    if (!readback->mutex || !readback->cond || !readback->thread) {
+        fprintf(stderr, "Could not start the readback worker: %s\n",
+                SDL_GetError());
+        exit(1);
+    }
+
+    printf("Readback: directory=%s format=%s width=%u height=%u\n",
+           readback->directory, readback->raw ? "raw" : "bmp", width,
+           height);
+}
+
+// Maps the frames whose fence is signaled and hands them to the worker, then
+// unmaps the written ones. `timeout` in nanoseconds, 0 to only poll.
+static void gl_readback_collect(GlReadback* readback, GLuint64 timeout) {
+    while (readback->mapped < readback->issued) {
+        GlReadbackSlot* const slot =
+            gl_readback_slot(readback, readback->mapped);
+        const GLenum status = glClientWaitSync(
+            slot->fence, timeout ? GL_SYNC_FLUSH_COMMANDS_BIT : 0, timeout);
+        if (status == GL_TIMEOUT_EXPIRED) break;
+        if (status == GL_WAIT_FAILED) {
+            fprintf(stderr, "Readback: waiting for a frame failed\n");
+            exit(1);
+        }
+        glDeleteSync(slot->fence);
+        slot->fence = NULL;
+
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot->buffer);
+        slot->data = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0,
+                                      (GLsizeiptr)readback->size,
+                                      GL_MAP_READ_BIT);
+        if (!slot->data) {
+            fprintf(stderr, "Readback: could not map a frame\n");
+            exit(1);
+        }
+
+        SDL_LockMutex(readback->mutex);
+        SDL_AtomicSet(&slot->state, GL_READBACK_MAPPED);
+        SDL_CondSignal(readback->cond);
+        SDL_UnlockMutex(readback->mutex);
+        readback->mapped += 1;
+    }
+
+    while (readback->unmapped < readback->mapped) {
+        GlReadbackSlot* const slot =
+            gl_readback_slot(readback, readback->unmapped);
+        if (SDL_AtomicGet(&slot->state) != GL_READBACK_WRITTEN) break;
+
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot->buffer);
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        slot->data = NULL;
+        SDL_AtomicSet(&slot->state, GL_READBACK_FREE);
+        readback->unmapped += 1;
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+void gl_readback_frame(GlReadback* readback) {
+    if (!readback->enabled) return;
+    TRACE_BEGIN("readback");
+
+    gl_readback_collect(readback, 0);
+
+    const u64 frame = readback->frame++;
+    if (readback->issued - readback->unmapped == GL_READBACK_SLOTS) {
+        readback->dropped += 1;
+        TRACE_END();
+        return;
+    }
+
+    GlReadbackSlot* const slot = gl_readback_slot(readback, readback->issued);
+    slot->frame = frame;
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot->buffer);
+    glReadPixels(0, 0, (GLsizei)readback->width, (GLsizei)readback->height,
+                 GL_BGR, GL_UNSIGNED_BYTE, NULL);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    slot->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    SDL_AtomicSet(&slot->state, GL_READBACK_PENDING);
+    readback->issued += 1;
+    TRACE_END();
+}
+
+void gl_readback_destroy(GlReadback* readback) {
+    if (!readback->enabled) return;
+
+    while (readback->unmapped < readback->issued) {
+        gl_readback_collect(readback, GL_READBACK_DRAIN_TIMEOUT);
+        if (readback->unmapped < readback->mapped) SDL_Delay(1);
+    }
+
+    SDL_LockMutex(readback->mutex);
+    SDL_AtomicSet(&readback->running, 0);
+    SDL_CondBroadcast(readback->cond);
+    SDL_UnlockMutex(readback->mutex);
+    SDL_WaitThread(readback->thread, NULL);
+    SDL_DestroyCond(readback->cond);
+    SDL_DestroyMutex(readback->mutex);
+
+    for (u32 i = 0; i < GL_READBACK_SLOTS; i++) {
+        resource_untrack(RESOURCE_GL_BUFFER, readback->slots[i].buffer);
+        glDeleteBuffers(1, &readback->slots[i].buffer);
+    }
+
+    printf("Readback: frames=%" PRIu64 " written=%" PRIu64
+           " dropped=%" PRIu64 " errors=%" PRIu64 "\n",
+           readback->frame, readback->written, readback->dropped,
+           readback->write_errors);
+}
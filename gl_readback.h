@@ -0,0 +1,66 @@
+#pragma once
+#include <SDL2/SDL.h>
+
+#include "opengl.h"
+#include "utils.h"
+
+// Asynchronous capture of the rendered frames to disk, without stalling the
+// render thread.
+//
+// `READBACK_DIR=<directory>` writes every frame there, as
+// `frame_<n>.bmp`, or `frame_<n>_<width>x<height>.raw` (BGR rows padded to
+// 4 bytes, bottom first) with `READBACK_FORMAT=raw`.
+//
+// Each frame is read into one of a ring of pixel pack buffers, with a fence.
+// Frames later, once the fence is signaled, the buffer is mapped and a worker
+// thread writes it out while the render thread goes on, then it is unmapped
+// and reused. When every buffer is busy, the frame is dropped and counted
+// rather than waited for.
+
+#define GL_READBACK_SLOTS 4
+
+typedef enum {
+    GL_READBACK_FREE,
+    GL_READBACK_PENDING,  // Read issued, waiting for the fence
+    GL_READBACK_MAPPED,   // Handed to the worker
+    GL_READBACK_WRITTEN,  // To unmap
+} GlReadbackState;
+
+typedef struct {
+    GLuint buffer;
+    GLsync fence;
+    u64 frame;
+    const u8* data;  // Mapped
+    SDL_atomic_t state;
+} GlReadbackSlot;
+
+typedef struct {
+    _Bool enabled;
+    const char* directory;
+    _Bool raw;
+    u32 width, height;
+    usize size;  // Of a frame
+
+    // Slots go through their states in ring order, these count the frames
+    // which went past each step: slot = count % GL_READBACK_SLOTS
+    GlReadbackSlot slots[GL_READBACK_SLOTS];
+    u64 issued, mapped, unmapped;
+    u64 frame;
+
+    SDL_Thread* thread;
+    SDL_mutex* mutex;
+    SDL_cond* cond;
+    SDL_atomic_t running;
+
+    u64 dropped;
+    // Worker only
+    u64 written, write_errors;
+} GlReadback;
+
+// From the environment, for a drawable of this size
+void gl_readback_init(GlReadback* readback, u32 width, u32 height);
+// Writes the frames in flight, then frees everything
+void gl_readback_destroy(GlReadback* readback);
+// After the frame is complete in the back buffer, before the swap: reads it
+// and collects the earlier ones which are ready
+void gl_readback_frame(GlReadback* readback);
@@ -0,0 +1,95 @@
+#include "job_pool.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "trace.h"
+
+static int job_pool_thread(void* data) {
+    JobPoolThread* const thread = data;
+    JobPool* const pool = thread->pool;
+    trace_thread_name(pool->name);
+
+    u32 generation = 0;
+    for (;;) {
+        SDL_LockMutex(pool->mutex);
+        while (pool->generation == generation && pool->running)
+            SDL_CondWait(pool->start, pool->mutex);
+        generation = pool->generation;
+        const _Bool running = pool->running;
+        SDL_UnlockMutex(pool->mutex);
+        if (!running) return 0;
+
+        pool->function(pool->data, thread->worker);
+
+        SDL_LockMutex(pool->mutex);
+        pool->finished_count += 1;
+        if (pool->finished_count == pool->thread_count)
+            SDL_CondSignal(pool->finished);
+        SDL_UnlockMutex(pool->mutex);
+    }
+}
+
+void job_pool_init(JobPool* pool, const char* name, const char* env,
+                   u32 max_threads) {
+    assert(max_threads <= JOB_POOL_MAX_THREADS);
+    memset(pool, 0, sizeof(JobPool));
+    pool->name = name;
+
+    const char* const threads = getenv(env);
+    const i32 cpus = SDL_GetCPUCount();
+    const i32 thread_count =
+        threads ? atoi(threads) : (cpus > 1 ? cpus - 1 : 0);
+    pool->thread_count = (u32)CLAMP(thread_count, 0, (i32)max_threads);
+
+    if (!pool->thread_count) return;
+    pool->mutex = SDL_CreateMutex();
+    pool->start = SDL_CreateCond();
+    pool->finished = SDL_CreateCond();
+    pool->running = true;
+    for (u32 i = 0; i < pool->thread_count; i++) {
+        JobPoolThread* const thread = &pool->threads[i];
+        thread->pool = pool;
+        thread->worker = i + 1;
+        thread->thread = SDL_CreateThread(job_pool_thread, name, thread);
+        if (!thread->thread) {
+            fprintf(stderr, "Could not start a %s worker: %s\n", name,
+                    SDL_GetError());
+            exit(1);
+        }
+    }
+}
+
+void job_pool_destroy(JobPool* pool) {
+    if (!pool->thread_count) return;
+
+    SDL_LockMutex(pool->mutex);
+    pool->running = false;
+    SDL_CondBroadcast(pool->start);
+    SDL_UnlockMutex(pool->mutex);
+    for (u32 i = 0; i < pool->thread_count; i++)
+        SDL_WaitThread(pool->threads[i].thread, NULL);
+    SDL_DestroyCond(pool->finished);
+    SDL_DestroyCond(pool->start);
+    SDL_DestroyMutex(pool->mutex);
+}
+
+void job_pool_run(JobPool* pool, JobPoolFunction function, void* data) {
+    if (pool->thread_count) {
+        SDL_LockMutex(pool->mutex);
+        pool->function = function;
+        pool->data = data;
+        pool->finished_count = 0;
+        pool->generation += 1;
+        SDL_CondBroadcast(pool->start);
+        SDL_UnlockMutex(pool->mutex);
+    }
+    function(data, 0);
+    if (pool->thread_count) {
+        SDL_LockMutex(pool->mutex);
+        while (pool->finished_count < pool->thread_count)
+            SDL_CondWait(pool->finished, pool->mutex);
+        SDL_UnlockMutex(pool->mutex);
+    }
+}
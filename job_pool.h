@@ -0,0 +1,47 @@
+#pragma once
+#include <SDL2/SDL.h>
+
+#include "utils.h"
+
+// Worker threads running a job together with the caller, for the modules
+// splitting their work across the cores (light_clusters.h, soft_raster.h).
+// The caller is worker 0, the threads workers 1 to `thread_count`.
+// `job_pool_run` wakes the threads, runs the job on the caller too, and
+// returns once every worker is done with it. The job splits the work
+// itself, e.g. every worker taking the next item from an atomic counter
+// until none is left.
+
+#define JOB_POOL_MAX_THREADS 15
+
+// Runs on every worker at once
+typedef void (*JobPoolFunction)(void* data, u32 worker);
+
+// Of one thread
+typedef struct {
+    struct JobPool* pool;
+    u32 worker;
+    SDL_Thread* thread;
+} JobPoolThread;
+
+typedef struct JobPool {
+    const char* name;  // Of the threads
+    JobPoolThread threads[JOB_POOL_MAX_THREADS];
+    u32 thread_count;
+    SDL_mutex* mutex;
+    SDL_cond* start;
+    SDL_cond* finished;
+    u32 generation, finished_count;
+    _Bool running;
+
+    // Of the last run
+    JobPoolFunction function;
+    void* data;
+} JobPool;
+
+// Starts the threads, as many as `env` (e.g. "LIGHT_THREADS") says, by
+// default one less than the CPUs, at most `max_threads`
+void job_pool_init(JobPool* pool, const char* name, const char* env,
+                   u32 max_threads);
+void job_pool_destroy(JobPool* pool);
+// Runs `function` on every worker, returns once they are all done
+void job_pool_run(JobPool* pool, JobPoolFunction function, void* data);
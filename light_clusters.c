@@ -0,0 +1,349 @@
+#include "light_clusters.h"
+
+#include <assert.h>
+#include <stdio.h>
+
+#include "simd.h"
+#include "trace.h"
+
+// max(v, 0)
+static SimdF32x4 light_clusters_positive(SimdF32x4 v) {
+    const SimdF32x4 zero = {0};
+    return (SimdF32x4)((SimdI32x4)v & (v > zero));
+}
+
+// Lanes of the 4 lights from `first` whose sphere touches the box: the
+// squared distance from the center to the box is below the squared radius
+static SimdI32x4 light_clusters_test(const LightClustersSet* set, u32 first,
+                                     const f32* min, const f32* max) {
+    const SimdF32x4 x = simd_load(set->x + first);
+    const SimdF32x4 y = simd_load(set->y + first);
+    const SimdF32x4 depth = simd_load(set->depth + first);
+    const SimdF32x4 radius = simd_load(set->radius + first);
+
+    const SimdF32x4 dx = light_clusters_positive(simd_splat(min[0]) - x) +
+                         light_clusters_positive(x - simd_splat(max[0]));
+    const SimdF32x4 dy = light_clusters_positive(simd_splat(min[1]) - y) +
+                         light_clusters_positive(y - simd_splat(max[1]));
+    const SimdF32x4 dz = light_clusters_positive(simd_splat(min[2]) - depth) +
+                         light_clusters_positive(depth - simd_splat(max[2]));
+    return dx * dx + dy * dy + dz * dz <= radius * radius;
+}
+
+// The lights of `in` touching the box
+static void light_clusters_cull(const LightClustersSet* in, const f32* min,
+                                const f32* max, LightClustersSet* out) {
+    out->count = 0;
+    for (u32 i = 0; i < in->count; i += 4) {
+        const SimdI32x4 hit = light_clusters_test(in, i, min, max);
+        const u32 lanes = MIN(4, in->count - i);
+        for (u32 lane = 0; lane < lanes; lane++) {
+            if (!hit[lane]) continue;
+            const u32 j = i + lane;
+            const u32 k = out->count++;
+            out->x[k] = in->x[j];
+            out->y[k] = in->y[j];
+            out->depth[k] = in->depth[j];
+            out->radius[k] = in->radius[j];
+            out->index[k] = in->index[j];
+        }
+    }
+}
+
+// Writes the indices of the lights of `in` touching the box, returns their
+// count. Those past RENDERER_MAX_LIGHTS_PER_CLUSTER are dropped.
+static u32 light_clusters_assign(const LightClustersSet* in, const f32* min,
+                                 const f32* max, u16* indices,
+                                 u32* dropped) {
+    u32 count = 0;
+    for (u32 i = 0; i < in->count; i += 4) {
+        const SimdI32x4 hit = light_clusters_test(in, i, min, max);
+        const u32 lanes = MIN(4, in->count - i);
+        for (u32 lane = 0; lane < lanes; lane++) {
+            if (!hit[lane]) continue;
+            if (count == RENDERER_MAX_LIGHTS_PER_CLUSTER) {
+                *dropped += 1;
+                continue;
+            }
+            indices[count++] = in->index[i + lane];
+        }
+    }
+    return count;
+}
+
+// Bounds of `count` clusters from `first`
+static void light_clusters_union(const LightClusters* clusters, u32 first,
+                                 u32 count, vec3 min, vec3 max) {
+    for (u32 axis = 0; axis < 3; axis++) {
+        min[axis] = clusters->bounds_min[first][axis];
+        max[axis] = clusters->bounds_max[first][axis];
+    }
+    for (u32 i = first + 1; i < first + count; i++) {
+        for (u32 axis = 0; axis < 3; axis++) {
+            min[axis] = MIN(min[axis], clusters->bounds_min[i][axis]);
+            max[axis] = MAX(max[axis], clusters->bounds_max[i][axis]);
+        }
+    }
+}
+
+static void light_clusters_slice(LightClusters* clusters,
+                                 LightClustersWorker* worker, u32 z) {
+    const u32 first = z * LIGHT_CLUSTERS_PER_SLICE;
+    vec3 min, max;
+    light_clusters_union(clusters, first, LIGHT_CLUSTERS_PER_SLICE, min, max);
+    light_clusters_cull(&clusters->lights, min, max, &worker->slice);
+
+    u32 dropped = 0;
+    for (u32 y = 0; y < RENDERER_CLUSTERS_Y; y++) {
+        const u32 row = first + y * RENDERER_CLUSTERS_X;
+        light_clusters_union(clusters, row, RENDERER_CLUSTERS_X, min, max);
+        light_clusters_cull(&worker->slice, min, max, &worker->row);
+
+        for (u32 x = 0; x < RENDERER_CLUSTERS_X; x += LIGHT_CLUSTERS_GROUP) {
+            light_clusters_union(clusters, row + x, LIGHT_CLUSTERS_GROUP, min,
+                                 max);
+            light_clusters_cull(&worker->row, min, max, &worker->group);
+
+            for (u32 i = 0; i < LIGHT_CLUSTERS_GROUP; i++) {
+                const u32 cluster = row + x + i;
+                u16* const indices = clusters->slice_indices +
+                                     (usize)cluster *
+                                         RENDERER_MAX_LIGHTS_PER_CLUSTER;
+                clusters->slice_counts[cluster] = light_clusters_assign(
+                    &worker->group, clusters->bounds_min[cluster],
+                    clusters->bounds_max[cluster], indices, &dropped);
+            }
+        }
+    }
+    clusters->slice_dropped[z] = dropped;
+}
+
+// Takes slices until none is left
+static void light_clusters_run(void* data, u32 worker) {
+    LightClusters* const clusters = data;
+    TRACE_BEGIN("light_clusters_assign");
+    for (;;) {
+        const u32 z = (u32)SDL_AtomicAdd(&clusters->next_slice, 1);
+        if (z >= RENDERER_CLUSTERS_Z) break;
+        light_clusters_slice(clusters, &clusters->workers[worker], z);
+    }
+    TRACE_END();
+}
+
+static usize light_clusters_set_size(u32 capacity) {
+    return (4 * sizeof(f32) + sizeof(u16)) * capacity + 5 * ARENA_ALIGNMENT;
+}
+
+static void light_clusters_set_init(LightClusters* clusters,
+                                    LightClustersSet* set, u32 capacity) {
+    Arena* const arena = &clusters->arena;
+    set->x = ARENA_ALLOC(arena, f32, capacity);
+    set->y = ARENA_ALLOC(arena, f32, capacity);
+    set->depth = ARENA_ALLOC(arena, f32, capacity);
+    set->radius = ARENA_ALLOC(arena, f32, capacity);
+    set->index = ARENA_ALLOC(arena, u16, capacity);
+    set->count = 0;
+    // The lanes past the count are read, never used
+    memset(set->x, 0, sizeof(f32) * capacity);
+    memset(set->y, 0, sizeof(f32) * capacity);
+    memset(set->depth, 0, sizeof(f32) * capacity);
+    memset(set->radius, 0, sizeof(f32) * capacity);
+}
+
+void light_clusters_init(LightClusters* clusters, u32 max_lights) {
+    assert(max_lights > 0 && max_lights <= RENDERER_MAX_LIGHTS);
+    memset(clusters, 0, sizeof(LightClusters));
+    clusters->max_lights = max_lights;
+
+    job_pool_init(&clusters->pool, "light_clusters", "LIGHT_THREADS",
+                  LIGHT_CLUSTERS_MAX_WORKERS);
+    const u32 worker_count = clusters->pool.thread_count + 1;
+
+    // Padded for the last lanes
+    const u32 capacity = (max_lights + 3) / 4 * 4;
+    const u32 set_count = 1 + 3 * worker_count;
+    const usize cluster_count = RENDERER_CLUSTER_COUNT;
+    arena_init(&clusters->arena, "light_clusters",
+               light_clusters_set_size(capacity) * set_count +
+                   2 * sizeof(vec3) * cluster_count + 2 * ARENA_ALIGNMENT);
+    Arena* const arena = &clusters->arena;
+    clusters->bounds_min = ARENA_ALLOC(arena, vec3, cluster_count);
+    clusters->bounds_max = ARENA_ALLOC(arena, vec3, cluster_count);
+    light_clusters_set_init(clusters, &clusters->lights, capacity);
+
+    for (u32 i = 0; i < worker_count; i++) {
+        LightClustersWorker* const worker = &clusters->workers[i];
+        light_clusters_set_init(clusters, &worker->slice, capacity);
+        light_clusters_set_init(clusters, &worker->row, capacity);
+        light_clusters_set_init(clusters, &worker->group, capacity);
+    }
+}
+
+void light_clusters_destroy(LightClusters* clusters) {
+    job_pool_destroy(&clusters->pool);
+    arena_print(&clusters->arena);
+    arena_destroy(&clusters->arena);
+}
+
+// View space bounds, depth positive: each tile is a quarter of the frustum
+// cut by the depths of its slice, bounded at both of them
+static void light_clusters_bounds(LightClusters* clusters) {
+    const f32 tan_y = tanf(clusters->fov_y * 0.5f);
+    const f32 tan_x = tan_y * clusters->aspect;
+    const f32 range = clusters->far / clusters->near;
+
+    for (u32 z = 0; z < RENDERER_CLUSTERS_Z; z++) {
+        const f32 near = clusters->near *
+                         powf(range, (f32)z / (f32)RENDERER_CLUSTERS_Z);
+        const f32 far = clusters->near *
+                        powf(range, (f32)(z + 1) / (f32)RENDERER_CLUSTERS_Z);
+
+        for (u32 y = 0; y < RENDERER_CLUSTERS_Y; y++) {
+            // In normalized device coordinates
+            const f32 y0 = 2.0f * (f32)y / (f32)RENDERER_CLUSTERS_Y - 1.0f;
+            const f32 y1 =
+                2.0f * (f32)(y + 1) / (f32)RENDERER_CLUSTERS_Y - 1.0f;
+
+            for (u32 x = 0; x < RENDERER_CLUSTERS_X; x++) {
+                const f32 x0 =
+                    2.0f * (f32)x / (f32)RENDERER_CLUSTERS_X - 1.0f;
+                const f32 x1 =
+                    2.0f * (f32)(x + 1) / (f32)RENDERER_CLUSTERS_X - 1.0f;
+                const u32 cluster =
+                    (z * RENDERER_CLUSTERS_Y + y) * RENDERER_CLUSTERS_X + x;
+                f32* const min = clusters->bounds_min[cluster];
+                f32* const max = clusters->bounds_max[cluster];
+
+                min[0] = MIN(x0 * near, x0 * far) * tan_x;
+                max[0] = MAX(x1 * near, x1 * far) * tan_x;
+                min[1] = MIN(y0 * near, y0 * far) * tan_y;
+                max[1] = MAX(y1 * near, y1 * far) * tan_y;
+                min[2] = near;
+                max[2] = far;
+            }
+        }
+    }
+}
+
+usize light_clusters_frame_size(void) {
+    const usize cluster_count = RENDERER_CLUSTER_COUNT;
+    return sizeof(u16) * RENDERER_MAX_LIGHTS_PER_CLUSTER * cluster_count +
+           3 * sizeof(u32) * cluster_count +
+           sizeof(u32) * RENDERER_CLUSTERS_Z +
+           sizeof(u16) * RENDERER_MAX_LIGHT_INDICES + 5 * ARENA_ALIGNMENT;
+}
+
+void light_clusters_update(LightClusters* clusters,
+                           const RendererLight* lights, u32 light_count,
+                           mat4 view, f32 fov_y, f32 aspect, f32 near,
+                           f32 far, Arena* frame, RendererLights* out) {
+    assert(light_count <= clusters->max_lights);
+    TRACE_BEGIN("light_clusters");
+    const u64 start = SDL_GetPerformanceCounter();
+
+    if (fov_y != clusters->fov_y || aspect != clusters->aspect ||
+        near != clusters->near || far != clusters->far) {
+        clusters->fov_y = fov_y;
+        clusters->aspect = aspect;
+        clusters->near = near;
+        clusters->far = far;
+        light_clusters_bounds(clusters);
+    }
+
+    LightClustersSet* const set = &clusters->lights;
+    for (u32 i = 0; i < light_count; i++) {
+        vec3 position;
+        glm_mat4_mulv3(view, (f32*)lights[i].position, 1.0f, position);
+        set->x[i] = position[0];
+        set->y[i] = position[1];
+        set->depth[i] = -position[2];
+        set->radius[i] = lights[i].radius;
+        set->index[i] = (u16)i;
+    }
+    set->count = light_count;
+
+    // Every thread takes slices, the caller too
+    clusters->slice_indices = ARENA_ALLOC(
+        frame, u16, RENDERER_MAX_LIGHTS_PER_CLUSTER * RENDERER_CLUSTER_COUNT);
+    clusters->slice_counts = ARENA_ALLOC(frame, u32, RENDERER_CLUSTER_COUNT);
+    clusters->slice_dropped = ARENA_ALLOC(frame, u32, RENDERER_CLUSTERS_Z);
+    SDL_AtomicSet(&clusters->next_slice, 0);
+    job_pool_run(&clusters->pool, light_clusters_run, clusters);
+
+    // Packed in cluster order
+    TRACE_BEGIN("light_clusters_pack");
+    u32 index_count = 0;
+    for (u32 i = 0; i < RENDERER_CLUSTER_COUNT; i++)
+        index_count += clusters->slice_counts[i];
+    clusters->ranges = ARENA_ALLOC(frame, u32, 2 * RENDERER_CLUSTER_COUNT);
+    clusters->indices = ARENA_ALLOC(
+        frame, u16, MIN(index_count, RENDERER_MAX_LIGHT_INDICES));
+    clusters->index_count = 0;
+    clusters->max_per_cluster = 0;
+    clusters->empty_clusters = 0;
+    clusters->dropped = 0;
+    for (u32 z = 0; z < RENDERER_CLUSTERS_Z; z++)
+        clusters->dropped += clusters->slice_dropped[z];
+    for (u32 i = 0; i < RENDERER_CLUSTER_COUNT; i++) {
+        const u32 count = MIN(clusters->slice_counts[i],
+                              RENDERER_MAX_LIGHT_INDICES -
+                                  clusters->index_count);
+        clusters->dropped += clusters->slice_counts[i] - count;
+        clusters->ranges[2 * i] = clusters->index_count;
+        clusters->ranges[2 * i + 1] = count;
+        memcpy(clusters->indices + clusters->index_count,
+               clusters->slice_indices +
+                   (usize)i * RENDERER_MAX_LIGHTS_PER_CLUSTER,
+               sizeof(u16) * count);
+        clusters->index_count += count;
+        clusters->max_per_cluster = MAX(clusters->max_per_cluster, count);
+        if (!count) clusters->empty_clusters += 1;
+    }
+    TRACE_END();
+
+    // Depth is -z in view space, the third row of the view matrix
+    *out = (RendererLights){
+        .lights = lights,
+        .light_count = light_count,
+        .ranges = clusters->ranges,
+        .indices = clusters->indices,
+        .index_count = clusters->index_count,
+        .depth_plane = {-view[0][2], -view[1][2], -view[2][2], -view[3][2]},
+        .slice_scale = (f32)RENDERER_CLUSTERS_Z / logf(far / near),
+    };
+    out->slice_bias = -logf(near) * out->slice_scale;
+
+    const f64 ms = (f64)(SDL_GetPerformanceCounter() - start) * 1000.0 /
+                   (f64)SDL_GetPerformanceFrequency();
+    clusters->update_count += 1;
+    clusters->total_indices += clusters->index_count;
+    clusters->total_dropped += clusters->dropped;
+    clusters->peak_per_cluster =
+        MAX(clusters->peak_per_cluster, clusters->max_per_cluster);
+    clusters->total_ms += ms;
+    clusters->max_ms = MAX(clusters->max_ms, ms);
+    TRACE_END();
+}
+
+void light_clusters_print(const LightClusters* clusters) {
+    if (!clusters->update_count) return;
+
+    const f64 updates = (f64)clusters->update_count;
+    const u32 used = RENDERER_CLUSTER_COUNT - clusters->empty_clusters;
+    printf("Light clusters: lights=%u clusters=%ux%ux%u threads=%u "
+           "updates=%" PRIu64 " lights_per_cluster_mean=%.2f "
+           "lights_per_cluster_peak=%u dropped_mean=%.1f "
+           "assign_mean=%.3fms assign_max=%.3fms\n",
+           clusters->lights.count, RENDERER_CLUSTERS_X, RENDERER_CLUSTERS_Y,
+           RENDERER_CLUSTERS_Z, clusters->pool.thread_count + 1,
+           clusters->update_count,
+           (f64)clusters->total_indices / updates / RENDERER_CLUSTER_COUNT,
+           clusters->peak_per_cluster,
+           (f64)clusters->total_dropped / updates,
+           clusters->total_ms / updates, clusters->max_ms);
+    printf("Light clusters: last update indices=%u non_empty_clusters=%u "
+           "lights_per_non_empty_cluster=%.2f lights_per_cluster_max=%u\n",
+           clusters->index_count, used,
+           used ? (f64)clusters->index_count / used : 0.0,
+           clusters->max_per_cluster);
+}
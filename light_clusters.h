@@ -0,0 +1,92 @@
+#pragma once
+#include <SDL2/SDL.h>
+#include <cglm/cglm.h>
+
+#include "allocator.h"
+#include "job_pool.h"
+#include "renderer.h"
+#include "utils.h"
+
+// Clustered forward lighting: the view frustum is split into
+// RENDERER_CLUSTERS_X by _Y tiles on screen and RENDERER_CLUSTERS_Z slices
+// in depth, thinner near the camera (exponential). Every frame, each point
+// light is assigned to the clusters its sphere touches, and the fragment
+// shaders only loop over the lights of their cluster.
+//
+// Slices are assigned in parallel, by worker threads and the caller, each
+// taking the next slice until none is left. Within a slice, the lights are
+// culled against the slice, then each row of tiles, then groups of tiles of
+// the row, then each cluster, 4 lights at a time with vector instructions
+// (SSE or NEON, through the compiler vector extensions). The lists are then
+// packed into one index buffer, the per cluster offsets and counts in
+// another.
+//
+// `LIGHT_THREADS=<n>` sets the number of workers, by default one less than
+// the CPUs, at most LIGHT_CLUSTERS_MAX_WORKERS.
+
+#define LIGHT_CLUSTERS_MAX_WORKERS 7
+#define LIGHT_CLUSTERS_PER_SLICE (RENDERER_CLUSTERS_X * RENDERER_CLUSTERS_Y)
+// Clusters of a row culled together, dividing RENDERER_CLUSTERS_X
+#define LIGHT_CLUSTERS_GROUP 4
+
+// Lights in view space, depth positive, structure of arrays for the vector
+// tests. Arrays are padded to a multiple of 4.
+typedef struct {
+    f32 *x, *y, *depth, *radius;
+    u16* index;  // Of the light
+    u32 count;
+} LightClustersSet;
+
+// Of one worker of the pool
+typedef struct {
+    LightClustersSet slice, row, group;
+} LightClustersWorker;
+
+typedef struct {
+    u32 max_lights;
+    Arena arena;
+
+    // Camera of the cluster bounds
+    f32 fov_y, aspect, near, far;
+    // View space bounds of every cluster, x first, then y, then z
+    vec3* bounds_min;
+    vec3* bounds_max;
+
+    LightClustersSet lights;
+    // In the frame arena of the last update:
+    // Lists of every slice, RENDERER_MAX_LIGHTS_PER_CLUSTER per cluster
+    u16* slice_indices;
+    u32* slice_counts;  // Per cluster
+    u32* slice_dropped;  // Per slice, over RENDERER_MAX_LIGHTS_PER_CLUSTER
+    // Packed, what the renderer uploads
+    u32* ranges;  // First and count per cluster
+    u16* indices;
+    u32 index_count;
+
+    JobPool pool;
+    LightClustersWorker workers[LIGHT_CLUSTERS_MAX_WORKERS + 1];
+    SDL_atomic_t next_slice;
+
+    // Last update
+    u32 max_per_cluster, empty_clusters, dropped;
+    // Since init
+    u64 update_count;
+    u64 total_indices, total_dropped;
+    u32 peak_per_cluster;
+    f64 total_ms, max_ms;
+} LightClusters;
+
+// Room for `max_lights`, at most RENDERER_MAX_LIGHTS, starts the workers
+void light_clusters_init(LightClusters* clusters, u32 max_lights);
+void light_clusters_destroy(LightClusters* clusters);
+// What an update takes from the frame arena, at most
+usize light_clusters_frame_size(void);
+// Assigns the lights (world space) to the clusters of the camera, with the
+// projection of `glm_perspective`. The lists are allocated from `frame`,
+// `out` points into them until it is reset.
+void light_clusters_update(LightClusters* clusters,
+                           const RendererLight* lights, u32 light_count,
+                           mat4 view, f32 fov_y, f32 aspect, f32 near,
+                           f32 far, Arena* frame, RendererLights* out);
+// Lights per cluster and assignment time
+void light_clusters_print(const LightClusters* clusters);
@@ -0,0 +1,191 @@
+#include "lod.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+
+#include "mesh_simplify.h"
+#include "trace.h"
+
+// Of `Lod.levels`, set during a selection
+#define LOD_CULLED 0x80
+#define LOD_LEVEL_MASK 0x7f
+
+usize lod_chain_capacity(u32 index_count) {
+    // Every level is simplified from the full mesh, into the space left
+    return (usize)index_count * LOD_MAX_LEVELS;
+}
+
+usize lod_chain_scratch_size(u32 index_count, u32 vertex_count) {
+    return mesh_simplify_scratch_size(index_count, vertex_count);
+}
+
+void lod_chain_build(LodChain* chain, u32* chain_indices, const u32* indices,
+                     u32 index_count, const f32* positions, u32 vertex_count,
+                     Arena* scratch) {
+    TRACE_BEGIN("lod_chain_build");
+    memset(chain, 0, sizeof(LodChain));
+    memcpy(chain_indices, indices, sizeof(u32) * index_count);
+    chain->levels[0] = (LodLevel){.index_count = index_count};
+    chain->level_count = 1;
+    chain->index_count = index_count;
+    for (u32 i = 0; i < index_count; i++)
+        chain->radius = MAX(chain->radius,
+                            glm_vec3_norm((f32*)&positions[indices[i] * 3]));
+
+    // From the full mesh every time, the errors are relative to it
+    while (chain->level_count < LOD_MAX_LEVELS) {
+        const LodLevel* const last = &chain->levels[chain->level_count - 1];
+        const u32 triangles = last->index_count / 3;
+        if (triangles <= LOD_MIN_TRIANGLES) break;
+
+        f32 error = 0.0f;
+        const u32 target = MAX(triangles / 4, LOD_MIN_TRIANGLES) * 3;
+        const u32 count = mesh_simplify(
+            &chain_indices[chain->index_count], indices, index_count,
+            positions, vertex_count, target, &error, scratch);
+        if ((f32)count > (1.0f - LOD_MIN_REDUCTION) * (f32)last->index_count)
+            break;
+
+        chain->levels[chain->level_count++] = (LodLevel){
+            .first_index = chain->index_count,
+            .index_count = count,
+            .error = MAX(error, last->error),
+        };
+        chain->index_count += count;
+    }
+    TRACE_END();
+}
+
+void lod_init(Lod* lod, const LodChain* chain, u32 instance_count) {
+    memset(lod, 0, sizeof(Lod));
+    lod->chain = *chain;
+    lod->instance_count = instance_count;
+    arena_init(&lod->arena, "lod", sizeof(u8) * instance_count +
+                                       ARENA_ALIGNMENT);
+    lod->levels = ARENA_ALLOC(&lod->arena, u8, instance_count);
+    memset(lod->levels, 0, sizeof(u8) * instance_count);
+}
+
+void lod_destroy(Lod* lod) {
+    arena_print(&lod->arena);
+    arena_destroy(&lod->arena);
+}
+
+void lod_view(LodView* view, mat4 view_matrix, mat4 projection,
+              u32 drawable_height, f32 near) {
+    mat4 view_projection, camera;
+    glm_mat4_mul(projection, view_matrix, view_projection);
+    glm_frustum_planes(view_projection, view->planes);
+    glm_mat4_inv(view_matrix, camera);
+    glm_vec3_copy(camera[3], view->position);
+    // projection[1][1] is 1 / tan(fov_y / 2)
+    view->pixels_per_unit = 0.5f * (f32)drawable_height * projection[1][1];
+    view->near = near;
+}
+
+// From `level`, the finest level under the limit when it is over it,
+// otherwise the coarsest one under the limit with the hysteresis
+static u32 lod_level_pick(const LodChain* chain, u32 level, f32 pixels) {
+    if (chain->levels[level].error * pixels > LOD_PIXEL_ERROR) {
+        while (level > 0 &&
+               chain->levels[level].error * pixels > LOD_PIXEL_ERROR)
+            level--;
+        return level;
+    }
+
+    while (level + 1 < chain->level_count &&
+           chain->levels[level + 1].error * pixels <=
+               LOD_PIXEL_ERROR * (1.0f - LOD_HYSTERESIS))
+        level++;
+    return level;
+}
+
+static _Bool lod_sphere_visible(const vec4 planes[6], const f32* center,
+                                f32 radius) {
+    for (u32 i = 0; i < 6; i++) {
+        if (glm_vec3_dot((f32*)planes[i], (f32*)center) + planes[i][3] <
+            -radius)
+            return false;
+    }
+    return true;
+}
+
+u32 lod_select(Lod* lod, const LodView* view, const vec3* centers, f32 scale,
+               u32* order, u32 counts[LOD_MAX_LEVELS]) {
+    TRACE_BEGIN("lod_select");
+    const LodChain* const chain = &lod->chain;
+    const f32 radius = chain->radius * scale;
+    memset(counts, 0, sizeof(u32) * LOD_MAX_LEVELS);
+
+    // Levels, then the visible instances grouped by level
+    u32 culled = 0;
+    for (u32 i = 0; i < lod->instance_count; i++) {
+        const u32 current = lod->levels[i] & LOD_LEVEL_MASK;
+        if (!lod_sphere_visible(view->planes, centers[i], radius)) {
+            lod->levels[i] = (u8)(current | LOD_CULLED);
+            culled += 1;
+            continue;
+        }
+
+        const f32 distance =
+            glm_vec3_distance((f32*)centers[i], (f32*)view->position);
+        // Of a mesh unit, at the nearest of the instance
+        const f32 pixels = view->pixels_per_unit * scale /
+                           MAX(distance - radius, view->near);
+        const u32 level = lod_level_pick(chain, current, pixels);
+        lod->total_transitions += level != current;
+        lod->levels[i] = (u8)level;
+        counts[level] += 1;
+    }
+
+    u32 offsets[LOD_MAX_LEVELS];
+    u32 visible = 0;
+    for (u32 level = 0; level < chain->level_count; level++) {
+        offsets[level] = visible;
+        visible += counts[level];
+        lod->total_level_instances[level] += counts[level];
+        lod->total_triangles +=
+            (u64)counts[level] * (chain->levels[level].index_count / 3);
+    }
+    for (u32 i = 0; i < lod->instance_count; i++) {
+        if (lod->levels[i] & LOD_CULLED) continue;
+        order[offsets[lod->levels[i]]++] = i;
+    }
+
+    lod->select_count += 1;
+    lod->total_instances += lod->instance_count;
+    lod->total_culled += culled;
+    TRACE_END();
+    return visible;
+}
+
+void lod_print(const Lod* lod) {
+    const LodChain* const chain = &lod->chain;
+    printf("LOD: levels=%u radius=%.3f", chain->level_count,
+           (f64)chain->radius);
+    for (u32 i = 0; i < chain->level_count; i++) {
+        printf(" level%u_triangles=%u level%u_error=%.5f", i,
+               chain->levels[i].index_count / 3, i,
+               (f64)chain->levels[i].error);
+    }
+    printf("\n");
+
+    const f64 selects = lod->select_count ? (f64)lod->select_count : 1.0;
+    const f64 instances = (f64)lod->total_instances / selects;
+    const f64 triangles = (f64)lod->total_triangles / selects;
+    const f64 full_triangles =
+        (f64)(lod->total_instances - lod->total_culled) / selects *
+        (chain->levels[0].index_count / 3);
+    printf("LOD: selects=%" PRIu64 " instances_mean=%.1f culled_mean=%.1f "
+           "transitions_mean=%.2f triangles_mean=%.1f "
+           "full_detail_triangles_mean=%.1f triangle_reduction=%.1fx",
+           lod->select_count, instances,
+           (f64)lod->total_culled / selects,
+           (f64)lod->total_transitions / selects, triangles, full_triangles,
+           triangles > 0.0 ? full_triangles / triangles : 0.0);
+    for (u32 i = 0; i < chain->level_count; i++) {
+        printf(" level%u_mean=%.1f", i,
+               (f64)lod->total_level_instances[i] / selects);
+    }
+    printf("\n");
+}
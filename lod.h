@@ -0,0 +1,83 @@
+#pragma once
+#include <cglm/cglm.h>
+
+#include "allocator.h"
+#include "utils.h"
+
+// Levels of detail: a mesh and its simplifications (mesh_simplify.h), each
+// with a quarter of the triangles of the one before, stored one after the
+// other in the index list of the mesh. Every level keeps the error of its
+// simplification, in mesh units.
+//
+// Every frame, the level of each instance is picked from its error once
+// projected on screen: the coarsest level whose error stays under
+// LOD_PIXEL_ERROR pixels at the distance of the instance. To keep from
+// popping back and forth at that distance, an instance only moves to a
+// coarser level once it is under the limit by LOD_HYSTERESIS. The
+// instances out of the frustum are culled at the same time, and the others
+// are grouped by level, a draw per level.
+
+#define LOD_MAX_LEVELS 6
+// Simplification stops at this number of triangles, or when a level has
+// less than LOD_MIN_REDUCTION of the triangles of the one before removed
+#define LOD_MIN_TRIANGLES 32
+#define LOD_MIN_REDUCTION 0.2f
+#define LOD_PIXEL_ERROR 1.0f
+#define LOD_HYSTERESIS 0.25f
+
+typedef struct {
+    u32 first_index, index_count;
+    f32 error;  // Mesh units, 0 for the full mesh
+} LodLevel;
+
+typedef struct {
+    LodLevel levels[LOD_MAX_LEVELS];
+    u32 level_count;
+    u32 index_count;  // Of every level
+    f32 radius;  // Around the origin of the mesh
+} LodChain;
+
+// Camera of a selection
+typedef struct {
+    vec4 planes[6];  // Of the frustum
+    vec3 position;
+    // Of a unit at a distance of 1, e.g. height / (2 tan(fov_y / 2))
+    f32 pixels_per_unit;
+    f32 near;
+} LodView;
+
+typedef struct {
+    LodChain chain;
+    Arena arena;
+    u32 instance_count;
+    u8* levels;  // Per instance, the full mesh at first, kept while culled
+
+    // Since the init, a selection per frame
+    u64 select_count;
+    u64 total_instances, total_culled, total_transitions;
+    u64 total_level_instances[LOD_MAX_LEVELS];
+    u64 total_triangles;
+} Lod;
+
+// Index count of the chain of a mesh of `index_count` indices, at most
+usize lod_chain_capacity(u32 index_count);
+// Of `lod_chain_build`, taken from `scratch` and given back
+usize lod_chain_scratch_size(u32 index_count, u32 vertex_count);
+// Writes the full mesh then its simplifications to `chain_indices`, at
+// most `lod_chain_capacity` of them. `positions` are vec3.
+void lod_chain_build(LodChain* chain, u32* chain_indices, const u32* indices,
+                     u32 index_count, const f32* positions, u32 vertex_count,
+                     Arena* scratch);
+
+void lod_init(Lod* lod, const LodChain* chain, u32 instance_count);
+void lod_destroy(Lod* lod);
+void lod_view(LodView* view, mat4 view_matrix, mat4 projection,
+              u32 drawable_height, f32 near);
+// Picks the level of every instance of `centers`, scaled by `scale`, and
+// writes the visible ones to `order` grouped by level, in the order of
+// `centers` within a level. `counts` gets the number of instances of each
+// level, returns their sum.
+u32 lod_select(Lod* lod, const LodView* view, const vec3* centers, f32 scale,
+               u32* order, u32 counts[LOD_MAX_LEVELS]);
+// Levels of the chain, and where the instances were
+void lod_print(const Lod* lod);
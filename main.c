@@ -1,13 +1,131 @@
+#include <SDL2/SDL.h>
 #include <stdbool.h>
+#include <stdlib.h>
 
-#include "opengl_lifecycle.h"
+#include "renderer.h"
+#include "scene.h"
+#include "sim.h"
+#include "trace.h"
 #include "utils.h"
 
 int main() {
-    SDL_Window* window;
-    SDL_GLContext* context;
-    if (!gl_init(&window, &context)) return 1;
+    // `BACKEND=gl|vulkan|soft` selects the renderer, `CUBES=<count>` the
+    // number of instanced cubes, `LIGHTS=<count>` the number of point lights,
+    // `PARTICLES=<count>` the number of GPU particles, `STATIC=<count>` the
+    // number of cubes which never move, `LOD=0|1` spheres instead of cubes,
+    // at full detail or with levels of detail, `GRAPH=<percent>` the cubes
+    // in a scene graph, the percentage of them moving, `WORLD=<path>` a world
+    // file streamed around a flying camera, in `WORLD_BUDGET=<MB>`,
+    // `TICK_RATE=<hz>` the simulation rate, `TRACE=<path>` records a trace,
+    // also written on F12
+    trace_init();
+    trace_thread_name("main");
 
-    gl_loop(window);
-}
+    Renderer renderer;
+    if (!renderer_init(&renderer, renderer_backend_from_env(), false)) return 1;
+
+    const char* const cubes = getenv("CUBES");
+    const u32 cube_count = cubes ? (u32)strtoul(cubes, NULL, 10) : 10;
+    const char* const lights = getenv("LIGHTS");
+    const u32 light_count = lights ? (u32)strtoul(lights, NULL, 10) : 0;
+    const char* const statics = getenv("STATIC");
+    const u32 static_count = statics ? (u32)strtoul(statics, NULL, 10) : 0;
+    const char* const lod = getenv("LOD");
+    const char* const graph = getenv("GRAPH");
+    const u32 moving_percent = graph ? (u32)strtoul(graph, NULL, 10) : 0;
+    const char* const world = getenv("WORLD");
+    const char* const world_budget = getenv("WORLD_BUDGET");
+    const char* const particles = getenv("PARTICLES");
+    const u32 particle_count =
+        particles ? (u32)strtoul(particles, NULL, 10) : 0;
+
+    const SceneDesc desc = {
+        .instance_count = cube_count > 0 ? cube_count : 1,
+        .material_count = 1,
+        .quantized_vertices = true,
+        .spheres = lod != NULL,
+        .lod = lod && strtoul(lod, NULL, 10) != 0 && !graph,
+        .scene_graph = graph != NULL,
+        .moving_percent = MIN(moving_percent, 100),
+        .world_path = world,
+        .world_budget_mb =
+            world_budget ? (u32)strtoul(world_budget, NULL, 10) : 0,
+        .light_count = MIN(light_count, RENDERER_MAX_LIGHTS),
+        .static_count = static_count,
+        .particle_count =
+            particle_count
+                ? CLAMP(particle_count, SCENE_EMITTERS, RENDERER_MAX_PARTICLES)
+                : 0,
+    };
+    Scene scene;
+    scene_create(&scene, &renderer, &desc);
+
+    SDL_SetRelativeMouseMode(SDL_FALSE);
+
+    // The animation runs on the simulation thread, which poses the scene,
+    // frames draw its last two ticks blended
+    Sim sim;
+    sim_start(&sim, &scene);
+
+    const u8 fps_desired = 60;
+    const u8 frame_rate = 1000 / fps_desired;
 
+    _Bool done = false;
+    while (!done) {
+        const u32 start = SDL_GetTicks();
+        TRACE_BEGIN("frame");
+
+        //
+        // Input
+        //
+        TRACE_BEGIN("input");
+        SDL_Event event;
+        while (SDL_PollEvent(&event)) {
+            switch (event.type) {
+                case SDL_QUIT:
+                    done = true;
+                    break;
+                case SDL_KEYDOWN:
+                    switch (event.key.keysym.scancode) {
+                        case SDL_SCANCODE_ESCAPE:
+                            done = true;
+                            break;
+                        case SDL_SCANCODE_LEFT:
+                            sim_rotate(&sim);
+                            break;
+                        case SDL_SCANCODE_F12:
+                            trace_dump(getenv("TRACE"));
+                            break;
+                        default:
+                            break;
+                    }
+                    break;
+                default:
+                    break;
+            }
+        }
+        TRACE_END();
+        const ScenePose* const pose =
+            sim_interpolate(&sim, SDL_GetPerformanceCounter());
+
+        //
+        // Rendering
+        //
+        RendererFrame frame;
+        scene_frame(pose, &renderer, &frame);
+        renderer_frame_begin(&renderer, &frame);
+        scene_draw(&scene, pose, &renderer);
+        renderer_frame_submit(&renderer);
+        renderer_frame_end(&renderer);
+        TRACE_END();
+
+        const u32 delta_time = SDL_GetTicks() - start;
+        if (delta_time < frame_rate) SDL_Delay(frame_rate - delta_time);
+    }
+
+    sim_stop(&sim);
+    renderer_stats_print(&renderer);
+    scene_destroy(&scene);
+    renderer_destroy(&renderer);
+    trace_shutdown();
+}
@@ -0,0 +1,132 @@
+#include "mesh.h"
+
+#include <assert.h>
+
+void mesh_bounds(const f32* positions, u32 vertex_count, MeshBounds* bounds) {
+    vec3 min = {INFINITY, INFINITY, INFINITY};
+    vec3 max = {-INFINITY, -INFINITY, -INFINITY};
+    for (u32 i = 0; i < vertex_count * 3; i++) {
+        min[i % 3] = MIN(min[i % 3], positions[i]);
+        max[i % 3] = MAX(max[i % 3], positions[i]);
+    }
+
+    for (u32 axis = 0; axis < 3; axis++) {
+        bounds->center[axis] = (min[axis] + max[axis]) * 0.5f;
+        const f32 extent = (max[axis] - min[axis]) * 0.5f;
+        // Flat along this axis, every vertex quantizes to 0
+        bounds->extent[axis] = extent > 0.0f ? extent : 1.0f;
+    }
+}
+
+void mesh_quantize_positions(const f32* positions, u32 vertex_count,
+                             const MeshBounds* bounds,
+                             MeshQuantizedPosition* quantized) {
+    for (u32 i = 0; i < vertex_count; i++) {
+        for (u32 axis = 0; axis < 3; axis++) {
+            const f32 unit = (positions[i * 3 + axis] - bounds->center[axis]) /
+                             bounds->extent[axis];
+            quantized[i].xyzw[axis] =
+                (i16)lroundf(CLAMP(unit, -1.0f, 1.0f) * 32767.0f);
+        }
+        quantized[i].xyzw[3] = 0;
+    }
+}
+
+void mesh_quantize_uvs(const f32* uvs, u32 vertex_count,
+                       MeshQuantizedUv* quantized) {
+    for (u32 i = 0; i < vertex_count * 2; i++) {
+        quantized[i / 2].uv[i % 2] =
+            (u16)lroundf(CLAMP(uvs[i], 0.0f, 1.0f) * 65535.0f);
+    }
+}
+
+void mesh_dequantize(const MeshBounds* bounds, mat4 model) {
+    glm_translate(model, (f32*)bounds->center);
+    glm_scale(model, (f32*)bounds->extent);
+}
+
+usize mesh_sphere_scratch_size(u32 subdivisions) {
+    const usize side = subdivisions + 1;
+    return sizeof(u32) * side * side * side + ARENA_ALIGNMENT;
+}
+
+void mesh_sphere(u32 subdivisions, f32* positions, u32* indices,
+                 Arena* scratch) {
+    // Vertex of every point of the lattice of the cube, those of the edges
+    // are shared by the faces
+    const u32 side = subdivisions + 1;
+    const ArenaMark mark = arena_mark(scratch);
+    u32* const lattice = ARENA_ALLOC(scratch, u32, side * side * side);
+    memset(lattice, 0xff, sizeof(u32) * side * side * side);
+
+    u32 vertex_count = 0, index_count = 0;
+    for (u32 face = 0; face < 6; face++) {
+        // The grid spans the two next axes, counter clockwise from outside
+        const u32 axis = face / 2;
+        const _Bool positive = face % 2;
+        u32 grid[2][2];
+        for (u32 i = 0; i < subdivisions; i++) {
+            for (u32 j = 0; j < subdivisions; j++) {
+                for (u32 corner = 0; corner < 4; corner++) {
+                    u32 point[3];
+                    point[axis] = positive ? subdivisions : 0;
+                    point[(axis + 1) % 3] = i + corner % 2;
+                    point[(axis + 2) % 3] = j + corner / 2;
+                    u32* const vertex =
+                        &lattice[(point[0] * side + point[1]) * side +
+                                 point[2]];
+                    if (*vertex == UINT32_MAX) {
+                        f32* const p = &positions[vertex_count * 3];
+                        for (u32 k = 0; k < 3; k++)
+                            p[k] = (f32)point[k] * 2.0f /
+                                       (f32)subdivisions -
+                                   1.0f;
+                        glm_vec3_normalize(p);
+                        *vertex = vertex_count++;
+                    }
+                    grid[corner / 2][corner % 2] = *vertex;
+                }
+
+                const u32 quad[2][3] = {
+                    {grid[0][0], grid[0][1], grid[1][1]},
+                    {grid[0][0], grid[1][1], grid[1][0]},
+                };
+                for (u32 t = 0; t < 2; t++) {
+                    indices[index_count++] = quad[t][0];
+                    indices[index_count++] = quad[t][positive ? 1 : 2];
+                    indices[index_count++] = quad[t][positive ? 2 : 1];
+                }
+            }
+        }
+    }
+    assert(vertex_count == MESH_SPHERE_VERTEX_COUNT(subdivisions));
+    assert(index_count == MESH_SPHERE_INDEX_COUNT(subdivisions));
+    arena_release(scratch, mark);
+}
+
+void mesh_sphere_unweld(const f32* positions, const u32* indices,
+                        u32 index_count, f32* vertex_positions,
+                        f32* vertex_uvs) {
+    for (u32 i = 0; i < index_count; i += 3) {
+        vec3 center = GLM_VEC3_ZERO_INIT;
+        for (u32 j = 0; j < 3; j++)
+            glm_vec3_add(center, (f32*)&positions[indices[i + j] * 3],
+                         center);
+
+        u32 axis = 0;
+        for (u32 k = 1; k < 3; k++)
+            if (fabsf(center[k]) > fabsf(center[axis])) axis = k;
+        const f32 sign = center[axis] < 0.0f ? -1.0f : 1.0f;
+
+        // Projected from the center of the sphere onto the face. Corners
+        // of coarse levels can be far from it, the projection is bounded.
+        for (u32 j = 0; j < 3; j++) {
+            const f32* const p = &positions[indices[i + j] * 3];
+            const f32 depth = MAX(p[axis] * sign, 0.5f);
+            memcpy(&vertex_positions[(i + j) * 3], p, sizeof(vec3));
+            vertex_uvs[(i + j) * 2] = p[(axis + 1) % 3] / depth * 0.5f + 0.5f;
+            vertex_uvs[(i + j) * 2 + 1] =
+                p[(axis + 2) % 3] / depth * 0.5f + 0.5f;
+        }
+    }
+}
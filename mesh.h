@@ -0,0 +1,59 @@
+#pragma once
+#include <cglm/cglm.h>
+
+#include "allocator.h"
+#include "utils.h"
+
+// Vertex compression, for RENDERER_VERTEX_QUANTIZED: positions become 16 bits
+// normalized integers relative to the bounds of the mesh, UVs 16 bits
+// unsigned normalized. 20 bytes per vertex become 12.
+//
+// Positions are dequantized by the model matrix (`mesh_dequantize`), the
+// shaders are the same for both formats. The error is under 1/65535 of the
+// mesh size per axis.
+
+// x, y, z then padding: 3 component 16 bits formats are rarely supported
+typedef struct {
+    i16 xyzw[4];
+} MeshQuantizedPosition;
+
+typedef struct {
+    u16 uv[2];
+} MeshQuantizedUv;
+
+// Axis aligned
+typedef struct {
+    vec3 center;
+    vec3 extent;  // Half size, never 0
+} MeshBounds;
+
+void mesh_bounds(const f32* positions, u32 vertex_count, MeshBounds* bounds);
+// `positions` are vec3
+void mesh_quantize_positions(const f32* positions, u32 vertex_count,
+                             const MeshBounds* bounds,
+                             MeshQuantizedPosition* quantized);
+// `uvs` are vec2, clamped to [0, 1]
+void mesh_quantize_uvs(const f32* uvs, u32 vertex_count,
+                       MeshQuantizedUv* quantized);
+// Applies the dequantization to `model`, after everything else
+void mesh_dequantize(const MeshBounds* bounds, mat4 model);
+
+// A cube inflated into a sphere of radius 1, every face a grid of
+// `subdivisions` squares per side, welded: a dense closed mesh for the
+// levels of detail (lod.h)
+#define MESH_SPHERE_VERTEX_COUNT(subdivisions) \
+    (6 * (subdivisions) * (subdivisions) + 2)
+#define MESH_SPHERE_INDEX_COUNT(subdivisions) \
+    (36 * (subdivisions) * (subdivisions))
+
+// Of `mesh_sphere`, taken from `scratch` and given back
+usize mesh_sphere_scratch_size(u32 subdivisions);
+// `positions` are vec3
+void mesh_sphere(u32 subdivisions, f32* positions, u32* indices,
+                 Arena* scratch);
+// Non indexed vertices of triangles of the sphere, e.g. of a simplification,
+// each textured like the face of the cube under its center. `vertex_uvs`
+// are vec2.
+void mesh_sphere_unweld(const f32* positions, const u32* indices,
+                        u32 index_count, f32* vertex_positions,
+                        f32* vertex_uvs);
@@ -0,0 +1,286 @@
+#include "mesh_simplify.h"
+
+#include <assert.h>
+#include <cglm/cglm.h>
+
+#include "trace.h"
+
+// First index of a removed triangle
+#define MESH_SIMPLIFY_REMOVED UINT32_MAX
+// Cosine of the largest turn of a triangle in a collapse
+#define MESH_SIMPLIFY_MAX_TURN 0.25f
+
+// Upper half of a symmetric 4x4 matrix: aa ab ac ad bb bc bd cc cd dd,
+// weighted by the area of the triangles
+typedef struct {
+    f64 q[10];
+    f64 area;
+} MeshQuadric;
+
+typedef struct {
+    f32 cost;
+    u32 from, to;
+} MeshCollapse;
+
+// Of the plane ax + by + cz + d = 0, normalized
+static void mesh_quadric_add_plane(MeshQuadric* quadric, const f64 plane[4],
+                                   f64 area) {
+    u32 k = 0;
+    for (u32 i = 0; i < 4; i++)
+        for (u32 j = i; j < 4; j++)
+            quadric->q[k++] += plane[i] * plane[j] * area;
+    quadric->area += area;
+}
+
+static void mesh_quadric_add(MeshQuadric* quadric, const MeshQuadric* other) {
+    for (u32 i = 0; i < 10; i++) quadric->q[i] += other->q[i];
+    quadric->area += other->area;
+}
+
+// Of the sum of both quadrics at `p`: the mean of the squared distances to
+// their planes, by area
+static f64 mesh_quadric_error(const MeshQuadric* a, const MeshQuadric* b,
+                              const f32* p) {
+    const f64 v[4] = {p[0], p[1], p[2], 1.0};
+    f64 error = 0.0;
+    u32 k = 0;
+    for (u32 i = 0; i < 4; i++) {
+        for (u32 j = i; j < 4; j++, k++) {
+            const f64 q = a->q[k] + b->q[k];
+            error += (i == j ? 1.0 : 2.0) * q * v[i] * v[j];
+        }
+    }
+    const f64 area = a->area + b->area;
+    return area > 0.0 ? MAX(error, 0.0) / area : 0.0;
+}
+
+static void mesh_triangle_normal(const f32* a, const f32* b, const f32* c,
+                                 vec3 normal) {
+    vec3 ab, ac;
+    glm_vec3_sub((f32*)b, (f32*)a, ab);
+    glm_vec3_sub((f32*)c, (f32*)a, ac);
+    glm_vec3_cross(ab, ac, normal);
+}
+
+static void mesh_quadrics(const u32* indices, u32 index_count,
+                          const f32* positions, u32 vertex_count,
+                          MeshQuadric* quadrics) {
+    memset(quadrics, 0, sizeof(MeshQuadric) * vertex_count);
+    for (u32 i = 0; i < index_count; i += 3) {
+        const f32* const a = &positions[indices[i] * 3];
+        vec3 normal;
+        mesh_triangle_normal(a, &positions[indices[i + 1] * 3],
+                             &positions[indices[i + 2] * 3], normal);
+        const f32 length = glm_vec3_norm(normal);
+        // Degenerate, no plane
+        if (length <= 0.0f) continue;
+
+        glm_vec3_scale(normal, 1.0f / length, normal);
+        const f64 plane[4] = {normal[0], normal[1], normal[2],
+                              -glm_vec3_dot(normal, (f32*)a)};
+        for (u32 j = 0; j < 3; j++)
+            mesh_quadric_add_plane(&quadrics[indices[i + j]], plane,
+                                   0.5 * length);
+    }
+}
+
+// Triangles of every vertex: adjacency[offsets[v]] to
+// adjacency[offsets[v + 1]]
+static void mesh_adjacency(const u32* triangles, u32 index_count,
+                           u32 vertex_count, u32* offsets, u32* adjacency) {
+    memset(offsets, 0, sizeof(u32) * (vertex_count + 1));
+    for (u32 i = 0; i < index_count; i++) offsets[triangles[i] + 1] += 1;
+    for (u32 v = 0; v < vertex_count; v++) offsets[v + 1] += offsets[v];
+    // Each offset ends up at the next one, then they are shifted back
+    for (u32 i = 0; i < index_count; i++)
+        adjacency[offsets[triangles[i]]++] = i / 3;
+    for (u32 v = vertex_count; v > 0; v--) offsets[v] = offsets[v - 1];
+    offsets[0] = 0;
+}
+
+static int mesh_collapse_compare(const void* a, const void* b) {
+    const f32 x = ((const MeshCollapse*)a)->cost;
+    const f32 y = ((const MeshCollapse*)b)->cost;
+    return (x > y) - (x < y);
+}
+
+// The cheapest direction of every edge, once per edge of a closed mesh:
+// only from the triangle where it goes up. Boundary edges going down are
+// never collapsed.
+static u32 mesh_collapses_rank(const u32* triangles, u32 index_count,
+                               const f32* positions,
+                               const MeshQuadric* quadrics,
+                               MeshCollapse* collapses) {
+    u32 count = 0;
+    for (u32 i = 0; i < index_count; i++) {
+        const u32 a = triangles[i];
+        const u32 b = triangles[i - i % 3 + (i + 1) % 3];
+        if (a >= b) continue;
+
+        const f64 at_a =
+            mesh_quadric_error(&quadrics[a], &quadrics[b], &positions[a * 3]);
+        const f64 at_b =
+            mesh_quadric_error(&quadrics[a], &quadrics[b], &positions[b * 3]);
+        collapses[count++] = at_b <= at_a
+                                 ? (MeshCollapse){(f32)at_b, a, b}
+                                 : (MeshCollapse){(f32)at_a, b, a};
+    }
+    qsort(collapses, count, sizeof(MeshCollapse), mesh_collapse_compare);
+    return count;
+}
+
+typedef struct {
+    u32* triangles;
+    u32 index_count;
+    const f32* positions;
+    u32* offsets;
+    u32* adjacency;
+    MeshQuadric* quadrics;
+    u8* locked;  // Next to a collapse of the pass
+    u32* marks;
+    u32 mark;
+} MeshSimplify;
+
+// Not flipping a triangle, and the vertices next to both ends are the
+// opposite corners of the triangles of the edge: otherwise the surface
+// would fold onto itself
+static _Bool mesh_collapse_valid(MeshSimplify* s, u32 from, u32 to) {
+    const u32 neighbor = s->mark++;
+    const u32 counted = s->mark++;
+    for (u32 i = s->offsets[to]; i < s->offsets[to + 1]; i++) {
+        const u32* const t = &s->triangles[s->adjacency[i] * 3];
+        if (t[0] == MESH_SIMPLIFY_REMOVED) continue;
+        for (u32 j = 0; j < 3; j++) s->marks[t[j]] = neighbor;
+    }
+
+    u32 shared = 0, common = 0;
+    for (u32 i = s->offsets[from]; i < s->offsets[from + 1]; i++) {
+        const u32* const t = &s->triangles[s->adjacency[i] * 3];
+        if (t[0] == MESH_SIMPLIFY_REMOVED) continue;
+        if (t[0] == to || t[1] == to || t[2] == to) {
+            shared += 1;
+        } else {
+            vec3 before, after;
+            const f32* p[3];
+            for (u32 j = 0; j < 3; j++) p[j] = &s->positions[t[j] * 3];
+            mesh_triangle_normal(p[0], p[1], p[2], before);
+            for (u32 j = 0; j < 3; j++)
+                if (t[j] == from) p[j] = &s->positions[to * 3];
+            mesh_triangle_normal(p[0], p[1], p[2], after);
+            // Turned by more than MESH_SIMPLIFY_MAX_TURN, or degenerate
+            if (glm_vec3_dot(before, after) <=
+                MESH_SIMPLIFY_MAX_TURN * glm_vec3_norm(before) *
+                    glm_vec3_norm(after))
+                return false;
+        }
+
+        for (u32 j = 0; j < 3; j++) {
+            const u32 v = t[j];
+            if (v == from || v == to || s->marks[v] != neighbor) continue;
+            s->marks[v] = counted;
+            common += 1;
+        }
+    }
+    return shared > 0 && common == shared;
+}
+
+// Returns the number of triangles removed
+static u32 mesh_collapse(MeshSimplify* s, u32 from, u32 to) {
+    for (u32 i = s->offsets[to]; i < s->offsets[to + 1]; i++) {
+        const u32* const t = &s->triangles[s->adjacency[i] * 3];
+        if (t[0] == MESH_SIMPLIFY_REMOVED) continue;
+        for (u32 j = 0; j < 3; j++) s->locked[t[j]] = true;
+    }
+
+    u32 removed = 0;
+    for (u32 i = s->offsets[from]; i < s->offsets[from + 1]; i++) {
+        u32* const t = &s->triangles[s->adjacency[i] * 3];
+        if (t[0] == MESH_SIMPLIFY_REMOVED) continue;
+        for (u32 j = 0; j < 3; j++) s->locked[t[j]] = true;
+
+        if (t[0] == to || t[1] == to || t[2] == to) {
+            t[0] = t[1] = t[2] = MESH_SIMPLIFY_REMOVED;
+            removed += 1;
+        } else {
+            for (u32 j = 0; j < 3; j++)
+                if (t[j] == from) t[j] = to;
+        }
+    }
+    mesh_quadric_add(&s->quadrics[to], &s->quadrics[from]);
+    return removed;
+}
+
+// Moves the remaining triangles to the front
+static u32 mesh_triangles_compact(u32* triangles, u32 index_count) {
+    u32 count = 0;
+    for (u32 i = 0; i < index_count; i += 3) {
+        if (triangles[i] == MESH_SIMPLIFY_REMOVED) continue;
+        memmove(&triangles[count], &triangles[i], sizeof(u32) * 3);
+        count += 3;
+    }
+    return count;
+}
+
+usize mesh_simplify_scratch_size(u32 index_count, u32 vertex_count) {
+    return sizeof(u32) * (2 * (usize)index_count + 2 * (usize)vertex_count +
+                          1) +
+           sizeof(MeshCollapse) * index_count +
+           (sizeof(MeshQuadric) + sizeof(u8)) * vertex_count +
+           7 * ARENA_ALIGNMENT;
+}
+
+u32 mesh_simplify(u32* destination, const u32* indices, u32 index_count,
+                  const f32* positions, u32 vertex_count,
+                  u32 target_index_count, f32* error, Arena* scratch) {
+    assert(index_count % 3 == 0);
+    TRACE_BEGIN("mesh_simplify");
+    const ArenaMark mark = arena_mark(scratch);
+    MeshSimplify s = {
+        .triangles = ARENA_ALLOC(scratch, u32, index_count),
+        .index_count = index_count,
+        .positions = positions,
+        .offsets = ARENA_ALLOC(scratch, u32, vertex_count + 1),
+        .adjacency = ARENA_ALLOC(scratch, u32, index_count),
+        .quadrics = ARENA_ALLOC(scratch, MeshQuadric, vertex_count),
+        .locked = ARENA_ALLOC(scratch, u8, vertex_count),
+        .marks = ARENA_ALLOC(scratch, u32, vertex_count),
+        .mark = 1,
+    };
+    MeshCollapse* const collapses =
+        ARENA_ALLOC(scratch, MeshCollapse, index_count);
+    memcpy(s.triangles, indices, sizeof(u32) * index_count);
+    memset(s.marks, 0, sizeof(u32) * vertex_count);
+    mesh_quadrics(indices, index_count, positions, vertex_count, s.quadrics);
+
+    u32 triangle_count = index_count / 3;
+    const u32 target_triangles = target_index_count / 3;
+    f32 max_cost = 0.0f;
+    while (triangle_count > target_triangles) {
+        s.index_count = mesh_triangles_compact(s.triangles, s.index_count);
+        mesh_adjacency(s.triangles, s.index_count, vertex_count, s.offsets,
+                       s.adjacency);
+        const u32 collapse_count = mesh_collapses_rank(
+            s.triangles, s.index_count, positions, s.quadrics, collapses);
+        memset(s.locked, 0, vertex_count);
+
+        u32 collapsed = 0;
+        for (u32 i = 0; i < collapse_count; i++) {
+            if (triangle_count <= target_triangles) break;
+            const MeshCollapse* const c = &collapses[i];
+            if (s.locked[c->from] || s.locked[c->to]) continue;
+            if (!mesh_collapse_valid(&s, c->from, c->to)) continue;
+
+            triangle_count -= mesh_collapse(&s, c->from, c->to);
+            max_cost = MAX(max_cost, c->cost);
+            collapsed += 1;
+        }
+        if (!collapsed) break;
+    }
+
+    s.index_count = mesh_triangles_compact(s.triangles, s.index_count);
+    memcpy(destination, s.triangles, sizeof(u32) * s.index_count);
+    *error = sqrtf(max_cost);
+    arena_release(scratch, mark);
+    TRACE_END();
+    return s.index_count;
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include "allocator.h"
+#include "utils.h"
+
+// Mesh simplification with quadric error metrics (Garland and Heckbert).
+//
+// Every vertex has a quadric: the sum of the squared distances to the
+// planes of its triangles. Collapsing an edge moves one of its vertices onto
+// the other, which keeps its position and the sum of both quadrics. The cost
+// of a collapse is the kept quadric at the kept position, the cheapest
+// direction of every edge is taken.
+//
+// Collapses are made in passes: the edges are ranked by cost, then
+// collapsed cheapest first, skipping those next to a collapse of the pass.
+// A collapse is refused when it would flip a triangle or pinch the surface.
+//
+// The simplified triangles reference the vertices of the input, which are
+// neither moved nor added: levels of detail share their vertex buffer. Meant
+// for closed meshes, welded on positions.
+
+// Of `mesh_simplify`, taken from `scratch` and given back
+usize mesh_simplify_scratch_size(u32 index_count, u32 vertex_count);
+
+// Writes at most `index_count` indices to `destination`, down to
+// `target_index_count` when the mesh allows it, and returns their count.
+// `positions` are vec3. `error` gets the square root of the largest
+// collapse cost, about the distance the surface moved, in mesh units.
+u32 mesh_simplify(u32* destination, const u32* indices, u32 index_count,
+                  const f32* positions, u32 vertex_count,
+                  u32 target_index_count, f32* error, Arena* scratch);
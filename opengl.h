@@ -0,0 +1,13 @@
+#pragma once
+
+// OpenGL core profile declarations, wherever the build runs: the framework
+// on macOS, the Mesa (or vendor) headers elsewhere, e.g. llvmpipe without a
+// GPU. The Makefile links the matching library.
+#ifdef __APPLE__
+#define GL_SILENCE_DEPRECATION 1
+#include <OpenGL/gl3.h>
+#else
+#define GL_GLEXT_PROTOTYPES 1
+#include <GL/gl.h>
+#include <GL/glext.h>
+#endif
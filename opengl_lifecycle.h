@@ -7,5 +7,5 @@ typedef struct SDL_Window SDL_Window;
 typedef void* SDL_GLContext;
 
 void gl_drop(SDL_Window* window, SDL_GLContext* context);
-bool gl_init(SDL_Window** window, SDL_GLContext** context);
-void gl_loop(SDL_Window* window);
+// `hidden` for headless runs, e.g. with `SDL_VIDEODRIVER=offscreen`
+bool gl_init(SDL_Window** window, SDL_GLContext** context, bool hidden);
@@ -0,0 +1,218 @@
+#include "renderer.h"
+
+#include <SDL2/SDL.h>
+#include <assert.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "resource_registry.h"
+#include "trace.h"
+
+static const RendererFunctions* const backends[RENDERER_BACKEND_COUNT] = {
+    [RENDERER_GL] = &gl_renderer_functions,
+    [RENDERER_VULKAN] = &vk_renderer_functions,
+    [RENDERER_SOFT] = &soft_renderer_functions,
+};
+
+RendererBackend renderer_backend_from_env(void) {
+    const char* const backend = getenv("BACKEND");
+    if (!backend) return RENDERER_GL;
+
+    for (u32 i = 0; i < RENDERER_BACKEND_COUNT; i++) {
+        if (strcmp(backend, backends[i]->name) == 0) return (RendererBackend)i;
+    }
+
+    fprintf(stderr,
+            "Unknown backend `%s`, expected `gl`, `vulkan` or `soft`\n",
+            backend);
+    exit(1);
+}
+
+const char* renderer_backend_name(RendererBackend backend) {
+    assert(backend < RENDERER_BACKEND_COUNT);
+    return backends[backend]->name;
+}
+
+_Bool renderer_init(Renderer* renderer, RendererBackend backend,
+                    _Bool headless) {
+    assert(backend < RENDERER_BACKEND_COUNT);
+
+    memset(renderer, 0, sizeof(Renderer));
+    renderer->backend = backend;
+    renderer->functions = backends[backend];
+    renderer->headless = headless;
+    arena_init(&renderer->frame_arena, "frame", RENDERER_FRAME_ARENA_SIZE);
+
+    if (!renderer->functions->init(renderer)) return false;
+
+    printf("Renderer: backend=%s width=%u height=%u\n",
+           renderer->functions->name, renderer->width, renderer->height);
+    return true;
+}
+
+void renderer_destroy(Renderer* renderer) {
+    renderer->functions->destroy(renderer);
+    arena_destroy(&renderer->frame_arena);
+}
+
+RendererBuffer renderer_buffer_create(Renderer* renderer,
+                                      RendererBufferUsage usage,
+                                      const void* data, usize size) {
+    renderer->stats.bytes_uploaded += size;
+    return renderer->functions->buffer_create(renderer, usage, data, size);
+}
+
+void renderer_buffer_update(Renderer* renderer, RendererBuffer buffer,
+                            const void* data, usize size) {
+    renderer->stats.bytes_uploaded += size;
+    renderer->functions->buffer_update(renderer, buffer, data, size);
+}
+
+RendererTexture renderer_texture_create(Renderer* renderer, u32 width,
+                                        u32 height, const u8* bgr) {
+    renderer->stats.bytes_uploaded += (u64)width * height * 3;
+
+    TRACE_BEGIN("texture_create");
+    const RendererTexture texture =
+        renderer->functions->texture_create(renderer, width, height, bgr);
+    TRACE_END();
+    return texture;
+}
+
+RendererTexture renderer_texture_array_create(Renderer* renderer, u32 width,
+                                              u32 height, u32 layer_count,
+                                              const u8* bgr) {
+    renderer->stats.bytes_uploaded += (u64)width * height * 3 * layer_count;
+
+    TRACE_BEGIN("texture_array_create");
+    const RendererTexture texture = renderer->functions->texture_array_create(
+        renderer, width, height, layer_count, bgr);
+    TRACE_END();
+    return texture;
+}
+
+RendererPipeline renderer_pipeline_create(Renderer* renderer,
+                                          const char* name,
+                                          RendererPipelineInputs inputs,
+                                          RendererVertexFormat vertex_format) {
+    TRACE_BEGIN("pipeline_create");
+    const RendererPipeline pipeline = renderer->functions->pipeline_create(
+        renderer, name, inputs, vertex_format);
+    TRACE_END();
+    return pipeline;
+}
+
+void renderer_frame_begin(Renderer* renderer, const RendererFrame* frame) {
+    RendererStats* const stats = &renderer->stats;
+    stats->draw_calls = 0;
+    stats->triangles = 0;
+    stats->resolution_scale = 1.0f;
+    // Uploads done between frames are accounted to the next one
+    renderer->frame_start = SDL_GetPerformanceCounter();
+
+    TRACE_BEGIN("frame_begin");
+    renderer->functions->frame_begin(renderer, frame);
+    TRACE_END();
+}
+
+void renderer_lights_update(Renderer* renderer,
+                            const RendererLights* lights) {
+    assert(lights->light_count <= RENDERER_MAX_LIGHTS &&
+           lights->index_count <= RENDERER_MAX_LIGHT_INDICES);
+    renderer->stats.bytes_uploaded +=
+        sizeof(RendererLight) * lights->light_count +
+        sizeof(u32) * 2 * RENDERER_CLUSTER_COUNT +
+        sizeof(u16) * lights->index_count;
+
+    TRACE_BEGIN("lights_update");
+    renderer->functions->lights_update(renderer, lights);
+    TRACE_END();
+}
+
+void renderer_draw(Renderer* renderer, const RendererDraw* draw) {
+    assert(draw->pipeline && draw->positions && draw->uvs &&
+           draw->instances && draw->texture);
+
+    renderer->stats.draw_calls += 1;
+    renderer->stats.triangles +=
+        (u64)(draw->vertex_count / 3) * draw->instance_count;
+    renderer->functions->draw(renderer, draw);
+}
+
+_Bool renderer_particles_create(Renderer* renderer, u32 capacity) {
+    assert(capacity > 0 && capacity <= RENDERER_MAX_PARTICLES);
+
+    TRACE_BEGIN("particles_create");
+    const _Bool created =
+        renderer->functions->particles_create(renderer, capacity);
+    TRACE_END();
+    return created;
+}
+
+// The simulation step is not counted as a draw
+void renderer_particles_draw(Renderer* renderer,
+                             const RendererParticles* particles) {
+    assert(particles->emitter_count > 0 &&
+           particles->emitter_count <= RENDERER_MAX_EMITTERS);
+
+    renderer->stats.draw_calls += 1;
+    TRACE_BEGIN("particles_draw");
+    renderer->functions->particles_draw(renderer, particles);
+    TRACE_END();
+}
+
+void renderer_frame_submit(Renderer* renderer) {
+    TRACE_BEGIN("frame_submit");
+    renderer->functions->frame_submit(renderer);
+    TRACE_END();
+}
+
+void renderer_frame_end(Renderer* renderer) {
+    TRACE_BEGIN("frame_end");
+    renderer->functions->frame_end(renderer);
+    TRACE_END();
+
+    RendererStats* const stats = &renderer->stats;
+    stats->cpu_ms =
+        (f64)(SDL_GetPerformanceCounter() - renderer->frame_start) * 1000.0 /
+        (f64)SDL_GetPerformanceFrequency();
+    stats->frame_count += 1;
+    stats->total_draw_calls += stats->draw_calls;
+    stats->total_triangles += stats->triangles;
+    stats->total_bytes_uploaded += stats->bytes_uploaded;
+    stats->total_cpu_ms += stats->cpu_ms;
+    stats->total_resolution_scale += stats->resolution_scale;
+    if (stats->frame_count == 1 ||
+        stats->resolution_scale < stats->min_resolution_scale)
+        stats->min_resolution_scale = stats->resolution_scale;
+    stats->bytes_uploaded = 0;
+
+    arena_reset(&renderer->frame_arena);
+}
+
+void renderer_finish(Renderer* renderer) {
+    renderer->functions->finish(renderer);
+}
+
+void renderer_stats_print(const Renderer* renderer) {
+    const RendererStats* const stats = &renderer->stats;
+    if (stats->frame_count == 0) return;
+
+    printf(
+        "Renderer: backend=%s frames=%" PRIu64
+        " cpu_frame_mean=%.3fms draw_calls_mean=%.1f triangles_mean=%.1f "
+        "bytes_uploaded_mean=%.1f resolution_scale_mean=%.3f "
+        "resolution_scale_min=%.3f\n",
+        renderer->functions->name, stats->frame_count,
+        stats->total_cpu_ms / (f64)stats->frame_count,
+        (f64)stats->total_draw_calls / (f64)stats->frame_count,
+        (f64)stats->total_triangles / (f64)stats->frame_count,
+        (f64)stats->total_bytes_uploaded / (f64)stats->frame_count,
+        stats->total_resolution_scale / (f64)stats->frame_count,
+        (f64)stats->min_resolution_scale);
+    arena_print(&renderer->frame_arena);
+    resource_registry_print(RENDERER_REPORT_RESOURCES);
+}
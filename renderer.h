@@ -0,0 +1,266 @@
+#pragma once
+#include <cglm/cglm.h>
+
+#include "allocator.h"
+#include "utils.h"
+
+struct SDL_Window;
+typedef struct SDL_Window SDL_Window;
+
+// Backend neutral interface, implemented with OpenGL 3.3 (renderer_gl.c),
+// Vulkan (vulkan/vk_renderer.c) and on the CPU (renderer_soft.c). Scenes only
+// talk to this interface so every backend runs the exact same workload.
+//
+// Conventions are OpenGL's: right handed, clip space depth in [-1, 1]. The
+// Vulkan backend corrects the projection itself.
+
+typedef enum {
+    RENDERER_GL,
+    RENDERER_VULKAN,
+    RENDERER_SOFT,
+    RENDERER_BACKEND_COUNT,
+} RendererBackend;
+
+typedef enum {
+    // Uploaded once
+    RENDERER_BUFFER_VERTEX,
+    // One mat4 model matrix per instance, rewritten every frame
+    RENDERER_BUFFER_INSTANCE,
+} RendererBufferUsage;
+
+typedef enum {
+    // vec3 positions, vec2 UVs
+    RENDERER_VERTEX_F32,
+    // MeshQuantizedPosition and MeshQuantizedUv (mesh.h), the model matrices
+    // dequantize the positions
+    RENDERER_VERTEX_QUANTIZED,
+} RendererVertexFormat;
+
+typedef enum {
+    // Positions and UVs, then a model matrix per instance
+    RENDERER_PIPELINE_INSTANCED,
+    // Also a RendererInstanceMaterial per instance, the texture is an array
+    RENDERER_PIPELINE_INSTANCE_MATERIALS,
+} RendererPipelineInputs;
+
+#define RENDERER_MAX_BUFFERS 64
+#define RENDERER_MAX_TEXTURES 64
+#define RENDERER_MAX_PIPELINES 8
+// Scratch memory of a frame, grown by the scene for its light lists, levels
+// of detail and culled world
+#define RENDERER_FRAME_ARENA_SIZE (1 << 20)
+// Largest GPU objects listed by `renderer_stats_print`
+#define RENDERER_REPORT_RESOURCES 8
+
+// Clustered lighting (light_clusters.h): tiles on screen, slices in depth
+#define RENDERER_CLUSTERS_X 16
+#define RENDERER_CLUSTERS_Y 9
+#define RENDERER_CLUSTERS_Z 24
+#define RENDERER_CLUSTER_COUNT \
+    (RENDERER_CLUSTERS_X * RENDERER_CLUSTERS_Y * RENDERER_CLUSTERS_Z)
+// Light indices are 16 bits
+#define RENDERER_MAX_LIGHTS 4096
+#define RENDERER_MAX_LIGHTS_PER_CLUSTER 128
+// Of every cluster together
+#define RENDERER_MAX_LIGHT_INDICES (1 << 18)
+
+// GPU particles, the pool is shared by the emitters
+#define RENDERER_MAX_EMITTERS 16
+#define RENDERER_MAX_PARTICLES (1 << 22)
+
+// Handles, 0 is never a valid one
+typedef u32 RendererBuffer;
+typedef u32 RendererTexture;
+typedef u32 RendererPipeline;
+
+typedef struct {
+    vec4 clear_color;
+    mat4 view_projection;
+} RendererFrame;
+
+// Where the texture of an instance is in a texture array: its UVs are
+// scaled by uv_rect[2..3] and offset by uv_rect[0..1], into `layer`
+typedef struct {
+    f32 uv_rect[4];
+    f32 layer;
+} RendererInstanceMaterial;
+
+// Point light, its contribution fades to 0 at `radius`
+typedef struct {
+    f32 position[3];  // World space
+    f32 radius;
+    f32 color[3];
+    f32 padding;
+} RendererLight;
+
+// Lights of a frame, assigned to the clusters of its camera
+typedef struct {
+    const RendererLight* lights;
+    u32 light_count;
+    // First index and count per cluster, x first, then y, then z
+    const u32* ranges;
+    const u16* indices;
+    u32 index_count;
+    // View depth of a world position: dot(depth_plane, vec4(position, 1))
+    vec4 depth_plane;
+    // Slice of a depth: floor(log(depth) * slice_scale + slice_bias). Tiles
+    // split the drawable evenly, from its bottom left corner.
+    f32 slice_scale, slice_bias;
+} RendererLights;
+
+// Spawns `rate` particles per second in its share of the pool, over its
+// oldest ones
+typedef struct {
+    f32 position[3];  // World space
+    f32 rate;
+    f32 velocity[3];  // Initial
+    f32 spread;  // Length of the random part of the initial velocity
+    f32 color[3];
+    f32 lifetime;  // Seconds, a quarter more or less per particle
+    f32 size;  // Of the billboards, world units
+} RendererEmitter;
+
+// A step of the simulation, then the particles of a frame
+typedef struct {
+    const RendererEmitter* emitters;
+    u32 emitter_count;
+    f32 gravity[3];
+    f32 dt;  // Seconds simulated
+    // World space axes of the camera, the billboards face it
+    vec3 camera_right, camera_up;
+} RendererParticles;
+
+typedef struct {
+    RendererPipeline pipeline;
+    // In the vertex format of the pipeline
+    RendererBuffer positions;
+    RendererBuffer uvs;
+    RendererBuffer instances;  // mat4
+    // RendererInstanceMaterial, with RENDERER_PIPELINE_INSTANCE_MATERIALS
+    RendererBuffer materials;
+    RendererTexture texture;
+    u32 first_vertex, vertex_count;
+    u32 first_instance, instance_count;
+} RendererDraw;
+
+typedef struct {
+    u64 frame_count;
+    // Last frame
+    u32 draw_calls;
+    u64 triangles;  // Submitted by the draws, particles aside
+    u64 bytes_uploaded;
+    f64 cpu_ms;  // From frame begin to frame end
+    // Of the drawable size per axis, below 1 with dynamic resolution
+    f32 resolution_scale;
+    // Since startup
+    u64 total_draw_calls;
+    u64 total_triangles;
+    u64 total_bytes_uploaded;
+    f64 total_cpu_ms;
+    f64 total_resolution_scale;
+    f32 min_resolution_scale;
+} RendererStats;
+
+typedef struct Renderer Renderer;
+
+typedef struct {
+    const char* name;
+    // Creates the window and sets the size of the drawable, false on failure
+    _Bool (*init)(Renderer* renderer);
+    void (*destroy)(Renderer* renderer);
+
+    RendererBuffer (*buffer_create)(Renderer* renderer,
+                                    RendererBufferUsage usage,
+                                    const void* data, usize size);
+    void (*buffer_update)(Renderer* renderer, RendererBuffer buffer,
+                          const void* data, usize size);
+    // 24 bits BGR pixels with rows padded to 4 bytes, as found in BMP files
+    RendererTexture (*texture_create)(Renderer* renderer, u32 width,
+                                      u32 height, const u8* bgr);
+    // `layer_count` layers of the same BGR layout one after the other, for
+    // the pipelines with instance materials
+    RendererTexture (*texture_array_create)(Renderer* renderer, u32 width,
+                                            u32 height, u32 layer_count,
+                                            const u8* bgr);
+    // `name` selects the shaders of the backend, e.g. "instanced". The lit
+    // ones ("instanced_lit") shade the lights of `lights_update`.
+    RendererPipeline (*pipeline_create)(Renderer* renderer, const char* name,
+                                        RendererPipelineInputs inputs,
+                                        RendererVertexFormat vertex_format);
+
+    // Waits for the frame resources to be free and starts recording
+    void (*frame_begin)(Renderer* renderer, const RendererFrame* frame);
+    // After frame begin, before the draws, in every frame using a lit
+    // pipeline. Copies the lights and their clusters.
+    void (*lights_update)(Renderer* renderer, const RendererLights* lights);
+    void (*draw)(Renderer* renderer, const RendererDraw* draw);
+    // A pool of `capacity` particles on the GPU, all dead. False when the
+    // backend has no particles.
+    _Bool (*particles_create)(Renderer* renderer, u32 capacity);
+    // After the opaque draws: spawns and moves the particles on the GPU, then
+    // draws them blended, without writing depth
+    void (*particles_draw)(Renderer* renderer,
+                           const RendererParticles* particles);
+    // Hands the recorded work to the GPU
+    void (*frame_submit)(Renderer* renderer);
+    // Presents
+    void (*frame_end)(Renderer* renderer);
+    // Waits for the GPU to be done with every submitted frame
+    void (*finish)(Renderer* renderer);
+} RendererFunctions;
+
+struct Renderer {
+    RendererBackend backend;
+    const RendererFunctions* functions;
+    SDL_Window* window;
+    u32 width, height;  // Drawable size in pixels
+    // No window to present to: OpenGL draws into a hidden one, Vulkan into
+    // an offscreen image, the software backend into memory
+    _Bool headless;
+    void* data;  // Backend state
+
+    RendererStats stats;
+    u64 frame_start;
+    // Reset by `renderer_frame_end`, outside of frames take it back with
+    // `arena_mark` and `arena_release`
+    Arena frame_arena;
+};
+
+extern const RendererFunctions gl_renderer_functions;
+extern const RendererFunctions vk_renderer_functions;
+extern const RendererFunctions soft_renderer_functions;
+
+// From `BACKEND=gl|vulkan|soft`, defaults to OpenGL
+RendererBackend renderer_backend_from_env(void);
+const char* renderer_backend_name(RendererBackend backend);
+
+_Bool renderer_init(Renderer* renderer, RendererBackend backend,
+                    _Bool headless);
+void renderer_destroy(Renderer* renderer);
+
+RendererBuffer renderer_buffer_create(Renderer* renderer,
+                                      RendererBufferUsage usage,
+                                      const void* data, usize size);
+void renderer_buffer_update(Renderer* renderer, RendererBuffer buffer,
+                            const void* data, usize size);
+RendererTexture renderer_texture_create(Renderer* renderer, u32 width,
+                                        u32 height, const u8* bgr);
+RendererTexture renderer_texture_array_create(Renderer* renderer, u32 width,
+                                              u32 height, u32 layer_count,
+                                              const u8* bgr);
+RendererPipeline renderer_pipeline_create(Renderer* renderer,
+                                          const char* name,
+                                          RendererPipelineInputs inputs,
+                                          RendererVertexFormat vertex_format);
+
+void renderer_frame_begin(Renderer* renderer, const RendererFrame* frame);
+void renderer_lights_update(Renderer* renderer, const RendererLights* lights);
+void renderer_draw(Renderer* renderer, const RendererDraw* draw);
+_Bool renderer_particles_create(Renderer* renderer, u32 capacity);
+void renderer_particles_draw(Renderer* renderer,
+                             const RendererParticles* particles);
+void renderer_frame_submit(Renderer* renderer);
+void renderer_frame_end(Renderer* renderer);
+void renderer_finish(Renderer* renderer);
+
+void renderer_stats_print(const Renderer* renderer);
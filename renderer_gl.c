@@ -0,0 +1,555 @@
+#include <SDL2/SDL.h>
+#include <assert.h>
+#include <stdio.h>
+
+#include "gl_calls.h"
+#include "gl_particles.h"
+#include "gl_readback.h"
+#include "mesh.h"
+#include "opengl.h"
+#include "opengl_lifecycle.h"
+#include "renderer.h"
+#include "resolution.h"
+#include "resource_registry.h"
+#include "shader.h"
+#include "trace.h"
+#include "utils.h"
+
+// Timer queries are read this many frames later, when they are ready
+#define GL_TIMER_FRAME_LAG 4
+// Frames between two GPU/CPU clock calibrations
+#define GL_TIMER_CALIBRATION_INTERVAL 256
+
+// OpenGL 3.3 backend of the shared renderer: draws are issued right away, a
+// vertex array object per kind of pipeline inputs holds the attribute
+// layout.
+//
+// With dynamic resolution, frames are drawn into the bottom left corner of
+// an offscreen framebuffer of the drawable size, then blitted to the window
+// with linear filtering. Changing the scale never reallocates.
+//
+// With READBACK_DIR, every finished frame is also read back from the window
+// and written to disk asynchronously, see gl_readback.h.
+//
+// Lights, the ranges of the clusters and their light indices are buffer
+// textures on units 1 to 3, rewritten every frame. Lit programs are those
+// with a `cluster_scale` uniform.
+//
+// Particles are simulated and drawn with transform feedback, see
+// gl_particles.h.
+
+// Texture units of the light buffer textures, after the material one
+#define GL_LIGHTS_FIRST_UNIT 1
+
+typedef struct {
+    SDL_GLContext* context;
+    // Indexed by RendererPipelineInputs
+    GLuint vertex_arrays[2];
+
+    GLuint buffers[RENDERER_MAX_BUFFERS];
+    u32 buffer_count;
+    GLuint textures[RENDERER_MAX_TEXTURES];
+    GLenum texture_targets[RENDERER_MAX_TEXTURES];
+    u32 texture_count;
+    GLuint programs[RENDERER_MAX_PIPELINES];
+    GLint view_projection_locations[RENDERER_MAX_PIPELINES];
+    RendererPipelineInputs program_inputs[RENDERER_MAX_PIPELINES];
+    RendererVertexFormat program_vertex_formats[RENDERER_MAX_PIPELINES];
+    // -1 for the unlit programs
+    GLint depth_plane_locations[RENDERER_MAX_PIPELINES];
+    GLint cluster_scale_locations[RENDERER_MAX_PIPELINES];
+    u32 program_count;
+
+    // Lights, cluster ranges, light indices
+    GLuint light_buffers[3];
+    GLuint light_textures[3];
+    vec4 depth_plane;
+    vec4 cluster_scale;
+
+    mat4 view_projection;
+
+    Resolution resolution;
+    GLuint framebuffer;
+    GLuint renderbuffers[2];  // Color, depth
+    u32 scaled_width, scaled_height;  // Of the current frame
+
+    GlReadback readback;
+    GlParticles particles;  // Capacity 0 until created
+
+    // For the trace and dynamic resolution: begin and end timestamps of the
+    // frames in flight
+    _Bool timers;
+    GLuint timer_queries[GL_TIMER_FRAME_LAG][2];
+    u32 timer_frame;
+    u32 gpu_track;
+} GlRenderer;
+
+static GlRenderer* gl_renderer(Renderer* renderer) { return renderer->data; }
+
+static void gl_renderer_framebuffer_create(Renderer* renderer) {
+    GlRenderer* const gl = gl_renderer(renderer);
+
+    const GLenum formats[2] = {GL_RGBA8, GL_DEPTH_COMPONENT24};
+    const GLenum attachments[2] = {GL_COLOR_ATTACHMENT0,
+                                   GL_DEPTH_ATTACHMENT};
+    glGenFramebuffers(1, &gl->framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, gl->framebuffer);
+    glGenRenderbuffers(2, gl->renderbuffers);
+    for (u32 i = 0; i < 2; i++) {
+        glBindRenderbuffer(GL_RENDERBUFFER, gl->renderbuffers[i]);
+        glRenderbufferStorage(GL_RENDERBUFFER, formats[i],
+                              (GLsizei)renderer->width,
+                              (GLsizei)renderer->height);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, attachments[i],
+                                  GL_RENDERBUFFER, gl->renderbuffers[i]);
+        resource_track(RESOURCE_GL_RENDERBUFFER, gl->renderbuffers[i],
+                       RESOURCE_RENDER_TARGET,
+                       (u64)renderer->width * renderer->height * 4,
+                       "dynamic_resolution");
+    }
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) !=
+        GL_FRAMEBUFFER_COMPLETE) {
+        fprintf(stderr, "Incomplete dynamic resolution framebuffer\n");
+        exit(1);
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+static _Bool gl_renderer_init(Renderer* renderer) {
+    GlRenderer* const gl = ogl_malloc(sizeof(GlRenderer));
+    memset(gl, 0, sizeof(GlRenderer));
+    renderer->data = gl;
+    gl_calls_init();
+
+    if (!gl_init(&renderer->window, &gl->context, renderer->headless))
+        return false;
+
+    i32 width = 0, height = 0;
+    SDL_GL_GetDrawableSize(renderer->window, &width, &height);
+    renderer->width = (u32)width;
+    renderer->height = (u32)height;
+
+    // No vsync, frames are paced by the caller
+    SDL_GL_SetSwapInterval(0);
+
+    // Position, UV, then the 4 columns of the model matrix, which advance
+    // once per instance, then the UV rectangle and layer of the material.
+    // Enabled arrays and divisors are vertex array state.
+    glGenVertexArrays(2, gl->vertex_arrays);
+    for (u32 inputs = 0; inputs < 2; inputs++) {
+        const u32 count =
+            inputs == RENDERER_PIPELINE_INSTANCE_MATERIALS ? 8 : 6;
+        glBindVertexArray(gl->vertex_arrays[inputs]);
+        for (u32 i = 0; i < count; i++) glEnableVertexAttribArray(i);
+        for (u32 i = 2; i < count; i++) glVertexAttribDivisor(i, 1);
+    }
+
+    resolution_init(&gl->resolution);
+    if (gl->resolution.enabled) gl_renderer_framebuffer_create(renderer);
+
+    gl_readback_init(&gl->readback, renderer->width, renderer->height);
+
+    gl->timers = trace_enabled || gl->resolution.enabled;
+    if (gl->timers)
+        glGenQueries(GL_TIMER_FRAME_LAG * 2, &gl->timer_queries[0][0]);
+    if (trace_enabled) gl->gpu_track = trace_gpu_track("GPU (OpenGL)");
+
+    return true;
+}
+
+// Emits the GPU zone of the frame which used the slot and feeds its time to
+// the dynamic resolution, if its timestamps are ready, then starts the
+// current frame
+static void gl_renderer_timer_begin(GlRenderer* gl) {
+    if (trace_enabled &&
+        gl->timer_frame % GL_TIMER_CALIBRATION_INTERVAL == 0) {
+        GLint64 gpu_ns = 0;
+        glGetInteger64v(GL_TIMESTAMP, &gpu_ns);
+        trace_gpu_calibrate(gl->gpu_track, (u64)gpu_ns, trace_now());
+    }
+
+    GLuint* const queries =
+        gl->timer_queries[gl->timer_frame % GL_TIMER_FRAME_LAG];
+    if (gl->timer_frame >= GL_TIMER_FRAME_LAG) {
+        GLint available = 0;
+        glGetQueryObjectiv(queries[1], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (available) {
+            GLuint64 begin = 0, end = 0;
+            glGetQueryObjectui64v(queries[0], GL_QUERY_RESULT, &begin);
+            glGetQueryObjectui64v(queries[1], GL_QUERY_RESULT, &end);
+            if (trace_enabled)
+                trace_gpu_zone(gl->gpu_track, "frame", begin, end);
+            resolution_update(&gl->resolution, (f32)(end - begin) / 1e6f);
+        }
+    }
+    glQueryCounter(queries[0], GL_TIMESTAMP);
+}
+
+static void gl_renderer_timer_end(GlRenderer* gl) {
+    glQueryCounter(gl->timer_queries[gl->timer_frame % GL_TIMER_FRAME_LAG][1],
+                   GL_TIMESTAMP);
+    gl->timer_frame += 1;
+}
+
+static void gl_renderer_destroy(Renderer* renderer) {
+    GlRenderer* const gl = gl_renderer(renderer);
+
+    gl_readback_destroy(&gl->readback);
+    if (gl->particles.capacity) {
+        gl_particles_print(&gl->particles);
+        gl_particles_destroy(&gl->particles);
+    }
+    if (gl->light_buffers[0]) {
+        for (u32 i = 0; i < 3; i++)
+            resource_untrack(RESOURCE_GL_BUFFER, gl->light_buffers[i]);
+        glDeleteTextures(3, gl->light_textures);
+        glDeleteBuffers(3, gl->light_buffers);
+    }
+    if (gl->timers)
+        glDeleteQueries(GL_TIMER_FRAME_LAG * 2, &gl->timer_queries[0][0]);
+    if (gl->framebuffer) {
+        resolution_print(&gl->resolution);
+        for (u32 i = 0; i < 2; i++)
+            resource_untrack(RESOURCE_GL_RENDERBUFFER, gl->renderbuffers[i]);
+        glDeleteRenderbuffers(2, gl->renderbuffers);
+        glDeleteFramebuffers(1, &gl->framebuffer);
+    }
+    for (u32 i = 0; i < gl->program_count; i++) {
+        resource_untrack(RESOURCE_GL_PROGRAM, gl->programs[i]);
+        glDeleteProgram(gl->programs[i]);
+    }
+    for (u32 i = 0; i < gl->texture_count; i++)
+        resource_untrack(RESOURCE_GL_TEXTURE, gl->textures[i]);
+    for (u32 i = 0; i < gl->buffer_count; i++)
+        resource_untrack(RESOURCE_GL_BUFFER, gl->buffers[i]);
+    glDeleteTextures((GLsizei)gl->texture_count, gl->textures);
+    glDeleteBuffers((GLsizei)gl->buffer_count, gl->buffers);
+    glDeleteVertexArrays(2, gl->vertex_arrays);
+    gl_calls_shutdown();
+
+    gl_drop(renderer->window, gl->context);
+    free(gl);
+}
+
+static RendererBuffer gl_renderer_buffer_create(Renderer* renderer,
+                                                RendererBufferUsage usage,
+                                                const void* data,
+                                                usize size) {
+    GlRenderer* const gl = gl_renderer(renderer);
+    assert(gl->buffer_count < RENDERER_MAX_BUFFERS);
+
+    GLuint* const buffer = &gl->buffers[gl->buffer_count];
+    glGenBuffers(1, buffer);
+    glBindBuffer(GL_ARRAY_BUFFER, *buffer);
+    glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)size, data,
+                 usage == RENDERER_BUFFER_INSTANCE ? GL_STREAM_DRAW
+                                                   : GL_STATIC_DRAW);
+    resource_track(RESOURCE_GL_BUFFER, *buffer, RESOURCE_BUFFER, size, NULL);
+
+    return ++gl->buffer_count;
+}
+
+static void gl_renderer_buffer_update(Renderer* renderer,
+                                      RendererBuffer buffer, const void* data,
+                                      usize size) {
+    GlRenderer* const gl = gl_renderer(renderer);
+    assert(buffer > 0 && buffer <= gl->buffer_count);
+
+    // Orphan the previous storage so the driver does not wait for the draws
+    // still reading it
+    glBindBuffer(GL_ARRAY_BUFFER, gl->buffers[buffer - 1]);
+    glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)size, NULL, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, (GLsizeiptr)size, data);
+    resource_resize(RESOURCE_GL_BUFFER, gl->buffers[buffer - 1], size);
+}
+
+static RendererTexture gl_renderer_texture_create(Renderer* renderer,
+                                                  u32 width, u32 height,
+                                                  const u8* bgr) {
+    GlRenderer* const gl = gl_renderer(renderer);
+    assert(gl->texture_count < RENDERER_MAX_TEXTURES);
+
+    GLuint* const texture = &gl->textures[gl->texture_count];
+    gl->texture_targets[gl->texture_count] = GL_TEXTURE_2D;
+    glGenTextures(1, texture);
+    glBindTexture(GL_TEXTURE_2D, *texture);
+
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, (GLsizei)width, (GLsizei)height, 0,
+                 GL_BGR, GL_UNSIGNED_BYTE, bgr);
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+                    GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_MIRRORED_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_MIRRORED_REPEAT);
+    glGenerateMipmap(GL_TEXTURE_2D);
+    // RGB is padded to 4 bytes by drivers, the mipmaps add a third
+    resource_track(RESOURCE_GL_TEXTURE, *texture, RESOURCE_TEXTURE,
+                   (u64)width * height * 4 * 4 / 3, NULL);
+
+    return ++gl->texture_count;
+}
+
+static RendererTexture gl_renderer_texture_array_create(Renderer* renderer,
+                                                        u32 width, u32 height,
+                                                        u32 layer_count,
+                                                        const u8* bgr) {
+    GlRenderer* const gl = gl_renderer(renderer);
+    assert(gl->texture_count < RENDERER_MAX_TEXTURES);
+
+    GLuint* const texture = &gl->textures[gl->texture_count];
+    gl->texture_targets[gl->texture_count] = GL_TEXTURE_2D_ARRAY;
+    glGenTextures(1, texture);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, *texture);
+
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGB, (GLsizei)width,
+                 (GLsizei)height, (GLsizei)layer_count, 0, GL_BGR,
+                 GL_UNSIGNED_BYTE, bgr);
+
+    // Clamped, the UVs of atlas entries stop at the edges of their rectangle
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER,
+                    GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+    resource_track(RESOURCE_GL_TEXTURE, *texture, RESOURCE_TEXTURE,
+                   (u64)width * height * layer_count * 4 * 4 / 3, NULL);
+
+    return ++gl->texture_count;
+}
+
+static RendererPipeline gl_renderer_pipeline_create(
+    Renderer* renderer, const char* name, RendererPipelineInputs inputs,
+    RendererVertexFormat vertex_format) {
+    GlRenderer* const gl = gl_renderer(renderer);
+    assert(gl->program_count < RENDERER_MAX_PIPELINES);
+
+    char vertex_path[256], fragment_path[256];
+    snprintf(vertex_path, sizeof(vertex_path), "resources/%s_vertex.glsl",
+             name);
+    snprintf(fragment_path, sizeof(fragment_path),
+             "resources/%s_fragment.glsl", name);
+
+    const GLuint program = shader_load(vertex_path, fragment_path);
+    gl->programs[gl->program_count] = program;
+    gl->view_projection_locations[gl->program_count] =
+        glGetUniformLocation(program, "VP");
+    gl->program_inputs[gl->program_count] = inputs;
+    gl->program_vertex_formats[gl->program_count] = vertex_format;
+
+    // The light samplers never move
+    const GLint cluster_scale = glGetUniformLocation(program, "cluster_scale");
+    gl->cluster_scale_locations[gl->program_count] = cluster_scale;
+    gl->depth_plane_locations[gl->program_count] =
+        glGetUniformLocation(program, "depth_plane");
+    if (cluster_scale != -1) {
+        const char* const samplers[3] = {"lights", "light_ranges",
+                                         "light_indices"};
+        glUseProgram(program);
+        for (u32 i = 0; i < 3; i++) {
+            glUniform1i(glGetUniformLocation(program, samplers[i]),
+                        GL_LIGHTS_FIRST_UNIT + (GLint)i);
+        }
+    }
+
+    GLint binary_length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &binary_length);
+    resource_track(RESOURCE_GL_PROGRAM, program, RESOURCE_SHADER,
+                   (u64)binary_length, NULL);
+
+    return ++gl->program_count;
+}
+
+static void gl_renderer_frame_begin(Renderer* renderer,
+                                    const RendererFrame* frame) {
+    GlRenderer* const gl = gl_renderer(renderer);
+    glm_mat4_copy((vec4*)frame->view_projection, gl->view_projection);
+
+    // The scale picked from the frames already measured
+    if (gl->timers) gl_renderer_timer_begin(gl);
+
+    gl->scaled_width = renderer->width;
+    gl->scaled_height = renderer->height;
+    if (gl->framebuffer) {
+        gl->scaled_width = resolution_scaled(&gl->resolution, renderer->width);
+        gl->scaled_height =
+            resolution_scaled(&gl->resolution, renderer->height);
+        renderer->stats.resolution_scale = gl->resolution.scale;
+        glBindFramebuffer(GL_FRAMEBUFFER, gl->framebuffer);
+    }
+
+    glViewport(0, 0, (GLsizei)gl->scaled_width, (GLsizei)gl->scaled_height);
+    glClearColor(frame->clear_color[0], frame->clear_color[1],
+                 frame->clear_color[2], frame->clear_color[3]);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+}
+
+// The buffers and their textures, on their units
+static void gl_renderer_lights_create(GlRenderer* gl) {
+    // RendererLight is 2 texels
+    const GLenum formats[3] = {GL_RGBA32F, GL_RG32UI, GL_R16UI};
+    glGenBuffers(3, gl->light_buffers);
+    glGenTextures(3, gl->light_textures);
+    for (u32 i = 0; i < 3; i++) {
+        glBindBuffer(GL_TEXTURE_BUFFER, gl->light_buffers[i]);
+        glBufferData(GL_TEXTURE_BUFFER, 0, NULL, GL_STREAM_DRAW);
+        resource_track(RESOURCE_GL_BUFFER, gl->light_buffers[i],
+                       RESOURCE_BUFFER, 0, "lights");
+
+        glActiveTexture(GL_TEXTURE0 + GL_LIGHTS_FIRST_UNIT + i);
+        glBindTexture(GL_TEXTURE_BUFFER, gl->light_textures[i]);
+        glTexBuffer(GL_TEXTURE_BUFFER, formats[i], gl->light_buffers[i]);
+    }
+    glActiveTexture(GL_TEXTURE0);
+}
+
+static void gl_renderer_lights_update(Renderer* renderer,
+                                      const RendererLights* lights) {
+    GlRenderer* const gl = gl_renderer(renderer);
+    if (!gl->light_buffers[0]) gl_renderer_lights_create(gl);
+
+    const void* const data[3] = {lights->lights, lights->ranges,
+                                 lights->indices};
+    const usize sizes[3] = {
+        sizeof(RendererLight) * lights->light_count,
+        sizeof(u32) * 2 * RENDERER_CLUSTER_COUNT,
+        sizeof(u16) * lights->index_count,
+    };
+    // Orphaned like the instance buffers
+    for (u32 i = 0; i < 3; i++) {
+        glBindBuffer(GL_TEXTURE_BUFFER, gl->light_buffers[i]);
+        glBufferData(GL_TEXTURE_BUFFER, (GLsizeiptr)sizes[i], NULL,
+                     GL_STREAM_DRAW);
+        glBufferSubData(GL_TEXTURE_BUFFER, 0, (GLsizeiptr)sizes[i], data[i]);
+        resource_resize(RESOURCE_GL_BUFFER, gl->light_buffers[i], sizes[i]);
+    }
+
+    // Tiles of the scaled frame, with dynamic resolution
+    glm_vec4_copy((f32*)lights->depth_plane, gl->depth_plane);
+    gl->cluster_scale[0] =
+        (f32)RENDERER_CLUSTERS_X / (f32)gl->scaled_width;
+    gl->cluster_scale[1] =
+        (f32)RENDERER_CLUSTERS_Y / (f32)gl->scaled_height;
+    gl->cluster_scale[2] = lights->slice_scale;
+    gl->cluster_scale[3] = lights->slice_bias;
+}
+
+static void gl_renderer_draw(Renderer* renderer, const RendererDraw* draw) {
+    GlRenderer* const gl = gl_renderer(renderer);
+
+    const u32 program = draw->pipeline - 1;
+    glUseProgram(gl->programs[program]);
+    glUniformMatrix4fv(gl->view_projection_locations[program], 1, GL_FALSE,
+                       (const f32*)gl->view_projection);
+    if (gl->cluster_scale_locations[program] != -1) {
+        glUniform4fv(gl->depth_plane_locations[program], 1, gl->depth_plane);
+        glUniform4fv(gl->cluster_scale_locations[program], 1,
+                     gl->cluster_scale);
+    }
+
+    glBindVertexArray(gl->vertex_arrays[gl->program_inputs[program]]);
+    glBindTexture(gl->texture_targets[draw->texture - 1],
+                  gl->textures[draw->texture - 1]);
+
+    glBindBuffer(GL_ARRAY_BUFFER, gl->buffers[draw->positions - 1]);
+    if (gl->program_vertex_formats[program] == RENDERER_VERTEX_QUANTIZED) {
+        glVertexAttribPointer(0, 3, GL_SHORT, GL_TRUE,
+                              sizeof(MeshQuantizedPosition), (void*)0);
+    } else {
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, gl->buffers[draw->uvs - 1]);
+    if (gl->program_vertex_formats[program] == RENDERER_VERTEX_QUANTIZED)
+        glVertexAttribPointer(1, 2, GL_UNSIGNED_SHORT, GL_TRUE, 0, (void*)0);
+    else
+        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 0, (void*)0);
+
+    // No base instance in OpenGL 3.3: the first instance is an offset in the
+    // instance stream
+    glBindBuffer(GL_ARRAY_BUFFER, gl->buffers[draw->instances - 1]);
+    const usize first = draw->first_instance * sizeof(mat4);
+    for (u32 i = 0; i < 4; i++) {
+        glVertexAttribPointer(2 + i, 4, GL_FLOAT, GL_FALSE, sizeof(mat4),
+                              (void*)(first + i * sizeof(vec4)));
+    }
+
+    if (gl->program_inputs[program] == RENDERER_PIPELINE_INSTANCE_MATERIALS) {
+        const GLsizei stride = sizeof(RendererInstanceMaterial);
+        const usize first_material = draw->first_instance * (usize)stride;
+        const usize uv_rect =
+            first_material + offsetof(RendererInstanceMaterial, uv_rect);
+        const usize layer =
+            first_material + offsetof(RendererInstanceMaterial, layer);
+        glBindBuffer(GL_ARRAY_BUFFER, gl->buffers[draw->materials - 1]);
+        glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, stride,
+                              (void*)uv_rect);
+        glVertexAttribPointer(7, 1, GL_FLOAT, GL_FALSE, stride, (void*)layer);
+    }
+
+    glDrawArraysInstanced(GL_TRIANGLES, (GLint)draw->first_vertex,
+                          (GLsizei)draw->vertex_count,
+                          (GLsizei)draw->instance_count);
+}
+
+static _Bool gl_renderer_particles_create(Renderer* renderer, u32 capacity) {
+    GlRenderer* const gl = gl_renderer(renderer);
+    assert(!gl->particles.capacity);
+
+    gl_particles_init(&gl->particles, capacity, gl->gpu_track);
+    return true;
+}
+
+static void gl_renderer_particles_draw(Renderer* renderer,
+                                       const RendererParticles* particles) {
+    GlRenderer* const gl = gl_renderer(renderer);
+    gl_particles_draw(&gl->particles, particles, gl->view_projection);
+}
+
+static void gl_renderer_frame_submit(Renderer* renderer) {
+    GlRenderer* const gl = gl_renderer(renderer);
+
+    // Upscale, the window is not cleared as it is entirely covered
+    if (gl->framebuffer) {
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, gl->framebuffer);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+        glBlitFramebuffer(0, 0, (GLint)gl->scaled_width,
+                          (GLint)gl->scaled_height, 0, 0,
+                          (GLint)renderer->width, (GLint)renderer->height,
+                          GL_COLOR_BUFFER_BIT, GL_LINEAR);
+    }
+
+    if (gl->timers) gl_renderer_timer_end(gl);
+    gl_readback_frame(&gl->readback);
+    glFlush();
+}
+
+static void gl_renderer_frame_end(Renderer* renderer) {
+    SDL_GL_SwapWindow(renderer->window);
+    gl_calls_frame_end();
+}
+
+static void gl_renderer_finish(Renderer* renderer) {
+    (void)renderer;
+    glFinish();
+}
+
+const RendererFunctions gl_renderer_functions = {
+    .name = "gl",
+    .init = gl_renderer_init,
+    .destroy = gl_renderer_destroy,
+    .buffer_create = gl_renderer_buffer_create,
+    .buffer_update = gl_renderer_buffer_update,
+    .texture_create = gl_renderer_texture_create,
+    .texture_array_create = gl_renderer_texture_array_create,
+    .pipeline_create = gl_renderer_pipeline_create,
+    .frame_begin = gl_renderer_frame_begin,
+    .lights_update = gl_renderer_lights_update,
+    .draw = gl_renderer_draw,
+    .particles_create = gl_renderer_particles_create,
+    .particles_draw = gl_renderer_particles_draw,
+    .frame_submit = gl_renderer_frame_submit,
+    .frame_end = gl_renderer_frame_end,
+    .finish = gl_renderer_finish,
+};
@@ -0,0 +1,295 @@
+#include <SDL2/SDL.h>
+#include <assert.h>
+#include <stdio.h>
+
+#include "renderer.h"
+#include "soft_raster.h"
+#include "utils.h"
+
+// Software backend of the shared renderer, for the machines without a
+// usable GPU driver and, on Linux, to compare against Mesa's llvmpipe: the
+// draws are rasterized on the CPU, in tiles on every core (soft_raster.h),
+// into a frame in memory which is then blitted to the surface of the window.
+// Headless, there is no window and the frame stays in memory.
+//
+// Buffers and textures are copies in memory, the textures converted to ARGB
+// and sampled without mipmaps. Every pipeline is drawn unlit whatever its
+// name, there are no lights nor particles.
+
+#define SOFT_WIDTH 1024
+#define SOFT_HEIGHT 768
+
+typedef struct {
+    void* data;
+    usize size, capacity;
+} SoftBuffer;
+
+typedef struct {
+    RendererPipelineInputs inputs;
+    RendererVertexFormat vertex_format;
+} SoftPipeline;
+
+typedef struct {
+    SoftRaster raster;
+    // Over the color buffer of the raster, NULL when headless
+    SDL_Surface* surface;
+
+    SoftBuffer buffers[RENDERER_MAX_BUFFERS];
+    u32 buffer_count;
+    SoftTexture textures[RENDERER_MAX_TEXTURES];
+    u32 texture_count;
+    SoftPipeline pipelines[RENDERER_MAX_PIPELINES];
+    u32 pipeline_count;
+} SoftRenderer;
+
+static SoftRenderer* soft_renderer(Renderer* renderer) {
+    return renderer->data;
+}
+
+static _Bool soft_renderer_init(Renderer* renderer) {
+    SoftRenderer* const soft = ogl_malloc(sizeof(SoftRenderer));
+    memset(soft, 0, sizeof(SoftRenderer));
+    renderer->data = soft;
+    renderer->width = SOFT_WIDTH;
+    renderer->height = SOFT_HEIGHT;
+
+    if (!renderer->headless) {
+        if (SDL_Init(SDL_INIT_VIDEO) < 0) {
+            fprintf(stderr, "Unable to initialize SDL: %s\n", SDL_GetError());
+            return false;
+        }
+        renderer->window = SDL_CreateWindow(
+            "hello", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED,
+            SOFT_WIDTH, SOFT_HEIGHT, SDL_WINDOW_SHOWN);
+        if (!renderer->window) {
+            fprintf(stderr, "Unable to create window: %s\n", SDL_GetError());
+            return false;
+        }
+    }
+
+    soft_raster_init(&soft->raster, renderer->width, renderer->height);
+    if (renderer->window) {
+        SoftRaster* const raster = &soft->raster;
+        soft->surface = SDL_CreateRGBSurfaceWithFormatFrom(
+            raster->color, (i32)raster->width, (i32)raster->height, 32,
+            (i32)(raster->stride * sizeof(u32)), SDL_PIXELFORMAT_ARGB8888);
+        if (!soft->surface) {
+            fprintf(stderr, "Unable to create the frame surface: %s\n",
+                    SDL_GetError());
+            return false;
+        }
+    }
+    return true;
+}
+
+static void soft_renderer_destroy(Renderer* renderer) {
+    SoftRenderer* const soft = soft_renderer(renderer);
+
+    soft_raster_print(&soft->raster);
+    if (soft->surface) SDL_FreeSurface(soft->surface);
+    soft_raster_destroy(&soft->raster);
+    for (u32 i = 0; i < soft->texture_count; i++)
+        free(soft->textures[i].texels);
+    for (u32 i = 0; i < soft->buffer_count; i++) free(soft->buffers[i].data);
+
+    if (renderer->window) {
+        SDL_DestroyWindow(renderer->window);
+        SDL_Quit();
+    }
+    free(soft);
+}
+
+static RendererBuffer soft_renderer_buffer_create(Renderer* renderer,
+                                                  RendererBufferUsage usage,
+                                                  const void* data,
+                                                  usize size) {
+    SoftRenderer* const soft = soft_renderer(renderer);
+    assert(soft->buffer_count < RENDERER_MAX_BUFFERS);
+    (void)usage;
+
+    SoftBuffer* const buffer = &soft->buffers[soft->buffer_count];
+    buffer->data = ogl_malloc(MAX(size, 1));
+    buffer->size = buffer->capacity = size;
+    if (data) memcpy(buffer->data, data, size);
+
+    return ++soft->buffer_count;
+}
+
+static void soft_renderer_buffer_update(Renderer* renderer,
+                                        RendererBuffer buffer,
+                                        const void* data, usize size) {
+    SoftRenderer* const soft = soft_renderer(renderer);
+    assert(buffer > 0 && buffer <= soft->buffer_count);
+
+    // The draws already binned their triangles, the data can be overwritten
+    SoftBuffer* const b = &soft->buffers[buffer - 1];
+    if (size > b->capacity) {
+        free(b->data);
+        b->data = ogl_malloc(size);
+        b->capacity = size;
+    }
+    memcpy(b->data, data, size);
+    b->size = size;
+}
+
+// The BGR rows are padded to 4 bytes
+static u32* soft_renderer_texels(u32 width, u32 height, u32 layer_count,
+                                 const u8* bgr) {
+    const usize row_size = ((usize)width * 3 + 3) / 4 * 4;
+    u32* const texels =
+        ogl_malloc(sizeof(u32) * width * height * (usize)layer_count);
+    for (usize row = 0; row < (usize)height * layer_count; row++) {
+        const u8* const src = bgr + row * row_size;
+        u32* const dst = texels + row * width;
+        for (u32 x = 0; x < width; x++) {
+            dst[x] = 0xff000000u | (u32)src[3 * x + 2] << 16 |
+                     (u32)src[3 * x + 1] << 8 | src[3 * x];
+        }
+    }
+    return texels;
+}
+
+static RendererTexture soft_renderer_texture_create(Renderer* renderer,
+                                                    u32 width, u32 height,
+                                                    const u8* bgr) {
+    SoftRenderer* const soft = soft_renderer(renderer);
+    assert(soft->texture_count < RENDERER_MAX_TEXTURES);
+
+    // Mirrored repeat, like the OpenGL backend
+    soft->textures[soft->texture_count] = (SoftTexture){
+        .texels = soft_renderer_texels(width, height, 1, bgr),
+        .width = width,
+        .height = height,
+        .layer_count = 1,
+    };
+    return ++soft->texture_count;
+}
+
+static RendererTexture soft_renderer_texture_array_create(
+    Renderer* renderer, u32 width, u32 height, u32 layer_count,
+    const u8* bgr) {
+    SoftRenderer* const soft = soft_renderer(renderer);
+    assert(soft->texture_count < RENDERER_MAX_TEXTURES);
+
+    // Clamped, the UVs of atlas entries stop at the edges of their rectangle
+    soft->textures[soft->texture_count] = (SoftTexture){
+        .texels = soft_renderer_texels(width, height, layer_count, bgr),
+        .width = width,
+        .height = height,
+        .layer_count = layer_count,
+        .clamp = true,
+    };
+    return ++soft->texture_count;
+}
+
+static RendererPipeline soft_renderer_pipeline_create(
+    Renderer* renderer, const char* name, RendererPipelineInputs inputs,
+    RendererVertexFormat vertex_format) {
+    SoftRenderer* const soft = soft_renderer(renderer);
+    assert(soft->pipeline_count < RENDERER_MAX_PIPELINES);
+    (void)name;
+
+    soft->pipelines[soft->pipeline_count] = (SoftPipeline){
+        .inputs = inputs,
+        .vertex_format = vertex_format,
+    };
+    return ++soft->pipeline_count;
+}
+
+static u32 soft_renderer_channel(f32 value, u32 shift) {
+    return (u32)(CLAMP(value, 0.0f, 1.0f) * 255.0f + 0.5f) << shift;
+}
+
+static void soft_renderer_frame_begin(Renderer* renderer,
+                                      const RendererFrame* frame) {
+    SoftRenderer* const soft = soft_renderer(renderer);
+    const f32* const c = frame->clear_color;
+    const u32 clear_color =
+        soft_renderer_channel(c[3], 24) | soft_renderer_channel(c[0], 16) |
+        soft_renderer_channel(c[1], 8) | soft_renderer_channel(c[2], 0);
+    soft_raster_begin(&soft->raster, clear_color,
+                      (vec4*)frame->view_projection);
+}
+
+static void soft_renderer_lights_update(Renderer* renderer,
+                                        const RendererLights* lights) {
+    (void)renderer;
+    (void)lights;
+}
+
+static void soft_renderer_draw(Renderer* renderer, const RendererDraw* draw) {
+    SoftRenderer* const soft = soft_renderer(renderer);
+    const SoftPipeline* const pipeline = &soft->pipelines[draw->pipeline - 1];
+
+    const SoftRasterDraw raster_draw = {
+        .positions = soft->buffers[draw->positions - 1].data,
+        .uvs = soft->buffers[draw->uvs - 1].data,
+        .quantized = pipeline->vertex_format == RENDERER_VERTEX_QUANTIZED,
+        .models = soft->buffers[draw->instances - 1].data,
+        .materials =
+            pipeline->inputs == RENDERER_PIPELINE_INSTANCE_MATERIALS
+                ? soft->buffers[draw->materials - 1].data
+                : NULL,
+        .texture = &soft->textures[draw->texture - 1],
+        .first_vertex = draw->first_vertex,
+        .vertex_count = draw->vertex_count,
+        .first_instance = draw->first_instance,
+        .instance_count = draw->instance_count,
+    };
+    soft_raster_draw(&soft->raster, &raster_draw);
+}
+
+static _Bool soft_renderer_particles_create(Renderer* renderer,
+                                            u32 capacity) {
+    (void)renderer;
+    (void)capacity;
+    return false;
+}
+
+static void soft_renderer_particles_draw(Renderer* renderer,
+                                         const RendererParticles* particles) {
+    (void)renderer;
+    (void)particles;
+}
+
+static void soft_renderer_frame_submit(Renderer* renderer) {
+    soft_raster_end(&soft_renderer(renderer)->raster);
+}
+
+static void soft_renderer_frame_end(Renderer* renderer) {
+    SoftRenderer* const soft = soft_renderer(renderer);
+    if (!soft->surface) return;
+
+    // Taken again every frame, SDL recreates it when the window changes
+    SDL_Surface* const window_surface =
+        SDL_GetWindowSurface(renderer->window);
+    if (!window_surface) {
+        fprintf(stderr, "Unable to get the window surface: %s\n",
+                SDL_GetError());
+        return;
+    }
+    SDL_BlitSurface(soft->surface, NULL, window_surface, NULL);
+    SDL_UpdateWindowSurface(renderer->window);
+}
+
+// Frames are done when submitted
+static void soft_renderer_finish(Renderer* renderer) { (void)renderer; }
+
+const RendererFunctions soft_renderer_functions = {
+    .name = "soft",
+    .init = soft_renderer_init,
+    .destroy = soft_renderer_destroy,
+    .buffer_create = soft_renderer_buffer_create,
+    .buffer_update = soft_renderer_buffer_update,
+    .texture_create = soft_renderer_texture_create,
+    .texture_array_create = soft_renderer_texture_array_create,
+    .pipeline_create = soft_renderer_pipeline_create,
+    .frame_begin = soft_renderer_frame_begin,
+    .lights_update = soft_renderer_lights_update,
+    .draw = soft_renderer_draw,
+    .particles_create = soft_renderer_particles_create,
+    .particles_draw = soft_renderer_particles_draw,
+    .frame_submit = soft_renderer_frame_submit,
+    .frame_end = soft_renderer_frame_end,
+    .finish = soft_renderer_finish,
+};
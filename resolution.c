@@ -0,0 +1,114 @@
+#include "resolution.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Weight of the last frame in the smoothed GPU time
+#define RESOLUTION_SMOOTHING 0.2f
+
+static f32 resolution_clamp(const Resolution* resolution, f32 scale) {
+    return MIN(MAX(scale, resolution->min_scale), resolution->max_scale);
+}
+
+void resolution_init(Resolution* resolution) {
+    memset(resolution, 0, sizeof(Resolution));
+    resolution->min_scale = 0.5f;
+    resolution->max_scale = 1.0f;
+    resolution->hysteresis = 0.1f;
+    resolution->scale = 1.0f;
+
+    const char* const target = getenv("DYNAMIC_RESOLUTION");
+    if (!target) return;
+    resolution->target_ms = strtof(target, NULL);
+    if (resolution->target_ms <= 0.0f) {
+        fprintf(stderr, "Invalid DYNAMIC_RESOLUTION=%s, expected a frame "
+                        "time in milliseconds\n",
+                target);
+        exit(EINVAL);
+    }
+    resolution->enabled = true;
+
+    const char* const scale = getenv("DYNAMIC_RESOLUTION_SCALE");
+    if (scale) {
+        char* end = NULL;
+        resolution->min_scale = strtof(scale, &end);
+        if (*end == ':') resolution->max_scale = strtof(end + 1, NULL);
+        if (!(resolution->min_scale > 0.0f &&
+              resolution->min_scale <= resolution->max_scale &&
+              resolution->max_scale <= 1.0f)) {
+            fprintf(stderr, "Invalid DYNAMIC_RESOLUTION_SCALE=%s, expected "
+                            "<min>:<max> in (0, 1]\n",
+                    scale);
+            exit(EINVAL);
+        }
+    }
+
+    const char* const hysteresis = getenv("DYNAMIC_RESOLUTION_HYSTERESIS");
+    if (hysteresis) resolution->hysteresis = strtof(hysteresis, NULL);
+
+    resolution->scale = resolution->max_scale;
+    printf("Dynamic resolution: target=%.2fms scale=%.2f:%.2f "
+           "hysteresis=%.2f\n",
+           (f64)resolution->target_ms, (f64)resolution->min_scale,
+           (f64)resolution->max_scale, (f64)resolution->hysteresis);
+}
+
+f32 resolution_update(Resolution* resolution, f32 gpu_ms) {
+    if (!resolution->enabled) return resolution->scale;
+
+    resolution->frame += 1;
+    resolution->gpu_ms =
+        resolution->gpu_ms > 0.0f
+            ? resolution->gpu_ms +
+                  (gpu_ms - resolution->gpu_ms) * RESOLUTION_SMOOTHING
+            : gpu_ms;
+    if (resolution->settle_frames > 0) {
+        resolution->settle_frames -= 1;
+        return resolution->scale;
+    }
+
+    const f32 target = resolution->target_ms;
+    const f32 band = target * resolution->hysteresis;
+    if (fabsf(resolution->gpu_ms - target) <= band)
+        return resolution->scale;
+
+    // The shading cost follows the pixel count, the square of the scale
+    f32 factor = sqrtf(target / resolution->gpu_ms);
+    factor = MIN(factor, RESOLUTION_MAX_INCREASE);
+    const f32 scale = resolution_clamp(resolution, resolution->scale * factor);
+    if (fabsf(scale - resolution->scale) < 0.01f) return resolution->scale;
+
+    resolution->scale = scale;
+    resolution->settle_frames = RESOLUTION_SETTLE_FRAMES;
+    resolution->history[resolution->change_count % RESOLUTION_HISTORY] =
+        (ResolutionChange){
+            .frame = resolution->frame,
+            .scale = scale,
+            .gpu_ms = resolution->gpu_ms,
+        };
+    resolution->change_count += 1;
+    return scale;
+}
+
+u32 resolution_scaled(const Resolution* resolution, u32 size) {
+    const u32 scaled = (u32)((f32)size * resolution->scale + 0.5f);
+    return scaled > 0 ? scaled : 1;
+}
+
+void resolution_print(const Resolution* resolution) {
+    if (!resolution->enabled) return;
+
+    printf("Dynamic resolution: scale=%.3f gpu_ms=%.3f changes=%u\n",
+           (f64)resolution->scale, (f64)resolution->gpu_ms,
+           resolution->change_count);
+    const u32 count = MIN(resolution->change_count, RESOLUTION_HISTORY);
+    for (u32 i = resolution->change_count - count;
+         i < resolution->change_count; i++) {
+        const ResolutionChange* const change =
+            &resolution->history[i % RESOLUTION_HISTORY];
+        printf("Dynamic resolution:   frame=%" PRIu64
+               " scale=%.3f gpu_ms=%.3f\n",
+               change->frame, (f64)change->scale, (f64)change->gpu_ms);
+    }
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include "utils.h"
+
+// Dynamic resolution: the scene is rendered at a fraction of the drawable
+// size, picked from the measured GPU frame time to hold a target, then
+// upscaled to the window.
+//
+// `DYNAMIC_RESOLUTION=<target ms>` enables it,
+// `DYNAMIC_RESOLUTION_SCALE=<min>:<max>` bounds the scale per axis
+// (default 0.5:1) and `DYNAMIC_RESOLUTION_HYSTERESIS=<fraction>` is the
+// band around the target where the scale is kept (default 0.1).
+//
+// GPU times arrive a few frames late and are noisy: they are smoothed, and
+// after a change the scale holds until frames at the new one are measured.
+
+// Frames without a change after one, more than the timer query latency
+#define RESOLUTION_SETTLE_FRAMES 8
+// Changes remembered for the report
+#define RESOLUTION_HISTORY 32
+// Per change, to come back up slowly after a spike
+#define RESOLUTION_MAX_INCREASE 1.1f
+
+typedef struct {
+    u64 frame;
+    f32 scale;
+    f32 gpu_ms;  // Smoothed, which triggered the change
+} ResolutionChange;
+
+typedef struct {
+    _Bool enabled;
+    f32 target_ms;
+    f32 min_scale, max_scale;
+    f32 hysteresis;
+
+    f32 scale;
+    f32 gpu_ms;  // Smoothed
+    u64 frame;
+    u32 settle_frames;
+
+    // Ring, the last RESOLUTION_HISTORY changes
+    ResolutionChange history[RESOLUTION_HISTORY];
+    u32 change_count;
+} Resolution;
+
+// From the environment, disabled at scale 1 without DYNAMIC_RESOLUTION
+void resolution_init(Resolution* resolution);
+// GPU time of a frame, returns the scale of the next ones
+f32 resolution_update(Resolution* resolution, f32 gpu_ms);
+// Size rendered at for a drawable size, at least 1
+u32 resolution_scaled(const Resolution* resolution, u32 size);
+void resolution_print(const Resolution* resolution);
@@ -0,0 +1,255 @@
+#include "resource_registry.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    ResourceKind kind;
+    ResourceClass usage;
+    u64 handle;
+    u64 bytes;
+    const char* owner;
+} Resource;
+
+static const char* const resource_kind_names[RESOURCE_KIND_COUNT] = {
+    [RESOURCE_GL_BUFFER] = "gl_buffer",
+    [RESOURCE_GL_TEXTURE] = "gl_texture",
+    [RESOURCE_GL_PROGRAM] = "gl_program",
+    [RESOURCE_GL_RENDERBUFFER] = "gl_renderbuffer",
+    [RESOURCE_VK_MEMORY] = "vk_memory",
+    [RESOURCE_VK_SHADER_MODULE] = "vk_shader_module",
+};
+
+// Also the names of MEMORY_BUDGET
+static const char* const resource_class_names[RESOURCE_CLASS_COUNT + 1] = {
+    [RESOURCE_BUFFER] = "buffer",
+    [RESOURCE_STAGING] = "staging",
+    [RESOURCE_TEXTURE] = "texture",
+    [RESOURCE_RENDER_TARGET] = "render_target",
+    [RESOURCE_SHADER] = "shader",
+    [RESOURCE_TOTAL] = "total",
+};
+
+// Indexed by class, RESOURCE_TOTAL last
+static struct {
+    _Bool initialized;
+    const char* owner;
+
+    Resource* resources;
+    u32 resource_count, resource_capacity;
+
+    u64 bytes[RESOURCE_CLASS_COUNT + 1];
+    u64 peak_bytes[RESOURCE_CLASS_COUNT + 1];
+    u32 counts[RESOURCE_CLASS_COUNT + 1];
+
+    u64 budgets[RESOURCE_CLASS_COUNT + 1];
+    ResourceEvictFn evict_hooks[RESOURCE_CLASS_COUNT + 1];
+    void* evict_user_data[RESOURCE_CLASS_COUNT + 1];
+    // Warned once until back under budget
+    _Bool over_budget[RESOURCE_CLASS_COUNT + 1];
+    _Bool evicting;
+} registry;
+
+static void resource_registry_init(void) {
+    if (registry.initialized) return;
+    registry.initialized = true;
+    registry.owner = "renderer";
+
+    const char* budget = getenv("MEMORY_BUDGET");
+    while (budget && *budget) {
+        const char* const equal = strchr(budget, '=');
+        if (!equal) break;
+
+        u32 usage = 0;
+        for (; usage <= RESOURCE_TOTAL; usage++) {
+            const usize len = strlen(resource_class_names[usage]);
+            if (len == (usize)(equal - budget) &&
+                strncmp(budget, resource_class_names[usage], len) == 0)
+                break;
+        }
+        if (usage > RESOURCE_TOTAL) {
+            fprintf(stderr,
+                    "Unknown class in MEMORY_BUDGET=%s, expected buffer, "
+                    "staging, texture, render_target, shader or total\n",
+                    getenv("MEMORY_BUDGET"));
+            exit(EINVAL);
+        }
+
+        char* end = NULL;
+        registry.budgets[usage] = strtoull(equal + 1, &end, 10) << 20;
+        budget = *end == ',' ? end + 1 : end;
+    }
+}
+
+const char* resource_owner_set(const char* owner) {
+    resource_registry_init();
+    const char* const previous = registry.owner;
+    registry.owner = owner;
+    return previous;
+}
+
+static Resource* resource_find(ResourceKind kind, u64 handle) {
+    for (u32 i = 0; i < registry.resource_count; i++) {
+        Resource* const resource = &registry.resources[i];
+        if (resource->kind == kind && resource->handle == handle)
+            return resource;
+    }
+    return NULL;
+}
+
+static void resource_budget_check(u32 usage) {
+    if (!registry.budgets[usage]) return;
+
+    if (registry.bytes[usage] > registry.budgets[usage] &&
+        registry.evict_hooks[usage] && !registry.evicting) {
+        registry.evicting = true;
+        registry.evict_hooks[usage](
+            (ResourceClass)usage,
+            registry.bytes[usage] - registry.budgets[usage],
+            registry.evict_user_data[usage]);
+        registry.evicting = false;
+    }
+
+    const _Bool over = registry.bytes[usage] > registry.budgets[usage];
+    if (over && !registry.over_budget[usage]) {
+        fprintf(stderr,
+                "Resources: over budget class=%s bytes=%" PRIu64
+                " budget=%" PRIu64 "\n",
+                resource_class_names[usage], registry.bytes[usage],
+                registry.budgets[usage]);
+    }
+    registry.over_budget[usage] = over;
+}
+
+static void resource_add(ResourceClass usage, i64 bytes) {
+    const u32 indices[2] = {usage, RESOURCE_TOTAL};
+    for (u32 i = 0; i < ARR_SIZE(indices); i++) {
+        const u32 j = indices[i];
+        registry.bytes[j] = (u64)((i64)registry.bytes[j] + bytes);
+        registry.peak_bytes[j] = MAX(registry.peak_bytes[j], registry.bytes[j]);
+    }
+    if (bytes > 0) {
+        resource_budget_check(usage);
+        resource_budget_check(RESOURCE_TOTAL);
+    } else {
+        // Back under budget, warn again next time
+        for (u32 i = 0; i < ARR_SIZE(indices); i++) {
+            const u32 j = indices[i];
+            if (registry.bytes[j] <= registry.budgets[j])
+                registry.over_budget[j] = false;
+        }
+    }
+}
+
+void resource_track(ResourceKind kind, u64 handle, ResourceClass usage,
+                    u64 bytes, const char* owner) {
+    resource_registry_init();
+    assert(usage < RESOURCE_CLASS_COUNT);
+    assert(!resource_find(kind, handle));
+
+    if (registry.resource_count == registry.resource_capacity) {
+        registry.resource_capacity = registry.resource_capacity > 0
+                                         ? registry.resource_capacity * 2
+                                         : 64;
+        registry.resources =
+            realloc(registry.resources,
+                    sizeof(Resource) * registry.resource_capacity);
+        if (!registry.resources) exit(ENOMEM);
+    }
+    registry.resources[registry.resource_count++] = (Resource){
+        .kind = kind,
+        .usage = usage,
+        .handle = handle,
+        .bytes = bytes,
+        .owner = owner ? owner : registry.owner,
+    };
+    registry.counts[usage] += 1;
+    registry.counts[RESOURCE_TOTAL] += 1;
+    resource_add(usage, (i64)bytes);
+}
+
+void resource_resize(ResourceKind kind, u64 handle, u64 bytes) {
+    Resource* const resource = resource_find(kind, handle);
+    assert(resource);
+    if (resource->bytes == bytes) return;
+
+    const i64 delta = (i64)bytes - (i64)resource->bytes;
+    resource->bytes = bytes;
+    resource_add(resource->usage, delta);
+}
+
+void resource_untrack(ResourceKind kind, u64 handle) {
+    Resource* const resource = resource_find(kind, handle);
+    assert(resource);
+
+    const Resource removed = *resource;
+    *resource = registry.resources[--registry.resource_count];
+    registry.counts[removed.usage] -= 1;
+    registry.counts[RESOURCE_TOTAL] -= 1;
+    resource_add(removed.usage, -(i64)removed.bytes);
+}
+
+u64 resource_bytes(ResourceClass usage) {
+    assert(usage <= RESOURCE_TOTAL);
+    return registry.bytes[usage];
+}
+
+u64 resource_peak_bytes(ResourceClass usage) {
+    assert(usage <= RESOURCE_TOTAL);
+    return registry.peak_bytes[usage];
+}
+
+u32 resource_count(ResourceClass usage) {
+    assert(usage <= RESOURCE_TOTAL);
+    return registry.counts[usage];
+}
+
+void resource_set_budget(ResourceClass usage, u64 bytes) {
+    resource_registry_init();
+    assert(usage <= RESOURCE_TOTAL);
+    registry.budgets[usage] = bytes;
+    registry.over_budget[usage] = false;
+    resource_budget_check(usage);
+}
+
+void resource_set_evict_hook(ResourceClass usage, ResourceEvictFn hook,
+                             void* user_data) {
+    assert(usage <= RESOURCE_TOTAL);
+    registry.evict_hooks[usage] = hook;
+    registry.evict_user_data[usage] = user_data;
+}
+
+static int resource_compare_bytes(const void* a, const void* b) {
+    const u64 bytes_a = ((const Resource*)a)->bytes;
+    const u64 bytes_b = ((const Resource*)b)->bytes;
+    return (bytes_a < bytes_b) - (bytes_a > bytes_b);
+}
+
+void resource_registry_print(u32 max_entries) {
+    for (u32 usage = 0; usage <= RESOURCE_TOTAL; usage++) {
+        if (!registry.peak_bytes[usage]) continue;
+
+        printf("Resources: class=%s count=%u bytes=%" PRIu64
+               " peak_bytes=%" PRIu64,
+               resource_class_names[usage], registry.counts[usage],
+               registry.bytes[usage], registry.peak_bytes[usage]);
+        if (registry.budgets[usage])
+            printf(" budget=%" PRIu64, registry.budgets[usage]);
+        printf("\n");
+    }
+
+    // Sorted in place, the order does not matter to the lookups
+    qsort(registry.resources, registry.resource_count, sizeof(Resource),
+          resource_compare_bytes);
+    const u32 count = MIN(max_entries, registry.resource_count);
+    for (u32 i = 0; i < count; i++) {
+        const Resource* const resource = &registry.resources[i];
+        printf("Resources:   %s handle=%" PRIu64 " class=%s bytes=%" PRIu64
+               " owner=%s\n",
+               resource_kind_names[resource->kind], resource->handle,
+               resource_class_names[resource->usage], resource->bytes,
+               resource->owner);
+    }
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include "utils.h"
+
+// Registry of the GPU objects created by the backends, with their size and
+// what they are used for, to see what a scene costs and where it goes over
+// budget.
+//
+// Sizes are the actual allocation for Vulkan (memory requirements) and
+// estimates for OpenGL, which does not expose them: the data size for
+// buffers, 4 bytes per texel plus a third for the mipmaps for textures, the
+// binary length for programs.
+//
+// `MEMORY_BUDGET=<class>=<MB>[,<class>=<MB>...]` sets budgets, e.g.
+// `MEMORY_BUDGET=texture=256,total=512`. Going over one calls the eviction
+// hook of the class, then warns if that was not enough.
+//
+// Single threaded: objects are created and destroyed by the render thread.
+
+// What the object is, with its handle, identifies it
+typedef enum {
+    RESOURCE_GL_BUFFER,
+    RESOURCE_GL_TEXTURE,
+    RESOURCE_GL_PROGRAM,
+    RESOURCE_GL_RENDERBUFFER,
+    RESOURCE_VK_MEMORY,        // VkDeviceMemory
+    RESOURCE_VK_SHADER_MODULE,
+    RESOURCE_KIND_COUNT,
+} ResourceKind;
+
+// What it is used for, budgets are per class
+typedef enum {
+    RESOURCE_BUFFER,  // Vertex and instance data
+    RESOURCE_STAGING,  // Transfers to and from the host
+    RESOURCE_TEXTURE,
+    RESOURCE_RENDER_TARGET,
+    RESOURCE_SHADER,
+    RESOURCE_CLASS_COUNT,
+} ResourceClass;
+
+// Budget of every class together
+#define RESOURCE_TOTAL RESOURCE_CLASS_COUNT
+
+// Called when `usage` (or RESOURCE_TOTAL) is `over` bytes above its budget,
+// expected to destroy objects, which untracks them
+typedef void (*ResourceEvictFn)(ResourceClass usage, u64 over,
+                                void* user_data);
+
+// Tags the objects tracked without an owner, returns the previous tag
+const char* resource_owner_set(const char* owner);
+
+// `owner` is a static string, NULL for the current tag
+void resource_track(ResourceKind kind, u64 handle, ResourceClass usage,
+                    u64 bytes, const char* owner);
+// Storage reallocated, e.g. glBufferData on an existing buffer
+void resource_resize(ResourceKind kind, u64 handle, u64 bytes);
+void resource_untrack(ResourceKind kind, u64 handle);
+
+// `usage` can be RESOURCE_TOTAL
+u64 resource_bytes(ResourceClass usage);
+u64 resource_peak_bytes(ResourceClass usage);
+u32 resource_count(ResourceClass usage);
+
+// 0 for no budget
+void resource_set_budget(ResourceClass usage, u64 bytes);
+void resource_set_evict_hook(ResourceClass usage, ResourceEvictFn hook,
+                             void* user_data);
+
+// Totals per class, then the `max_entries` largest objects
+void resource_registry_print(u32 max_entries);
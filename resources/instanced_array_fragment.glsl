@@ -0,0 +1,13 @@
+#version 330 core
+
+// Interpolated values from the vertex shaders, the layer is the same on
+// every vertex
+in vec3 UV;
+
+out vec3 color;
+
+uniform sampler2DArray texture_sampler;
+
+void main(){
+    color = texture(texture_sampler, UV).rgb;
+}
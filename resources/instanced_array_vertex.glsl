@@ -0,0 +1,19 @@
+#version 330 core
+
+layout(location = 0) in vec3 vertex_position_modelspace;
+layout(location = 1) in vec2 vertex_UV;
+// One per instance, a mat4 takes 4 locations
+layout(location = 2) in mat4 model;
+// One per instance too: where the texture of the instance is in the array
+layout(location = 6) in vec4 uv_rect;
+layout(location = 7) in float layer;
+
+// UV and layer
+out vec3 UV;
+
+uniform mat4 VP;
+
+void main() {
+    gl_Position = VP * model * vec4(vertex_position_modelspace, 1);
+    UV = vec3(uv_rect.xy + vertex_UV * uv_rect.zw, layer);
+}
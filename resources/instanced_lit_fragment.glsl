@@ -0,0 +1,53 @@
+#version 330 core
+
+// Clustered forward lighting, see light_clusters.h. Must match renderer.h.
+const uvec3 clusters = uvec3(16u, 9u, 24u);
+const vec3 ambient = vec3(0.05);
+
+in vec2 UV;
+in vec3 position_worldspace;
+
+out vec3 color;
+
+uniform sampler2D texture_sampler;
+// Per light, position and radius then color
+uniform samplerBuffer lights;
+// Per cluster, first index and count
+uniform usamplerBuffer light_ranges;
+uniform usamplerBuffer light_indices;
+// View depth of a world position
+uniform vec4 depth_plane;
+// Tiles per pixel, then the scale and bias of the slice of a log depth
+uniform vec4 cluster_scale;
+
+void main(){
+    vec3 albedo = texture(texture_sampler, UV).rgb;
+
+    // Flat, the meshes have no normals. Toward the camera with the window
+    // origin at the bottom left.
+    vec3 normal = normalize(cross(dFdx(position_worldspace),
+                                  dFdy(position_worldspace)));
+
+    float depth = dot(depth_plane, vec4(position_worldspace, 1));
+    uvec3 cluster = uvec3(
+        uvec2(gl_FragCoord.xy * cluster_scale.xy),
+        uint(max(log(depth) * cluster_scale.z + cluster_scale.w, 0.0)));
+    cluster = min(cluster, clusters - 1u);
+    uvec2 range = texelFetch(light_ranges, int(
+        (cluster.z * clusters.y + cluster.y) * clusters.x + cluster.x)).rg;
+
+    vec3 lit = ambient * albedo;
+    for (uint i = 0u; i < range.y; i++) {
+        int light = int(texelFetch(light_indices, int(range.x + i)).r);
+        vec4 position_radius = texelFetch(lights, 2 * light);
+        vec3 light_color = texelFetch(lights, 2 * light + 1).rgb;
+
+        vec3 to_light = position_radius.xyz - position_worldspace;
+        float light_distance = length(to_light);
+        float falloff =
+            clamp(1.0 - light_distance / position_radius.w, 0.0, 1.0);
+        lit += albedo * light_color * falloff * falloff *
+               max(dot(normal, to_light / light_distance), 0.0);
+    }
+    color = lit;
+}
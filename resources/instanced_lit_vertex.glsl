@@ -0,0 +1,18 @@
+#version 330 core
+
+layout(location = 0) in vec3 vertex_position_modelspace;
+layout(location = 1) in vec2 vertex_UV;
+// One per instance, a mat4 takes 4 locations
+layout(location = 2) in mat4 model;
+
+out vec2 UV;
+out vec3 position_worldspace;
+
+uniform mat4 VP;
+
+void main() {
+    vec4 position = model * vec4(vertex_position_modelspace, 1);
+    gl_Position = VP * position;
+    UV = vertex_UV;
+    position_worldspace = position.xyz;
+}
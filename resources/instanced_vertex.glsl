@@ -2,12 +2,14 @@
 
 layout(location = 0) in vec3 vertex_position_modelspace;
 layout(location = 1) in vec2 vertex_UV;
+// One per instance, a mat4 takes 4 locations
+layout(location = 2) in mat4 model;
 
 out vec2 UV;
 
-uniform mat4 MVP;
+uniform mat4 VP;
 
 void main() {
-    gl_Position = MVP * vec4(vertex_position_modelspace, 1);
+    gl_Position = VP * model * vec4(vertex_position_modelspace, 1);
     UV = vertex_UV;
 }
@@ -0,0 +1,12 @@
+#version 330 core
+
+in vec2 corner;
+in vec3 particle_color;
+
+out vec3 color;
+
+void main() {
+    // Round, fading to the edge. Blending adds it to the scene.
+    float falloff = max(1.0 - dot(corner, corner), 0.0);
+    color = particle_color * falloff;
+}
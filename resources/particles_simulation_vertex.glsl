@@ -0,0 +1,65 @@
+#version 330 core
+
+// One particle per vertex, written to the other buffer by transform feedback
+layout(location = 0) in vec4 position_age;
+layout(location = 1) in vec4 velocity_lifetime;
+
+out vec4 out_position_age;
+out vec4 out_velocity_lifetime;
+
+// dt, particles per emitter, emitter count, seed
+uniform vec4 simulation;
+uniform vec4 gravity;
+// Per emitter: position and lifetime, velocity and spread, first particle
+// and count of those spawned in its ring
+uniform vec4 emitters[48];
+
+uint hash(uint x) {
+    x ^= x >> 16;
+    x *= 0x7feb352du;
+    x ^= x >> 15;
+    x *= 0x846ca68bu;
+    x ^= x >> 16;
+    return x;
+}
+
+// In [0, 1)
+float random(inout uint state) {
+    state = hash(state);
+    return float(state >> 8) / 16777216.0;
+}
+
+void main() {
+    uint particle = uint(gl_VertexID);
+    uint share = uint(simulation.y);
+    uint emitter = particle / share;
+    float dt = simulation.x;
+
+    if (emitter < uint(simulation.z)) {
+        vec4 spawn = emitters[emitter * 3u + 2u];
+        uint ring = particle - emitter * share;
+        if ((ring + share - uint(spawn.x)) % share < uint(spawn.y)) {
+            vec4 origin = emitters[emitter * 3u];
+            vec4 velocity = emitters[emitter * 3u + 1u];
+            uint state = particle ^ hash(uint(simulation.w));
+            vec3 direction = vec3(random(state), random(state),
+                                  random(state)) * 2.0 - 1.0;
+            out_position_age = vec4(origin.xyz, 0.0);
+            out_velocity_lifetime =
+                vec4(velocity.xyz + direction * velocity.w,
+                     origin.w * (0.75 + 0.5 * random(state)));
+            return;
+        }
+    }
+
+    // The dead stay as they are
+    if (position_age.w >= velocity_lifetime.w) {
+        out_position_age = position_age;
+        out_velocity_lifetime = velocity_lifetime;
+        return;
+    }
+    vec3 velocity = velocity_lifetime.xyz + gravity.xyz * dt;
+    out_position_age = vec4(position_age.xyz + velocity * dt,
+                            position_age.w + dt);
+    out_velocity_lifetime = vec4(velocity, velocity_lifetime.w);
+}
@@ -0,0 +1,38 @@
+#version 330 core
+
+// One particle per instance, 4 vertices of a strip each
+layout(location = 0) in vec4 position_age;
+layout(location = 1) in vec4 velocity_lifetime;
+
+out vec2 corner;
+out vec3 particle_color;
+
+uniform mat4 VP;
+// World space axes of the camera
+uniform vec4 camera_right;
+uniform vec4 camera_up;
+// Particles per emitter, emitter count
+uniform vec4 pool;
+// Per emitter: color and size
+uniform vec4 colors[16];
+
+void main() {
+    uint emitter = uint(gl_InstanceID) / uint(pool.x);
+    // Dead, or never spawned: every vertex at the same place outside of the
+    // clip volume
+    if (position_age.w >= velocity_lifetime.w || emitter >= uint(pool.y)) {
+        gl_Position = vec4(2.0, 2.0, 2.0, 1.0);
+        corner = vec2(0.0);
+        particle_color = vec3(0.0);
+        return;
+    }
+
+    vec4 color = colors[emitter];
+    corner = vec2(gl_VertexID & 1, gl_VertexID >> 1) * 2.0 - 1.0;
+    vec3 offset = (camera_right.xyz * corner.x + camera_up.xyz * corner.y) *
+                  color.w * 0.5;
+    gl_Position = VP * vec4(position_age.xyz + offset, 1.0);
+    // Fades out with age
+    particle_color =
+        color.rgb * (1.0 - position_age.w / velocity_lifetime.w);
+}
@@ -0,0 +1,944 @@
+#include "scene.h"
+
+#include <assert.h>
+#include <stdio.h>
+
+#include "bmp.h"
+#include "cube.h"
+#include "resource_registry.h"
+#include "texture_atlas.h"
+#include "texture_uv.h"
+#include "trace.h"
+
+// Same layout as vulkan/vk_scene.c
+static const vec3 default_positions[] = {
+    {0.0f, 0.0f, 0.0f},    {2.0f, 5.0f, -15.0f}, {-1.5f, -2.2f, -2.5f},
+    {-3.8f, -2.0f, -9.3f}, {2.4f, -0.4f, -3.5f}, {-1.7f, 3.0f, -7.5f},
+    {4.3f, -2.0f, -2.5f},  {1.5f, 6.0f, -2.5f},  {1.5f, 5.2f, -1.5f},
+    {-1.3f, 3.0f, -1.5f}};
+
+// xorshift32, the state must not be 0
+static u32 scene_random(u32* state) {
+    u32 x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+// In [min, max)
+static f32 scene_random_range(u32* state, f32 min, f32 max) {
+    const f32 unit = (f32)(scene_random(state) >> 8) / (f32)(1 << 24);
+    return min + unit * (max - min);
+}
+
+static void scene_positions(Scene* scene) {
+    const SceneDesc* const desc = &scene->desc;
+    u32 state = desc->seed;
+
+    for (u32 i = 0; i < desc->instance_count; i++) {
+        f32* const position = scene->positions[i];
+
+        if (desc->overdraw) {
+            // Farthest first, all of them centered
+            const f32 t = (f32)i / (f32)desc->instance_count;
+            position[0] = scene_random_range(&state, -0.5f, 0.5f);
+            position[1] = scene_random_range(&state, -0.5f, 0.5f);
+            position[2] = -5.0f - 40.0f * (1.0f - t);
+        } else if (desc->seed) {
+            position[0] = scene_random_range(&state, -20.0f, 20.0f);
+            position[1] = scene_random_range(&state, -15.0f, 15.0f);
+            position[2] = scene_random_range(&state, -80.0f, 0.0f);
+        } else if (i < ARR_SIZE(default_positions)) {
+            glm_vec3_copy((f32*)default_positions[i], position);
+        } else {
+            const u32 j = i - (u32)ARR_SIZE(default_positions);
+            position[0] = ((f32)(j % 32) - 16.0f) * 3.0f;
+            position[1] = ((f32)((j / 32) % 32) - 16.0f) * 3.0f;
+            position[2] = -20.0f - (f32)(j / 1024) * 3.0f;
+        }
+    }
+}
+
+static void scene_models(const Scene* scene, f32 angle, mat4* models) {
+    vec3 rotation_axis = {1.0f, 0.3f, 0.5f};
+    vec3 scale = {scene->scale, scene->scale, scene->scale};
+    for (u32 i = 0; i < scene->desc.instance_count; i++) {
+        glm_mat4_identity(models[i]);
+        glm_translate(models[i], scene->positions[i]);
+        glm_rotate(models[i], glm_rad((0.8f + (f32)i) * angle * 20.0f),
+                   rotation_axis);
+        glm_scale(models[i], scale);
+        if (scene->desc.quantized_vertices)
+            mesh_dequantize(&scene->bounds, models[i]);
+    }
+}
+
+// Every pivot of the scene graph turns at its own speed, or not at all
+static _Bool scene_pivot_moving(const Scene* scene, u32 pivot) {
+    return pivot % 100 < scene->desc.moving_percent;
+}
+
+static void scene_pivot_local(const Scene* scene, u32 pivot, f32 angle,
+                              mat4 local) {
+    glm_mat4_identity(local);
+    glm_translate(local, scene->pivots[pivot]);
+    if (scene_pivot_moving(scene, pivot)) {
+        glm_rotate(local, glm_rad((1.0f + (f32)(pivot % 3)) * angle * 20.0f),
+                   (vec3){0.0f, 1.0f, 0.0f});
+    }
+}
+
+// On the circle of its pivot, turned by its place on it
+static void scene_child_local(const Scene* scene, u32 instance, mat4 local) {
+    vec3 rotation_axis = {1.0f, 0.3f, 0.5f};
+    vec3 scale = {scene->scale, scene->scale, scene->scale};
+    const f32 turn =
+        2.0f * GLM_PIf * (f32)(instance % SCENE_GRAPH_GROUP) /
+        (f32)SCENE_GRAPH_GROUP;
+    glm_mat4_identity(local);
+    glm_translate(local, (vec3){cosf(turn) * SCENE_GRAPH_RADIUS, 0.0f,
+                                sinf(turn) * SCENE_GRAPH_RADIUS});
+    glm_rotate(local, turn, rotation_axis);
+    glm_scale(local, scale);
+    if (scene->desc.quantized_vertices)
+        mesh_dequantize(&scene->bounds, local);
+}
+
+// The pivots at the positions of their first instance, then the instances.
+// The models of the pose of the scene are the world matrices of the
+// instances.
+static void scene_graph_create(Scene* scene) {
+    const u32 instance_count = scene->desc.instance_count;
+    scene_graph_init(&scene->graph, scene->pivot_count + instance_count);
+    mat4 local;
+    for (u32 i = 0; i < scene->pivot_count; i++) {
+        glm_vec3_copy(scene->positions[i * SCENE_GRAPH_GROUP],
+                      scene->pivots[i]);
+        scene_pivot_local(scene, i, 0.0f, local);
+        scene_graph_add(&scene->graph, SCENE_GRAPH_ROOT, local);
+    }
+    for (u32 i = 0; i < instance_count; i++) {
+        scene_child_local(scene, i, local);
+        scene_graph_add(&scene->graph, i / SCENE_GRAPH_GROUP, local);
+    }
+    scene_graph_update(&scene->graph);
+    scene->pose.models = &scene->graph.worlds[scene->pivot_count];
+}
+
+// Only the moving pivots, the update follows them to their instances. The
+// world matrices are copied to the models of any other pose.
+static void scene_graph_pose(Scene* scene, f32 angle, mat4* models) {
+    const u32 moving = MIN(scene->desc.moving_percent, 100);
+    mat4 local;
+    for (u32 first = 0; first < scene->pivot_count; first += 100) {
+        const u32 last = MIN(first + moving, scene->pivot_count);
+        for (u32 i = first; i < last; i++) {
+            scene_pivot_local(scene, i, angle, local);
+            scene_graph_set_local(&scene->graph, i, local);
+        }
+    }
+    scene_graph_update(&scene->graph);
+
+    mat4* const worlds = &scene->graph.worlds[scene->pivot_count];
+    if (models != worlds)
+        memcpy(models, worlds, sizeof(mat4) * scene->desc.instance_count);
+}
+
+// The mesh, quantized or as is. `vertex_positions` are vec3, `vertex_uvs`
+// vec2.
+static void scene_vertices_create(Scene* scene, Renderer* renderer,
+                                  const f32* vertex_positions,
+                                  const f32* vertex_uvs, u32 vertex_count) {
+    if (!scene->desc.quantized_vertices) {
+        scene->positions_buffer =
+            renderer_buffer_create(renderer, RENDERER_BUFFER_VERTEX,
+                                   vertex_positions,
+                                   sizeof(vec3) * vertex_count);
+        scene->uvs_buffer =
+            renderer_buffer_create(renderer, RENDERER_BUFFER_VERTEX,
+                                   vertex_uvs, sizeof(vec2) * vertex_count);
+        return;
+    }
+
+    const ArenaMark mark = arena_mark(&scene->arena);
+    MeshQuantizedPosition* const positions =
+        ARENA_ALLOC(&scene->arena, MeshQuantizedPosition, vertex_count);
+    MeshQuantizedUv* const uvs =
+        ARENA_ALLOC(&scene->arena, MeshQuantizedUv, vertex_count);
+
+    mesh_bounds(vertex_positions, vertex_count, &scene->bounds);
+    mesh_quantize_positions(vertex_positions, vertex_count, &scene->bounds,
+                            positions);
+    mesh_quantize_uvs(vertex_uvs, vertex_count, uvs);
+
+    scene->positions_buffer =
+        renderer_buffer_create(renderer, RENDERER_BUFFER_VERTEX, positions,
+                               sizeof(MeshQuantizedPosition) * vertex_count);
+    scene->uvs_buffer =
+        renderer_buffer_create(renderer, RENDERER_BUFFER_VERTEX, uvs,
+                               sizeof(MeshQuantizedUv) * vertex_count);
+    arena_release(&scene->arena, mark);
+}
+
+// Of `scene_sphere_create`: the welded sphere and its chain stay until the
+// levels are uploaded
+static usize scene_sphere_scratch_size(void) {
+    const u32 vertex_count =
+        MESH_SPHERE_VERTEX_COUNT(SCENE_SPHERE_SUBDIVISIONS);
+    const u32 index_count = MESH_SPHERE_INDEX_COUNT(SCENE_SPHERE_SUBDIVISIONS);
+    const usize chain_capacity = lod_chain_capacity(index_count);
+    const usize build = MAX(mesh_sphere_scratch_size(SCENE_SPHERE_SUBDIVISIONS),
+                            lod_chain_scratch_size(index_count, vertex_count));
+    const usize upload = (sizeof(vec3) + sizeof(vec2) +
+                          sizeof(MeshQuantizedPosition) +
+                          sizeof(MeshQuantizedUv)) *
+                         chain_capacity;
+    return sizeof(vec3) * vertex_count +
+           sizeof(u32) * (index_count + chain_capacity) + MAX(build, upload) +
+           16 * ARENA_ALIGNMENT;
+}
+
+// The sphere and its levels of detail, each level as triangles of their own
+static void scene_sphere_create(Scene* scene, Renderer* renderer) {
+    TRACE_BEGIN("sphere_create");
+    const u32 vertex_count =
+        MESH_SPHERE_VERTEX_COUNT(SCENE_SPHERE_SUBDIVISIONS);
+    const u32 index_count = MESH_SPHERE_INDEX_COUNT(SCENE_SPHERE_SUBDIVISIONS);
+    const ArenaMark mark = arena_mark(&scene->arena);
+    vec3* const positions = ARENA_ALLOC(&scene->arena, vec3, vertex_count);
+    u32* const indices = ARENA_ALLOC(&scene->arena, u32, index_count);
+    u32* const chain_indices =
+        ARENA_ALLOC(&scene->arena, u32, lod_chain_capacity(index_count));
+    mesh_sphere(SCENE_SPHERE_SUBDIVISIONS, positions[0], indices,
+                &scene->arena);
+    lod_chain_build(&scene->lod_chain, chain_indices, indices, index_count,
+                    positions[0], vertex_count, &scene->arena);
+
+    // A vertex per index, the first vertex of a level is its first index
+    const u32 chain_vertices = scene->lod_chain.index_count;
+    vec3* const vertex_positions =
+        ARENA_ALLOC(&scene->arena, vec3, chain_vertices);
+    vec2* const vertex_uvs = ARENA_ALLOC(&scene->arena, vec2, chain_vertices);
+    mesh_sphere_unweld(positions[0], chain_indices, chain_vertices,
+                       vertex_positions[0], vertex_uvs[0]);
+    scene->vertex_count = index_count;
+    scene_vertices_create(scene, renderer, vertex_positions[0], vertex_uvs[0],
+                          chain_vertices);
+    arena_release(&scene->arena, mark);
+    TRACE_END();
+}
+
+// A texture of its own, or an entry of the atlas when there is one
+static u32 scene_texture_add(Renderer* renderer, TextureAtlas* atlas,
+                             u32 width, u32 height, const u8* bgr) {
+    return atlas ? texture_atlas_add(atlas, width, height, bgr)
+                 : renderer_texture_create(renderer, width, height, bgr);
+}
+
+static u32 scene_texture_load(Scene* scene, Renderer* renderer,
+                              TextureAtlas* atlas) {
+    TRACE_BEGIN("texture_load");
+    const ArenaMark mark = arena_mark(&scene->arena);
+    u8* data = arena_alloc(&scene->arena, SCENE_BMP_CAPACITY);
+    usize data_len = 0, width = 0, height = 0, img_size = 0, data_pos = 0;
+
+    bmp_load("resources/crate.bmp", &data, SCENE_BMP_CAPACITY, &data_len,
+             &width, &height, &img_size, &data_pos);
+    printf("BMP: data_len=%zu, width=%zu height=%zu img_size=%zu\n", data_len,
+           width, height, img_size);
+
+    const u32 texture = scene_texture_add(renderer, atlas, (u32)width,
+                                          (u32)height, data + data_pos);
+    arena_release(&scene->arena, mark);
+    TRACE_END();
+    return texture;
+}
+
+static usize scene_texture_row_size(u32 size) {
+    return (size * 3 + 3) / 4 * 4;
+}
+
+// Checkerboard in a color picked from the seed, laid out like a BMP
+static u32 scene_texture_generate(Scene* scene, Renderer* renderer,
+                                  TextureAtlas* atlas, u32 size, u32* state) {
+    const usize row_size = scene_texture_row_size(size);
+    const ArenaMark mark = arena_mark(&scene->arena);
+    u8* const data = arena_alloc(&scene->arena, row_size * size);
+
+    u8 color[3];
+    for (u32 i = 0; i < 3; i++) color[i] = (u8)scene_random(state);
+
+    for (u32 y = 0; y < size; y++) {
+        u8* const row = data + y * row_size;
+        for (u32 x = 0; x < size; x++) {
+            const _Bool dark = ((x / 32) + (y / 32)) % 2;
+            for (u32 c = 0; c < 3; c++)
+                row[x * 3 + c] = dark ? color[c] / 4 : color[c];
+        }
+    }
+
+    const u32 texture = scene_texture_add(renderer, atlas, size, size, data);
+    arena_release(&scene->arena, mark);
+    return texture;
+}
+
+// First instance of a material, the ranges are contiguous
+static u32 scene_material_first(const Scene* scene, u32 material) {
+    return (u32)((u64)scene->desc.instance_count * material /
+                 scene->desc.material_count);
+}
+
+// Random spheres of light, circling at their own speed
+static void scene_lights_create(Scene* scene) {
+    u32 state = (scene->desc.seed ^ 0x9e3779b9u) | 1;
+    for (u32 i = 0; i < scene->desc.light_count; i++) {
+        f32* const orbit = scene->light_orbits[i];
+        orbit[0] = scene_random_range(&state, -20.0f, 20.0f);
+        orbit[1] = scene_random_range(&state, -15.0f, 15.0f);
+        orbit[2] = scene_random_range(&state, -60.0f, 5.0f);
+        orbit[3] = scene_random_range(&state, 0.5f, 3.0f);
+
+        RendererLight* const light = &scene->lights[i];
+        light->radius = scene_random_range(&state, 1.5f, 4.0f);
+        for (u32 c = 0; c < 3; c++)
+            light->color[c] = scene_random_range(&state, 0.2f, 1.5f);
+        light->padding = 0.0f;
+    }
+}
+
+static void scene_lights(const Scene* scene, f32 angle,
+                         RendererLight* lights) {
+    for (u32 i = 0; i < scene->desc.light_count; i++) {
+        const f32* const orbit = scene->light_orbits[i];
+        const f32 t = angle * (f32)(1 + i % 7) * 5.0f + (f32)i;
+        RendererLight* const light = &lights[i];
+        *light = scene->lights[i];
+        light->position[0] = orbit[0] + cosf(t) * orbit[3];
+        light->position[1] = orbit[1];
+        light->position[2] = orbit[2] + sinf(t) * orbit[3];
+    }
+}
+
+// Spread like the random instances, each with its own rotation, the
+// materials in contiguous ranges
+static void scene_static_models(const Scene* scene, mat4* models,
+                                u32* materials) {
+    const u32 static_count = scene->desc.static_count;
+    u32 state = (scene->desc.seed ^ 0x85ebca6bu) | 1;
+    vec3 rotation_axis = {1.0f, 0.3f, 0.5f};
+    vec3 scale = {scene->scale, scene->scale, scene->scale};
+    for (u32 i = 0; i < static_count; i++) {
+        vec3 position;
+        position[0] = scene_random_range(&state, -20.0f, 20.0f);
+        position[1] = scene_random_range(&state, -15.0f, 15.0f);
+        position[2] = scene_random_range(&state, -80.0f, 0.0f);
+
+        glm_mat4_identity(models[i]);
+        glm_translate(models[i], position);
+        glm_rotate(models[i], scene_random_range(&state, 0.0f, 6.28f),
+                   rotation_axis);
+        glm_scale(models[i], scale);
+        materials[i] =
+            (u32)((u64)i * scene->desc.material_count / static_count);
+    }
+}
+
+static void scene_static_create(Scene* scene, Renderer* renderer,
+                                RendererVertexFormat vertex_format) {
+    const u32 static_count = scene->desc.static_count;
+    const ArenaMark mark = arena_mark(&scene->arena);
+    mat4* const models = ARENA_ALLOC(&scene->arena, mat4, static_count);
+    u32* const materials = ARENA_ALLOC(&scene->arena, u32, static_count);
+    scene_static_models(scene, models, materials);
+
+    const StaticBatchMesh cube = {
+        .positions = cube_vertex_buffer_data,
+        .uvs = texture_uv_buffer_data,
+        .vertex_count = ARR_SIZE(cube_vertex_buffer_data) / 3,
+    };
+    static_batch_build(&scene->static_batch, renderer, &cube,
+                       (const mat4*)models, materials, static_count,
+                       vertex_format);
+    arena_release(&scene->arena, mark);
+}
+
+// Upward jets spread among the cubes, emitting enough to fill the pool
+static void scene_emitters_create(Scene* scene) {
+    u32 state = scene->desc.seed ? scene->desc.seed : 1;
+    for (u32 i = 0; i < SCENE_EMITTERS; i++) {
+        RendererEmitter* const emitter = &scene->emitters[i];
+        emitter->position[0] = scene_random_range(&state, -8.0f, 8.0f);
+        emitter->position[1] = scene_random_range(&state, -5.0f, -3.0f);
+        emitter->position[2] = scene_random_range(&state, -30.0f, -5.0f);
+        emitter->velocity[0] = 0.0f;
+        emitter->velocity[1] = scene_random_range(&state, 6.0f, 9.0f);
+        emitter->velocity[2] = 0.0f;
+        emitter->spread = scene_random_range(&state, 1.0f, 2.0f);
+        for (u32 c = 0; c < 3; c++)
+            emitter->color[c] = scene_random_range(&state, 0.05f, 0.3f);
+        emitter->lifetime = scene_random_range(&state, 1.5f, 2.5f);
+        emitter->size = scene_random_range(&state, 0.05f, 0.1f);
+        emitter->rate = (f32)scene->desc.particle_count /
+                        (f32)SCENE_EMITTERS / emitter->lifetime;
+    }
+}
+
+// Swaying, the particles already emitted stay where they are
+static void scene_emitters(const Scene* scene, f32 angle,
+                           RendererEmitter* emitters) {
+    for (u32 i = 0; i < SCENE_EMITTERS; i++) {
+        const f32 t = angle * 4.0f + (f32)i;
+        emitters[i] = scene->emitters[i];
+        emitters[i].position[0] += sinf(t) * 2.0f;
+    }
+}
+
+// Over the middle of the world along -z, back to the far edge once past the
+// near one
+static void scene_world_camera(const Scene* scene, f32 angle, vec3 camera) {
+    const WorldHeader* const header = scene->world.file.header;
+    const f32 width = header->chunk_size * (f32)header->grid_width;
+    const f32 depth = header->chunk_size * (f32)header->grid_depth;
+    const f32 traveled = fmodf(angle * SCENE_WORLD_SPEED, depth);
+    camera[0] = header->origin[0] + 0.5f * width;
+    camera[1] = SCENE_WORLD_HEIGHT;
+    camera[2] = header->origin[2] + depth - traveled;
+}
+
+// The mesh of the scene, with its dequantization
+static void scene_world_open(Scene* scene) {
+    const SceneDesc* const desc = &scene->desc;
+    mat4 mesh_transform;
+    glm_mat4_identity(mesh_transform);
+    if (desc->quantized_vertices)
+        mesh_dequantize(&scene->bounds, mesh_transform);
+    const u32 budget_mb =
+        desc->world_budget_mb ? desc->world_budget_mb : SCENE_WORLD_BUDGET_MB;
+    world_stream_open(&scene->world, desc->world_path,
+                      (usize)budget_mb << 20, SCENE_FAR,
+                      desc->spheres ? "sphere" : "cube", mesh_transform,
+                      desc->material_count);
+}
+
+// Zeroed until the first cull, from the frame arena reserved for it
+static void scene_world_create(Scene* scene, Renderer* renderer) {
+    const usize size = sizeof(mat4) * scene->world.model_capacity;
+    Arena* const frame = &renderer->frame_arena;
+    const ArenaMark mark = arena_mark(frame);
+    void* const models = arena_alloc(frame, size);
+    memset(models, 0, size);
+    scene->world_instances_buffer = renderer_buffer_create(
+        renderer, RENDERER_BUFFER_INSTANCE, models, size);
+    arena_release(frame, mark);
+}
+
+// What `scene_draw` takes from the frame arena, at most: the light lists,
+// the order and models of the visible levels of detail, the culled world
+static usize scene_frame_size(const Scene* scene) {
+    const SceneDesc* const desc = &scene->desc;
+    usize size = 0;
+    if (desc->light_count) size += light_clusters_frame_size();
+    if (desc->lod) {
+        size += (sizeof(u32) + sizeof(mat4)) * desc->instance_count +
+                2 * ARENA_ALIGNMENT;
+    }
+    if (desc->world_path) size += world_stream_frame_size(&scene->world);
+    return size;
+}
+
+static void scene_camera(const ScenePose* pose, const Renderer* renderer,
+                         mat4 view, mat4 projection) {
+    vec3 translation;
+    glm_vec3_negate_to((f32*)pose->camera, translation);
+    glm_mat4_identity(view);
+    glm_translate(view, translation);
+    glm_perspective(glm_rad(SCENE_FOV_Y),
+                    (f32)renderer->width / (f32)renderer->height, SCENE_NEAR,
+                    SCENE_FAR, projection);
+}
+
+// Per instance, from the atlas entry of every material
+static void scene_materials_create(Scene* scene, Renderer* renderer,
+                                   const TextureAtlas* atlas,
+                                   const u32* entries) {
+    const u32 instance_count = scene->desc.instance_count;
+    const ArenaMark mark = arena_mark(&scene->arena);
+    RendererInstanceMaterial* const materials =
+        ARENA_ALLOC(&scene->arena, RendererInstanceMaterial, instance_count);
+
+    for (u32 i = 0; i < scene->desc.material_count; i++) {
+        RendererInstanceMaterial material;
+        texture_atlas_material(atlas, entries[i], &material);
+        const u32 last = scene_material_first(scene, i + 1);
+        for (u32 j = scene_material_first(scene, i); j < last; j++)
+            materials[j] = material;
+    }
+
+    scene->materials_buffer = renderer_buffer_create(
+        renderer, RENDERER_BUFFER_VERTEX, materials,
+        sizeof(RendererInstanceMaterial) * instance_count);
+    arena_release(&scene->arena, mark);
+}
+
+void scene_create(Scene* scene, Renderer* renderer, const SceneDesc* desc) {
+    assert(desc->instance_count > 0);
+    assert(desc->material_count > 0 &&
+           desc->material_count <= SCENE_MAX_MATERIALS);
+    // The lit shaders sample a single texture
+    assert(desc->light_count <= RENDERER_MAX_LIGHTS &&
+           !(desc->light_count && desc->texture_array));
+    assert(!desc->particle_count || desc->particle_count >= SCENE_EMITTERS);
+    // The atlas materials are per instance
+    assert(!(desc->static_count && desc->texture_array));
+    assert(!desc->lod || (desc->spheres && !desc->texture_array));
+    // The levels are picked from the positions, which the graph moves
+    assert(!(desc->scene_graph && desc->lod));
+    assert(desc->moving_percent <= 100);
+    // The materials of the world are drawn one after the other
+    assert(!(desc->world_path && desc->texture_array));
+
+    memset(scene, 0, sizeof(Scene));
+    scene->desc = *desc;
+    const char* const owner =
+        resource_owner_set(desc->name ? desc->name : "scene");
+    if (!scene->desc.seed && desc->overdraw) scene->desc.seed = 1;
+    scene->scale = desc->overdraw ? 4.0f : 1.0f;
+
+    // The textures are created one after the other, they share their scratch
+    // with the vertices, uploaded before them, and the materials, after
+    const u32 instance_count = desc->instance_count;
+    const usize texture_scratch =
+        desc->texture_size ? scene_texture_row_size(desc->texture_size) *
+                                 desc->texture_size
+                           : SCENE_BMP_CAPACITY;
+    const usize materials_scratch =
+        desc->texture_array ? sizeof(RendererInstanceMaterial) * instance_count
+                            : 0;
+    const usize vertices_scratch =
+        (sizeof(MeshQuantizedPosition) + sizeof(MeshQuantizedUv)) *
+            (ARR_SIZE(cube_vertex_buffer_data) / 3) +
+        ARENA_ALIGNMENT;
+    const usize static_scratch =
+        (sizeof(mat4) + sizeof(u32)) * desc->static_count +
+        ARENA_ALIGNMENT;
+    const usize sphere_scratch =
+        desc->spheres ? scene_sphere_scratch_size() : 0;
+    const u32 pivot_count =
+        desc->scene_graph
+            ? (instance_count + SCENE_GRAPH_GROUP - 1) / SCENE_GRAPH_GROUP
+            : 0;
+    const usize models_size = desc->scene_graph
+                                  ? sizeof(vec3) * pivot_count
+                                  : sizeof(mat4) * instance_count;
+    const u32 light_count = desc->light_count;
+    // The lights of the pose follow those where the orbits start
+    arena_init(&scene->arena, "scene",
+               sizeof(vec3) * instance_count + models_size +
+                   (2 * sizeof(RendererLight) + sizeof(vec4)) * light_count +
+                   7 * ARENA_ALIGNMENT +
+                   MAX(MAX(MAX(texture_scratch, materials_scratch),
+                           MAX(vertices_scratch, sphere_scratch)),
+                       static_scratch));
+    scene->positions = ARENA_ALLOC(&scene->arena, vec3, instance_count);
+    if (desc->scene_graph) {
+        scene->pivot_count = pivot_count;
+        scene->pivots = ARENA_ALLOC(&scene->arena, vec3, pivot_count);
+    } else {
+        scene->pose.models = ARENA_ALLOC(&scene->arena, mat4, instance_count);
+    }
+    scene_positions(scene);
+    if (light_count) {
+        scene->lights = ARENA_ALLOC(&scene->arena, RendererLight, light_count);
+        scene->pose.lights =
+            ARENA_ALLOC(&scene->arena, RendererLight, light_count);
+        scene->light_orbits = ARENA_ALLOC(&scene->arena, vec4, light_count);
+        scene_lights_create(scene);
+        light_clusters_init(&scene->clusters, light_count);
+    }
+    if (desc->particle_count) {
+        scene->particles =
+            renderer_particles_create(renderer, desc->particle_count);
+        scene_emitters_create(scene);
+    }
+
+    const RendererVertexFormat vertex_format = desc->quantized_vertices
+                                                   ? RENDERER_VERTEX_QUANTIZED
+                                                   : RENDERER_VERTEX_F32;
+    if (desc->texture_array) {
+        scene->pipeline = renderer_pipeline_create(
+            renderer, "instanced_array", RENDERER_PIPELINE_INSTANCE_MATERIALS,
+            vertex_format);
+    } else {
+        scene->pipeline = renderer_pipeline_create(
+            renderer, light_count ? "instanced_lit" : "instanced",
+            RENDERER_PIPELINE_INSTANCED, vertex_format);
+    }
+    if (desc->spheres) {
+        scene_sphere_create(scene, renderer);
+    } else {
+        scene->vertex_count = ARR_SIZE(cube_vertex_buffer_data) / 3;
+        scene_vertices_create(scene, renderer, cube_vertex_buffer_data,
+                              texture_uv_buffer_data, scene->vertex_count);
+    }
+    if (desc->lod) lod_init(&scene->lod, &scene->lod_chain, instance_count);
+    if (desc->static_count)
+        scene_static_create(scene, renderer, vertex_format);
+    if (desc->world_path) scene_world_open(scene);
+    arena_reserve(&renderer->frame_arena,
+                  RENDERER_FRAME_ARENA_SIZE + scene_frame_size(scene));
+    if (desc->world_path) scene_world_create(scene, renderer);
+
+    if (desc->scene_graph) scene_graph_create(scene);
+    scene_pose(scene, 0.0f, &scene->pose);
+    scene->instances_buffer = renderer_buffer_create(
+        renderer, RENDERER_BUFFER_INSTANCE, scene->pose.models,
+        sizeof(mat4) * instance_count);
+
+    // Layers of the largest textures, the small ones are packed
+    TextureAtlas atlas;
+    TextureAtlas* const array = desc->texture_array ? &atlas : NULL;
+    if (array) texture_atlas_init(array, 0, 0, desc->material_count);
+    // Textures, or their atlas entries
+    u32 textures[SCENE_MAX_MATERIALS];
+
+    u32 state = scene->desc.seed ? scene->desc.seed : 1;
+    for (u32 i = 0; i < desc->material_count; i++) {
+        const u32 size = desc->mixed_texture_sizes && i % 2
+                             ? MAX(desc->texture_size / 4, 1)
+                             : desc->texture_size;
+        textures[i] =
+            desc->texture_size
+                ? scene_texture_generate(scene, renderer, array, size, &state)
+                : scene_texture_load(scene, renderer, array);
+    }
+
+    if (array) {
+        texture_atlas_print(array);
+        scene->texture_array = texture_atlas_upload(array, renderer);
+        scene_materials_create(scene, renderer, array, textures);
+    } else {
+        memcpy(scene->textures, textures, sizeof(textures));
+    }
+
+    resource_owner_set(owner);
+
+    printf("Created scene: name=%s instances=%u mesh=%s triangles=%u "
+           "levels=%u static=%u materials=%u lights=%u particles=%u\n",
+           desc->name ? desc->name : "default", instance_count,
+           desc->spheres ? "sphere" : "cube", scene->vertex_count / 3,
+           desc->spheres ? scene->lod_chain.level_count : 1,
+           desc->static_count, desc->material_count, light_count,
+           scene->particles ? desc->particle_count : 0);
+}
+
+void scene_destroy(Scene* scene) {
+    if (scene->desc.world_path) {
+        world_stream_print(&scene->world);
+        world_stream_close(&scene->world);
+    }
+    if (scene->desc.scene_graph) {
+        scene_graph_print(&scene->graph);
+        scene_graph_destroy(&scene->graph);
+    }
+    if (scene->desc.lod) {
+        lod_print(&scene->lod);
+        lod_destroy(&scene->lod);
+    }
+    if (scene->desc.static_count) {
+        static_batch_print(&scene->static_batch);
+        static_batch_destroy(&scene->static_batch);
+    }
+    if (scene->desc.light_count) {
+        light_clusters_print(&scene->clusters);
+        light_clusters_destroy(&scene->clusters);
+    }
+    arena_print(&scene->arena);
+    arena_destroy(&scene->arena);
+}
+
+usize scene_pose_size(const Scene* scene) {
+    return sizeof(mat4) * scene->desc.instance_count +
+           sizeof(RendererLight) * scene->desc.light_count +
+           2 * ARENA_ALIGNMENT;
+}
+
+void scene_pose_init(const Scene* scene, ScenePose* pose, Arena* arena) {
+    memset(pose, 0, sizeof(ScenePose));
+    pose->models = ARENA_ALLOC(arena, mat4, scene->desc.instance_count);
+    if (scene->desc.light_count) {
+        pose->lights =
+            ARENA_ALLOC(arena, RendererLight, scene->desc.light_count);
+    }
+}
+
+void scene_pose_copy(const Scene* scene, const ScenePose* from,
+                     ScenePose* to) {
+    to->angle = from->angle;
+    glm_vec3_copy((f32*)from->camera, to->camera);
+    memcpy(to->models, from->models,
+           sizeof(mat4) * scene->desc.instance_count);
+    if (scene->desc.light_count) {
+        memcpy(to->lights, from->lights,
+               sizeof(RendererLight) * scene->desc.light_count);
+    }
+    memcpy(to->emitters, from->emitters, sizeof(to->emitters));
+}
+
+// `count` floats from `a` to `b`
+static void scene_lerp(const f32* a, const f32* b, f32 t, usize count,
+                       f32* out) {
+    for (usize i = 0; i < count; i++) out[i] = a[i] + (b[i] - a[i]) * t;
+}
+
+// The camera only depends on the angle: over the world, it wraps around
+static void scene_camera_position(const Scene* scene, f32 angle,
+                                  vec3 camera) {
+    if (scene->desc.world_path) {
+        scene_world_camera(scene, angle, camera);
+    } else {
+        glm_vec3_copy((vec3){0.0f, 0.0f, 10.0f}, camera);
+    }
+}
+
+void scene_pose_blend(const Scene* scene, const ScenePose* from,
+                      const ScenePose* to, f32 t, ScenePose* pose) {
+    TRACE_BEGIN("scene_pose_blend");
+    pose->angle = from->angle + (to->angle - from->angle) * t;
+    scene_camera_position(scene, pose->angle, pose->camera);
+    // Close enough for the rotations of a tick, without normalizing them
+    scene_lerp((const f32*)from->models, (const f32*)to->models, t,
+               sizeof(mat4) / sizeof(f32) * scene->desc.instance_count,
+               (f32*)pose->models);
+    if (scene->desc.light_count) {
+        scene_lerp((const f32*)from->lights, (const f32*)to->lights, t,
+                   sizeof(RendererLight) / sizeof(f32) *
+                       scene->desc.light_count,
+                   (f32*)pose->lights);
+    }
+    scene_lerp((const f32*)from->emitters, (const f32*)to->emitters, t,
+               sizeof(RendererEmitter) / sizeof(f32) * SCENE_EMITTERS,
+               (f32*)pose->emitters);
+    TRACE_END();
+}
+
+void scene_update(Scene* scene) {
+    scene_pose(scene, scene->pose.angle + SCENE_ANGLE_STEP, &scene->pose);
+}
+
+void scene_pose(Scene* scene, f32 angle, ScenePose* pose) {
+    TRACE_BEGIN("scene_update");
+    pose->angle = angle;
+    if (scene->desc.scene_graph) {
+        scene_graph_pose(scene, angle, pose->models);
+    } else {
+        scene_models(scene, angle, pose->models);
+    }
+    scene_camera_position(scene, angle, pose->camera);
+    scene_lights(scene, angle, pose->lights);
+    if (scene->particles) scene_emitters(scene, angle, pose->emitters);
+    TRACE_END();
+}
+
+void scene_frame(const ScenePose* pose, const Renderer* renderer,
+                 RendererFrame* frame) {
+    glm_vec4_copy((vec4){0.0f, 0.0f, 0.0f, 1.0f}, frame->clear_color);
+
+    mat4 view, projection;
+    scene_camera(pose, renderer, view, projection);
+    glm_mat4_mul(projection, view, frame->view_projection);
+}
+
+// The chunks in view
+static void scene_static_draw(Scene* scene, const ScenePose* pose,
+                              Renderer* renderer) {
+    mat4 view, projection, view_projection;
+    scene_camera(pose, renderer, view, projection);
+    glm_mat4_mul(projection, view, view_projection);
+
+    StaticBatch* const batch = &scene->static_batch;
+    static_batch_cull(batch, view_projection);
+    for (u32 i = 0; i < batch->draw_count; i++) {
+        const StaticBatchDraw* const d = &batch->draws[i];
+        const RendererDraw draw = {
+            .pipeline = scene->pipeline,
+            .positions = batch->positions,
+            .uvs = batch->uvs,
+            .instances = batch->instances,
+            .texture = scene->textures[d->material],
+            .first_vertex = d->first_vertex,
+            .vertex_count = d->vertex_count,
+            .first_instance = d->instance,
+            .instance_count = 1,
+        };
+        renderer_draw(renderer, &draw);
+    }
+}
+
+// The chunks around the camera, those in view uploaded, a draw per material
+static void scene_world_draw(Scene* scene, const ScenePose* pose,
+                             Renderer* renderer) {
+    mat4 view, projection, view_projection;
+    scene_camera(pose, renderer, view, projection);
+    glm_mat4_mul(projection, view, view_projection);
+
+    WorldStream* const world = &scene->world;
+    world_stream_update(world, (f32*)pose->camera);
+    if (!world_stream_cull(world, view_projection, &renderer->frame_arena))
+        return;
+    renderer_buffer_update(renderer, scene->world_instances_buffer,
+                           world->models, sizeof(mat4) * world->model_count);
+    for (u32 i = 0; i < world->draw_count; i++) {
+        const WorldStreamDraw* const d = &world->draws[i];
+        const RendererDraw draw = {
+            .pipeline = scene->pipeline,
+            .positions = scene->positions_buffer,
+            .uvs = scene->uvs_buffer,
+            .instances = scene->world_instances_buffer,
+            .texture = scene->textures[d->material],
+            .vertex_count = scene->vertex_count,
+            .first_instance = d->first_instance,
+            .instance_count = d->instance_count,
+        };
+        renderer_draw(renderer, &draw);
+    }
+}
+
+// A step of the time the animation advanced since the last one
+static void scene_particles_draw(Scene* scene, const ScenePose* pose,
+                                 Renderer* renderer) {
+    const f32 steps =
+        (pose->angle - scene->particles_angle) / SCENE_ANGLE_STEP;
+    scene->particles_angle = pose->angle;
+
+    // The billboards face the camera: the first rows of the view
+    mat4 view, projection;
+    scene_camera(pose, renderer, view, projection);
+    RendererParticles particles = {
+        .emitters = pose->emitters,
+        .emitter_count = SCENE_EMITTERS,
+        .gravity = {0.0f, -9.81f, 0.0f},
+        .dt = CLAMP(steps, 0.0f, 8.0f) * SCENE_UPDATE_SECONDS,
+    };
+    for (u32 i = 0; i < 3; i++) {
+        particles.camera_right[i] = view[i][0];
+        particles.camera_up[i] = view[i][1];
+    }
+    renderer_particles_draw(renderer, &particles);
+}
+
+// The visible instances, grouped by level then by material, a draw each.
+// Only their models are uploaded.
+static void scene_lod_draw(Scene* scene, const ScenePose* pose,
+                           Renderer* renderer) {
+    mat4 view, projection;
+    scene_camera(pose, renderer, view, projection);
+    LodView camera;
+    lod_view(&camera, view, projection, renderer->height, SCENE_NEAR);
+    Arena* const frame = &renderer->frame_arena;
+    u32* const order = ARENA_ALLOC(frame, u32, scene->desc.instance_count);
+    u32 counts[LOD_MAX_LEVELS];
+    const u32 visible =
+        lod_select(&scene->lod, &camera, (const vec3*)scene->positions,
+                   scene->scale, order, counts);
+    if (!visible) return;
+
+    mat4* const models = ARENA_ALLOC(frame, mat4, visible);
+    for (u32 i = 0; i < visible; i++)
+        glm_mat4_copy(pose->models[order[i]], models[i]);
+    renderer_buffer_update(renderer, scene->instances_buffer, models,
+                           sizeof(mat4) * visible);
+
+    // Within a level the instances are in order, so are the materials
+    u32 first = 0;
+    for (u32 level = 0; level < scene->lod_chain.level_count; level++) {
+        const LodLevel* const l = &scene->lod_chain.levels[level];
+        const u32 end = first + counts[level];
+        u32 material = 0;
+        while (first < end) {
+            while (order[first] >= scene_material_first(scene, material + 1))
+                material++;
+            const u32 next = scene_material_first(scene, material + 1);
+            u32 last = first;
+            while (last < end && order[last] < next) last++;
+
+            const RendererDraw draw = {
+                .pipeline = scene->pipeline,
+                .positions = scene->positions_buffer,
+                .uvs = scene->uvs_buffer,
+                .instances = scene->instances_buffer,
+                .texture = scene->textures[material],
+                .first_vertex = l->first_index,
+                .vertex_count = l->index_count,
+                .first_instance = first,
+                .instance_count = last - first,
+            };
+            renderer_draw(renderer, &draw);
+            first = last;
+        }
+    }
+}
+
+void scene_draw(Scene* scene, const ScenePose* pose, Renderer* renderer) {
+    const u32 instance_count = scene->desc.instance_count;
+    if (!scene->desc.lod) {
+        renderer_buffer_update(renderer, scene->instances_buffer,
+                               pose->models, sizeof(mat4) * instance_count);
+    }
+
+    if (scene->desc.light_count) {
+        mat4 view, projection;
+        scene_camera(pose, renderer, view, projection);
+        RendererLights lights;
+        light_clusters_update(&scene->clusters, pose->lights,
+                              scene->desc.light_count, view,
+                              glm_rad(SCENE_FOV_Y),
+                              (f32)renderer->width / (f32)renderer->height,
+                              SCENE_NEAR, SCENE_FAR, &renderer->frame_arena,
+                              &lights);
+        renderer_lights_update(renderer, &lights);
+    }
+
+    // Every material at once, they are per instance
+    if (scene->desc.texture_array) {
+        const RendererDraw draw = {
+            .pipeline = scene->pipeline,
+            .positions = scene->positions_buffer,
+            .uvs = scene->uvs_buffer,
+            .instances = scene->instances_buffer,
+            .materials = scene->materials_buffer,
+            .texture = scene->texture_array,
+            .vertex_count = scene->vertex_count,
+            .instance_count = instance_count,
+        };
+        renderer_draw(renderer, &draw);
+    } else if (scene->desc.lod) {
+        scene_lod_draw(scene, pose, renderer);
+    } else {
+        // Contiguous ranges, one per material
+        for (u32 i = 0; i < scene->desc.material_count; i++) {
+            const u32 first = scene_material_first(scene, i);
+            const u32 last = scene_material_first(scene, i + 1);
+            if (first == last) continue;
+
+            const RendererDraw draw = {
+                .pipeline = scene->pipeline,
+                .positions = scene->positions_buffer,
+                .uvs = scene->uvs_buffer,
+                .instances = scene->instances_buffer,
+                .texture = scene->textures[i],
+                // The full mesh, e.g. 6 squares = 12 triangles = 12*3
+                // vertices for the cube
+                .vertex_count = scene->vertex_count,
+                .first_instance = first,
+                .instance_count = last - first,
+            };
+            renderer_draw(renderer, &draw);
+        }
+    }
+
+    if (scene->desc.static_count) scene_static_draw(scene, pose, renderer);
+    if (scene->desc.world_path) scene_world_draw(scene, pose, renderer);
+    if (scene->particles) scene_particles_draw(scene, pose, renderer);
+}
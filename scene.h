@@ -0,0 +1,163 @@
+#pragma once
+#include <cglm/cglm.h>
+
+#include "light_clusters.h"
+#include "lod.h"
+#include "mesh.h"
+#include "renderer.h"
+#include "scene_graph.h"
+#include "static_batch.h"
+#include "utils.h"
+#include "world_stream.h"
+
+#define SCENE_MAX_MATERIALS RENDERER_MAX_TEXTURES
+// File of resources/crate.bmp, loaded in the scene arena
+#define SCENE_BMP_CAPACITY (1 << 20)
+// Rotation of the cubes per update, in radians
+#define SCENE_ANGLE_STEP 0.01f
+// Camera, for the clusters of the lights too
+#define SCENE_FOV_Y 45.0f  // Degrees
+#define SCENE_NEAR 0.1f
+#define SCENE_FAR 100.0f
+// Fountains of particles, sharing the pool
+#define SCENE_EMITTERS 8
+// Simulated by the particles per update
+#define SCENE_UPDATE_SECONDS (1.0f / 60.0f)
+// Squares per side of every face of the spheres
+#define SCENE_SPHERE_SUBDIVISIONS 16
+// Instances per pivot of the scene graph, on a circle of SCENE_GRAPH_RADIUS
+#define SCENE_GRAPH_GROUP 16
+#define SCENE_GRAPH_RADIUS 2.0f
+// With a world: the camera flies this many units per unit of the animation
+// angle, at this height, and the chunks within SCENE_FAR are streamed
+#define SCENE_WORLD_SPEED 300.0f
+#define SCENE_WORLD_HEIGHT 4.0f
+#define SCENE_WORLD_BUDGET_MB 64
+
+// What to generate. Everything derives from these fields so a scene is the
+// same on every run and every backend.
+typedef struct {
+    const char* name;
+    u32 instance_count;
+    // Seed of the random layout, 0 for the 10 cubes of the original scene
+    // followed by a grid of cubes behind them
+    u32 seed;
+    // Every material is a texture and a draw call over a contiguous range of
+    // instances
+    u32 material_count;
+    // 0 for resources/crate.bmp, otherwise generated square textures
+    u32 texture_size;
+    // Odd materials are generated at a quarter of texture_size
+    _Bool mixed_texture_sizes;
+    // Every texture in one texture array (texture_atlas.h), all the
+    // materials drawn in a single call with a material per instance
+    _Bool texture_array;
+    // Compressed vertices (mesh.h)
+    _Bool quantized_vertices;
+    // Spheres instead of cubes (mesh_sphere), simplified into levels of
+    // detail (lod.h)
+    _Bool spheres;
+    // With spheres: the level of every instance picked per frame from its
+    // error on screen, the instances out of view culled. Otherwise they are
+    // all drawn at full detail. Not with texture_array.
+    _Bool lod;
+    // Point lights circling through the scene, with clustered shading
+    // (light_clusters.h), at most RENDERER_MAX_LIGHTS. 0 draws unlit.
+    u32 light_count;
+    // GPU particles from SCENE_EMITTERS fountains, from SCENE_EMITTERS to
+    // RENDERER_MAX_PARTICLES, when the backend has them. 0 for none.
+    u32 particle_count;
+    // Cubes which never move, besides the instances: baked per material
+    // into world space chunks (static_batch.h), a draw per group of visible
+    // chunks. Not with texture_array.
+    u32 static_count;
+    // Screen filling cubes stacked back to front, every layer passes the
+    // depth test
+    _Bool overdraw;
+    // The instances are children of pivots in a scene graph
+    // (scene_graph.h), SCENE_GRAPH_GROUP around each pivot. Only
+    // `moving_percent` of the pivots turn, with their children, the other
+    // instances cost nothing per update. Not with lod.
+    _Bool scene_graph;
+    u32 moving_percent;
+    // World file (world_file.h) streamed around the camera (world_stream.h),
+    // besides the instances, the camera flying over it. Its chunks take at
+    // most `world_budget_mb`, SCENE_WORLD_BUDGET_MB when 0. Not with
+    // texture_array.
+    const char* world_path;
+    u32 world_budget_mb;
+} SceneDesc;
+
+// What the animation moves, set by scene_pose. A scene can pose several,
+// e.g. the snapshots of the simulation thread (sim.h), the draws only read
+// them.
+typedef struct {
+    f32 angle;
+    vec3 camera;  // Looking down -z
+    mat4* models;  // Per instance
+    RendererLight* lights;
+    RendererEmitter emitters[SCENE_EMITTERS];
+} ScenePose;
+
+typedef struct {
+    SceneDesc desc;
+    // Everything below, sized from the description and freed at once
+    Arena arena;
+    vec3* positions;
+    f32 scale;
+    // Of scene_update. With scene_graph, its models are the world matrices
+    // of the instance nodes.
+    ScenePose pose;
+    // Of the mesh, with quantized vertices
+    MeshBounds bounds;
+    u32 vertex_count;  // Of the mesh at full detail
+    // With spheres, the levels follow each other in the vertex buffers
+    LodChain lod_chain;
+    // With lod
+    Lod lod;
+    RendererLight* lights;  // Where the orbits start
+    vec4* light_orbits;  // Center, radius
+    LightClusters clusters;
+    StaticBatch static_batch;
+    // Created by the backend
+    _Bool particles;
+    RendererEmitter emitters[SCENE_EMITTERS];  // Not swaying
+    f32 particles_angle;  // Of the last step
+    // With scene_graph: the pivots are its first nodes, the instances follow
+    SceneGraph graph;
+    vec3* pivots;
+    u32 pivot_count;
+    // With world_path
+    WorldStream world;
+
+    RendererPipeline pipeline;
+    RendererBuffer positions_buffer, uvs_buffer, instances_buffer;
+    RendererBuffer world_instances_buffer;
+    RendererTexture textures[SCENE_MAX_MATERIALS];
+    // With texture_array, instead of the textures
+    RendererBuffer materials_buffer;
+    RendererTexture texture_array;
+} Scene;
+
+void scene_create(Scene* scene, Renderer* renderer, const SceneDesc* desc);
+void scene_destroy(Scene* scene);
+
+// Of the buffers of a pose
+usize scene_pose_size(const Scene* scene);
+void scene_pose_init(const Scene* scene, ScenePose* pose, Arena* arena);
+void scene_pose_copy(const Scene* scene, const ScenePose* from,
+                     ScenePose* to);
+// Sets `pose` between `from` and `to`, `t` from 0 to 1, e.g. between two
+// ticks of the simulation. Only reads the scene, from any thread.
+void scene_pose_blend(const Scene* scene, const ScenePose* from,
+                      const ScenePose* to, f32 t, ScenePose* pose);
+// Advances the pose of the scene by one step
+void scene_update(Scene* scene);
+// Sets `pose` to the animation at `angle`. With scene_graph, the graph of
+// the scene is updated too: a single thread poses a scene.
+void scene_pose(Scene* scene, f32 angle, ScenePose* pose);
+// Camera and clear color
+void scene_frame(const ScenePose* pose, const Renderer* renderer,
+                 RendererFrame* frame);
+// Between frame begin and submit, uploads the models of `pose`
+void scene_draw(Scene* scene, const ScenePose* pose, Renderer* renderer);
@@ -0,0 +1,119 @@
+#include "scene_graph.h"
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdio.h>
+
+#include "trace.h"
+
+// Above this share of the graph flagged, the pass walks every flag
+#define SCENE_GRAPH_SORT_LIMIT 8
+
+void scene_graph_init(SceneGraph* graph, u32 capacity) {
+    memset(graph, 0, sizeof(SceneGraph));
+    graph->capacity = capacity;
+    arena_init(&graph->arena, "scene_graph",
+               (sizeof(u32) * 4 + sizeof(mat4) * 2 + sizeof(u8)) * capacity +
+                   7 * ARENA_ALIGNMENT);
+    graph->parents = ARENA_ALLOC(&graph->arena, u32, capacity);
+    graph->first_children = ARENA_ALLOC(&graph->arena, u32, capacity);
+    graph->child_counts = ARENA_ALLOC(&graph->arena, u32, capacity);
+    graph->locals = ARENA_ALLOC(&graph->arena, mat4, capacity);
+    graph->worlds = ARENA_ALLOC(&graph->arena, mat4, capacity);
+    graph->dirty = ARENA_ALLOC(&graph->arena, u8, capacity);
+    graph->updates = ARENA_ALLOC(&graph->arena, u32, capacity);
+}
+
+void scene_graph_destroy(SceneGraph* graph) {
+    arena_print(&graph->arena);
+    arena_destroy(&graph->arena);
+}
+
+u32 scene_graph_add(SceneGraph* graph, u32 parent, mat4 local) {
+    assert(graph->count < graph->capacity);
+    const u32 node = graph->count++;
+    if (parent != SCENE_GRAPH_ROOT) {
+        assert(parent < node);
+        // Right after the siblings
+        if (graph->child_counts[parent] == 0)
+            graph->first_children[parent] = node;
+        assert(graph->first_children[parent] + graph->child_counts[parent] ==
+               node);
+        graph->child_counts[parent] += 1;
+    }
+
+    graph->parents[node] = parent;
+    graph->first_children[node] = 0;
+    graph->child_counts[node] = 0;
+    graph->dirty[node] = false;
+    scene_graph_set_local(graph, node, local);
+    return node;
+}
+
+void scene_graph_set_local(SceneGraph* graph, u32 node, mat4 local) {
+    assert(node < graph->count);
+    glm_mat4_copy(local, graph->locals[node]);
+    if (graph->dirty[node]) return;
+    graph->dirty[node] = true;
+    graph->updates[graph->update_count++] = node;
+}
+
+static int scene_graph_node_compare(const void* a, const void* b) {
+    const u32 x = *(const u32*)a, y = *(const u32*)b;
+    return (x > y) - (x < y);
+}
+
+static void scene_graph_world(SceneGraph* graph, u32 node) {
+    const u32 parent = graph->parents[node];
+    if (parent == SCENE_GRAPH_ROOT) {
+        glm_mat4_copy(graph->locals[node], graph->worlds[node]);
+    } else {
+        glm_mat4_mul(graph->worlds[parent], graph->locals[node],
+                     graph->worlds[node]);
+    }
+    graph->dirty[node] = false;
+}
+
+void scene_graph_update(SceneGraph* graph) {
+    TRACE_BEGIN("scene_graph_update");
+    // Descendants of the dirty nodes, appended to the list as it is walked.
+    // Those already flagged are already in it.
+    for (u32 i = 0; i < graph->update_count; i++) {
+        const u32 node = graph->updates[i];
+        const u32 first = graph->first_children[node];
+        const u32 last = first + graph->child_counts[node];
+        for (u32 child = first; child < last; child++) {
+            if (graph->dirty[child]) continue;
+            graph->dirty[child] = true;
+            graph->updates[graph->update_count++] = child;
+        }
+    }
+
+    // Parents before their children
+    const u32 updated = graph->update_count;
+    if (updated * SCENE_GRAPH_SORT_LIMIT > graph->count) {
+        for (u32 node = 0; node < graph->count; node++)
+            if (graph->dirty[node]) scene_graph_world(graph, node);
+    } else {
+        qsort(graph->updates, updated, sizeof(u32),
+              scene_graph_node_compare);
+        for (u32 i = 0; i < updated; i++)
+            scene_graph_world(graph, graph->updates[i]);
+    }
+
+    graph->update_count = 0;
+    graph->update_calls += 1;
+    graph->total_updated += updated;
+    graph->max_updated = MAX(graph->max_updated, updated);
+    TRACE_END();
+}
+
+void scene_graph_print(const SceneGraph* graph) {
+    const f64 updates =
+        graph->update_calls ? (f64)graph->update_calls : 1.0;
+    const f64 updated = (f64)graph->total_updated / updates;
+    printf("Scene graph: nodes=%u updates=%" PRIu64
+           " updated_mean=%.1f updated_max=%u updated_share=%.2f%%\n",
+           graph->count, graph->update_calls, updated, graph->max_updated,
+           graph->count ? updated * 100.0 / (f64)graph->count : 0.0);
+}
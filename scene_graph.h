@@ -0,0 +1,49 @@
+#pragma once
+#include <cglm/cglm.h>
+
+#include "allocator.h"
+#include "utils.h"
+
+// Hierarchy of transforms in flat arrays: a node is an index, its parent
+// always comes before it, and the children of a node follow each other.
+// Local and world matrices are in arrays of their own, the worlds of
+// consecutive nodes can be uploaded as they are.
+//
+// Changing a local matrix flags its node dirty. An update flags the
+// descendants of the dirty nodes, then recomputes the world matrices of the
+// flagged nodes in index order, parents first, in one pass. Nodes which did
+// not move cost nothing: an update is proportional to the moving subtrees,
+// not to the size of the graph. When most of the graph moved, the pass
+// walks every flag instead of sorting the flagged nodes.
+
+#define SCENE_GRAPH_ROOT UINT32_MAX
+
+typedef struct {
+    Arena arena;
+    u32 capacity, count;
+    u32* parents;  // SCENE_GRAPH_ROOT for the roots
+    u32* first_children;
+    u32* child_counts;
+    mat4* locals;
+    mat4* worlds;
+    u8* dirty;  // To recompute on the next update
+    u32* updates;  // Dirty nodes, then their descendants
+    u32 update_count;
+
+    // Since the init
+    u64 update_calls;
+    u64 total_updated;
+    u32 max_updated;
+} SceneGraph;
+
+void scene_graph_init(SceneGraph* graph, u32 capacity);
+void scene_graph_destroy(SceneGraph* graph);
+// Appends a node, dirty. `parent` is a node already added, or
+// SCENE_GRAPH_ROOT; the children of a node must be added one after the
+// other.
+u32 scene_graph_add(SceneGraph* graph, u32 parent, mat4 local);
+void scene_graph_set_local(SceneGraph* graph, u32 node, mat4 local);
+// World matrices of the dirty nodes and of their descendants
+void scene_graph_update(SceneGraph* graph);
+// Nodes recomputed per update against the size of the graph
+void scene_graph_print(const SceneGraph* graph);
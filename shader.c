@@ -7,20 +7,26 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "gl_calls.h"
+#include "trace.h"
 #include "utils.h"
 
-#define BUFFER_CAPACITY 1000
+// Of the largest shader source, and of the logs
+#define BUFFER_CAPACITY 8192
 static u8 buffer[BUFFER_CAPACITY] = "";
 
 static void shader_compile(GLuint shader_id, const char path[]) {
     usize shader_src_len = 0;
 
+    TRACE_BEGIN("shader_read");
     if (file_read(path, buffer, BUFFER_CAPACITY, &shader_src_len) != 0) {
         exit(errno);
     }
     nul_terminate(buffer, shader_src_len);
     shader_src_len += 1;
+    TRACE_END();
 
+    TRACE_BEGIN("shader_compile");
     // Load
     const GLchar* buffer_ptr = (const GLchar*)&buffer;
     glShaderSource(shader_id, 1, &buffer_ptr, NULL);
@@ -47,20 +53,12 @@ static void shader_compile(GLuint shader_id, const char path[]) {
                 buffer);
         exit(1);
     }
+    TRACE_END();
 }
 
-GLuint shader_load(const char vertex_file_path[],
-                   const char fragment_file_path[]) {
-    const GLuint vertex_shader_id = glCreateShader(GL_VERTEX_SHADER);
-    const GLuint fragment_shader_id = glCreateShader(GL_FRAGMENT_SHADER);
-
-    shader_compile(vertex_shader_id, vertex_file_path);
-    shader_compile(fragment_shader_id, fragment_file_path);
-
-    // Link
-    const GLuint program_id = glCreateProgram();
-    glAttachShader(program_id, vertex_shader_id);
-    glAttachShader(program_id, fragment_shader_id);
+// Links then checks the program, the shaders are released
+static void shader_link(GLuint program_id, const GLuint shader_ids[],
+                        u32 shader_count) {
     glLinkProgram(program_id);
 
     // Check for link errors
@@ -80,11 +78,47 @@ GLuint shader_load(const char vertex_file_path[],
         exit(1);
     }
 
-    glDetachShader(program_id, vertex_shader_id);
-    glDetachShader(program_id, fragment_shader_id);
+    for (u32 i = 0; i < shader_count; i++) {
+        glDetachShader(program_id, shader_ids[i]);
+        glDeleteShader(shader_ids[i]);
+    }
+}
+
+GLuint shader_load(const char vertex_file_path[],
+                   const char fragment_file_path[]) {
+    TRACE_BEGIN("shader_load");
+    const GLuint shader_ids[2] = {
+        glCreateShader(GL_VERTEX_SHADER),
+        glCreateShader(GL_FRAGMENT_SHADER),
+    };
+
+    shader_compile(shader_ids[0], vertex_file_path);
+    shader_compile(shader_ids[1], fragment_file_path);
+
+    // Link
+    const GLuint program_id = glCreateProgram();
+    glAttachShader(program_id, shader_ids[0]);
+    glAttachShader(program_id, shader_ids[1]);
+    shader_link(program_id, shader_ids, 2);
+
+    TRACE_END();
+    return program_id;
+}
 
-    glDeleteShader(vertex_shader_id);
-    glDeleteShader(fragment_shader_id);
+GLuint shader_load_feedback(const char vertex_file_path[],
+                            const char* const varyings[],
+                            u32 varying_count) {
+    TRACE_BEGIN("shader_load_feedback");
+    const GLuint shader_id = glCreateShader(GL_VERTEX_SHADER);
+    shader_compile(shader_id, vertex_file_path);
+
+    // The outputs to capture are chosen before linking
+    const GLuint program_id = glCreateProgram();
+    glAttachShader(program_id, shader_id);
+    glTransformFeedbackVaryings(program_id, (GLsizei)varying_count,
+                                varyings, GL_INTERLEAVED_ATTRIBS);
+    shader_link(program_id, &shader_id, 1);
 
+    TRACE_END();
     return program_id;
 }
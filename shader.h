@@ -1,7 +1,11 @@
 #pragma once
-#define GL_SILENCE_DEPRECATION 1
-
-#include <OpenGL/gl3.h>
+#include "opengl.h"
+#include "utils.h"
 
 GLuint shader_load(const char vertex_file_path[],
                    const char fragment_file_path[]);
+// Vertex shader only, its `varyings` are written interleaved to the
+// transform feedback buffer
+GLuint shader_load_feedback(const char vertex_file_path[],
+                            const char* const varyings[],
+                            u32 varying_count);
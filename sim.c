@@ -0,0 +1,129 @@
+#include "sim.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "trace.h"
+
+// In `shared`, the slot holds a snapshot the render thread has not seen
+#define SIM_FRESH 4
+
+static void sim_publish(Sim* sim) {
+    i32 shared;
+    do {
+        shared = SDL_AtomicGet(&sim->shared);
+    } while (!SDL_AtomicCAS(&sim->shared, shared, (i32)sim->back | SIM_FRESH));
+
+    // The previous shared slot becomes the back one, entirely posed again
+    sim->published = sim->back;
+    sim->back = (u32)shared & ~(u32)SIM_FRESH;
+}
+
+static int sim_thread(void* data) {
+    Sim* const sim = data;
+    trace_thread_name("simulation");
+
+    u64 next = sim->slots[sim->back].time + sim->tick_duration;
+    while (SDL_AtomicGet(&sim->running)) {
+        const u64 now = SDL_GetPerformanceCounter();
+        if (now < next) {
+            const u64 ms =
+                (next - now) * 1000 / SDL_GetPerformanceFrequency();
+            SDL_Delay(ms > 0 ? (u32)ms : 0);
+            continue;
+        }
+        if (now - next > sim->tick_duration * SIM_MAX_CATCH_UP_TICKS)
+            next = now;
+
+        TRACE_BEGIN("sim_tick");
+        const i32 rotations = SDL_AtomicSet(&sim->pending_rotations, 0);
+
+        sim->tick += 1;
+        sim->angle += SCENE_ANGLE_STEP + SIM_ROTATION * (f32)rotations;
+
+        SimState* const state = &sim->slots[sim->back];
+        state->tick = sim->tick;
+        state->time = next;
+        scene_pose_copy(sim->scene, &sim->slots[sim->published].pose,
+                        &state->previous);
+        scene_pose(sim->scene, sim->angle, &state->pose);
+        sim_publish(sim);
+        TRACE_END();
+
+        next += sim->tick_duration;
+    }
+    return 0;
+}
+
+void sim_start(Sim* sim, Scene* scene) {
+    memset(sim, 0, sizeof(Sim));
+    sim->scene = scene;
+    sim->angle = scene->pose.angle;
+
+    const char* const tick_rate_env = getenv("TICK_RATE");
+    u64 tick_rate =
+        tick_rate_env ? strtoull(tick_rate_env, NULL, 10) : 0;
+    if (tick_rate == 0) tick_rate = SIM_DEFAULT_TICK_RATE;
+    sim->tick_duration = SDL_GetPerformanceFrequency() / tick_rate;
+
+    // Every slot at the pose of the scene, the render thread draws it until
+    // the first tick
+    arena_init(&sim->arena, "simulation", 7 * scene_pose_size(scene));
+    const u64 now = SDL_GetPerformanceCounter();
+    for (u32 i = 0; i < 3; i++) {
+        SimState* const state = &sim->slots[i];
+        state->time = now;
+        scene_pose_init(scene, &state->previous, &sim->arena);
+        scene_pose_init(scene, &state->pose, &sim->arena);
+        scene_pose(scene, sim->angle, &state->pose);
+        scene_pose_copy(scene, &state->pose, &state->previous);
+    }
+    scene_pose_init(scene, &sim->blended, &sim->arena);
+    sim->back = 0;
+    SDL_AtomicSet(&sim->shared, 1);
+    sim->front = 2;
+    sim->published = 1;
+
+    SDL_AtomicSet(&sim->running, 1);
+    sim->thread = SDL_CreateThread(sim_thread, "simulation", sim);
+    if (!sim->thread) {
+        fprintf(stderr, "SDL_CreateThread failed: %s\n", SDL_GetError());
+        exit(1);
+    }
+    printf("Simulation: tick_rate=%" PRIu64 "\n", tick_rate);
+}
+
+void sim_stop(Sim* sim) {
+    SDL_AtomicSet(&sim->running, 0);
+    SDL_WaitThread(sim->thread, NULL);
+    sim->thread = NULL;
+    arena_print(&sim->arena);
+    arena_destroy(&sim->arena);
+}
+
+void sim_rotate(Sim* sim) { SDL_AtomicAdd(&sim->pending_rotations, 1); }
+
+static const SimState* sim_latest(Sim* sim) {
+    if (SDL_AtomicGet(&sim->shared) & SIM_FRESH) {
+        // Retried when the simulation publishes meanwhile
+        i32 shared;
+        do {
+            shared = SDL_AtomicGet(&sim->shared);
+        } while (!SDL_AtomicCAS(&sim->shared, shared, (i32)sim->front));
+        sim->front = (u32)shared & ~(u32)SIM_FRESH;
+    }
+    return &sim->slots[sim->front];
+}
+
+const ScenePose* sim_interpolate(Sim* sim, u64 now) {
+    const SimState* const state = sim_latest(sim);
+    f32 t = 1.0f;
+    if (now < state->time + sim->tick_duration) {
+        t = now > state->time ? (f32)(now - state->time) /
+                                    (f32)sim->tick_duration
+                              : 0.0f;
+    }
+    scene_pose_blend(sim->scene, &state->previous, &state->pose, t,
+                     &sim->blended);
+    return &sim->blended;
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include <SDL2/SDL.h>
+
+#include "allocator.h"
+#include "scene.h"
+#include "utils.h"
+
+// Simulation on its own thread at a fixed tick rate, independent of the
+// frame rate. Every tick poses the scene (scene_pose): the model matrices,
+// lights and camera are computed on the simulation thread, while the render
+// thread draws the previous tick. Each tick publishes an immutable snapshot
+// through a triple buffer: the simulation writes into its back slot and
+// swaps it with the shared one, the render thread swaps the shared one with
+// its front slot when a newer snapshot is there. Neither waits for the
+// other.
+//
+// A snapshot holds the poses of its tick and of the one before. Frames
+// blend them by how far they are into the tick (scene_pose_blend), so the
+// motion stays smooth at any frame rate, one tick behind the simulation.
+// The slots take 2 poses each and the render thread one more, 7 model
+// matrices per instance.
+
+// Ticks per second, overridden by `TICK_RATE=<hz>`
+#define SIM_DEFAULT_TICK_RATE 60
+// Behind by more ticks, e.g. after a stop in the debugger, the simulation
+// skips them instead of catching up
+#define SIM_MAX_CATCH_UP_TICKS 8
+// Turn of `sim_rotate`, in radians
+#define SIM_ROTATION 0.2f
+
+typedef struct {
+    u64 tick;
+    u64 time;  // Performance counter, when the tick was due
+    ScenePose previous;  // Of the tick before
+    ScenePose pose;
+} SimState;
+
+typedef struct {
+    // Posed by the simulation thread only, from the start to the stop, the
+    // blends only read it
+    Scene* scene;
+    Arena arena;  // Of the poses of the slots
+
+    // Slots are owned by the simulation (back), the render thread (front),
+    // and whoever swaps next (shared)
+    SimState slots[3];
+    SDL_atomic_t shared;  // Slot index, with SIM_FRESH until taken
+    u32 back, front;
+    // Of the last tick, read by the simulation for the next one. It is
+    // shared or front, both threads only read it.
+    u32 published;
+    ScenePose blended;  // Of the render thread
+
+    // Of the simulation thread
+    u64 tick;
+    f32 angle;
+
+    u64 tick_duration;  // In performance counter units
+    SDL_atomic_t running;
+    // Input, applied on the next tick
+    SDL_atomic_t pending_rotations;
+    SDL_Thread* thread;
+} Sim;
+
+// Starts from the pose of the scene
+void sim_start(Sim* sim, Scene* scene);
+void sim_stop(Sim* sim);
+
+// Turns the scene on the next tick, from any thread
+void sim_rotate(Sim* sim);
+// The latest snapshot blended at `now` (performance counter), from the
+// render thread. It stays valid until the next call.
+const ScenePose* sim_interpolate(Sim* sim, u64 now);
@@ -0,0 +1,24 @@
+#pragma once
+#include <string.h>
+
+#include "utils.h"
+
+// 4 lanes, compiled to SSE or NEON through the compiler vector extensions
+typedef f32 SimdF32x4 __attribute__((vector_size(16)));
+typedef i32 SimdI32x4 __attribute__((vector_size(16)));
+
+static inline SimdF32x4 simd_load(const f32* values) {
+    SimdF32x4 v;
+    memcpy(&v, values, sizeof(v));
+    return v;
+}
+
+static inline SimdF32x4 simd_splat(f32 value) {
+    return (SimdF32x4){value, value, value, value};
+}
+
+// Lanes of `a` where `mask` is set, else of `b`
+static inline SimdF32x4 simd_select(SimdI32x4 mask, SimdF32x4 a,
+                                    SimdF32x4 b) {
+    return (SimdF32x4)((mask & (SimdI32x4)a) | (~mask & (SimdI32x4)b));
+}
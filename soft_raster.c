@@ -0,0 +1,573 @@
+#include "soft_raster.h"
+
+#include <assert.h>
+#include <stdio.h>
+
+#include "mesh.h"
+#include "simd.h"
+#include "trace.h"
+
+// Outcodes of the clip space planes
+#define SOFT_RASTER_NEAR (1u << 4)
+
+// Clip space, after the model view projection
+typedef struct {
+    vec4 position;
+    f32 u, v;
+} SoftRasterVertex;
+
+// a * x + b * y + c, at the pixels of `x` on the row `y`, from the origin
+// of the triangle
+static SimdF32x4 soft_raster_plane(const f32* plane, SimdF32x4 x, f32 y) {
+    return simd_splat(plane[0]) * x + simd_splat(plane[1] * y + plane[2]);
+}
+
+static SimdF32x4 soft_raster_clamp(SimdF32x4 v, f32 min, f32 max) {
+    const SimdF32x4 low = simd_splat(min);
+    const SimdF32x4 high = simd_splat(max);
+    v = simd_select(v < low, low, v);
+    return simd_select(v > high, high, v);
+}
+
+// Texels of 4 coordinates, mirrored every other repeat or clamped
+static SimdI32x4 soft_raster_texels(SimdF32x4 t, u32 size, _Bool clamp) {
+    if (!clamp) {
+        // 1 - |2 * fract(t / 2) - 1|, bounded before the conversions, the
+        // texture repeats long before
+        const SimdF32x4 half =
+            soft_raster_clamp(t * simd_splat(0.5f), -1e6f, 1e6f);
+        SimdF32x4 whole = __builtin_convertvector(
+            __builtin_convertvector(half, SimdI32x4), SimdF32x4);
+        // Truncated towards 0, floored
+        whole -= simd_select(whole > half, simd_splat(1.0f), simd_splat(0.0f));
+        const SimdF32x4 folded =
+            simd_splat(2.0f) * (half - whole) - simd_splat(1.0f);
+        const SimdI32x4 abs_mask = {INT32_MAX, INT32_MAX, INT32_MAX,
+                                    INT32_MAX};
+        t = simd_splat(1.0f) - (SimdF32x4)((SimdI32x4)folded & abs_mask);
+    }
+    t = soft_raster_clamp(t, 0.0f, 1.0f);
+
+    const SimdI32x4 texels =
+        __builtin_convertvector(t * simd_splat((f32)size), SimdI32x4);
+    const i32 last = (i32)size - 1;
+    const SimdI32x4 lasts = {last, last, last, last};
+    return ((texels > lasts) & lasts) | ((texels <= lasts) & texels);
+}
+
+// Indices of the texels of 4 pixels in the texture of the triangle
+static SimdI32x4 soft_raster_sample(const SoftRasterTriangle* triangle,
+                                    SimdF32x4 u, SimdF32x4 v) {
+    const SoftTexture* const texture = triangle->texture;
+    const SimdI32x4 x = soft_raster_texels(u, texture->width, texture->clamp);
+    const SimdI32x4 y = soft_raster_texels(v, texture->height, texture->clamp);
+    const i32 width = (i32)texture->width;
+    const i32 first_row = (i32)(triangle->layer * texture->height);
+    return (y + first_row) * width + x;
+}
+
+static void soft_raster_vertex(const SoftRasterDraw* draw,
+                               const SoftRasterWorker* worker, u32 vertex,
+                               SoftRasterVertex* out) {
+    vec4 position = {0.0f, 0.0f, 0.0f, 1.0f};
+    f32 uv[2];
+    if (draw->quantized) {
+        const MeshQuantizedPosition* const p =
+            (const MeshQuantizedPosition*)draw->positions + vertex;
+        const MeshQuantizedUv* const q =
+            (const MeshQuantizedUv*)draw->uvs + vertex;
+        // Like the normalized attributes of OpenGL
+        for (u32 i = 0; i < 3; i++)
+            position[i] = MAX((f32)p->xyzw[i] / 32767.0f, -1.0f);
+        for (u32 i = 0; i < 2; i++) uv[i] = (f32)q->uv[i] / 65535.0f;
+    } else {
+        memcpy(position, (const f32*)draw->positions + 3 * (usize)vertex,
+               sizeof(vec3));
+        memcpy(uv, (const f32*)draw->uvs + 2 * (usize)vertex, sizeof(uv));
+    }
+
+    glm_mat4_mulv((vec4*)worker->model_view_projection, position,
+                  out->position);
+    out->u = uv[0] * worker->uv_rect[2] + worker->uv_rect[0];
+    out->v = uv[1] * worker->uv_rect[3] + worker->uv_rect[1];
+}
+
+static u32 soft_raster_outcode(const vec4 p) {
+    return (u32)(p[0] < -p[3]) | (u32)(p[0] > p[3]) << 1 |
+           (u32)(p[1] < -p[3]) << 2 | (u32)(p[1] > p[3]) << 3 |
+           (u32)(p[2] < -p[3]) << 4 | (u32)(p[2] > p[3]) << 5;
+}
+
+static void soft_raster_bin(SoftRasterWorker* worker, u32 tile,
+                            u32 triangle) {
+    u32 block = worker->tails[tile];
+    if (block == UINT32_MAX ||
+        worker->blocks[block].count == SOFT_RASTER_BLOCK) {
+        assert(worker->block_count < worker->block_capacity);
+        const u32 next = worker->block_count++;
+        worker->blocks[next].next = UINT32_MAX;
+        worker->blocks[next].count = 0;
+        if (block == UINT32_MAX)
+            worker->heads[tile] = next;
+        else
+            worker->blocks[block].next = next;
+        worker->tails[tile] = block = next;
+    }
+    SoftRasterBlock* const b = &worker->blocks[block];
+    b->triangles[b->count++] = triangle;
+}
+
+// Plane of the values at the vertices, from the edges and twice the area,
+// anchored on the first vertex
+static void soft_raster_setup_plane(const SoftRasterTriangle* triangle,
+                                    f32 inv_area, const f32* x, const f32* y,
+                                    const f32* values, f32* plane) {
+    for (u32 i = 0; i < 2; i++) {
+        plane[i] = (triangle->edges[0][i] * values[0] +
+                    triangle->edges[1][i] * values[1] +
+                    triangle->edges[2][i] * values[2]) *
+                   inv_area;
+    }
+    plane[2] = values[0] - plane[0] * x[0] - plane[1] * y[0];
+}
+
+// Window coordinates, y down, then bins the triangle if it faces the camera
+// and covers pixel centers
+static void soft_raster_setup(SoftRaster* raster, SoftRasterWorker* worker,
+                              const SoftRasterVertex* v0,
+                              const SoftRasterVertex* v1,
+                              const SoftRasterVertex* v2) {
+    const SoftRasterVertex* const vertices[3] = {v0, v1, v2};
+    const f32 width = (f32)raster->width, height = (f32)raster->height;
+    f32 x[3], y[3], depth[3], inv_w[3], u[3], v[3];
+    for (u32 i = 0; i < 3; i++) {
+        const f32* const p = vertices[i]->position;
+        inv_w[i] = 1.0f / p[3];
+        x[i] = (p[0] * inv_w[i] * 0.5f + 0.5f) * width;
+        y[i] = (0.5f - p[1] * inv_w[i] * 0.5f) * height;
+        depth[i] = p[2] * inv_w[i] * 0.5f + 0.5f;
+        u[i] = vertices[i]->u * inv_w[i];
+        v[i] = vertices[i]->v * inv_w[i];
+    }
+
+    // Twice the area, positive for the front faces: counter clockwise in
+    // normalized device coordinates, clockwise once y points down. Also
+    // false for NaNs.
+    const f32 area = (x[2] - x[0]) * (y[1] - y[0]) -
+                     (x[1] - x[0]) * (y[2] - y[0]);
+    if (!(area > 0.0f)) {
+        worker->culled += 1;
+        return;
+    }
+
+    // Pixel centers within the bounds, in the frame
+    const f32 min_x = MIN(MIN(x[0], x[1]), x[2]);
+    const f32 max_x = MAX(MAX(x[0], x[1]), x[2]);
+    const f32 min_y = MIN(MIN(y[0], y[1]), y[2]);
+    const f32 max_y = MAX(MAX(y[0], y[1]), y[2]);
+    const f32 first_x = MAX(ceilf(min_x - 0.5f), 0.0f);
+    const f32 last_x = MIN(floorf(max_x - 0.5f), width - 1.0f);
+    const f32 first_y = MAX(ceilf(min_y - 0.5f), 0.0f);
+    const f32 last_y = MIN(floorf(max_y - 0.5f), height - 1.0f);
+    if (first_x > last_x || first_y > last_y) {
+        worker->culled += 1;
+        return;
+    }
+
+    SoftRasterTriangle* const triangle =
+        &worker->triangles[worker->triangle_count];
+    triangle->min_x = (u16)first_x;
+    triangle->max_x = (u16)last_x;
+    triangle->min_y = (u16)first_y;
+    triangle->max_y = (u16)last_y;
+    triangle->texture = raster->draw->texture;
+    triangle->layer = worker->layer;
+    triangle->origin[0] = first_x;
+    triangle->origin[1] = first_y;
+    for (u32 i = 0; i < 3; i++) {
+        x[i] -= first_x;
+        y[i] -= first_y;
+    }
+
+    // Edge i is opposite to vertex i, where it is `area`
+    triangle->top_left = 0;
+    for (u32 i = 0; i < 3; i++) {
+        const u32 a = (i + 1) % 3, b = (i + 2) % 3;
+        f32* const edge = triangle->edges[i];
+        // The opposite of the same edge in the neighbor triangle, exactly
+        // when both have the same origin
+        edge[0] = y[b] - y[a];
+        edge[1] = x[a] - x[b];
+        edge[2] = x[b] * y[a] - x[a] * y[b];
+        // Inside to the right, or below a horizontal edge
+        if (edge[0] > 0.0f || (edge[0] == 0.0f && edge[1] > 0.0f))
+            triangle->top_left |= (u8)(1u << i);
+    }
+
+    const f32 inv_area = 1.0f / area;
+    soft_raster_setup_plane(triangle, inv_area, x, y, depth,
+                            triangle->depth);
+    soft_raster_setup_plane(triangle, inv_area, x, y, inv_w,
+                            triangle->inv_w);
+    soft_raster_setup_plane(triangle, inv_area, x, y, u, triangle->u);
+    soft_raster_setup_plane(triangle, inv_area, x, y, v, triangle->v);
+
+    const u32 index = worker->triangle_count++;
+    const u32 tile_x0 = triangle->min_x / SOFT_RASTER_TILE;
+    const u32 tile_x1 = triangle->max_x / SOFT_RASTER_TILE;
+    const u32 tile_y0 = triangle->min_y / SOFT_RASTER_TILE;
+    const u32 tile_y1 = triangle->max_y / SOFT_RASTER_TILE;
+    for (u32 tile_y = tile_y0; tile_y <= tile_y1; tile_y++) {
+        for (u32 tile_x = tile_x0; tile_x <= tile_x1; tile_x++)
+            soft_raster_bin(worker, tile_y * raster->tiles_x + tile_x, index);
+    }
+    worker->binned += 1;
+}
+
+// Triangle `triangle` of the current instance of the worker
+static void soft_raster_triangle(SoftRaster* raster, SoftRasterWorker* worker,
+                                 u32 triangle) {
+    const SoftRasterDraw* const draw = raster->draw;
+    SoftRasterVertex in[3];
+    u32 outside = UINT32_MAX, crossing = 0;
+    for (u32 i = 0; i < 3; i++) {
+        soft_raster_vertex(draw, worker, draw->first_vertex + 3 * triangle + i,
+                           &in[i]);
+        const u32 outcode = soft_raster_outcode(in[i].position);
+        outside &= outcode;
+        crossing |= outcode;
+    }
+
+    // Every vertex beyond the same plane
+    if (outside) {
+        worker->culled += 1;
+        return;
+    }
+    // The other planes are left to the bounds of the frame and the depth
+    // test, only the near one flips the projection
+    if (!(crossing & SOFT_RASTER_NEAR)) {
+        soft_raster_setup(raster, worker, &in[0], &in[1], &in[2]);
+        return;
+    }
+
+    // The vertices in front of z = -w, and where the edges cross it: a
+    // triangle or a quad, fanned
+    SoftRasterVertex out[4];
+    u32 count = 0;
+    for (u32 i = 0; i < 3; i++) {
+        const SoftRasterVertex* const a = &in[i];
+        const SoftRasterVertex* const b = &in[(i + 1) % 3];
+        const f32 da = a->position[2] + a->position[3];
+        const f32 db = b->position[2] + b->position[3];
+        if (da >= 0.0f) out[count++] = *a;
+        if ((da >= 0.0f) != (db >= 0.0f)) {
+            const f32 t = da / (da - db);
+            SoftRasterVertex* const c = &out[count++];
+            glm_vec4_lerp((f32*)a->position, (f32*)b->position, t,
+                          c->position);
+            c->u = a->u + (b->u - a->u) * t;
+            c->v = a->v + (b->v - a->v) * t;
+        }
+    }
+    worker->clipped += 1;
+    for (u32 i = 1; i + 1 < count; i++)
+        soft_raster_setup(raster, worker, &out[0], &out[i], &out[i + 1]);
+}
+
+static void soft_raster_instance(SoftRaster* raster, SoftRasterWorker* worker,
+                                 u32 instance) {
+    const SoftRasterDraw* const draw = raster->draw;
+    const u32 index = draw->first_instance + instance;
+    worker->instance = instance;
+    glm_mat4_mul(raster->view_projection, (vec4*)draw->models[index],
+                 worker->model_view_projection);
+
+    worker->uv_rect[0] = worker->uv_rect[1] = 0.0f;
+    worker->uv_rect[2] = worker->uv_rect[3] = 1.0f;
+    worker->layer = 0;
+    if (draw->materials) {
+        const RendererInstanceMaterial* const material =
+            &draw->materials[index];
+        memcpy(worker->uv_rect, material->uv_rect, sizeof(f32) * 4);
+        const f32 layer = CLAMP(material->layer, 0.0f,
+                                (f32)(draw->texture->layer_count - 1));
+        worker->layer = (u32)(layer + 0.5f);
+    }
+}
+
+// Bins batches of triangles until the draw is done or the bins are full
+static void soft_raster_front(SoftRaster* raster, SoftRasterWorker* worker) {
+    const SoftRasterDraw* const draw = raster->draw;
+    const u32 per_instance = draw->vertex_count / 3;
+    const u64 total = (u64)per_instance * draw->instance_count;
+    for (;;) {
+        if (worker->next == worker->end) {
+            const u64 batch = (u64)SDL_AtomicAdd(&raster->next_batch, 1);
+            if (batch * SOFT_RASTER_BATCH >= total) {
+                worker->next = worker->end = 0;
+                return;
+            }
+            worker->next = batch * SOFT_RASTER_BATCH;
+            worker->end = MIN(worker->next + SOFT_RASTER_BATCH, total);
+        }
+
+        // A clipped triangle is 2, each may touch every tile
+        if (worker->triangle_count + 2 > SOFT_RASTER_TRIANGLES ||
+            worker->block_capacity - worker->block_count <
+                2 * raster->tile_count) {
+            worker->full = true;
+            return;
+        }
+
+        const u32 instance = (u32)(worker->next / per_instance);
+        if (instance != worker->instance)
+            soft_raster_instance(raster, worker, instance);
+        soft_raster_triangle(raster, worker,
+                             (u32)(worker->next % per_instance));
+        worker->next += 1;
+    }
+}
+
+// The triangle, within the tile from (x0, y0) to (x1, y1) excluded
+static void soft_raster_rasterize(SoftRaster* raster,
+                                  const SoftRasterTriangle* triangle, u32 x0,
+                                  u32 y0, u32 x1, u32 y1) {
+    const u32 min_x = MAX(triangle->min_x, x0);
+    const u32 max_x = MIN(triangle->max_x, x1 - 1);
+    const u32 min_y = MAX(triangle->min_y, y0);
+    const u32 max_y = MIN(triangle->max_y, y1 - 1);
+    if (min_x > max_x || min_y > max_y) return;
+
+    // Pixel centers of a group, groups aligned to 4 pixels in the rows
+    const SimdF32x4 lanes = {0.5f, 1.5f, 2.5f, 3.5f};
+    SimdI32x4 top_left[3];
+    for (u32 i = 0; i < 3; i++) {
+        const i32 bit = (triangle->top_left >> i) & 1;
+        top_left[i] = (SimdI32x4){-bit, -bit, -bit, -bit};
+    }
+    const SimdF32x4 zero = {0};
+
+    for (u32 y = min_y; y <= max_y; y++) {
+        const f32 py = (f32)y + 0.5f - triangle->origin[1];
+        u32* const color = raster->color + (usize)y * raster->stride;
+        f32* const depth = raster->depth + (usize)y * raster->stride;
+
+        for (u32 x = min_x & ~3u; x <= max_x; x += 4) {
+            const SimdF32x4 px =
+                simd_splat((f32)x - triangle->origin[0]) + lanes;
+            SimdI32x4 mask = {-1, -1, -1, -1};
+            for (u32 i = 0; i < 3; i++) {
+                const SimdF32x4 e =
+                    soft_raster_plane(triangle->edges[i], px, py);
+                mask &= (e > zero) | ((e == zero) & top_left[i]);
+            }
+            if (!(mask[0] | mask[1] | mask[2] | mask[3])) continue;
+
+            const SimdF32x4 z = soft_raster_plane(triangle->depth, px, py);
+            const SimdF32x4 d = simd_load(depth + x);
+            mask &= z < d;
+            if (!(mask[0] | mask[1] | mask[2] | mask[3])) continue;
+
+            const SimdF32x4 d_new = simd_select(mask, z, d);
+            memcpy(depth + x, &d_new, sizeof(d_new));
+
+            // Interpolated over w, linear in screen space
+            const SimdF32x4 w =
+                simd_splat(1.0f) / soft_raster_plane(triangle->inv_w, px, py);
+            const SimdF32x4 u = soft_raster_plane(triangle->u, px, py) * w;
+            const SimdF32x4 v = soft_raster_plane(triangle->v, px, py) * w;
+            const SimdI32x4 texels = soft_raster_sample(triangle, u, v);
+            for (u32 lane = 0; lane < 4; lane++) {
+                if (mask[lane])
+                    color[x + lane] = triangle->texture->texels[texels[lane]];
+            }
+        }
+    }
+}
+
+static void soft_raster_tile(SoftRaster* raster, u32 tile) {
+    const u32 x0 = (tile % raster->tiles_x) * SOFT_RASTER_TILE;
+    const u32 y0 = (tile / raster->tiles_x) * SOFT_RASTER_TILE;
+    const u32 x1 = MIN(x0 + SOFT_RASTER_TILE, raster->width);
+    const u32 y1 = MIN(y0 + SOFT_RASTER_TILE, raster->height);
+
+    // The groups of 4 pixels may run into the padding of the rows
+    if (!raster->cleared) {
+        const u32 x_end = MIN(x0 + SOFT_RASTER_TILE, raster->stride);
+        for (u32 y = y0; y < y1; y++) {
+            const usize row = (usize)y * raster->stride;
+            for (u32 x = x0; x < x_end; x++) {
+                raster->color[row + x] = raster->clear_color;
+                raster->depth[row + x] = 1.0f;
+            }
+        }
+    }
+
+    for (u32 i = 0; i <= raster->pool.thread_count; i++) {
+        const SoftRasterWorker* const worker = &raster->workers[i];
+        for (u32 block = worker->heads[tile]; block != UINT32_MAX;
+             block = worker->blocks[block].next) {
+            const SoftRasterBlock* const b = &worker->blocks[block];
+            for (u32 j = 0; j < b->count; j++) {
+                soft_raster_rasterize(raster,
+                                      &worker->triangles[b->triangles[j]],
+                                      x0, y0, x1, y1);
+            }
+        }
+    }
+}
+
+// Bins the triangles of the draw
+static void soft_raster_front_job(void* data, u32 worker) {
+    SoftRaster* const raster = data;
+    TRACE_BEGIN("soft_raster_front");
+    soft_raster_front(raster, &raster->workers[worker]);
+    TRACE_END();
+}
+
+// Takes tiles until none is left
+static void soft_raster_back_job(void* data, u32 worker) {
+    SoftRaster* const raster = data;
+    (void)worker;
+    TRACE_BEGIN("soft_raster_back");
+    for (;;) {
+        const u32 tile = (u32)SDL_AtomicAdd(&raster->next_tile, 1);
+        if (tile >= raster->tile_count) break;
+        soft_raster_tile(raster, tile);
+    }
+    TRACE_END();
+}
+
+// Runs the job on every worker, returns its time
+static f64 soft_raster_dispatch(SoftRaster* raster, JobPoolFunction job) {
+    const u64 start = SDL_GetPerformanceCounter();
+    SDL_AtomicSet(&raster->next_tile, 0);
+    job_pool_run(&raster->pool, job, raster);
+    return (f64)(SDL_GetPerformanceCounter() - start) * 1000.0 /
+           (f64)SDL_GetPerformanceFrequency();
+}
+
+static void soft_raster_bins_reset(SoftRaster* raster) {
+    for (u32 i = 0; i <= raster->pool.thread_count; i++) {
+        SoftRasterWorker* const worker = &raster->workers[i];
+        memset(worker->heads, 0xff, sizeof(u32) * raster->tile_count);
+        memset(worker->tails, 0xff, sizeof(u32) * raster->tile_count);
+        worker->triangle_count = 0;
+        worker->block_count = 0;
+        worker->full = false;
+    }
+}
+
+// Rasterizes the bins and empties them
+static void soft_raster_flush(SoftRaster* raster) {
+    raster->back_ms += soft_raster_dispatch(raster, soft_raster_back_job);
+    raster->cleared = true;
+    soft_raster_bins_reset(raster);
+}
+
+void soft_raster_init(SoftRaster* raster, u32 width, u32 height) {
+    assert(width > 0 && height > 0 && width <= UINT16_MAX &&
+           height <= UINT16_MAX);
+    memset(raster, 0, sizeof(SoftRaster));
+    raster->width = width;
+    raster->height = height;
+    raster->stride = (width + 3) / 4 * 4;
+    raster->tiles_x = (width + SOFT_RASTER_TILE - 1) / SOFT_RASTER_TILE;
+    raster->tiles_y = (height + SOFT_RASTER_TILE - 1) / SOFT_RASTER_TILE;
+    raster->tile_count = raster->tiles_x * raster->tiles_y;
+
+    job_pool_init(&raster->pool, "soft_raster", "SOFT_THREADS",
+                  SOFT_RASTER_MAX_WORKERS);
+    const u32 worker_count = raster->pool.thread_count + 1;
+
+    const usize pixels = (usize)raster->stride * height;
+    const u32 block_capacity = raster->tile_count * SOFT_RASTER_BLOCKS_PER_TILE;
+    const usize worker_size =
+        sizeof(SoftRasterTriangle) * SOFT_RASTER_TRIANGLES +
+        sizeof(SoftRasterBlock) * block_capacity +
+        2 * sizeof(u32) * raster->tile_count + 3 * ARENA_ALIGNMENT;
+    arena_init(&raster->arena, "soft_raster",
+               (sizeof(u32) + sizeof(f32)) * pixels + 2 * ARENA_ALIGNMENT +
+                   worker_size * worker_count);
+    Arena* const arena = &raster->arena;
+    raster->color = ARENA_ALLOC(arena, u32, pixels);
+    raster->depth = ARENA_ALLOC(arena, f32, pixels);
+    memset(raster->color, 0, sizeof(u32) * pixels);
+
+    for (u32 i = 0; i < worker_count; i++) {
+        SoftRasterWorker* const worker = &raster->workers[i];
+        worker->triangles =
+            ARENA_ALLOC(arena, SoftRasterTriangle, SOFT_RASTER_TRIANGLES);
+        worker->blocks = ARENA_ALLOC(arena, SoftRasterBlock, block_capacity);
+        worker->block_capacity = block_capacity;
+        worker->heads = ARENA_ALLOC(arena, u32, raster->tile_count);
+        worker->tails = ARENA_ALLOC(arena, u32, raster->tile_count);
+    }
+    soft_raster_bins_reset(raster);
+}
+
+void soft_raster_destroy(SoftRaster* raster) {
+    job_pool_destroy(&raster->pool);
+    arena_print(&raster->arena);
+    arena_destroy(&raster->arena);
+}
+
+void soft_raster_begin(SoftRaster* raster, u32 clear_color,
+                       mat4 view_projection) {
+    glm_mat4_copy(view_projection, raster->view_projection);
+    raster->clear_color = clear_color;
+    raster->cleared = false;
+}
+
+void soft_raster_draw(SoftRaster* raster, const SoftRasterDraw* draw) {
+    if (draw->vertex_count < 3 || !draw->instance_count) return;
+    TRACE_BEGIN("soft_raster_draw");
+
+    raster->draw = draw;
+    SDL_AtomicSet(&raster->next_batch, 0);
+    for (u32 i = 0; i <= raster->pool.thread_count; i++) {
+        SoftRasterWorker* const worker = &raster->workers[i];
+        worker->next = worker->end = 0;
+        worker->instance = UINT32_MAX;
+    }
+
+    // The threads whose bins are full keep their batch for the next round
+    for (;;) {
+        raster->front_ms +=
+            soft_raster_dispatch(raster, soft_raster_front_job);
+        _Bool full = false;
+        for (u32 i = 0; i <= raster->pool.thread_count; i++)
+            full |= raster->workers[i].full;
+        if (!full) break;
+        soft_raster_flush(raster);
+        raster->flushes += 1;
+    }
+    raster->draw = NULL;
+    TRACE_END();
+}
+
+void soft_raster_end(SoftRaster* raster) {
+    TRACE_BEGIN("soft_raster_end");
+    soft_raster_flush(raster);
+    raster->frame_count += 1;
+    TRACE_END();
+}
+
+void soft_raster_print(const SoftRaster* raster) {
+    if (!raster->frame_count) return;
+
+    u64 binned = 0, culled = 0, clipped = 0;
+    for (u32 i = 0; i <= raster->pool.thread_count; i++) {
+        binned += raster->workers[i].binned;
+        culled += raster->workers[i].culled;
+        clipped += raster->workers[i].clipped;
+    }
+    const f64 frames = (f64)raster->frame_count;
+    printf("Soft raster: threads=%u tiles=%ux%u frames=%" PRIu64
+           " binned_mean=%.0f culled_mean=%.0f clipped_mean=%.0f "
+           "flushes_mean=%.2f front_mean=%.3fms back_mean=%.3fms\n",
+           raster->pool.thread_count + 1, raster->tiles_x, raster->tiles_y,
+           raster->frame_count, (f64)binned / frames, (f64)culled / frames,
+           (f64)clipped / frames, (f64)raster->flushes / frames,
+           raster->front_ms / frames, raster->back_ms / frames);
+}
@@ -0,0 +1,148 @@
+#pragma once
+#include <SDL2/SDL.h>
+#include <cglm/cglm.h>
+
+#include "allocator.h"
+#include "job_pool.h"
+#include "renderer.h"
+#include "utils.h"
+
+// Tile based software rasterizer, behind the "soft" backend of the renderer
+// (renderer_soft.c). The frame is split into SOFT_RASTER_TILE pixels square
+// tiles.
+//
+// Front end: the triangles of a draw are transformed, clipped against the
+// near plane, culled when they face away or lie out of the frustum, then set
+// up (edge functions, and the planes of depth, 1/w, u/w and v/w over the
+// screen) and appended to the bins of the tiles their bounds overlap. Worker
+// threads and the caller take batches of triangles of the draw, each thread
+// binning into its own bins, without locks.
+//
+// Back end: the threads take tiles until none is left, and rasterize the
+// triangles binned in a tile by every thread, in binning order, 4 pixels at
+// a time with vector instructions (SSE or NEON, through the compiler vector
+// extensions): edge functions with the top left rule, depth test, then
+// perspective correct UVs sampling the nearest texel. A tile is only touched
+// by one thread, its pixels stay in its cache.
+//
+// Bins are bounded: once those of a thread are full, the draw is suspended
+// while the tiles are rasterized and the bins emptied, then resumed. The
+// memory does not grow with the triangles of a frame.
+//
+// `SOFT_THREADS=<n>` sets the number of workers, by default one less than
+// the CPUs, at most SOFT_RASTER_MAX_WORKERS.
+
+#define SOFT_RASTER_MAX_WORKERS JOB_POOL_MAX_THREADS
+#define SOFT_RASTER_TILE 64  // Multiple of 4
+// Per thread, between two rasterizations of the tiles
+#define SOFT_RASTER_TRIANGLES (1 << 14)
+#define SOFT_RASTER_BLOCKS_PER_TILE 16
+// Triangles of a bin block
+#define SOFT_RASTER_BLOCK 62
+// Triangles of a draw a thread takes at once
+#define SOFT_RASTER_BATCH 64
+
+// ARGB texels, rows bottom up like the BMP files
+typedef struct {
+    u32* texels;
+    u32 width, height, layer_count;
+    _Bool clamp;  // Else mirrored repeat
+} SoftTexture;
+
+typedef struct {
+    // In the vertex format: MeshQuantizedPosition and MeshQuantizedUv
+    // (mesh.h) when quantized, else vec3 and vec2
+    const void* positions;
+    const void* uvs;
+    _Bool quantized;
+    const mat4* models;  // Per instance
+    // Per instance, NULL without instance materials
+    const RendererInstanceMaterial* materials;
+    const SoftTexture* texture;
+    u32 first_vertex, vertex_count;
+    u32 first_instance, instance_count;
+} SoftRasterDraw;
+
+// Set up for the back end. Edges and planes are a * x + b * y + c over the
+// pixel coordinates from `origin`, the edges positive inside: relative to
+// the triangle, the planes of the small ones keep their precision far from
+// the corner of the frame.
+typedef struct {
+    f32 origin[2];  // Corner of the bounds
+    f32 edges[3][3];
+    f32 depth[3], inv_w[3], u[3], v[3];  // u and v over w
+    u16 min_x, min_y, max_x, max_y;  // Pixels covered at most, inclusive
+    u8 top_left;  // Bit per edge, the pixels on it are inside
+    u32 layer;
+    const SoftTexture* texture;
+} SoftRasterTriangle;
+
+// Part of the bin of a tile
+typedef struct {
+    u32 next;  // Block, UINT32_MAX for the last one
+    u32 count;
+    u32 triangles[SOFT_RASTER_BLOCK];
+} SoftRasterBlock;
+
+// Of one worker of the pool
+typedef struct {
+    SoftRasterTriangle* triangles;
+    u32 triangle_count;
+    SoftRasterBlock* blocks;
+    u32 block_count, block_capacity;
+    // Per tile, UINT32_MAX when empty
+    u32* heads;
+    u32* tails;
+    _Bool full;
+
+    // Triangles of the draw taken and not binned yet, instance after instance
+    u64 next, end;
+    u32 instance;  // Of `model_view_projection`, UINT32_MAX for none
+    mat4 model_view_projection;
+    f32 uv_rect[4];
+    u32 layer;
+
+    // Since init
+    u64 binned, culled, clipped;
+} SoftRasterWorker;
+
+typedef struct {
+    u32 width, height;
+    u32 stride;  // Pixels per row, a multiple of 4
+    u32 tiles_x, tiles_y, tile_count;
+    Arena arena;
+    // Rows top down, padded to the stride
+    u32* color;  // ARGB
+    f32* depth;  // From 0 to 1
+
+    // Of the frame
+    mat4 view_projection;
+    u32 clear_color;
+    _Bool cleared;  // The tiles, once rasterized
+
+    const SoftRasterDraw* draw;  // Of the front end
+    SDL_atomic_t next_batch;
+    SDL_atomic_t next_tile;
+
+    JobPool pool;
+    SoftRasterWorker workers[SOFT_RASTER_MAX_WORKERS + 1];
+
+    // Since init
+    u64 frame_count;
+    u64 flushes;  // Rasterizations of the tiles before the end of a frame
+    f64 front_ms, back_ms;
+} SoftRaster;
+
+// Color and depth buffers of `width` by `height` pixels, starts the workers
+void soft_raster_init(SoftRaster* raster, u32 width, u32 height);
+void soft_raster_destroy(SoftRaster* raster);
+// The tiles are cleared to `clear_color` (ARGB) when first rasterized
+void soft_raster_begin(SoftRaster* raster, u32 clear_color,
+                       mat4 view_projection);
+// Bins the triangles of the draw, rasterizing the tiles whenever the bins
+// are full. `draw` is only read until it returns.
+void soft_raster_draw(SoftRaster* raster, const SoftRasterDraw* draw);
+// Rasterizes what is left in the bins, `color` then holds the frame
+void soft_raster_end(SoftRaster* raster);
+// Triangles binned and culled, front and back end time
+void soft_raster_print(const SoftRaster* raster);
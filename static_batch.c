@@ -0,0 +1,225 @@
+#include "static_batch.h"
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "mesh.h"
+#include "trace.h"
+
+// Sorts the objects into their chunks
+typedef struct {
+    u64 key;
+    u32 object;
+} StaticBatchKey;
+
+// Material, then the cell of the center, 16 bits per axis
+static u64 static_batch_key(u32 material, const vec3 center) {
+    u64 key = material;
+    for (u32 i = 0; i < 3; i++) {
+        const i32 cell = (i32)floorf(center[i] / STATIC_BATCH_CELL_SIZE);
+        key = key << 16 | ((u64)(u32)(cell + (1 << 15)) & 0xffff);
+    }
+    return key;
+}
+
+// Objects of a chunk stay in the order they were given
+static int static_batch_key_compare(const void* a, const void* b) {
+    const StaticBatchKey* const x = a;
+    const StaticBatchKey* const y = b;
+    if (x->key != y->key) return x->key < y->key ? -1 : 1;
+    return (x->object > y->object) - (x->object < y->object);
+}
+
+static StaticBatchKey* static_batch_sort(StaticBatch* batch,
+                                         const StaticBatchMesh* mesh,
+                                         const mat4* models,
+                                         const u32* materials) {
+    MeshBounds bounds;
+    mesh_bounds(mesh->positions, mesh->vertex_count, &bounds);
+
+    StaticBatchKey* const keys =
+        ARENA_ALLOC(&batch->arena, StaticBatchKey, batch->object_count);
+    for (u32 i = 0; i < batch->object_count; i++) {
+        vec3 center;
+        glm_mat4_mulv3((vec4*)models[i], bounds.center, 1.0f, center);
+        keys[i].key = static_batch_key(materials[i], center);
+        keys[i].object = i;
+    }
+    qsort(keys, batch->object_count, sizeof(StaticBatchKey),
+          static_batch_key_compare);
+    return keys;
+}
+
+// World space vertices of the sorted objects, split into chunks at every
+// change of key
+static void static_batch_bake(StaticBatch* batch, const StaticBatchMesh* mesh,
+                              const mat4* models, const u32* materials,
+                              const StaticBatchKey* keys, vec3* positions,
+                              vec2* uvs) {
+    const u32 mesh_vertices = mesh->vertex_count;
+    StaticBatchChunk* chunk = NULL;
+    for (u32 i = 0; i < batch->object_count; i++) {
+        const u32 object = keys[i].object;
+        const u32 first = i * mesh_vertices;
+        if (!chunk || keys[i].key != keys[i - 1].key) {
+            chunk = &batch->chunks[batch->chunk_count++];
+            *chunk = (StaticBatchChunk){
+                .material = materials[object],
+                .first_vertex = first,
+                .bounds_min = {INFINITY, INFINITY, INFINITY},
+                .bounds_max = {-INFINITY, -INFINITY, -INFINITY},
+            };
+        }
+
+        for (u32 v = 0; v < mesh_vertices; v++) {
+            f32* const position = positions[first + v];
+            glm_mat4_mulv3((vec4*)models[object],
+                           (f32*)&mesh->positions[v * 3], 1.0f, position);
+            glm_vec3_min(chunk->bounds_min, position, chunk->bounds_min);
+            glm_vec3_max(chunk->bounds_max, position, chunk->bounds_max);
+        }
+        memcpy(uvs[first], &mesh->uvs[0], sizeof(vec2) * mesh_vertices);
+        chunk->vertex_count += mesh_vertices;
+        chunk->object_count += 1;
+    }
+}
+
+void static_batch_build(StaticBatch* batch, Renderer* renderer,
+                        const StaticBatchMesh* mesh, const mat4* models,
+                        const u32* materials, u32 object_count,
+                        RendererVertexFormat vertex_format) {
+    assert(object_count > 0 && mesh->vertex_count > 0);
+    assert((u64)object_count * mesh->vertex_count <= UINT32_MAX);
+    memset(batch, 0, sizeof(StaticBatch));
+    batch->vertex_format = vertex_format;
+    batch->object_count = object_count;
+    batch->vertex_count = object_count * mesh->vertex_count;
+    TRACE_BEGIN("static_batch_build");
+
+    // The chunks and the draws stay, at most one per object, the rest is
+    // scratch for the upload
+    const _Bool quantized = vertex_format == RENDERER_VERTEX_QUANTIZED;
+    const usize vertex_count = batch->vertex_count;
+    const usize quantized_size =
+        quantized ? sizeof(MeshQuantizedPosition) + sizeof(MeshQuantizedUv)
+                  : 0;
+    arena_init(&batch->arena, "static_batch",
+               (sizeof(StaticBatchChunk) + sizeof(StaticBatchDraw) +
+                sizeof(StaticBatchKey) + sizeof(mat4)) *
+                       object_count +
+                   (sizeof(vec3) + sizeof(vec2) + quantized_size) *
+                       vertex_count +
+                   8 * ARENA_ALIGNMENT);
+    batch->chunks = ARENA_ALLOC(&batch->arena, StaticBatchChunk, object_count);
+    batch->draws = ARENA_ALLOC(&batch->arena, StaticBatchDraw, object_count);
+
+    const ArenaMark mark = arena_mark(&batch->arena);
+    const StaticBatchKey* const keys =
+        static_batch_sort(batch, mesh, models, materials);
+    vec3* const positions = ARENA_ALLOC(&batch->arena, vec3, vertex_count);
+    vec2* const uvs = ARENA_ALLOC(&batch->arena, vec2, vertex_count);
+    static_batch_bake(batch, mesh, models, materials, keys, positions, uvs);
+
+    mat4* const instances =
+        ARENA_ALLOC(&batch->arena, mat4, batch->chunk_count);
+    if (quantized) {
+        MeshQuantizedPosition* const quantized_positions =
+            ARENA_ALLOC(&batch->arena, MeshQuantizedPosition, vertex_count);
+        MeshQuantizedUv* const quantized_uvs =
+            ARENA_ALLOC(&batch->arena, MeshQuantizedUv, vertex_count);
+
+        // Each chunk relative to its own bounds
+        for (u32 i = 0; i < batch->chunk_count; i++) {
+            const StaticBatchChunk* const chunk = &batch->chunks[i];
+            MeshBounds bounds;
+            mesh_bounds(positions[chunk->first_vertex], chunk->vertex_count,
+                        &bounds);
+            mesh_quantize_positions(positions[chunk->first_vertex],
+                                    chunk->vertex_count, &bounds,
+                                    &quantized_positions[chunk->first_vertex]);
+            glm_mat4_identity(instances[i]);
+            mesh_dequantize(&bounds, instances[i]);
+        }
+        mesh_quantize_uvs(uvs[0], batch->vertex_count, quantized_uvs);
+
+        batch->positions = renderer_buffer_create(
+            renderer, RENDERER_BUFFER_VERTEX, quantized_positions,
+            sizeof(MeshQuantizedPosition) * vertex_count);
+        batch->uvs = renderer_buffer_create(
+            renderer, RENDERER_BUFFER_VERTEX, quantized_uvs,
+            sizeof(MeshQuantizedUv) * vertex_count);
+    } else {
+        for (u32 i = 0; i < batch->chunk_count; i++)
+            glm_mat4_identity(instances[i]);
+
+        batch->positions =
+            renderer_buffer_create(renderer, RENDERER_BUFFER_VERTEX,
+                                   positions, sizeof(vec3) * vertex_count);
+        batch->uvs = renderer_buffer_create(
+            renderer, RENDERER_BUFFER_VERTEX, uvs, sizeof(vec2) * vertex_count);
+    }
+    batch->instances =
+        renderer_buffer_create(renderer, RENDERER_BUFFER_VERTEX, instances,
+                               sizeof(mat4) * batch->chunk_count);
+
+    arena_release(&batch->arena, mark);
+    TRACE_END();
+}
+
+void static_batch_destroy(StaticBatch* batch) {
+    arena_print(&batch->arena);
+    arena_destroy(&batch->arena);
+}
+
+void static_batch_cull(StaticBatch* batch, mat4 view_projection) {
+    TRACE_BEGIN("static_batch_cull");
+    vec4 planes[6];
+    glm_frustum_planes(view_projection, planes);
+
+    // Only float vertices share their instance matrix
+    const _Bool merge = batch->vertex_format == RENDERER_VERTEX_F32;
+    StaticBatchDraw* last = NULL;
+    batch->draw_count = 0;
+    for (u32 i = 0; i < batch->chunk_count; i++) {
+        StaticBatchChunk* const chunk = &batch->chunks[i];
+        vec3 box[2];
+        glm_vec3_copy(chunk->bounds_min, box[0]);
+        glm_vec3_copy(chunk->bounds_max, box[1]);
+        if (!glm_aabb_frustum(box, planes)) continue;
+
+        batch->total_visible_chunks += 1;
+        batch->total_visible_objects += chunk->object_count;
+        if (merge && last && last->material == chunk->material &&
+            last->first_vertex + last->vertex_count == chunk->first_vertex) {
+            last->vertex_count += chunk->vertex_count;
+            continue;
+        }
+
+        last = &batch->draws[batch->draw_count++];
+        *last = (StaticBatchDraw){
+            .material = chunk->material,
+            .first_vertex = chunk->first_vertex,
+            .vertex_count = chunk->vertex_count,
+            .instance = i,
+        };
+    }
+
+    batch->cull_count += 1;
+    batch->total_draws += batch->draw_count;
+    TRACE_END();
+}
+
+void static_batch_print(const StaticBatch* batch) {
+    const f64 culls = batch->cull_count ? (f64)batch->cull_count : 1.0;
+    const f64 visible_objects = (f64)batch->total_visible_objects / culls;
+    const f64 draws = (f64)batch->total_draws / culls;
+    printf("Static batch: objects=%u chunks=%u vertices=%u culls=%" PRIu64
+           " visible_chunks_mean=%.1f visible_objects_mean=%.1f "
+           "draws_mean=%.1f draw_reduction=%.1fx\n",
+           batch->object_count, batch->chunk_count, batch->vertex_count,
+           batch->cull_count, (f64)batch->total_visible_chunks / culls,
+           visible_objects, draws,
+           draws > 0.0 ? visible_objects / draws : 0.0);
+}
@@ -0,0 +1,78 @@
+#pragma once
+#include <cglm/cglm.h>
+
+#include "allocator.h"
+#include "renderer.h"
+#include "utils.h"
+
+// Static batching: objects which never move are baked at load into world
+// space vertices, shared by every object of a chunk. A chunk holds the
+// objects of one material whose center falls in one cell of a grid of
+// STATIC_BATCH_CELL_SIZE, so it is culled against the view as a whole.
+//
+// Every frame, the chunks in view are turned into draws. With float
+// vertices chunks need no transform: the visible chunks of a material
+// which follow each other in the buffers are merged into a single draw.
+// Quantized vertices are relative to the bounds of their chunk, which has
+// its dequantization as instance matrix and a draw of its own.
+//
+// The baked vertices take the memory of every copy of the mesh, meant for
+// thousands of small props rather than millions.
+
+// World units
+#define STATIC_BATCH_CELL_SIZE 16.0f
+
+// A mesh of float vertices, non indexed
+typedef struct {
+    const f32* positions;  // vec3
+    const f32* uvs;  // vec2
+    u32 vertex_count;
+} StaticBatchMesh;
+
+typedef struct {
+    u32 material;
+    u32 first_vertex, vertex_count;
+    u32 object_count;
+    vec3 bounds_min, bounds_max;  // World space
+} StaticBatchChunk;
+
+// Visible chunks of one material, following each other in the buffers
+typedef struct {
+    u32 material;
+    u32 first_vertex, vertex_count;
+    u32 instance;  // Of the first chunk
+} StaticBatchDraw;
+
+typedef struct {
+    Arena arena;
+    RendererVertexFormat vertex_format;
+    u32 object_count;
+    StaticBatchChunk* chunks;
+    u32 chunk_count;
+    u32 vertex_count;
+
+    RendererBuffer positions, uvs;
+    // A mat4 per chunk: identity for float vertices, the dequantization of
+    // the chunk bounds for quantized ones
+    RendererBuffer instances;
+
+    // Of the last cull, at most one per chunk
+    StaticBatchDraw* draws;
+    u32 draw_count;
+
+    // Since the build
+    u64 cull_count;
+    u64 total_visible_chunks, total_visible_objects, total_draws;
+} StaticBatch;
+
+// Bakes `object_count` copies of `mesh`, each with its model matrix and
+// material, and uploads them in `vertex_format`
+void static_batch_build(StaticBatch* batch, Renderer* renderer,
+                        const StaticBatchMesh* mesh, const mat4* models,
+                        const u32* materials, u32 object_count,
+                        RendererVertexFormat vertex_format);
+void static_batch_destroy(StaticBatch* batch);
+// Fills `draws` with the chunks in the frustum of `view_projection`
+void static_batch_cull(StaticBatch* batch, mat4 view_projection);
+// Chunks, and the draws per frame against a draw per object
+void static_batch_print(const StaticBatch* batch);
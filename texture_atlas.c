@@ -0,0 +1,197 @@
+#include "texture_atlas.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "trace.h"
+
+void texture_atlas_init(TextureAtlas* atlas, u32 layer_width,
+                        u32 layer_height, u32 max_layers) {
+    memset(atlas, 0, sizeof(TextureAtlas));
+    atlas->layer_width = layer_width;
+    atlas->layer_height = layer_height;
+    atlas->max_layers = max_layers;
+}
+
+void texture_atlas_destroy(TextureAtlas* atlas) {
+    free(atlas->pixels);
+    atlas->pixels = NULL;
+}
+
+static u8* texture_atlas_layer(TextureAtlas* atlas, u32 layer) {
+    return atlas->pixels + atlas->layer_size * layer;
+}
+
+static u32 texture_atlas_layer_add(TextureAtlas* atlas) {
+    if (atlas->layer_count == atlas->max_layers) {
+        fprintf(stderr, "Texture atlas: out of layers, max_layers=%u\n",
+                atlas->max_layers);
+        exit(ENOMEM);
+    }
+    return atlas->layer_count++;
+}
+
+// Finds room for the texture and its gutter, false if it is larger than a
+// layer
+static _Bool texture_atlas_pack(TextureAtlas* atlas, u32 width, u32 height,
+                                TextureAtlasEntry* entry) {
+    const u32 padded_width = width + 2 * TEXTURE_ATLAS_GUTTER;
+    const u32 padded_height = height + 2 * TEXTURE_ATLAS_GUTTER;
+    if (padded_width > atlas->layer_width ||
+        padded_height > atlas->layer_height)
+        return false;
+
+    // The shelf wasting the least height
+    TextureAtlasShelf* shelf = NULL;
+    for (u32 i = 0; i < atlas->shelf_count; i++) {
+        TextureAtlasShelf* const s = &atlas->shelves[i];
+        if (s->height >= padded_height &&
+            s->x + padded_width <= atlas->layer_width &&
+            (!shelf || s->height < shelf->height))
+            shelf = s;
+    }
+
+    if (!shelf) {
+        if (atlas->shelf_count == TEXTURE_ATLAS_MAX_SHELVES) {
+            fprintf(stderr, "Texture atlas: out of shelves\n");
+            exit(ENOMEM);
+        }
+
+        // On top of the last one, they are added in order
+        const TextureAtlasShelf* const last =
+            atlas->shelf_count ? &atlas->shelves[atlas->shelf_count - 1]
+                               : NULL;
+        u32 layer = 0, y = 0;
+        if (last &&
+            last->y + last->height + padded_height <= atlas->layer_height) {
+            layer = last->layer;
+            y = last->y + last->height;
+        } else {
+            layer = texture_atlas_layer_add(atlas);
+            // What no texture covers is uploaded too
+            memset(texture_atlas_layer(atlas, layer), 0, atlas->layer_size);
+            atlas->shelf_layer_count += 1;
+        }
+
+        shelf = &atlas->shelves[atlas->shelf_count++];
+        *shelf = (TextureAtlasShelf){
+            .layer = layer,
+            .y = y,
+            .height = padded_height,
+        };
+    }
+
+    *entry = (TextureAtlasEntry){
+        .layer = shelf->layer,
+        .x = shelf->x + TEXTURE_ATLAS_GUTTER,
+        .y = shelf->y + TEXTURE_ATLAS_GUTTER,
+        .width = width,
+        .height = height,
+    };
+    shelf->x += padded_width;
+    return true;
+}
+
+// Copies the texture at its place, then repeats its edges into the gutter
+static void texture_atlas_copy(TextureAtlas* atlas,
+                               const TextureAtlasEntry* entry,
+                               const u8* bgr) {
+    const u32 gutter = TEXTURE_ATLAS_GUTTER;
+    const usize src_row_size = (entry->width * 3 + 3) / 4 * 4;
+    const usize width_size = (usize)entry->width * 3;
+    u8* const layer = texture_atlas_layer(atlas, entry->layer);
+
+    for (u32 y = 0; y < entry->height + 2 * gutter; y++) {
+        const i32 src_y =
+            CLAMP((i32)y - (i32)gutter, 0, (i32)entry->height - 1);
+        const u8* const src = bgr + (usize)src_y * src_row_size;
+        u8* const dst = layer + (entry->y - gutter + y) * atlas->row_size +
+                        (usize)(entry->x - gutter) * 3;
+
+        memcpy(dst + gutter * 3, src, width_size);
+        for (u32 x = 0; x < gutter; x++) {
+            memcpy(dst + x * 3, src, 3);
+            memcpy(dst + (gutter + entry->width + x) * 3,
+                   src + width_size - 3, 3);
+        }
+    }
+}
+
+u32 texture_atlas_add(TextureAtlas* atlas, u32 width, u32 height,
+                      const u8* bgr) {
+    if (!atlas->layer_width) {
+        atlas->layer_width = width;
+        atlas->layer_height = height;
+    }
+    if (!atlas->pixels) {
+        atlas->row_size = (atlas->layer_width * 3 + 3) / 4 * 4;
+        atlas->layer_size = atlas->row_size * atlas->layer_height;
+        atlas->pixels = ogl_malloc(atlas->layer_size * atlas->max_layers);
+    }
+    if (atlas->entry_count == TEXTURE_ATLAS_MAX_ENTRIES) {
+        fprintf(stderr, "Texture atlas: out of entries\n");
+        exit(ENOMEM);
+    }
+
+    TextureAtlasEntry* const entry = &atlas->entries[atlas->entry_count];
+    if (width == atlas->layer_width && height == atlas->layer_height) {
+        // Same rows as a layer
+        *entry = (TextureAtlasEntry){
+            .layer = texture_atlas_layer_add(atlas),
+            .width = width,
+            .height = height,
+        };
+        memcpy(texture_atlas_layer(atlas, entry->layer), bgr,
+               atlas->layer_size);
+    } else {
+        if (!texture_atlas_pack(atlas, width, height, entry)) {
+            fprintf(stderr,
+                    "Texture atlas: a texture of %ux%u does not fit in "
+                    "layers of %ux%u\n",
+                    width, height, atlas->layer_width, atlas->layer_height);
+            exit(EINVAL);
+        }
+        texture_atlas_copy(atlas, entry, bgr);
+        atlas->packed_pixels += (u64)width * height;
+    }
+
+    return atlas->entry_count++;
+}
+
+RendererTexture texture_atlas_upload(TextureAtlas* atlas, Renderer* renderer) {
+    assert(atlas->layer_count > 0);
+    TRACE_BEGIN("texture_atlas_upload");
+    const RendererTexture texture = renderer_texture_array_create(
+        renderer, atlas->layer_width, atlas->layer_height, atlas->layer_count,
+        atlas->pixels);
+    texture_atlas_destroy(atlas);
+    TRACE_END();
+    return texture;
+}
+
+void texture_atlas_material(const TextureAtlas* atlas, u32 entry,
+                            RendererInstanceMaterial* material) {
+    assert(entry < atlas->entry_count);
+    const TextureAtlasEntry* const e = &atlas->entries[entry];
+    const f32 width = (f32)atlas->layer_width;
+    const f32 height = (f32)atlas->layer_height;
+
+    material->uv_rect[0] = (f32)e->x / width;
+    material->uv_rect[1] = (f32)e->y / height;
+    material->uv_rect[2] = (f32)e->width / width;
+    material->uv_rect[3] = (f32)e->height / height;
+    material->layer = (f32)e->layer;
+}
+
+void texture_atlas_print(const TextureAtlas* atlas) {
+    const u64 shelf_pixels = (u64)atlas->shelf_layer_count *
+                             atlas->layer_width * atlas->layer_height;
+    printf("Texture atlas: layer_size=%ux%u layers=%u entries=%u "
+           "shelf_layers=%u shelves=%u shelf_occupancy=%.1f%%\n",
+           atlas->layer_width, atlas->layer_height, atlas->layer_count,
+           atlas->entry_count, atlas->shelf_layer_count, atlas->shelf_count,
+           shelf_pixels ? 100.0 * (f64)atlas->packed_pixels /
+                              (f64)shelf_pixels
+                        : 0.0);
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include "renderer.h"
+#include "utils.h"
+
+// Packs textures into the layers of a single texture array, so instances
+// with different textures are drawn in one instanced call, each with the
+// RendererInstanceMaterial of its texture.
+//
+// Textures of the layer size take a layer each. Smaller ones are shelf
+// packed into shared layers: a shelf is a row of textures as tall as the
+// first one put in it, a texture goes into the shelf wasting the least
+// height, else opens a new shelf, else a new layer. Packed textures are
+// surrounded by a gutter repeating their edges, so filtering and the first
+// mipmaps do not bleed between neighbours.
+//
+// Pixels are BGR rows padded to 4 bytes, like `renderer_texture_create`.
+
+#define TEXTURE_ATLAS_MAX_ENTRIES 256
+#define TEXTURE_ATLAS_MAX_SHELVES 256
+// Pixels around the packed textures
+#define TEXTURE_ATLAS_GUTTER 4
+
+typedef struct {
+    u32 layer;
+    u32 x, y;  // Of the texture, inside the gutter
+    u32 width, height;
+} TextureAtlasEntry;
+
+typedef struct {
+    u32 layer;
+    u32 y, height;
+    u32 x;  // Where the next texture goes
+} TextureAtlasShelf;
+
+typedef struct {
+    u32 layer_width, layer_height;
+    usize row_size, layer_size;  // In bytes
+    u32 max_layers;
+    // Layers one after the other, freed by the upload
+    u8* pixels;
+    u32 layer_count;
+
+    TextureAtlasEntry entries[TEXTURE_ATLAS_MAX_ENTRIES];
+    u32 entry_count;
+    TextureAtlasShelf shelves[TEXTURE_ATLAS_MAX_SHELVES];
+    u32 shelf_count;
+    // Of the layers holding shelves, to report the packing
+    u32 shelf_layer_count;
+    u64 packed_pixels;
+} TextureAtlas;
+
+// Layers of `layer_width` by `layer_height`, 0 for the size of the first
+// texture added. Their pixels are allocated at once on the first add.
+void texture_atlas_init(TextureAtlas* atlas, u32 layer_width,
+                        u32 layer_height, u32 max_layers);
+void texture_atlas_destroy(TextureAtlas* atlas);
+// Copies the pixels, returns the index of the entry. Fatal when it does not
+// fit.
+u32 texture_atlas_add(TextureAtlas* atlas, u32 width, u32 height,
+                      const u8* bgr);
+// Texture array of every layer, then frees the pixels. The entries stay.
+RendererTexture texture_atlas_upload(TextureAtlas* atlas, Renderer* renderer);
+void texture_atlas_material(const TextureAtlas* atlas, u32 entry,
+                            RendererInstanceMaterial* material);
+void texture_atlas_print(const TextureAtlas* atlas);
@@ -0,0 +1,563 @@
+// Replays a GL command stream captured with `GL_CAPTURE=<path>` (see
+// gl_capture.h), headless and uncapped. The setup part runs once, then the
+// captured frames run `repeat` times, each one timed up to a glFinish: the
+// time to issue the calls and the time until the GPU is done.
+//
+// Usage, from anywhere:
+//   gl_replay <capture> [repeat]
+// OpenGL needs a video driver even when hidden: SDL_VIDEODRIVER=offscreen
+// (EGL) or Xvfb with llvmpipe.
+
+#include <SDL2/SDL.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "../gl_capture.h"
+#include "../opengl.h"
+#include "../opengl_lifecycle.h"
+#include "../utils.h"
+
+// Of a transform feedback program
+#define GL_REPLAY_MAX_VARYINGS 16
+
+// Captured names to the names of the replay, 0 maps to 0
+typedef struct {
+    GLuint* names;
+    u32 capacity;
+} GlReplayMap;
+
+typedef struct {
+    GLuint program;  // Captured
+    GLint captured;
+    GLint location;
+} GlReplayLocation;
+
+typedef struct {
+    SDL_Window* window;
+    const u8* cursor;
+    const u8* end;
+
+    GlReplayMap buffers, textures, vertex_arrays, shaders, programs;
+    GlReplayMap framebuffers, renderbuffers;
+    GlReplayLocation* locations;
+    u32 location_count, location_capacity;
+    GLuint program;  // Captured name of the current one
+
+    u32 calls;  // Since the last frame end
+} GlReplay;
+
+static void gl_replay_map_set(GlReplayMap* map, GLuint captured,
+                              GLuint name) {
+    if (captured >= map->capacity) {
+        u32 capacity = map->capacity > 0 ? map->capacity * 2 : 64;
+        while (capacity <= captured) capacity *= 2;
+
+        map->names = realloc(map->names, sizeof(GLuint) * capacity);
+        if (!map->names) exit(ENOMEM);
+        memset(map->names + map->capacity, 0,
+               sizeof(GLuint) * (capacity - map->capacity));
+        map->capacity = capacity;
+    }
+    map->names[captured] = name;
+}
+
+static GLuint gl_replay_map_get(const GlReplayMap* map, GLuint captured) {
+    if (captured == 0) return 0;
+    if (captured >= map->capacity || map->names[captured] == 0) {
+        fprintf(stderr, "Unknown object %u in the capture\n", captured);
+        exit(1);
+    }
+    return map->names[captured];
+}
+
+static GLint gl_replay_location(const GlReplay* replay, GLint captured) {
+    if (captured < 0) return captured;
+
+    for (u32 i = 0; i < replay->location_count; i++) {
+        const GlReplayLocation* const l = &replay->locations[i];
+        if (l->program == replay->program && l->captured == captured)
+            return l->location;
+    }
+    fprintf(stderr, "Unknown uniform location %d of program %u\n", captured,
+            replay->program);
+    exit(1);
+}
+
+static void gl_replay_location_add(GlReplay* replay, GLuint program,
+                                   GLint captured, GLint location) {
+    if (replay->location_count == replay->location_capacity) {
+        replay->location_capacity =
+            replay->location_capacity > 0 ? replay->location_capacity * 2
+                                          : 16;
+        replay->locations =
+            realloc(replay->locations,
+                    sizeof(GlReplayLocation) * replay->location_capacity);
+        if (!replay->locations) exit(ENOMEM);
+    }
+    replay->locations[replay->location_count++] = (GlReplayLocation){
+        .program = program,
+        .captured = captured,
+        .location = location,
+    };
+}
+
+static u64 gl_replay_u64(const u32* args) {
+    return (u64)args[0] | (u64)args[1] << 32;
+}
+
+static f32 gl_replay_f32(u32 bits) {
+    f32 value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+static void gl_replay_gen(GlReplayMap* map, const u32* names, u32 count,
+                          void (*gen)(GLsizei, GLuint*)) {
+    for (u32 i = 0; i < count; i++) {
+        GLuint name = 0;
+        gen(1, &name);
+        gl_replay_map_set(map, names[i], name);
+    }
+}
+
+static void gl_replay_delete(GlReplayMap* map, const u32* names, u32 count,
+                             void (*destroy)(GLsizei, const GLuint*)) {
+    for (u32 i = 0; i < count; i++) {
+        const GLuint name = gl_replay_map_get(map, names[i]);
+        destroy(1, &name);
+        gl_replay_map_set(map, names[i], 0);
+    }
+}
+
+static void gl_replay_check_shader(GLuint shader) {
+    GLint status = GL_FALSE;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+    if (status == GL_TRUE) return;
+
+    char log[1024] = "";
+    glGetShaderInfoLog(shader, sizeof(log), NULL, log);
+    fprintf(stderr, "Error compiling a captured shader: %s\n", log);
+    exit(1);
+}
+
+static void gl_replay_check_program(GLuint program) {
+    GLint status = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &status);
+    if (status == GL_TRUE) return;
+
+    char log[1024] = "";
+    glGetProgramInfoLog(program, sizeof(log), NULL, log);
+    fprintf(stderr, "Error linking a captured program: %s\n", log);
+    exit(1);
+}
+
+// The hidden window must be as large as the captured one, for the same
+// number of fragments to be shaded
+static void gl_replay_fit_window(GlReplay* replay, i32 width, i32 height) {
+    i32 drawable_width = 0, drawable_height = 0;
+    SDL_GL_GetDrawableSize(replay->window, &drawable_width, &drawable_height);
+    if (width <= drawable_width && height <= drawable_height) return;
+
+    SDL_SetWindowSize(replay->window, MAX(width, drawable_width),
+                      MAX(height, drawable_height));
+}
+
+// Executes the next record, returns its op
+static GlCaptureOp gl_replay_next(GlReplay* replay) {
+    GlCaptureRecord record;
+    if (replay->cursor + sizeof(record) > replay->end) {
+        fprintf(stderr, "Truncated capture\n");
+        exit(1);
+    }
+    memcpy(&record, replay->cursor, sizeof(record));
+
+    const u32* const a = (const u32*)(replay->cursor + sizeof(record));
+    const u8* const data = (const u8*)(a + record.arg_count);
+    const usize padded = ((usize)record.data_size + 3) & ~(usize)3;
+    if (data + padded > replay->end || record.op >= GL_CAPTURE_OP_COUNT) {
+        fprintf(stderr, "Truncated or corrupt capture\n");
+        exit(1);
+    }
+    replay->cursor = data + padded;
+    replay->calls += 1;
+
+    const void* const bytes = record.data_size > 0 ? data : NULL;
+    switch ((GlCaptureOp)record.op) {
+        case GL_CAPTURE_RANGE_BEGIN:
+        case GL_CAPTURE_FRAME_END:
+            break;
+
+        case GL_CAPTURE_GEN_BUFFERS:
+            gl_replay_gen(&replay->buffers, a, record.arg_count,
+                          glGenBuffers);
+            break;
+        case GL_CAPTURE_GEN_TEXTURES:
+            gl_replay_gen(&replay->textures, a, record.arg_count,
+                          glGenTextures);
+            break;
+        case GL_CAPTURE_GEN_VERTEX_ARRAYS:
+            gl_replay_gen(&replay->vertex_arrays, a, record.arg_count,
+                          glGenVertexArrays);
+            break;
+        case GL_CAPTURE_DELETE_BUFFERS:
+            gl_replay_delete(&replay->buffers, a, record.arg_count,
+                             glDeleteBuffers);
+            break;
+        case GL_CAPTURE_DELETE_TEXTURES:
+            gl_replay_delete(&replay->textures, a, record.arg_count,
+                             glDeleteTextures);
+            break;
+        case GL_CAPTURE_DELETE_VERTEX_ARRAYS:
+            gl_replay_delete(&replay->vertex_arrays, a, record.arg_count,
+                             glDeleteVertexArrays);
+            break;
+        case GL_CAPTURE_CREATE_SHADER:
+            gl_replay_map_set(&replay->shaders, a[1], glCreateShader(a[0]));
+            break;
+        case GL_CAPTURE_SHADER_SOURCE: {
+            const GLchar* const source = (const GLchar*)data;
+            glShaderSource(gl_replay_map_get(&replay->shaders, a[0]), 1,
+                           &source, NULL);
+            break;
+        }
+        case GL_CAPTURE_COMPILE_SHADER: {
+            const GLuint shader = gl_replay_map_get(&replay->shaders, a[0]);
+            glCompileShader(shader);
+            gl_replay_check_shader(shader);
+            break;
+        }
+        case GL_CAPTURE_DELETE_SHADER:
+            glDeleteShader(gl_replay_map_get(&replay->shaders, a[0]));
+            gl_replay_map_set(&replay->shaders, a[0], 0);
+            break;
+        case GL_CAPTURE_CREATE_PROGRAM:
+            gl_replay_map_set(&replay->programs, a[0], glCreateProgram());
+            break;
+        case GL_CAPTURE_ATTACH_SHADER:
+            glAttachShader(gl_replay_map_get(&replay->programs, a[0]),
+                           gl_replay_map_get(&replay->shaders, a[1]));
+            break;
+        case GL_CAPTURE_DETACH_SHADER:
+            glDetachShader(gl_replay_map_get(&replay->programs, a[0]),
+                           gl_replay_map_get(&replay->shaders, a[1]));
+            break;
+        case GL_CAPTURE_LINK_PROGRAM: {
+            const GLuint program = gl_replay_map_get(&replay->programs, a[0]);
+            glLinkProgram(program);
+            gl_replay_check_program(program);
+            break;
+        }
+        case GL_CAPTURE_TRANSFORM_FEEDBACK_VARYINGS: {
+            // Back to an array of the names
+            const GLchar* varyings[GL_REPLAY_MAX_VARYINGS];
+            GLsizei count = 0;
+            for (u32 offset = 0; offset < record.data_size &&
+                                 count < GL_REPLAY_MAX_VARYINGS;) {
+                const GLchar* const name = (const GLchar*)data + offset;
+                varyings[count++] = name;
+                offset += (u32)strlen(name) + 1;
+            }
+            glTransformFeedbackVaryings(
+                gl_replay_map_get(&replay->programs, a[0]), count, varyings,
+                a[1]);
+            break;
+        }
+        case GL_CAPTURE_DELETE_PROGRAM:
+            glDeleteProgram(gl_replay_map_get(&replay->programs, a[0]));
+            gl_replay_map_set(&replay->programs, a[0], 0);
+            break;
+        case GL_CAPTURE_GEN_FRAMEBUFFERS:
+            gl_replay_gen(&replay->framebuffers, a, record.arg_count,
+                          glGenFramebuffers);
+            break;
+        case GL_CAPTURE_DELETE_FRAMEBUFFERS:
+            gl_replay_delete(&replay->framebuffers, a, record.arg_count,
+                             glDeleteFramebuffers);
+            break;
+        case GL_CAPTURE_GEN_RENDERBUFFERS:
+            gl_replay_gen(&replay->renderbuffers, a, record.arg_count,
+                          glGenRenderbuffers);
+            break;
+        case GL_CAPTURE_DELETE_RENDERBUFFERS:
+            gl_replay_delete(&replay->renderbuffers, a, record.arg_count,
+                             glDeleteRenderbuffers);
+            break;
+        case GL_CAPTURE_RENDERBUFFER_STORAGE:
+            glRenderbufferStorage(a[0], a[1], (GLsizei)a[2], (GLsizei)a[3]);
+            break;
+        case GL_CAPTURE_FRAMEBUFFER_RENDERBUFFER:
+            glFramebufferRenderbuffer(
+                a[0], a[1], a[2],
+                gl_replay_map_get(&replay->renderbuffers, a[3]));
+            break;
+        case GL_CAPTURE_GET_UNIFORM_LOCATION: {
+            const GLint location = glGetUniformLocation(
+                gl_replay_map_get(&replay->programs, a[0]),
+                (const GLchar*)data);
+            gl_replay_location_add(replay, a[0], (GLint)a[1], location);
+            break;
+        }
+
+        case GL_CAPTURE_BIND_BUFFER:
+            glBindBuffer(a[0], gl_replay_map_get(&replay->buffers, a[1]));
+            break;
+        case GL_CAPTURE_BIND_TEXTURE:
+            glBindTexture(a[0], gl_replay_map_get(&replay->textures, a[1]));
+            break;
+        case GL_CAPTURE_ACTIVE_TEXTURE:
+            glActiveTexture(a[0]);
+            break;
+        case GL_CAPTURE_BIND_VERTEX_ARRAY:
+            glBindVertexArray(gl_replay_map_get(&replay->vertex_arrays, a[0]));
+            break;
+        case GL_CAPTURE_USE_PROGRAM:
+            glUseProgram(gl_replay_map_get(&replay->programs, a[0]));
+            replay->program = a[0];
+            break;
+        case GL_CAPTURE_BIND_FRAMEBUFFER:
+            glBindFramebuffer(a[0],
+                              gl_replay_map_get(&replay->framebuffers, a[1]));
+            break;
+        case GL_CAPTURE_BIND_RENDERBUFFER:
+            glBindRenderbuffer(a[0],
+                               gl_replay_map_get(&replay->renderbuffers, a[1]));
+            break;
+        case GL_CAPTURE_BIND_BUFFER_BASE:
+            glBindBufferBase(a[0], a[1],
+                             gl_replay_map_get(&replay->buffers, a[2]));
+            break;
+
+        case GL_CAPTURE_UNIFORM_MATRIX4FV:
+            glUniformMatrix4fv(gl_replay_location(replay, (GLint)a[0]),
+                               (GLsizei)a[1], (GLboolean)a[2],
+                               (const GLfloat*)data);
+            break;
+        case GL_CAPTURE_UNIFORM_4FV:
+            glUniform4fv(gl_replay_location(replay, (GLint)a[0]),
+                         (GLsizei)a[1], (const GLfloat*)data);
+            break;
+        case GL_CAPTURE_UNIFORM_1I:
+            glUniform1i(gl_replay_location(replay, (GLint)a[0]), (GLint)a[1]);
+            break;
+
+        case GL_CAPTURE_BUFFER_DATA:
+            glBufferData(a[0], (GLsizeiptr)gl_replay_u64(&a[1]), bytes, a[3]);
+            break;
+        case GL_CAPTURE_BUFFER_SUB_DATA:
+            glBufferSubData(a[0], (GLintptr)gl_replay_u64(&a[1]),
+                            (GLsizeiptr)record.data_size, data);
+            break;
+        case GL_CAPTURE_TEX_IMAGE_2D: {
+            // Without data, the offset in the unpack buffer
+            const void* const pixels =
+                bytes ? bytes : (const void*)(uintptr_t)gl_replay_u64(&a[8]);
+            glTexImage2D(a[0], (GLint)a[1], (GLint)a[2], (GLsizei)a[3],
+                         (GLsizei)a[4], (GLint)a[5], a[6], a[7], pixels);
+            break;
+        }
+        case GL_CAPTURE_TEX_IMAGE_3D: {
+            const void* const pixels =
+                bytes ? bytes : (const void*)(uintptr_t)gl_replay_u64(&a[9]);
+            glTexImage3D(a[0], (GLint)a[1], (GLint)a[2], (GLsizei)a[3],
+                         (GLsizei)a[4], (GLsizei)a[5], (GLint)a[6], a[7],
+                         a[8], pixels);
+            break;
+        }
+        case GL_CAPTURE_TEX_PARAMETERI:
+            glTexParameteri(a[0], a[1], (GLint)a[2]);
+            break;
+        case GL_CAPTURE_GENERATE_MIPMAP:
+            glGenerateMipmap(a[0]);
+            break;
+        case GL_CAPTURE_TEX_BUFFER:
+            glTexBuffer(a[0], a[1], gl_replay_map_get(&replay->buffers, a[2]));
+            break;
+
+        case GL_CAPTURE_ENABLE:
+            glEnable(a[0]);
+            break;
+        case GL_CAPTURE_DISABLE:
+            glDisable(a[0]);
+            break;
+        case GL_CAPTURE_VIEWPORT:
+            gl_replay_fit_window(replay, (i32)(a[0] + a[2]),
+                                 (i32)(a[1] + a[3]));
+            glViewport((GLint)a[0], (GLint)a[1], (GLsizei)a[2],
+                       (GLsizei)a[3]);
+            break;
+        case GL_CAPTURE_CLEAR_COLOR:
+            glClearColor(gl_replay_f32(a[0]), gl_replay_f32(a[1]),
+                         gl_replay_f32(a[2]), gl_replay_f32(a[3]));
+            break;
+        case GL_CAPTURE_ENABLE_VERTEX_ATTRIB_ARRAY:
+            glEnableVertexAttribArray(a[0]);
+            break;
+        case GL_CAPTURE_VERTEX_ATTRIB_POINTER:
+            glVertexAttribPointer(a[0], (GLint)a[1], a[2], (GLboolean)a[3],
+                                  (GLsizei)a[4],
+                                  (const void*)(uintptr_t)gl_replay_u64(
+                                      &a[5]));
+            break;
+        case GL_CAPTURE_VERTEX_ATTRIB_DIVISOR:
+            glVertexAttribDivisor(a[0], a[1]);
+            break;
+        case GL_CAPTURE_BLEND_FUNC:
+            glBlendFunc(a[0], a[1]);
+            break;
+        case GL_CAPTURE_DEPTH_MASK:
+            glDepthMask((GLboolean)a[0]);
+            break;
+
+        case GL_CAPTURE_CLEAR:
+            glClear(a[0]);
+            break;
+        case GL_CAPTURE_DRAW_ARRAYS:
+            glDrawArrays(a[0], (GLint)a[1], (GLsizei)a[2]);
+            break;
+        case GL_CAPTURE_DRAW_ARRAYS_INSTANCED:
+            glDrawArraysInstanced(a[0], (GLint)a[1], (GLsizei)a[2],
+                                  (GLsizei)a[3]);
+            break;
+        case GL_CAPTURE_BEGIN_TRANSFORM_FEEDBACK:
+            glBeginTransformFeedback(a[0]);
+            break;
+        case GL_CAPTURE_END_TRANSFORM_FEEDBACK:
+            glEndTransformFeedback();
+            break;
+        case GL_CAPTURE_FLUSH:
+            glFlush();
+            break;
+        case GL_CAPTURE_FINISH:
+            glFinish();
+            break;
+        case GL_CAPTURE_BLIT_FRAMEBUFFER:
+            // Into the window when upscaling
+            gl_replay_fit_window(replay, (i32)MAX(a[4], a[6]),
+                                 (i32)MAX(a[5], a[7]));
+            glBlitFramebuffer((GLint)a[0], (GLint)a[1], (GLint)a[2],
+                              (GLint)a[3], (GLint)a[4], (GLint)a[5],
+                              (GLint)a[6], (GLint)a[7], a[8], a[9]);
+            break;
+        case GL_CAPTURE_READ_PIXELS:
+            glReadPixels((GLint)a[0], (GLint)a[1], (GLsizei)a[2],
+                         (GLsizei)a[3], a[4], a[5],
+                         (void*)(uintptr_t)gl_replay_u64(&a[6]));
+            break;
+
+        case GL_CAPTURE_OP_COUNT:
+            break;
+    }
+
+    return (GlCaptureOp)record.op;
+}
+
+static f64 gl_replay_ms(u64 start, u64 end) {
+    return (f64)(end - start) * 1000.0 / (f64)SDL_GetPerformanceFrequency();
+}
+
+static u8* gl_replay_read(const char* path, usize* size) {
+    FILE* const file = fopen(path, "rb");
+    if (!file) {
+        fprintf(stderr, "Could not open %s: %s\n", path, strerror(errno));
+        exit(errno);
+    }
+    fseek(file, 0, SEEK_END);
+    const long length = ftell(file);
+    fclose(file);
+    if (length < 0) exit(EIO);
+
+    u8* const content = ogl_malloc((usize)length);
+    if (file_read(path, content, (usize)length, size) != 0) exit(EIO);
+    return content;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <capture> [repeat]\n", argv[0]);
+        return 1;
+    }
+    const u32 repeat = argc > 2 ? (u32)strtoul(argv[2], NULL, 10) : 1;
+
+    usize size = 0;
+    u8* const content = gl_replay_read(argv[1], &size);
+
+    GlCaptureHeader header;
+    if (size < sizeof(header)) {
+        fprintf(stderr, "Not a GL capture: %s\n", argv[1]);
+        return 1;
+    }
+    memcpy(&header, content, sizeof(header));
+    if (memcmp(header.magic, GL_CAPTURE_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != GL_CAPTURE_VERSION) {
+        fprintf(stderr, "Not a GL capture, or of another version: %s\n",
+                argv[1]);
+        return 1;
+    }
+    if (header.frame_count == 0) {
+        fprintf(stderr, "No frame in the capture\n");
+        return 1;
+    }
+
+    SDL_Window* window = NULL;
+    SDL_GLContext* context = NULL;
+    if (!gl_init(&window, &context, true)) return 1;
+    SDL_GL_SetSwapInterval(0);
+
+    GlReplay replay = {
+        .window = window,
+        .cursor = content + sizeof(header),
+        .end = content + size,
+    };
+
+    // Setup, up to the captured frames
+    const u64 setup_start = SDL_GetPerformanceCounter();
+    while (gl_replay_next(&replay) != GL_CAPTURE_RANGE_BEGIN) {
+    }
+    glFinish();
+    const f64 setup_ms =
+        gl_replay_ms(setup_start, SDL_GetPerformanceCounter());
+    printf("Replay: capture=%s size=%zu first_frame=%u frames=%u "
+           "setup=%.3fms\n",
+           argv[1], size, header.first_frame, header.frame_count, setup_ms);
+
+    const u8* const range = replay.cursor;
+    f64 issue_total = 0, total = 0, total_min = INFINITY, total_max = 0;
+    for (u32 r = 0; r < repeat; r++) {
+        replay.cursor = range;
+
+        for (u32 frame = 0; frame < header.frame_count; frame++) {
+            replay.calls = 0;
+            const u64 start = SDL_GetPerformanceCounter();
+            while (gl_replay_next(&replay) != GL_CAPTURE_FRAME_END) {
+            }
+            const u64 issued = SDL_GetPerformanceCounter();
+            glFinish();
+            const u64 end = SDL_GetPerformanceCounter();
+
+            const f64 issue_ms = gl_replay_ms(start, issued);
+            const f64 frame_ms = gl_replay_ms(start, end);
+            issue_total += issue_ms;
+            total += frame_ms;
+            if (frame_ms < total_min) total_min = frame_ms;
+            if (frame_ms > total_max) total_max = frame_ms;
+
+            if (r == 0) {
+                printf("Replay: frame=%u calls=%u issue=%.3fms "
+                       "total=%.3fms\n",
+                       header.first_frame + frame, replay.calls, issue_ms,
+                       frame_ms);
+            }
+        }
+    }
+
+    const f64 n = (f64)repeat * header.frame_count;
+    if (n > 0) {
+        printf("Replay: repeat=%u mean_issue=%.3fms mean=%.3fms min=%.3fms "
+               "max=%.3fms\n",
+               repeat, issue_total / n, total / n, total_min, total_max);
+    }
+
+    gl_drop(window, context);
+    free(content);
+    return 0;
+}
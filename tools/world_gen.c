@@ -0,0 +1,38 @@
+// Writes a random world of cubes (see world_file.h), to stream with
+// `WORLD=<path>`. The grid is square, and the chunks have from a quarter of
+// `chunk_instances` to all of them: the default is 256x256 chunks of 32
+// units, about 10M cubes in 430MB.
+//
+// Usage, from anywhere:
+//   world_gen <path> [chunks per side] [chunk_instances] [materials] [seed]
+
+#include <stdio.h>
+
+#include "../utils.h"
+#include "../world_file.h"
+
+static u32 world_gen_arg(int argc, char* argv[], int i, u32 fallback) {
+    return argc > i ? (u32)strtoul(argv[i], NULL, 10) : fallback;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        fprintf(stderr,
+                "Usage: %s <path> [chunks per side] [chunk_instances] "
+                "[materials] [seed]\n",
+                argv[0]);
+        return 1;
+    }
+
+    const u32 side = world_gen_arg(argc, argv, 2, 256);
+    const WorldDesc desc = {
+        .grid_width = MAX(side, 1),
+        .grid_depth = MAX(side, 1),
+        .chunk_size = 32.0f,
+        .chunk_instances = MAX(world_gen_arg(argc, argv, 3, 256), 1),
+        .material_count =
+            CLAMP(world_gen_arg(argc, argv, 4, 1), 1, WORLD_MAX_MATERIALS),
+        .seed = MAX(world_gen_arg(argc, argv, 5, 1), 1),
+    };
+    return world_file_write(argv[1], &desc);
+}
@@ -0,0 +1,239 @@
+#include "trace.h"
+
+#include <SDL2/SDL.h>
+#include <assert.h>
+#include <stdio.h>
+
+typedef enum {
+    TRACE_PHASE_BEGIN,
+    TRACE_PHASE_END,
+    TRACE_PHASE_COMPLETE,  // GPU zones, with a duration
+} TracePhase;
+
+typedef struct {
+    u64 timestamp;  // Trace clock, ns
+    u64 duration;
+    const char* name;
+    u32 track;  // Thread index, or TRACE_MAX_THREADS + GPU track
+    u32 phase;
+} TraceEvent;
+
+typedef struct {
+    TraceEvent* events;
+    // Written by the owner thread only, read by the dump
+    SDL_atomic_t head;
+    u32 index;
+    SDL_threadID thread_id;
+    const char* name;
+} TraceRing;
+
+typedef struct {
+    const char* name;
+    i64 offset_ns;  // cpu - gpu
+    _Bool calibrated;
+} TraceGpuTrack;
+
+_Bool trace_enabled = false;
+
+static struct {
+    const char* path;
+    u64 start;
+    u64 frequency;
+    SDL_TLSID tls;
+
+    TraceRing rings[TRACE_MAX_THREADS];
+    SDL_atomic_t ring_count;
+
+    TraceGpuTrack gpu_tracks[TRACE_MAX_GPU_TRACKS];
+    u32 gpu_track_count;
+} trace;
+
+void trace_init(void) {
+    trace.path = getenv("TRACE");
+    if (!trace.path) return;
+
+    trace.start = SDL_GetPerformanceCounter();
+    trace.frequency = SDL_GetPerformanceFrequency();
+    trace.tls = SDL_TLSCreate();
+    trace_enabled = true;
+    printf("Trace: path=%s\n", trace.path);
+}
+
+void trace_shutdown(void) {
+    if (!trace_enabled) return;
+
+    trace_dump(trace.path);
+    trace_enabled = false;
+    for (u32 i = 0; i < TRACE_MAX_THREADS; i++) free(trace.rings[i].events);
+}
+
+u64 trace_now(void) {
+    const u64 ticks = SDL_GetPerformanceCounter() - trace.start;
+    // Split to avoid overflowing the multiplication
+    return ticks / trace.frequency * 1000000000ULL +
+           ticks % trace.frequency * 1000000000ULL / trace.frequency;
+}
+
+// Registers the calling thread on its first event
+static TraceRing* trace_ring(void) {
+    TraceRing* ring = SDL_TLSGet(trace.tls);
+    if (ring) return ring;
+
+    const u32 index = (u32)SDL_AtomicAdd(&trace.ring_count, 1);
+    if (index >= TRACE_MAX_THREADS) return NULL;
+
+    ring = &trace.rings[index];
+    ring->events = ogl_malloc(sizeof(TraceEvent) * TRACE_RING_CAPACITY);
+    ring->index = index;
+    ring->thread_id = SDL_ThreadID();
+    SDL_TLSSet(trace.tls, ring, NULL);
+    return ring;
+}
+
+static void trace_push(TraceRing* ring, const TraceEvent* event) {
+    const u32 head = (u32)SDL_AtomicGet(&ring->head);
+    ring->events[head & (TRACE_RING_CAPACITY - 1)] = *event;
+    // Publishes the event, SDL atomics are full barriers
+    SDL_AtomicSet(&ring->head, (int)(head + 1));
+}
+
+void trace_begin(const char* name) {
+    TraceRing* const ring = trace_ring();
+    if (!ring) return;
+
+    const TraceEvent event = {.timestamp = trace_now(),
+                              .name = name,
+                              .track = ring->index,
+                              .phase = TRACE_PHASE_BEGIN};
+    trace_push(ring, &event);
+}
+
+void trace_end(void) {
+    TraceRing* const ring = trace_ring();
+    if (!ring) return;
+
+    const TraceEvent event = {.timestamp = trace_now(),
+                              .track = ring->index,
+                              .phase = TRACE_PHASE_END};
+    trace_push(ring, &event);
+}
+
+void trace_thread_name(const char* name) {
+    if (!trace_enabled) return;
+
+    TraceRing* const ring = trace_ring();
+    if (ring) ring->name = name;
+}
+
+//
+// GPU
+//
+u32 trace_gpu_track(const char* name) {
+    assert(trace.gpu_track_count < TRACE_MAX_GPU_TRACKS);
+    trace.gpu_tracks[trace.gpu_track_count].name = name;
+    return trace.gpu_track_count++;
+}
+
+void trace_gpu_calibrate(u32 track, u64 gpu_ns, u64 cpu_ns) {
+    TraceGpuTrack* const t = &trace.gpu_tracks[track];
+    t->offset_ns = (i64)cpu_ns - (i64)gpu_ns;
+    t->calibrated = true;
+}
+
+void trace_gpu_bound(u32 track, u64 gpu_ns, u64 cpu_ns) {
+    TraceGpuTrack* const t = &trace.gpu_tracks[track];
+    const i64 offset = (i64)cpu_ns - (i64)gpu_ns;
+    if (!t->calibrated || offset > t->offset_ns) t->offset_ns = offset;
+    t->calibrated = true;
+}
+
+void trace_gpu_zone(u32 track, const char* name, u64 gpu_begin_ns,
+                    u64 gpu_end_ns) {
+    TraceRing* const ring = trace_ring();
+    const TraceGpuTrack* const t = &trace.gpu_tracks[track];
+    if (!ring || !t->calibrated) return;
+
+    const i64 begin = (i64)gpu_begin_ns + t->offset_ns;
+    if (begin < 0) return;  // Before the trace started
+
+    const TraceEvent event = {.timestamp = (u64)begin,
+                              .duration = gpu_end_ns - gpu_begin_ns,
+                              .name = name,
+                              .track = TRACE_MAX_THREADS + track,
+                              .phase = TRACE_PHASE_COMPLETE};
+    trace_push(ring, &event);
+}
+
+//
+// Export
+//
+static void trace_write_event(FILE* file, const TraceEvent* event,
+                              _Bool* first) {
+    static const char* const phases[] = {
+        [TRACE_PHASE_BEGIN] = "B",
+        [TRACE_PHASE_END] = "E",
+        [TRACE_PHASE_COMPLETE] = "X",
+    };
+
+    // Microseconds
+    fprintf(file, "%s\n{\"ph\":\"%s\",\"pid\":1,\"tid\":%u,\"ts\":%.3f",
+            *first ? "" : ",", phases[event->phase], event->track,
+            (f64)event->timestamp / 1e3);
+    if (event->name) fprintf(file, ",\"name\":\"%s\"", event->name);
+    if (event->phase == TRACE_PHASE_COMPLETE)
+        fprintf(file, ",\"dur\":%.3f", (f64)event->duration / 1e3);
+    fprintf(file, "}");
+    *first = false;
+}
+
+static void trace_write_track_name(FILE* file, u32 track, const char* name,
+                                   _Bool* first) {
+    fprintf(file,
+            "%s\n{\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"name\":\"thread_name\","
+            "\"args\":{\"name\":\"%s\"}}",
+            *first ? "" : ",", track, name);
+    *first = false;
+}
+
+_Bool trace_dump(const char* path) {
+    if (!trace_enabled) return false;
+
+    FILE* const file = fopen(path, "w");
+    if (!file) {
+        fprintf(stderr, "Could not open %s: %s\n", path, strerror(errno));
+        return false;
+    }
+
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+    _Bool first = true;
+    u64 event_count = 0;
+
+    const u32 ring_count =
+        MIN((u32)SDL_AtomicGet(&trace.ring_count), TRACE_MAX_THREADS);
+    for (u32 i = 0; i < ring_count; i++) {
+        const TraceRing* const ring = &trace.rings[i];
+        char name[64];
+        snprintf(name, sizeof(name), "%s (%lu)",
+                 ring->name ? ring->name : "thread",
+                 (unsigned long)ring->thread_id);
+        trace_write_track_name(file, i, name, &first);
+
+        const u32 head = (u32)SDL_AtomicGet((SDL_atomic_t*)&ring->head);
+        const u32 tail =
+            head > TRACE_RING_CAPACITY ? head - TRACE_RING_CAPACITY : 0;
+        for (u32 j = tail; j != head; j++) {
+            trace_write_event(
+                file, &ring->events[j & (TRACE_RING_CAPACITY - 1)], &first);
+        }
+        event_count += head - tail;
+    }
+    for (u32 i = 0; i < trace.gpu_track_count; i++)
+        trace_write_track_name(file, TRACE_MAX_THREADS + i,
+                               trace.gpu_tracks[i].name, &first);
+
+    fprintf(file, "\n]}\n");
+    fclose(file);
+
+    printf("Trace: wrote %" PRIu64 " events to %s\n", event_count, path);
+    return true;
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include "utils.h"
+
+// Timeline capture of CPU zones and GPU zones, exported as Chrome trace
+// event JSON (chrome://tracing, ui.perfetto.dev).
+//
+// Every thread writes into its own ring buffer, without locks: only the
+// oldest events are lost when one wraps around. When tracing is off, a zone
+// costs one load and one branch; defining TRACE_DISABLE compiles them out.
+//
+// GPU timestamps are moved onto the CPU clock of the trace with a per track
+// offset, see `trace_gpu_calibrate` and `trace_gpu_bound`.
+//
+// Zones must be closed on the thread which opened them, in reverse order.
+
+#define TRACE_MAX_THREADS 16
+#define TRACE_MAX_GPU_TRACKS 4
+// Events per thread, power of 2
+#define TRACE_RING_CAPACITY (1 << 16)
+
+extern _Bool trace_enabled;
+
+// From `TRACE=<path>`, the trace is written there by `trace_shutdown`.
+// Must be called before the other threads start.
+void trace_init(void);
+void trace_shutdown(void);
+
+// Nanoseconds on the trace clock
+u64 trace_now(void);
+
+// `name` must outlive the trace, e.g. a string literal
+void trace_begin(const char* name);
+void trace_end(void);
+void trace_thread_name(const char* name);
+
+// A timeline for the zones of one GPU queue
+u32 trace_gpu_track(const char* name);
+// Both clocks read at the same time: offset = cpu - gpu
+void trace_gpu_calibrate(u32 track, u64 gpu_ns, u64 cpu_ns);
+// Without a shared clock: the GPU started `gpu_ns` after the CPU reached
+// `cpu_ns`, so the tightest of these bounds is kept as the offset
+void trace_gpu_bound(u32 track, u64 gpu_ns, u64 cpu_ns);
+void trace_gpu_zone(u32 track, const char* name, u64 gpu_begin_ns,
+                    u64 gpu_end_ns);
+
+// Writes every buffered event, false on failure. Other threads keep
+// recording meanwhile, the events they write during the dump may be torn.
+_Bool trace_dump(const char* path);
+
+#ifdef TRACE_DISABLE
+#define TRACE_BEGIN(name) ((void)0)
+#define TRACE_END() ((void)0)
+#else
+#define TRACE_BEGIN(name)                     \
+    do {                                      \
+        if (trace_enabled) trace_begin(name); \
+    } while (0)
+#define TRACE_END()                     \
+    do {                                \
+        if (trace_enabled) trace_end(); \
+    } while (0)
+#endif
@@ -18,8 +18,10 @@ typedef uint32_t u32;
 typedef uint16_t u16;
 typedef uint8_t u8;
 typedef float f32;
+typedef double f64;
 
-#define MIN(a, b) ((a) < (b)) ? (a) : (b)
+#define MIN(a, b) (((a) < (b)) ? (a) : (b))
+#define MAX(a, b) (((a) > (b)) ? (a) : (b))
 #define CLAMP(x, xmin, xmax) \
     ((x) < (xmin) ? (xmin) : (x) > (xmax) ? (xmax) : (x))
 
@@ -0,0 +1,20 @@
+#version 450
+
+// Specialization constants, see vk_pipeline.h
+layout(constant_id = 0) const bool TEXTURED = true;
+
+layout(location = 0) in vec2 fragUV;
+layout(location = 1) in vec3 fragColor;
+layout(location = 0) out vec4 outColor;
+
+layout(set = 1, binding = 0) uniform sampler2D texture_sampler;
+
+void main() {
+    vec3 color = fragColor;
+    // Dead code eliminated when the pipeline is specialized
+    if (TEXTURED)
+        color *= texture(texture_sampler, fragUV).rgb;
+    else
+        color *= vec3(fragUV, 0.5);
+    outColor = vec4(color, 1.0);
+}
@@ -0,0 +1,36 @@
+#version 450
+
+// Specialization constants, see vk_pipeline.h
+layout(constant_id = 1) const bool INSTANCE_COLORS = false;
+
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec2 inUV;
+layout(location = 0) out vec2 fragUV;
+layout(location = 1) out vec3 fragColor;
+
+layout(set = 0, binding = 0) uniform FrameUniforms {
+    mat4 view_projection;
+} frame;
+
+// Region of the current frame, selected by the dynamic offset
+layout(std430, set = 0, binding = 1) readonly buffer Objects {
+    mat4 models[];
+} objects;
+
+layout(push_constant) uniform DrawPushConstants {
+    uint object_index;
+} draw;
+
+void main() {
+    const uint index = draw.object_index + gl_InstanceIndex;
+    const mat4 model = objects.models[index];
+    gl_Position = frame.view_projection * model * vec4(inPosition, 1.0);
+    fragUV = inUV;
+
+    fragColor = vec3(1.0);
+    if (INSTANCE_COLORS) {
+        // Cheap hash of the index, to tell the instances apart
+        fragColor = vec3((index * 37u) % 255u, (index * 91u) % 255u,
+                         (index * 173u) % 255u) / 255.0;
+    }
+}
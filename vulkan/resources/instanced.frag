@@ -0,0 +1,10 @@
+#version 450
+
+layout(location = 0) in vec2 fragUV;
+layout(location = 0) out vec4 outColor;
+
+layout(set = 0, binding = 0) uniform sampler2D texture_sampler;
+
+void main() {
+    outColor = vec4(texture(texture_sampler, fragUV).rgb, 1.0);
+}
@@ -0,0 +1,18 @@
+#version 450
+
+// Shared renderer (../renderer.h): per instance model matrices in a vertex
+// stream, like resources/instanced_vertex.glsl
+
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec2 inUV;
+layout(location = 2) in mat4 inModel;
+layout(location = 0) out vec2 fragUV;
+
+layout(push_constant) uniform FramePushConstants {
+    mat4 view_projection;
+} frame;
+
+void main() {
+    gl_Position = frame.view_projection * inModel * vec4(inPosition, 1.0);
+    fragUV = inUV;
+}
@@ -0,0 +1,11 @@
+#version 450
+
+// UV and texture array layer
+layout(location = 0) in vec3 fragUV;
+layout(location = 0) out vec4 outColor;
+
+layout(set = 0, binding = 0) uniform sampler2DArray texture_sampler;
+
+void main() {
+    outColor = vec4(texture(texture_sampler, fragUV).rgb, 1.0);
+}
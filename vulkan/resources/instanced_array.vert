@@ -0,0 +1,21 @@
+#version 450
+
+// Shared renderer (../renderer.h): instanced.vert with a material per
+// instance, like resources/instanced_array_vertex.glsl
+
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec2 inUV;
+layout(location = 2) in mat4 inModel;
+// RendererInstanceMaterial
+layout(location = 6) in vec4 inUVRect;
+layout(location = 7) in float inLayer;
+layout(location = 0) out vec3 fragUV;
+
+layout(push_constant) uniform FramePushConstants {
+    mat4 view_projection;
+} frame;
+
+void main() {
+    gl_Position = frame.view_projection * inModel * vec4(inPosition, 1.0);
+    fragUV = vec3(inUVRect.xy + inUV * inUVRect.zw, inLayer);
+}
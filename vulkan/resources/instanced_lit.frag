@@ -0,0 +1,66 @@
+#version 450
+
+// Clustered forward lighting, like resources/instanced_lit_fragment.glsl.
+// Must match ../renderer.h.
+const uvec3 clusters = uvec3(16, 9, 24);
+const vec3 ambient = vec3(0.05);
+
+layout(location = 0) in vec2 fragUV;
+layout(location = 1) in vec3 fragPosition;
+layout(location = 0) out vec4 outColor;
+
+layout(set = 0, binding = 0) uniform sampler2D texture_sampler;
+
+struct Light {
+    vec4 position_radius;
+    vec4 color;
+};
+layout(std430, set = 1, binding = 0) readonly buffer Lights {
+    Light lights[];
+};
+// Per cluster, first index and count
+layout(std430, set = 1, binding = 1) readonly buffer LightRanges {
+    uvec2 light_ranges[];
+};
+// 16 bits, two per element
+layout(std430, set = 1, binding = 2) readonly buffer LightIndices {
+    uint light_indices[];
+};
+
+// After the view projection of the vertex stage
+layout(push_constant) uniform LightPushConstants {
+    layout(offset = 64) vec4 depth_plane;
+    vec4 cluster_scale;
+} frame;
+
+void main() {
+    vec3 albedo = texture(texture_sampler, fragUV).rgb;
+
+    // Flat, the meshes have no normals. The window origin is at the top
+    // left, the tiles count from the bottom like in OpenGL.
+    vec3 normal = normalize(cross(dFdy(fragPosition), dFdx(fragPosition)));
+
+    float depth = dot(frame.depth_plane, vec4(fragPosition, 1.0));
+    uvec3 cluster = uvec3(
+        uvec2(gl_FragCoord.xy * frame.cluster_scale.xy),
+        uint(max(log(depth) * frame.cluster_scale.z + frame.cluster_scale.w,
+                 0.0)));
+    cluster = min(cluster, clusters - 1u);
+    cluster.y = clusters.y - 1u - cluster.y;
+    uvec2 range = light_ranges[
+        (cluster.z * clusters.y + cluster.y) * clusters.x + cluster.x];
+
+    vec3 lit = ambient * albedo;
+    for (uint i = 0u; i < range.y; i++) {
+        uint index = range.x + i;
+        uint light = (light_indices[index / 2u] >> (16u * (index % 2u))) &
+                     0xffffu;
+        vec3 to_light = lights[light].position_radius.xyz - fragPosition;
+        float light_distance = length(to_light);
+        float falloff = clamp(
+            1.0 - light_distance / lights[light].position_radius.w, 0.0, 1.0);
+        lit += albedo * lights[light].color.rgb * falloff * falloff *
+               max(dot(normal, to_light / light_distance), 0.0);
+    }
+    outColor = vec4(lit, 1.0);
+}
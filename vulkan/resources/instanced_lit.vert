@@ -0,0 +1,21 @@
+#version 450
+
+// Shared renderer (../renderer.h): like instanced.vert, with the world
+// position for the lighting
+
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec2 inUV;
+layout(location = 2) in mat4 inModel;
+layout(location = 0) out vec2 fragUV;
+layout(location = 1) out vec3 fragPosition;
+
+layout(push_constant) uniform FramePushConstants {
+    mat4 view_projection;
+} frame;
+
+void main() {
+    vec4 position = inModel * vec4(inPosition, 1.0);
+    gl_Position = frame.view_projection * position;
+    fragUV = inUV;
+    fragPosition = position.xyz;
+}
@@ -0,0 +1,213 @@
+#include "vk_descriptors.h"
+
+#include <assert.h>
+#include <stdio.h>
+
+void vk_descriptors_init(Descriptors* descriptors, VkDevice* device) {
+    memset(descriptors, 0, sizeof(Descriptors));
+    descriptors->device = *device;
+
+    //
+    // Set layouts
+    //
+    const VkDescriptorSetLayoutBinding frame_bindings[2] = {
+        {
+            .binding = 0,
+            .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+            .descriptorCount = 1,
+            .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
+        },
+        {
+            .binding = 1,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC,
+            .descriptorCount = 1,
+            .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
+        },
+    };
+    const VkDescriptorSetLayoutCreateInfo frame_layout_create_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .bindingCount = ARR_SIZE(frame_bindings),
+        .pBindings = frame_bindings,
+    };
+    assert(!vkCreateDescriptorSetLayout(*device, &frame_layout_create_info,
+                                        NULL, &descriptors->frame_layout));
+
+    const VkDescriptorSetLayoutBinding material_binding = {
+        .binding = 0,
+        .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+        .descriptorCount = 1,
+        .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+    };
+    const VkDescriptorSetLayoutCreateInfo material_layout_create_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .bindingCount = 1,
+        .pBindings = &material_binding,
+    };
+    assert(!vkCreateDescriptorSetLayout(*device, &material_layout_create_info,
+                                        NULL, &descriptors->material_layout));
+
+    //
+    // Pipeline layout
+    //
+    const VkDescriptorSetLayout set_layouts[2] = {
+        [DESCRIPTOR_SET_FRAME] = descriptors->frame_layout,
+        [DESCRIPTOR_SET_MATERIAL] = descriptors->material_layout,
+    };
+    const VkPushConstantRange push_constant_range = {
+        .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
+        .offset = 0,
+        .size = sizeof(DrawPushConstants),
+    };
+    const VkPipelineLayoutCreateInfo pipeline_layout_create_info = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        .setLayoutCount = ARR_SIZE(set_layouts),
+        .pSetLayouts = set_layouts,
+        .pushConstantRangeCount = 1,
+        .pPushConstantRanges = &push_constant_range,
+    };
+    assert(!vkCreatePipelineLayout(*device, &pipeline_layout_create_info, NULL,
+                                   &descriptors->pipeline_layout));
+
+    //
+    // Pools
+    //
+    const VkDescriptorPoolSize frame_pool_sizes[2] = {
+        {.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+         .descriptorCount = DESCRIPTOR_POOL_MAX_SETS},
+        {.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC,
+         .descriptorCount = DESCRIPTOR_POOL_MAX_SETS},
+    };
+    const VkDescriptorPoolCreateInfo frame_pool_create_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .maxSets = DESCRIPTOR_POOL_MAX_SETS,
+        .poolSizeCount = ARR_SIZE(frame_pool_sizes),
+        .pPoolSizes = frame_pool_sizes,
+    };
+    for (u32 i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        assert(!vkCreateDescriptorPool(*device, &frame_pool_create_info, NULL,
+                                       &descriptors->frame_pools[i]));
+    }
+
+    const VkDescriptorPoolSize persistent_pool_size = {
+        .type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+        .descriptorCount = DESCRIPTOR_POOL_MAX_SETS};
+    const VkDescriptorPoolCreateInfo persistent_pool_create_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .maxSets = DESCRIPTOR_POOL_MAX_SETS,
+        .poolSizeCount = 1,
+        .pPoolSizes = &persistent_pool_size,
+    };
+    assert(!vkCreateDescriptorPool(*device, &persistent_pool_create_info, NULL,
+                                   &descriptors->persistent_pool));
+
+    printf("Created descriptor set layouts and pools\n");
+}
+
+void vk_descriptors_destroy(Descriptors* descriptors) {
+    const VkDevice device = descriptors->device;
+
+    for (u32 i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+        vkDestroyDescriptorPool(device, descriptors->frame_pools[i], NULL);
+    vkDestroyDescriptorPool(device, descriptors->persistent_pool, NULL);
+    vkDestroyPipelineLayout(device, descriptors->pipeline_layout, NULL);
+    vkDestroyDescriptorSetLayout(device, descriptors->material_layout, NULL);
+    vkDestroyDescriptorSetLayout(device, descriptors->frame_layout, NULL);
+}
+
+void vk_descriptors_frame_begin(Descriptors* descriptors, u32 frame) {
+    assert(frame < MAX_FRAMES_IN_FLIGHT);
+    assert(!vkResetDescriptorPool(descriptors->device,
+                                  descriptors->frame_pools[frame], 0));
+    descriptors->frame_sets_allocated = 0;
+}
+
+static VkDescriptorSet vk_descriptors_allocate(VkDevice device,
+                                               VkDescriptorPool pool,
+                                               VkDescriptorSetLayout layout) {
+    const VkDescriptorSetAllocateInfo allocate_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .descriptorPool = pool,
+        .descriptorSetCount = 1,
+        .pSetLayouts = &layout,
+    };
+
+    VkDescriptorSet set;
+    assert(!vkAllocateDescriptorSets(device, &allocate_info, &set));
+    return set;
+}
+
+VkDescriptorSet vk_descriptors_frame_set(Descriptors* descriptors, u32 frame,
+                                         VkBuffer uniform_buffer,
+                                         VkDeviceSize uniform_offset,
+                                         VkDeviceSize uniform_range,
+                                         VkBuffer object_buffer,
+                                         VkDeviceSize object_range) {
+    assert(descriptors->frame_sets_allocated < DESCRIPTOR_POOL_MAX_SETS);
+
+    const VkDescriptorSet set = vk_descriptors_allocate(
+        descriptors->device, descriptors->frame_pools[frame],
+        descriptors->frame_layout);
+    descriptors->frame_sets_allocated += 1;
+
+    const VkDescriptorBufferInfo uniform_info = {
+        .buffer = uniform_buffer,
+        .offset = uniform_offset,
+        .range = uniform_range,
+    };
+    // The offset is supplied at bind time
+    const VkDescriptorBufferInfo object_info = {
+        .buffer = object_buffer,
+        .offset = 0,
+        .range = object_range,
+    };
+    const VkWriteDescriptorSet writes[2] = {
+        {
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .dstSet = set,
+            .dstBinding = 0,
+            .descriptorCount = 1,
+            .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+            .pBufferInfo = &uniform_info,
+        },
+        {
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .dstSet = set,
+            .dstBinding = 1,
+            .descriptorCount = 1,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC,
+            .pBufferInfo = &object_info,
+        },
+    };
+    vkUpdateDescriptorSets(descriptors->device, ARR_SIZE(writes), writes, 0,
+                           NULL);
+
+    return set;
+}
+
+VkDescriptorSet vk_descriptors_material_set(Descriptors* descriptors,
+                                            VkImageView image_view,
+                                            VkSampler sampler) {
+    assert(descriptors->persistent_sets_allocated < DESCRIPTOR_POOL_MAX_SETS);
+
+    const VkDescriptorSet set = vk_descriptors_allocate(
+        descriptors->device, descriptors->persistent_pool,
+        descriptors->material_layout);
+    descriptors->persistent_sets_allocated += 1;
+
+    const VkDescriptorImageInfo image_info = {
+        .sampler = sampler,
+        .imageView = image_view,
+        .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+    };
+    const VkWriteDescriptorSet write = {
+        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .dstSet = set,
+        .dstBinding = 0,
+        .descriptorCount = 1,
+        .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+        .pImageInfo = &image_info,
+    };
+    vkUpdateDescriptorSets(descriptors->device, 1, &write, 0, NULL);
+
+    return set;
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include <vulkan/vulkan.h>
+
+#include "../utils.h"
+#include "vk_utils.h"
+
+// Set 0, changes every frame: per-frame uniform buffer (binding 0) and the
+// per-object storage buffer (binding 1), bound with a dynamic offset
+// selecting the frame's region.
+// Set 1, changes per material: combined image sampler (binding 0).
+#define DESCRIPTOR_SET_FRAME 0
+#define DESCRIPTOR_SET_MATERIAL 1
+
+#define DESCRIPTOR_POOL_MAX_SETS 64
+
+// Per draw data, the fast path: no descriptor is touched between draws
+typedef struct {
+    u32 object_index;
+} DrawPushConstants;
+
+typedef struct {
+    VkDevice device;
+
+    VkDescriptorSetLayout frame_layout;
+    VkDescriptorSetLayout material_layout;
+    VkPipelineLayout pipeline_layout;
+
+    // Transient sets, the whole pool is reset when the frame comes around
+    VkDescriptorPool frame_pools[MAX_FRAMES_IN_FLIGHT];
+    // Long lived sets (materials)
+    VkDescriptorPool persistent_pool;
+
+    u32 frame_sets_allocated;
+    u32 persistent_sets_allocated;
+} Descriptors;
+
+void vk_descriptors_init(Descriptors* descriptors, VkDevice* device);
+void vk_descriptors_destroy(Descriptors* descriptors);
+
+// Must be called once the GPU is done with this frame's previous use
+void vk_descriptors_frame_begin(Descriptors* descriptors, u32 frame);
+
+VkDescriptorSet vk_descriptors_frame_set(Descriptors* descriptors, u32 frame,
+                                         VkBuffer uniform_buffer,
+                                         VkDeviceSize uniform_offset,
+                                         VkDeviceSize uniform_range,
+                                         VkBuffer object_buffer,
+                                         VkDeviceSize object_range);
+
+VkDescriptorSet vk_descriptors_material_set(Descriptors* descriptors,
+                                            VkImageView image_view,
+                                            VkSampler sampler);
@@ -0,0 +1,325 @@
+#include "vk_device.h"
+
+#include <SDL2/SDL_vulkan.h>
+#include <assert.h>
+#include <stdio.h>
+
+SDL_Window* vk_window_create(void) {
+    SDL_SetHint(SDL_HINT_FRAMEBUFFER_ACCELERATION, "1");
+    if (SDL_Init(SDL_INIT_VIDEO) < 0) {
+        fprintf(stderr, "Unable to initialize SDL: %s", SDL_GetError());
+        exit(1);
+    }
+
+    u32 flags = SDL_WINDOW_SHOWN | SDL_WINDOW_RESIZABLE | SDL_WINDOW_VULKAN;
+    const char window_title[] = "hello";
+    const u16 window_width = 1024;
+    const u16 window_height = 768;
+    SDL_Window* window = SDL_CreateWindow(window_title, SDL_WINDOWPOS_CENTERED,
+                                          SDL_WINDOWPOS_CENTERED, window_width,
+                                          window_height, flags);
+
+    if (!window) {
+        fprintf(stderr, "Unable to create window: %s", SDL_GetError());
+        exit(1);
+    }
+
+    return window;
+}
+
+void vk_get_extensions(SDL_Window* window,
+                       const char* extension_names[MAX_EXTENSIONS],
+                       u32* extension_count) {
+    extension_names[*extension_count] = VK_KHR_SURFACE_EXTENSION_NAME;
+    *extension_count = *extension_count + 1;
+
+    u32 detected_extension_count = 64 - *extension_count;
+    if (!SDL_Vulkan_GetInstanceExtensions(window, &detected_extension_count,
+                                          &extension_names[*extension_count])) {
+        fprintf(stderr, "SDL_GetVulkanInstanceExtensions failed: %s\n",
+                SDL_GetError());
+        exit(1);
+    }
+    *extension_count += detected_extension_count;
+
+    printf("Instance extensions: count=%u\n", *extension_count);
+    for (u32 i = 0; i < *extension_count; i++) {
+        printf("Extension: %s\n", extension_names[i]);
+    }
+}
+
+void vk_get_validation_layers(const char* validation_layer) {
+    VkLayerProperties layers[MAX_LAYERS];
+    u32 layer_count;
+
+    vkEnumerateInstanceLayerProperties(&layer_count, NULL);
+    assert(layer_count < MAX_LAYERS);
+    printf("Available layers: %u\n", layer_count);
+
+    vkEnumerateInstanceLayerProperties(&layer_count, layers);
+
+    _Bool found = false;
+    for (u32 i = 0; i < layer_count; i++) {
+        printf("Available layer: %s\n", layers[i].layerName);
+
+        if (strcmp(validation_layer, layers[i].layerName) == 0) {
+            found = true;
+            break;
+        }
+    }
+    if (!found) {
+        fprintf(stderr, "Validation layer not found\n");
+    }
+    printf("Validation layer found, activating\n");
+}
+
+void vk_create_instance(VkInstance* instance,
+                        const char* extension_names[MAX_EXTENSIONS],
+                        u32 extension_count, const char* validation_layer,
+                        u32 validation_layer_count) {
+    const VkApplicationInfo app_info = {
+        .sType = VK_STRUCTURE_TYPE_APPLICATION_INFO,
+        .apiVersion = VK_MAKE_VERSION(1, 0, 0)};
+
+    const VkInstanceCreateInfo instance_create_info = {
+        .sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO,
+        .pApplicationInfo = &app_info,
+        .enabledExtensionCount = extension_count,
+        .ppEnabledExtensionNames = extension_names,
+        .enabledLayerCount = validation_layer_count,
+        .ppEnabledLayerNames = &validation_layer};
+
+    assert(!vkCreateInstance(&instance_create_info, NULL, instance));
+}
+
+void vk_create_physical_device(VkInstance* instance, VkPhysicalDevice* gpu) {
+    u32 gpu_count;
+    assert(!vkEnumeratePhysicalDevices(*instance, &gpu_count, NULL));
+
+    if (gpu_count == 0) {
+        fprintf(stderr, "No GPUs detected\n");
+        exit(1);
+    } else {
+        VkPhysicalDevice gpus[gpu_count];
+        assert(!vkEnumeratePhysicalDevices(*instance, &gpu_count, gpus));
+        *gpu = gpus[0];
+    }
+    printf("GPUs detected: %u\n", gpu_count);
+}
+
+u32 vk_find_queue_family(VkPhysicalDevice* gpu, VkSurfaceKHR* surface) {
+    u32 queue_family_index = UINT32_MAX;
+    u32 queue_count;
+
+    vkGetPhysicalDeviceQueueFamilyProperties(*gpu, &queue_count, NULL);
+    VkQueueFamilyProperties queue_properties[queue_count];
+    vkGetPhysicalDeviceQueueFamilyProperties(*gpu, &queue_count,
+
+                                             queue_properties);
+
+    if (queue_count == 0) {
+        fprintf(stderr, "No queue family properties were found\n");
+        exit(1);
+    }
+    printf("Found %u family properties\n", queue_count);
+
+    for (u32 i = 0; i < queue_count; i++) {
+        VkBool32 supported = VK_TRUE;
+        if (surface)
+            vkGetPhysicalDeviceSurfaceSupportKHR(*gpu, i, *surface,
+                                                 &supported);
+
+        if (supported &&
+            (queue_properties[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) != 0) {
+            queue_family_index = i;
+            break;
+        }
+    }
+
+    if (queue_family_index == UINT32_MAX) {
+        fprintf(stderr, "No proper queue family found\n");
+        exit(1);
+    }
+
+    return queue_family_index;
+}
+
+void vk_create_logical_device(VkPhysicalDevice* gpu, u32 queue_family_index,
+                              _Bool swapchain, VkDevice* device) {
+    u32 extension_count = 0;
+
+    const char* extension_names[MAX_EXTENSIONS];
+    if (swapchain)
+        extension_names[extension_count++] = VK_KHR_SWAPCHAIN_EXTENSION_NAME;
+
+    f32 queue_priorities[1] = {0.0};
+    const VkDeviceQueueCreateInfo queue_info = {
+        .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+        .queueFamilyIndex = queue_family_index,
+        .queueCount = 1,
+        .pQueuePriorities = queue_priorities};
+
+    const VkDeviceCreateInfo device_create_info = {
+        .sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
+        .queueCreateInfoCount = 1,
+        .pQueueCreateInfos = &queue_info,
+        .enabledExtensionCount = extension_count,
+        .ppEnabledExtensionNames = extension_names,
+    };
+
+    assert(!vkCreateDevice(*gpu, &device_create_info, NULL, device));
+}
+
+void vk_create_command_pool(VkDevice* device, u32 queue_family_index,
+                            VkCommandPool* command_pool) {
+    const VkCommandPoolCreateInfo command_pool_create_info = {
+
+        .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+        .queueFamilyIndex = queue_family_index,
+        .flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT};
+
+    assert(!vkCreateCommandPool(*device, &command_pool_create_info, NULL,
+                                command_pool));
+}
+
+void vk_get_color_info(VkPhysicalDevice* gpu, VkSurfaceKHR* surface,
+                       VkFormat* format, u32* format_count,
+                       VkColorSpaceKHR* color_space) {
+    assert(!vkGetPhysicalDeviceSurfaceFormatsKHR(*gpu, *surface, format_count,
+                                                 NULL));
+
+    printf("Found %d formats\n", *format_count);
+
+    VkSurfaceFormatKHR formats[*format_count];
+
+    assert(!vkGetPhysicalDeviceSurfaceFormatsKHR(*gpu, *surface, format_count,
+                                                 formats));
+
+    if (*format_count == 0) {
+        fprintf(stderr, "Found zero format\n");
+        exit(1);
+    }
+
+    if (*format_count == 1 && formats[0].format == VK_FORMAT_UNDEFINED) {
+        printf(
+            "Found only one format which is undefined,defaulting to "
+            "VK_FORMAT_B8G8R8A8_SRGB\n");
+        *format = VK_FORMAT_B8G8R8A8_SRGB;
+    } else {
+        *format = formats[0].format;
+    }
+
+    *color_space = formats[0].colorSpace;
+    printf("Format: %d\n", *format);
+    printf("Color space: %d\n", *color_space);
+}
+
+void vk_create_shader_module(VkDevice* device, const char path[], u8* buffer,
+                             usize buffer_capacity, usize* buffer_len,
+                             VkShaderModule* shader_module) {
+    if (file_read(path, buffer, buffer_capacity, buffer_len) != 0) {
+        exit(errno);
+    }
+
+    VkShaderModuleCreateInfo create_info = {
+        .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+        .codeSize = *buffer_len,
+        .pCode = (u32*)buffer,
+    };
+
+    assert(!vkCreateShaderModule(*device, &create_info, NULL, shader_module));
+    memset(buffer, 0, buffer_capacity);
+
+    printf("Created shader module for `%s`\n", path);
+}
+
+void vk_create_shader_stages(
+    VkShaderModule* vert_shader_module, VkShaderModule* frag_shader_module,
+    VkPipelineShaderStageCreateInfo shader_stages[2]) {
+    const VkPipelineShaderStageCreateInfo vert_shader_stage_info = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+        .stage = VK_SHADER_STAGE_VERTEX_BIT,
+        .module = *vert_shader_module,
+        .pName = "main"  // Entrypoint function
+    };
+
+    const VkPipelineShaderStageCreateInfo frag_shader_stage_info = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+        .stage = VK_SHADER_STAGE_FRAGMENT_BIT,
+        .module = *frag_shader_module,
+        .pName = "main"  // Entrypoint function
+    };
+
+    shader_stages[0] = vert_shader_stage_info;
+    shader_stages[1] = frag_shader_stage_info;
+}
+
+void vk_swapchain_create(VkDevice* device, VkPhysicalDevice* gpu,
+                         VkSurfaceKHR surface, SDL_Window* window,
+                         VkFormat format, VkColorSpaceKHR color_space,
+                         Swapchain* swapchain) {
+    memset(swapchain, 0, sizeof(Swapchain));
+    swapchain->format = format;
+
+    VkSurfaceCapabilitiesKHR surface_capabilities;
+    assert(!vkGetPhysicalDeviceSurfaceCapabilitiesKHR(*gpu, surface,
+                                                      &surface_capabilities));
+
+    // Get drawing surface dimensions
+    if (surface_capabilities.currentExtent.width == (UINT32_MAX)) {
+        i32 w, h;
+        SDL_GetWindowSize(window, &w, &h);
+        printf("Window size as reported by the SDL: w=%d h=%d\n", w, h);
+        swapchain->extent.width = (u32)w;
+        swapchain->extent.height = (u32)h;
+    } else {
+        swapchain->extent = surface_capabilities.currentExtent;
+        printf("Window size as reported by Vulkan: w=%u h=%u\n",
+               swapchain->extent.width, swapchain->extent.height);
+    }
+
+    u32 image_count = surface_capabilities.minImageCount + 1;
+
+    if ((surface_capabilities.maxImageCount > 0) &&
+        (image_count > surface_capabilities.maxImageCount)) {
+        image_count = surface_capabilities.maxImageCount;
+    }
+
+    const VkSwapchainCreateInfoKHR swapchain_create_info = {
+        .sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR,
+        .surface = surface,
+        .minImageCount = image_count,
+        .imageFormat = format,
+        .imageColorSpace = color_space,
+        .imageExtent = swapchain->extent,
+        .imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
+        .preTransform = surface_capabilities.currentTransform,
+        .compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR,
+        .imageArrayLayers = 1,
+        .imageSharingMode = VK_SHARING_MODE_EXCLUSIVE,
+        .presentMode = VK_PRESENT_MODE_FIFO_KHR,
+        .clipped = 1};
+
+    assert(!vkCreateSwapchainKHR(*device, &swapchain_create_info, NULL,
+                                 &swapchain->swapchain));
+
+    assert(!vkGetSwapchainImagesKHR(*device, swapchain->swapchain,
+                                    &swapchain->image_count, NULL));
+    assert(swapchain->image_count <= MAX_SWAPCHAIN_IMAGES);
+    assert(!vkGetSwapchainImagesKHR(*device, swapchain->swapchain,
+                                    &swapchain->image_count,
+                                    swapchain->images));
+    printf("Swapchain image count: %u\n", swapchain->image_count);
+
+    for (u32 i = 0; i < swapchain->image_count; i++) {
+        vk_image_view_create(device, swapchain->images[i], format,
+                             VK_IMAGE_ASPECT_COLOR_BIT, &swapchain->views[i]);
+        printf("Initialized image view #%u\n", i);
+    }
+}
+
+void vk_swapchain_destroy(VkDevice* device, Swapchain* swapchain) {
+    for (u32 i = 0; i < swapchain->image_count; i++)
+        vkDestroyImageView(*device, swapchain->views[i], NULL);
+    vkDestroySwapchainKHR(*device, swapchain->swapchain, NULL);
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include <SDL2/SDL.h>
+#include <vulkan/vulkan.h>
+
+#include "../utils.h"
+#include "vk_utils.h"
+
+#define MAX_EXTENSIONS 64
+#define MAX_LAYERS 64
+#define MAX_SWAPCHAIN_IMAGES 8
+
+typedef struct {
+    VkSwapchainKHR swapchain;
+    VkFormat format;
+    VkExtent2D extent;
+    u32 image_count;
+    VkImage images[MAX_SWAPCHAIN_IMAGES];
+    VkImageView views[MAX_SWAPCHAIN_IMAGES];
+} Swapchain;
+
+SDL_Window* vk_window_create(void);
+
+void vk_get_extensions(SDL_Window* window,
+                       const char* extension_names[MAX_EXTENSIONS],
+                       u32* extension_count);
+void vk_get_validation_layers(const char* validation_layer);
+void vk_create_instance(VkInstance* instance,
+                        const char* extension_names[MAX_EXTENSIONS],
+                        u32 extension_count, const char* validation_layer,
+                        u32 validation_layer_count);
+void vk_create_physical_device(VkInstance* instance, VkPhysicalDevice* gpu);
+
+// When `surface` is NULL (headless), any graphics queue family will do
+u32 vk_find_queue_family(VkPhysicalDevice* gpu, VkSurfaceKHR* surface);
+void vk_create_logical_device(VkPhysicalDevice* gpu, u32 queue_family_index,
+                              _Bool swapchain, VkDevice* device);
+void vk_create_command_pool(VkDevice* device, u32 queue_family_index,
+                            VkCommandPool* command_pool);
+void vk_get_color_info(VkPhysicalDevice* gpu, VkSurfaceKHR* surface,
+                       VkFormat* format, u32* format_count,
+                       VkColorSpaceKHR* color_space);
+
+void vk_create_shader_module(VkDevice* device, const char path[], u8* buffer,
+                             usize buffer_capacity, usize* buffer_len,
+                             VkShaderModule* shader_module);
+void vk_create_shader_stages(
+    VkShaderModule* vert_shader_module, VkShaderModule* frag_shader_module,
+    VkPipelineShaderStageCreateInfo shader_stages[2]);
+
+// FIFO presentation, one view per image
+void vk_swapchain_create(VkDevice* device, VkPhysicalDevice* gpu,
+                         VkSurfaceKHR surface, SDL_Window* window,
+                         VkFormat format, VkColorSpaceKHR color_space,
+                         Swapchain* swapchain);
+void vk_swapchain_destroy(VkDevice* device, Swapchain* swapchain);
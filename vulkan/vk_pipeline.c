@@ -0,0 +1,355 @@
+#include "vk_pipeline.h"
+
+#include <assert.h>
+#include <cglm/cglm.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "../mesh.h"
+#include "../renderer.h"
+#include "../trace.h"
+
+void vk_pipeline_create(VkDevice* device,
+                        VkPipelineShaderStageCreateInfo shader_stages[2],
+                        VkRenderPass render_pass,
+                        VkPipelineLayout pipeline_layout,
+                        const VkSpecializationInfo* specialization,
+                        PipelineStreams streams, _Bool quantized,
+                        VkPipelineCache cache, VkPipeline* pipeline) {
+    // Constants which a stage does not declare are ignored by it
+    VkPipelineShaderStageCreateInfo stages[2] = {shader_stages[0],
+                                                 shader_stages[1]};
+    stages[0].pSpecializationInfo = specialization;
+    stages[1].pSpecializationInfo = specialization;
+
+    //
+    // Fixed functions
+    //
+
+    const VkPipelineViewportStateCreateInfo viewport_state = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
+        .viewportCount = 1,
+        .scissorCount = 1,
+    };
+
+    const VkPipelineRasterizationStateCreateInfo rasterizer = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
+        .polygonMode = VK_POLYGON_MODE_FILL,
+        .lineWidth = 1.0f,
+        .cullMode = VK_CULL_MODE_BACK_BIT,
+        // Same winding as OpenGL since the projection flips y
+        .frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE,
+    };
+
+    const VkPipelineDepthStencilStateCreateInfo depth_stencil = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO,
+        .depthTestEnable = VK_TRUE,
+        .depthWriteEnable = VK_TRUE,
+        .depthCompareOp = VK_COMPARE_OP_LESS,
+    };
+
+    const VkPipelineMultisampleStateCreateInfo multisampling = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
+        .rasterizationSamples = VK_SAMPLE_COUNT_1_BIT,
+        .minSampleShading = 1.0f,
+    };
+
+    const VkPipelineColorBlendAttachmentState color_blend_attachment = {
+        .colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
+                          VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT,
+        .srcColorBlendFactor = VK_BLEND_FACTOR_ONE,
+        .dstColorBlendFactor = VK_BLEND_FACTOR_ZERO,
+        .colorBlendOp = VK_BLEND_OP_ADD,
+        .srcAlphaBlendFactor = VK_BLEND_FACTOR_ZERO,
+        .dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO,
+        .alphaBlendOp = VK_BLEND_OP_ADD,
+    };
+
+    const VkPipelineColorBlendStateCreateInfo color_blending = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
+        .logicOp = VK_LOGIC_OP_COPY,
+        .attachmentCount = 1,
+        .pAttachments = &color_blend_attachment,
+    };
+
+    // Positions and UVs live in separate streams, like in `gl_loop`, followed
+    // by the model matrices and the materials of the instances
+    const VkVertexInputBindingDescription vertex_binding_descriptions[4] = {
+        {.binding = 0,
+         .stride = quantized ? sizeof(MeshQuantizedPosition) : sizeof(vec3),
+         .inputRate = VK_VERTEX_INPUT_RATE_VERTEX},
+        {.binding = 1,
+         .stride = quantized ? sizeof(MeshQuantizedUv) : sizeof(vec2),
+         .inputRate = VK_VERTEX_INPUT_RATE_VERTEX},
+        {.binding = 2,
+         .stride = sizeof(mat4),
+         .inputRate = VK_VERTEX_INPUT_RATE_INSTANCE},
+        {.binding = 3,
+         .stride = sizeof(RendererInstanceMaterial),
+         .inputRate = VK_VERTEX_INPUT_RATE_INSTANCE}};
+
+    VkVertexInputAttributeDescription vertex_attribute_descriptions[8] = {
+        // Position
+        {.format = quantized ? VK_FORMAT_R16G16B16A16_SNORM
+                             : VK_FORMAT_R32G32B32_SFLOAT,
+         .binding = 0,
+         .location = 0,
+         .offset = 0},
+
+        // UV
+        {.location = 1,
+         .binding = 1,
+         .format = quantized ? VK_FORMAT_R16G16_UNORM
+                             : VK_FORMAT_R32G32_SFLOAT,
+         .offset = 0}};
+
+    // Model matrix, one location per column
+    for (u32 i = 0; i < 4; i++) {
+        VkVertexInputAttributeDescription* const column =
+            &vertex_attribute_descriptions[2 + i];
+        column->location = 2 + i;
+        column->binding = 2;
+        column->format = VK_FORMAT_R32G32B32A32_SFLOAT;
+        column->offset = i * (u32)sizeof(vec4);
+    }
+
+    // Material, UV rectangle then layer
+    vertex_attribute_descriptions[6] = (VkVertexInputAttributeDescription){
+        .location = 6,
+        .binding = 3,
+        .format = VK_FORMAT_R32G32B32A32_SFLOAT,
+        .offset = offsetof(RendererInstanceMaterial, uv_rect),
+    };
+    vertex_attribute_descriptions[7] = (VkVertexInputAttributeDescription){
+        .location = 7,
+        .binding = 3,
+        .format = VK_FORMAT_R32_SFLOAT,
+        .offset = offsetof(RendererInstanceMaterial, layer),
+    };
+
+    // Shader input
+    const u32 binding_counts[] = {
+        [PIPELINE_STREAMS_VERTICES] = 2,
+        [PIPELINE_STREAMS_INSTANCED] = 3,
+        [PIPELINE_STREAMS_INSTANCE_MATERIALS] = 4,
+    };
+    const u32 attribute_counts[] = {
+        [PIPELINE_STREAMS_VERTICES] = 2,
+        [PIPELINE_STREAMS_INSTANCED] = 6,
+        [PIPELINE_STREAMS_INSTANCE_MATERIALS] = 8,
+    };
+    const VkPipelineVertexInputStateCreateInfo vertex_input_info = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
+        .vertexBindingDescriptionCount = binding_counts[streams],
+        .vertexAttributeDescriptionCount = attribute_counts[streams],
+        .pVertexBindingDescriptions = vertex_binding_descriptions,
+        .pVertexAttributeDescriptions = vertex_attribute_descriptions,
+    };
+
+    const VkPipelineInputAssemblyStateCreateInfo input_assembly = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
+        .topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
+        .primitiveRestartEnable = VK_FALSE,
+    };
+
+    // Dynamic state
+    const VkDynamicState dynamic_states[2] = {VK_DYNAMIC_STATE_VIEWPORT,
+                                              VK_DYNAMIC_STATE_SCISSOR};
+
+    VkPipelineDynamicStateCreateInfo dynamic_states_create_info = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
+        .pDynamicStates = dynamic_states,
+        .dynamicStateCount = ARR_SIZE(dynamic_states),
+    };
+
+    //
+    // Graphics pipeline
+    //
+    const VkGraphicsPipelineCreateInfo pipeline_info = {
+        .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+        .stageCount = 2,
+        .pStages = stages,
+        .pVertexInputState = &vertex_input_info,
+        .pInputAssemblyState = &input_assembly,
+        .pViewportState = &viewport_state,
+        .pRasterizationState = &rasterizer,
+        .pMultisampleState = &multisampling,
+        .pDepthStencilState = &depth_stencil,
+        .pColorBlendState = &color_blending,
+        .layout = pipeline_layout,
+        .renderPass = render_pass,
+        .pDynamicState = &dynamic_states_create_info,
+    };
+
+    assert(!vkCreateGraphicsPipelines(*device, cache, 1, &pipeline_info, NULL,
+                                      pipeline));
+}
+
+
+static u64 variant_hash(const PipelineVariantKey* key) {
+    // FNV-1a
+    u64 hash = 14695981039346656037ULL;
+    const u8* const bytes = (const u8*)key->values;
+    for (usize i = 0; i < sizeof(key->values); i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+static void vk_pipeline_variant_compile(PipelineVariants* variants,
+                                        PipelineVariant* variant) {
+    VkSpecializationMapEntry entries[SPEC_CONSTANT_COUNT];
+    for (u32 i = 0; i < SPEC_CONSTANT_COUNT; i++) {
+        entries[i] = (VkSpecializationMapEntry){
+            .constantID = i,
+            .offset = i * (u32)sizeof(u32),
+            .size = sizeof(u32),
+        };
+    }
+    const VkSpecializationInfo specialization = {
+        .mapEntryCount = SPEC_CONSTANT_COUNT,
+        .pMapEntries = entries,
+        .dataSize = sizeof(variant->key.values),
+        .pData = variant->key.values,
+    };
+
+    const u64 start = SDL_GetPerformanceCounter();
+    vk_pipeline_create(&variants->device, variants->shader_stages,
+                       variants->render_pass, variants->layout,
+                       &specialization, PIPELINE_STREAMS_VERTICES, false,
+                       variants->cache,
+                       &variant->pipeline);
+    variant->compile_ms = (f64)(SDL_GetPerformanceCounter() - start) *
+                          1000.0 / (f64)SDL_GetPerformanceFrequency();
+
+    SDL_AtomicSet(&variant->ready, 1);
+}
+
+static int vk_pipeline_worker(void* data) {
+    PipelineVariants* const variants = data;
+    trace_thread_name("pipeline_worker");
+
+    for (;;) {
+        SDL_LockMutex(variants->mutex);
+        while (!variants->quit && variants->queue_head == variants->queue_tail)
+            SDL_CondWait(variants->cond, variants->mutex);
+
+        if (variants->quit) {
+            SDL_UnlockMutex(variants->mutex);
+            return 0;
+        }
+        const u32 index =
+            variants->queue[variants->queue_head % PIPELINE_MAX_VARIANTS];
+        variants->queue_head += 1;
+        SDL_UnlockMutex(variants->mutex);
+
+        TRACE_BEGIN("pipeline_compile");
+        vk_pipeline_variant_compile(variants, &variants->variants[index]);
+        TRACE_END();
+    }
+}
+
+void vk_pipeline_variants_init(
+    PipelineVariants* variants, VkDevice* device,
+    VkPipelineShaderStageCreateInfo shader_stages[2], VkRenderPass render_pass,
+    VkPipelineLayout layout, const PipelineVariantKey* default_key) {
+    memset(variants, 0, sizeof(PipelineVariants));
+    variants->device = *device;
+    variants->shader_stages[0] = shader_stages[0];
+    variants->shader_stages[1] = shader_stages[1];
+    variants->render_pass = render_pass;
+    variants->layout = layout;
+
+    const VkPipelineCacheCreateInfo cache_create_info = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+    };
+    assert(!vkCreatePipelineCache(*device, &cache_create_info, NULL,
+                                  &variants->cache));
+
+    // The default variant is the fallback, it must exist before the first
+    // frame
+    PipelineVariant* const fallback = &variants->variants[0];
+    fallback->key = *default_key;
+    fallback->hash = variant_hash(default_key);
+    vk_pipeline_variant_compile(variants, fallback);
+    variants->variant_count = 1;
+    printf("Created graphics pipeline: %.3fms\n", fallback->compile_ms);
+
+    variants->mutex = SDL_CreateMutex();
+    variants->cond = SDL_CreateCond();
+    assert(variants->mutex && variants->cond);
+    for (u32 i = 0; i < PIPELINE_WORKER_COUNT; i++) {
+        variants->workers[i] =
+            SDL_CreateThread(vk_pipeline_worker, "pipeline_worker", variants);
+        assert(variants->workers[i]);
+    }
+}
+
+void vk_pipeline_variants_destroy(PipelineVariants* variants) {
+    SDL_LockMutex(variants->mutex);
+    variants->quit = true;
+    SDL_CondBroadcast(variants->cond);
+    SDL_UnlockMutex(variants->mutex);
+
+    // Waits for the compilations in progress, the queued ones are dropped
+    for (u32 i = 0; i < PIPELINE_WORKER_COUNT; i++)
+        SDL_WaitThread(variants->workers[i], NULL);
+
+    for (u32 i = 0; i < variants->variant_count; i++) {
+        if (SDL_AtomicGet(&variants->variants[i].ready))
+            vkDestroyPipeline(variants->device, variants->variants[i].pipeline,
+                              NULL);
+    }
+    vkDestroyPipelineCache(variants->device, variants->cache, NULL);
+    SDL_DestroyCond(variants->cond);
+    SDL_DestroyMutex(variants->mutex);
+}
+
+VkPipeline vk_pipeline_variants_get(PipelineVariants* variants,
+                                    const PipelineVariantKey* key) {
+    const u64 hash = variant_hash(key);
+
+    PipelineVariant* variant = NULL;
+    for (u32 i = 0; i < variants->variant_count; i++) {
+        if (variants->variants[i].hash == hash &&
+            !memcmp(&variants->variants[i].key, key, sizeof(*key))) {
+            variant = &variants->variants[i];
+            break;
+        }
+    }
+
+    if (!variant) {
+        assert(variants->variant_count < PIPELINE_MAX_VARIANTS);
+        const u32 index = variants->variant_count++;
+        variant = &variants->variants[index];
+        variant->key = *key;
+        variant->hash = hash;
+
+        SDL_LockMutex(variants->mutex);
+        variants->queue[variants->queue_tail % PIPELINE_MAX_VARIANTS] = index;
+        variants->queue_tail += 1;
+        SDL_CondSignal(variants->cond);
+        SDL_UnlockMutex(variants->mutex);
+    }
+
+    if (SDL_AtomicGet(&variant->ready)) return variant->pipeline;
+
+    variants->fallback_count += 1;
+    return variants->variants[0].pipeline;
+}
+
+void vk_pipeline_variants_print(PipelineVariants* variants) {
+    printf("Pipeline variants: count=%u fallbacks=%u\n",
+           variants->variant_count, variants->fallback_count);
+    for (u32 i = 0; i < variants->variant_count; i++) {
+        PipelineVariant* const variant = &variants->variants[i];
+        if (!SDL_AtomicGet(&variant->ready)) continue;
+
+        printf("  hash=%016" PRIx64 " constants=", variant->hash);
+        for (u32 j = 0; j < SPEC_CONSTANT_COUNT; j++)
+            printf("%s%u", j ? "," : "", variant->key.values[j]);
+        printf(" compile=%.3fms\n", variant->compile_ms);
+    }
+}
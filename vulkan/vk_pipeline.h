@@ -0,0 +1,90 @@
+#pragma once
+#include <SDL2/SDL.h>
+#include <vulkan/vulkan.h>
+
+#include "../utils.h"
+
+// Specialization constant ids, shared with resources/cube.{vert,frag}.
+// All of them are 4 bytes (VkBool32 for booleans).
+#define SPEC_TEXTURED 0
+#define SPEC_INSTANCE_COLORS 1
+#define SPEC_CONSTANT_COUNT 2
+
+#define PIPELINE_MAX_VARIANTS 32
+#define PIPELINE_WORKER_COUNT 2
+
+// Vertex streams read by a pipeline, each adds to the previous ones
+typedef enum {
+    // Positions and UVs: bindings 0 and 1, locations 0 and 1
+    PIPELINE_STREAMS_VERTICES,
+    // Model matrix per instance: binding 2, locations 2 to 5
+    PIPELINE_STREAMS_INSTANCED,
+    // RendererInstanceMaterial per instance: binding 3, UV rectangle at
+    // location 6 and texture array layer at 7
+    PIPELINE_STREAMS_INSTANCE_MATERIALS,
+} PipelineStreams;
+
+typedef struct {
+    u32 values[SPEC_CONSTANT_COUNT];
+} PipelineVariantKey;
+
+typedef struct {
+    PipelineVariantKey key;
+    u64 hash;
+    // Set by the worker once `pipeline` is written
+    SDL_atomic_t ready;
+    VkPipeline pipeline;
+    f64 compile_ms;
+} PipelineVariant;
+
+// Pipelines for every combination of specialization constants, built on
+// demand by worker threads. Until a requested variant is ready, the default
+// one (compiled up front) is handed out instead so the frame never waits.
+typedef struct {
+    VkDevice device;
+    // Internally synchronized, shared by the workers
+    VkPipelineCache cache;
+    VkPipelineShaderStageCreateInfo shader_stages[2];
+    VkRenderPass render_pass;
+    VkPipelineLayout layout;
+
+    // The first one is the default variant. Only the render thread adds
+    // variants.
+    PipelineVariant variants[PIPELINE_MAX_VARIANTS];
+    u32 variant_count;
+    u32 fallback_count;  // Requests answered with the default variant
+
+    // Indices of the variants to compile
+    SDL_mutex* mutex;
+    SDL_cond* cond;
+    u32 queue[PIPELINE_MAX_VARIANTS];
+    u32 queue_head, queue_tail;
+    _Bool quit;
+    SDL_Thread* workers[PIPELINE_WORKER_COUNT];
+} PipelineVariants;
+
+// The pipeline state of the cube scene, with the stages specialized by
+// `specialization` (may be NULL), reading the vertex `streams`. Positions
+// and UVs are 32 bits floats, or with `quantized` the 16 bits normalized
+// integers of ../mesh.h.
+void vk_pipeline_create(VkDevice* device,
+                        VkPipelineShaderStageCreateInfo shader_stages[2],
+                        VkRenderPass render_pass,
+                        VkPipelineLayout pipeline_layout,
+                        const VkSpecializationInfo* specialization,
+                        PipelineStreams streams, _Bool quantized,
+                        VkPipelineCache cache, VkPipeline* pipeline);
+
+// The shader modules must outlive the variants
+void vk_pipeline_variants_init(
+    PipelineVariants* variants, VkDevice* device,
+    VkPipelineShaderStageCreateInfo shader_stages[2], VkRenderPass render_pass,
+    VkPipelineLayout layout, const PipelineVariantKey* default_key);
+void vk_pipeline_variants_destroy(PipelineVariants* variants);
+
+// Never blocks: queues the variant for compilation if needed and returns the
+// best pipeline available right now
+VkPipeline vk_pipeline_variants_get(PipelineVariants* variants,
+                                    const PipelineVariantKey* key);
+
+void vk_pipeline_variants_print(PipelineVariants* variants);
@@ -0,0 +1,236 @@
+#include "vk_profiler.h"
+
+#include <SDL2/SDL_timer.h>
+#include <assert.h>
+#include <stdio.h>
+
+#include "../trace.h"
+#include "../utils.h"
+
+void vk_profiler_init(Profiler* profiler, VkPhysicalDevice* gpu,
+                      VkDevice* device, u32 queue_family_index,
+                      u32 report_interval) {
+    memset(profiler, 0, sizeof(Profiler));
+    profiler->device = *device;
+    profiler->report_interval = report_interval;
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(*gpu, &properties);
+
+    u32 queue_count;
+    vkGetPhysicalDeviceQueueFamilyProperties(*gpu, &queue_count, NULL);
+    VkQueueFamilyProperties queue_properties[queue_count];
+    vkGetPhysicalDeviceQueueFamilyProperties(*gpu, &queue_count,
+                                             queue_properties);
+    assert(queue_family_index < queue_count);
+
+    const u32 valid_bits =
+        queue_properties[queue_family_index].timestampValidBits;
+    if (valid_bits == 0 || properties.limits.timestampPeriod == 0.0f) {
+        fprintf(stderr,
+                "Timestamps are not supported by the queue family, GPU "
+                "timings disabled\n");
+        return;
+    }
+
+    profiler->enabled = true;
+    profiler->timestamp_period = properties.limits.timestampPeriod;
+    profiler->timestamp_mask =
+        valid_bits >= 64 ? UINT64_MAX : ((u64)1 << valid_bits) - 1;
+
+    const VkQueryPoolCreateInfo query_pool_create_info = {
+        .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+        .queryType = VK_QUERY_TYPE_TIMESTAMP,
+        .queryCount = PROFILER_FRAME_LAG * PROFILER_MAX_QUERIES,
+    };
+    assert(!vkCreateQueryPool(*device, &query_pool_create_info, NULL,
+                              &profiler->query_pool));
+
+    if (trace_enabled) profiler->trace_track = trace_gpu_track("GPU (Vulkan)");
+
+    printf("Created profiler: timestamp_period=%fns valid_bits=%u\n",
+           (f64)profiler->timestamp_period, valid_bits);
+}
+
+void vk_profiler_destroy(Profiler* profiler) {
+    if (profiler->enabled)
+        vkDestroyQueryPool(profiler->device, profiler->query_pool, NULL);
+    profiler->enabled = false;
+}
+
+static u32 vk_profiler_region_slot(Profiler* profiler, const char* name) {
+    for (u32 i = 0; i < profiler->region_count; i++) {
+        if (profiler->names[i] == name || strcmp(profiler->names[i], name) == 0)
+            return i;
+    }
+
+    if (profiler->region_count == PROFILER_MAX_REGIONS) return UINT32_MAX;
+
+    profiler->names[profiler->region_count] = name;
+    return profiler->region_count++;
+}
+
+// Read the timestamps of the frame which last used this slot, if the GPU is
+// done with them. Never waits.
+static void vk_profiler_collect(Profiler* profiler, u32 slot) {
+    ProfilerFrame* const frame = &profiler->frames[slot];
+    if (frame->query_count == 0) return;
+
+    // Pairs of (timestamp, availability)
+    u64 queries[PROFILER_MAX_QUERIES][2] = {{0}};
+    const VkResult res = vkGetQueryPoolResults(
+        profiler->device, profiler->query_pool, slot * PROFILER_MAX_QUERIES,
+        frame->query_count, sizeof(queries), queries, sizeof(queries[0]),
+        VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+    assert(res == VK_SUCCESS || res == VK_NOT_READY);
+
+    for (u32 i = 0; i < frame->region_count; i++) {
+        const ProfilerRegion* const region = &frame->regions[i];
+        if (region->end_query == UINT32_MAX) continue;  // Never closed
+
+        const u64* const begin = queries[region->begin_query];
+        const u64* const end = queries[region->end_query];
+        if (!begin[1] || !end[1]) continue;
+
+        const u32 j = vk_profiler_region_slot(profiler, region->name);
+        if (j == UINT32_MAX) continue;
+
+        const u64 ticks = (end[0] - begin[0]) & profiler->timestamp_mask;
+        profiler->gpu_ms_sum[j] +=
+            (f64)ticks * (f64)profiler->timestamp_period / 1e6;
+        profiler->gpu_samples[j] += 1;
+
+        if (trace_enabled) {
+            const f64 period = (f64)profiler->timestamp_period;
+            const u64 begin_ns = (u64)((f64)begin[0] * period);
+            // No clock shared with the CPU without an extension: the frame
+            // region bounds the offset
+            if (i == 0)
+                trace_gpu_bound(profiler->trace_track, begin_ns,
+                                frame->recorded_ns);
+            trace_gpu_zone(profiler->trace_track, region->name, begin_ns,
+                           begin_ns + (u64)((f64)ticks * period));
+        }
+    }
+    frame->query_count = 0;
+    frame->region_count = 0;
+}
+
+static void vk_profiler_publish(Profiler* profiler) {
+    ProfilerResults* const results = &profiler->results;
+    memset(results, 0, sizeof(ProfilerResults));
+
+    results->frame_count = profiler->frames_since_report;
+    results->region_count = profiler->region_count;
+    for (u32 i = 0; i < profiler->region_count; i++) {
+        results->names[i] = profiler->names[i];
+        if (profiler->gpu_samples[i] > 0)
+            results->gpu_ms[i] =
+                profiler->gpu_ms_sum[i] / profiler->gpu_samples[i];
+    }
+    for (u32 i = 0; i < PROFILER_CPU_COUNT; i++) {
+        if (profiler->cpu_samples[i] > 0)
+            results->cpu_ms[i] =
+                profiler->cpu_ms_sum[i] / profiler->cpu_samples[i];
+    }
+
+    memset(profiler->gpu_ms_sum, 0, sizeof(profiler->gpu_ms_sum));
+    memset(profiler->gpu_samples, 0, sizeof(profiler->gpu_samples));
+    memset(profiler->cpu_ms_sum, 0, sizeof(profiler->cpu_ms_sum));
+    memset(profiler->cpu_samples, 0, sizeof(profiler->cpu_samples));
+    profiler->frames_since_report = 0;
+    profiler->results_fresh = true;
+}
+
+void vk_profiler_frame_begin(Profiler* profiler, VkCommandBuffer cmd) {
+    profiler->results_fresh = false;
+    profiler->frames_since_report += 1;
+    if (profiler->report_interval > 0 &&
+        profiler->frames_since_report >= profiler->report_interval)
+        vk_profiler_publish(profiler);
+
+    if (!profiler->enabled) return;
+
+    const u32 slot = profiler->current_slot;
+    vk_profiler_collect(profiler, slot);
+
+    vkCmdResetQueryPool(cmd, profiler->query_pool, slot * PROFILER_MAX_QUERIES,
+                        PROFILER_MAX_QUERIES);
+
+    vk_profiler_region_begin(profiler, cmd, "frame");
+}
+
+void vk_profiler_frame_end(Profiler* profiler, VkCommandBuffer cmd) {
+    if (!profiler->enabled) return;
+
+    // The whole frame region is always the first one
+    vk_profiler_region_end(profiler, cmd, 0);
+    if (trace_enabled)
+        profiler->frames[profiler->current_slot].recorded_ns = trace_now();
+    profiler->current_slot = (profiler->current_slot + 1) % PROFILER_FRAME_LAG;
+}
+
+u32 vk_profiler_region_begin(Profiler* profiler, VkCommandBuffer cmd,
+                             const char* name) {
+    if (!profiler->enabled) return UINT32_MAX;
+
+    const u32 slot = profiler->current_slot;
+    ProfilerFrame* const frame = &profiler->frames[slot];
+    if (frame->region_count == PROFILER_MAX_REGIONS ||
+        frame->query_count + 2 > PROFILER_MAX_QUERIES)
+        return UINT32_MAX;
+
+    ProfilerRegion* const region = &frame->regions[frame->region_count];
+    region->name = name;
+    region->begin_query = frame->query_count++;
+    region->end_query = UINT32_MAX;
+
+    vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                        profiler->query_pool,
+                        slot * PROFILER_MAX_QUERIES + region->begin_query);
+
+    return frame->region_count++;
+}
+
+void vk_profiler_region_end(Profiler* profiler, VkCommandBuffer cmd,
+                            u32 region_index) {
+    if (!profiler->enabled || region_index == UINT32_MAX) return;
+
+    const u32 slot = profiler->current_slot;
+    ProfilerFrame* const frame = &profiler->frames[slot];
+    assert(region_index < frame->region_count);
+
+    ProfilerRegion* const region = &frame->regions[region_index];
+    region->end_query = frame->query_count++;
+
+    vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                        profiler->query_pool,
+                        slot * PROFILER_MAX_QUERIES + region->end_query);
+}
+
+u64 vk_profiler_cpu_now(void) { return SDL_GetPerformanceCounter(); }
+
+void vk_profiler_cpu_add(Profiler* profiler, ProfilerCpuTimer timer,
+                         u64 start) {
+    const u64 ticks = SDL_GetPerformanceCounter() - start;
+    profiler->cpu_ms_sum[timer] +=
+        (f64)ticks * 1000.0 / (f64)SDL_GetPerformanceFrequency();
+    profiler->cpu_samples[timer] += 1;
+}
+
+_Bool vk_profiler_results(const Profiler* profiler, ProfilerResults* results) {
+    if (!profiler->results_fresh) return false;
+
+    *results = profiler->results;
+    return true;
+}
+
+void vk_profiler_print(const ProfilerResults* results) {
+    printf("Profiler: frames=%u cpu_record=%.3fms cpu_submit=%.3fms",
+           results->frame_count, results->cpu_ms[PROFILER_CPU_RECORD],
+           results->cpu_ms[PROFILER_CPU_SUBMIT]);
+    for (u32 i = 0; i < results->region_count; i++) {
+        printf(" gpu_%s=%.3fms", results->names[i], results->gpu_ms[i]);
+    }
+    printf("\n");
+}
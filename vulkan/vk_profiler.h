@@ -0,0 +1,85 @@
+#pragma once
+#include <vulkan/vulkan.h>
+
+#include "../utils.h"
+
+// Timestamps are read back this many frames after being written, which is
+// more than MAX_FRAMES_IN_FLIGHT so the results are always ready by then and
+// reading them never stalls.
+#define PROFILER_FRAME_LAG 4
+#define PROFILER_MAX_REGIONS 16
+#define PROFILER_MAX_QUERIES (PROFILER_MAX_REGIONS * 2)
+
+typedef enum {
+    PROFILER_CPU_RECORD,
+    PROFILER_CPU_SUBMIT,
+    PROFILER_CPU_COUNT,
+} ProfilerCpuTimer;
+
+typedef struct {
+    const char* name;
+    u32 begin_query, end_query;
+} ProfilerRegion;
+
+typedef struct {
+    ProfilerRegion regions[PROFILER_MAX_REGIONS];
+    u32 region_count;
+    u32 query_count;
+    u64 recorded_ns;  // Trace clock, the GPU starts the frame after it
+} ProfilerFrame;
+
+// Averages over the last report interval
+typedef struct {
+    const char* names[PROFILER_MAX_REGIONS];
+    f64 gpu_ms[PROFILER_MAX_REGIONS];
+    u32 region_count;
+    f64 cpu_ms[PROFILER_CPU_COUNT];
+    u32 frame_count;
+} ProfilerResults;
+
+typedef struct {
+    VkDevice device;
+    VkQueryPool query_pool;
+    _Bool enabled;
+    f32 timestamp_period;  // Nanoseconds per tick
+    u64 timestamp_mask;
+    u32 trace_track;  // When tracing, every region is a GPU zone
+
+    ProfilerFrame frames[PROFILER_FRAME_LAG];
+    u32 current_slot;
+
+    // Accumulated since the last report
+    const char* names[PROFILER_MAX_REGIONS];
+    f64 gpu_ms_sum[PROFILER_MAX_REGIONS];
+    u32 gpu_samples[PROFILER_MAX_REGIONS];
+    u32 region_count;
+    f64 cpu_ms_sum[PROFILER_CPU_COUNT];
+    u32 cpu_samples[PROFILER_CPU_COUNT];
+
+    u32 report_interval;
+    u32 frames_since_report;
+    ProfilerResults results;
+    _Bool results_fresh;
+} Profiler;
+
+void vk_profiler_init(Profiler* profiler, VkPhysicalDevice* gpu,
+                      VkDevice* device, u32 queue_family_index,
+                      u32 report_interval);
+void vk_profiler_destroy(Profiler* profiler);
+
+// Must be called outside of a render pass, before any region is recorded
+void vk_profiler_frame_begin(Profiler* profiler, VkCommandBuffer cmd);
+void vk_profiler_frame_end(Profiler* profiler, VkCommandBuffer cmd);
+
+u32 vk_profiler_region_begin(Profiler* profiler, VkCommandBuffer cmd,
+                             const char* name);
+void vk_profiler_region_end(Profiler* profiler, VkCommandBuffer cmd,
+                            u32 region);
+
+u64 vk_profiler_cpu_now(void);
+void vk_profiler_cpu_add(Profiler* profiler, ProfilerCpuTimer timer,
+                         u64 start);
+
+// Returns true when a new set of results was published this frame
+_Bool vk_profiler_results(const Profiler* profiler, ProfilerResults* results);
+void vk_profiler_print(const ProfilerResults* results);
@@ -0,0 +1,758 @@
+#include "vk_render_graph.h"
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdio.h>
+
+#include "../resource_registry.h"
+#include "vk_utils.h"
+
+typedef struct {
+    VkImageLayout layout;
+    VkPipelineStageFlags stages;
+    VkAccessFlags access;
+    _Bool write;
+} AccessInfo;
+
+static AccessInfo access_info(RenderGraphAccess access) {
+    switch (access) {
+        case RENDER_GRAPH_COLOR_ATTACHMENT:
+            return (AccessInfo){
+                .layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+                .stages = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                .access = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT |
+                          VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+                .write = true};
+        case RENDER_GRAPH_DEPTH_ATTACHMENT:
+            return (AccessInfo){
+                .layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+                .stages = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+                          VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+                .access = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+                          VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                .write = true};
+        case RENDER_GRAPH_SAMPLED:
+            return (AccessInfo){
+                .layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                .stages = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                .access = VK_ACCESS_SHADER_READ_BIT};
+        case RENDER_GRAPH_TRANSFER_SRC:
+            return (AccessInfo){
+                .layout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                .stages = VK_PIPELINE_STAGE_TRANSFER_BIT,
+                .access = VK_ACCESS_TRANSFER_READ_BIT};
+        case RENDER_GRAPH_TRANSFER_DST:
+            return (AccessInfo){
+                .layout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                .stages = VK_PIPELINE_STAGE_TRANSFER_BIT,
+                .access = VK_ACCESS_TRANSFER_WRITE_BIT,
+                .write = true};
+    }
+    assert(0);
+}
+
+static VkImageUsageFlags access_usage(RenderGraphAccess access) {
+    switch (access) {
+        case RENDER_GRAPH_COLOR_ATTACHMENT:
+            return VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+        case RENDER_GRAPH_DEPTH_ATTACHMENT:
+            return VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+        case RENDER_GRAPH_SAMPLED:
+            return VK_IMAGE_USAGE_SAMPLED_BIT;
+        case RENDER_GRAPH_TRANSFER_SRC:
+            return VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+        case RENDER_GRAPH_TRANSFER_DST:
+            return VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    }
+    assert(0);
+}
+
+// A use reads the previous content of the image unless it is an attachment
+// which is cleared or discarded on load
+static _Bool use_reads(const RenderGraphUse* use) {
+    if (use->attachment) return use->load_op == VK_ATTACHMENT_LOAD_OP_LOAD;
+    return !access_info(use->access).write;
+}
+
+void vk_render_graph_init(RenderGraph* graph, VkDevice* device,
+                          VkPhysicalDeviceMemoryProperties* memory_properties) {
+    memset(graph, 0, sizeof(RenderGraph));
+    graph->device = *device;
+    graph->memory_properties = *memory_properties;
+}
+
+void vk_render_graph_destroy(RenderGraph* graph) {
+    const VkDevice device = graph->device;
+
+    for (u32 i = 0; i < graph->frame_buffer_count; i++)
+        vkDestroyFramebuffer(device, graph->frame_buffers[i].frame_buffer,
+                             NULL);
+
+    for (u32 i = 0; i < graph->pass_count; i++) {
+        if (graph->passes[i].render_pass)
+            vkDestroyRenderPass(device, graph->passes[i].render_pass, NULL);
+    }
+
+    for (u32 i = 0; i < graph->resource_count; i++) {
+        RenderGraphResource* const resource = &graph->resources[i];
+        if (resource->imported || !resource->image) continue;
+        vkDestroyImageView(device, resource->view, NULL);
+        vkDestroyImage(device, resource->image, NULL);
+    }
+
+    for (u32 i = 0; i < graph->memory_slot_count; i++)
+        vk_memory_free(device, graph->memory_slots[i].memory);
+}
+
+static u32 vk_render_graph_resource(RenderGraph* graph, const char* name,
+                                    VkFormat format, VkExtent2D extent,
+                                    VkImageAspectFlags aspect) {
+    assert(!graph->compiled);
+    assert(graph->resource_count < RENDER_GRAPH_MAX_RESOURCES);
+
+    const u32 index = graph->resource_count++;
+    graph->resources[index] = (RenderGraphResource){
+        .name = name,
+        .format = format,
+        .extent = extent,
+        .aspect = aspect,
+        .first_pass = RENDER_GRAPH_NONE,
+        .last_pass = RENDER_GRAPH_NONE,
+        .memory_slot = RENDER_GRAPH_NONE,
+    };
+    return index;
+}
+
+u32 vk_render_graph_import(RenderGraph* graph, const char* name,
+                           VkFormat format, VkExtent2D extent,
+                           VkImageAspectFlags aspect,
+                           VkImageLayout final_layout) {
+    const u32 index =
+        vk_render_graph_resource(graph, name, format, extent, aspect);
+    graph->resources[index].imported = true;
+    graph->resources[index].final_layout = final_layout;
+    return index;
+}
+
+u32 vk_render_graph_transient(RenderGraph* graph, const char* name,
+                              VkFormat format, VkExtent2D extent,
+                              VkImageAspectFlags aspect) {
+    return vk_render_graph_resource(graph, name, format, extent, aspect);
+}
+
+u32 vk_render_graph_pass(RenderGraph* graph, const char* name, u32 flags,
+                         RenderGraphRecordFn record, void* user_data) {
+    assert(!graph->compiled);
+    assert(graph->pass_count < RENDER_GRAPH_MAX_PASSES);
+
+    const u32 index = graph->pass_count++;
+    graph->passes[index] = (RenderGraphPass){
+        .name = name,
+        .flags = flags,
+        .record = record,
+        .user_data = user_data,
+    };
+    return index;
+}
+
+static void vk_render_graph_add_use(RenderGraph* graph, u32 pass,
+                                    RenderGraphUse use) {
+    assert(!graph->compiled);
+    assert(pass < graph->pass_count);
+    assert(use.resource < graph->resource_count);
+
+    RenderGraphPass* const p = &graph->passes[pass];
+    assert(p->use_count < RENDER_GRAPH_MAX_USES);
+    // One use per image and pass: an image can not be both read and written
+    for (u32 i = 0; i < p->use_count; i++)
+        assert(p->uses[i].resource != use.resource);
+
+    p->uses[p->use_count++] = use;
+}
+
+void vk_render_graph_use(RenderGraph* graph, u32 pass, u32 resource,
+                         RenderGraphAccess access) {
+    assert(access != RENDER_GRAPH_COLOR_ATTACHMENT &&
+           access != RENDER_GRAPH_DEPTH_ATTACHMENT);
+    vk_render_graph_add_use(
+        graph, pass, (RenderGraphUse){.resource = resource, .access = access});
+}
+
+void vk_render_graph_attachment(RenderGraph* graph, u32 pass, u32 resource,
+                                RenderGraphAccess access,
+                                VkAttachmentLoadOp load_op,
+                                VkClearValue clear_value) {
+    assert(access == RENDER_GRAPH_COLOR_ATTACHMENT ||
+           access == RENDER_GRAPH_DEPTH_ATTACHMENT);
+    assert(graph->passes[pass].flags & RENDER_GRAPH_PASS_GRAPHICS);
+    vk_render_graph_add_use(graph, pass,
+                            (RenderGraphUse){.resource = resource,
+                                             .access = access,
+                                             .attachment = true,
+                                             .load_op = load_op,
+                                             .clear_value = clear_value});
+}
+
+void vk_render_graph_set_clear_value(RenderGraph* graph, u32 pass,
+                                     u32 resource, VkClearValue clear_value) {
+    RenderGraphPass* const p = &graph->passes[pass];
+    for (u32 i = 0; i < p->use_count; i++) {
+        if (p->uses[i].resource == resource && p->uses[i].attachment) {
+            p->uses[i].clear_value = clear_value;
+            return;
+        }
+    }
+    assert(0 && "not an attachment of the pass");
+}
+
+//
+// Compilation
+//
+// Walks the passes backwards: a pass is kept if it has side effects or
+// writes an image which is imported or read by a kept pass.
+static void vk_render_graph_cull(RenderGraph* graph) {
+    _Bool needed[RENDER_GRAPH_MAX_RESOURCES] = {0};
+
+    for (u32 i = graph->pass_count; i-- > 0;) {
+        RenderGraphPass* const pass = &graph->passes[i];
+
+        _Bool alive = pass->flags & RENDER_GRAPH_PASS_SIDE_EFFECTS;
+        for (u32 j = 0; j < pass->use_count; j++) {
+            const RenderGraphUse* const use = &pass->uses[j];
+            if (!access_info(use->access).write) continue;
+            if (graph->resources[use->resource].imported ||
+                needed[use->resource])
+                alive = true;
+        }
+
+        pass->culled = !alive;
+        if (!alive) continue;
+
+        for (u32 j = 0; j < pass->use_count; j++) {
+            const RenderGraphUse* const use = &pass->uses[j];
+            if (use_reads(use)) needed[use->resource] = true;
+        }
+    }
+}
+
+static void vk_render_graph_lifetimes(RenderGraph* graph) {
+    for (u32 i = 0; i < graph->pass_count; i++) {
+        const RenderGraphPass* const pass = &graph->passes[i];
+        if (pass->culled) continue;
+
+        for (u32 j = 0; j < pass->use_count; j++) {
+            RenderGraphResource* const resource =
+                &graph->resources[pass->uses[j].resource];
+            if (resource->first_pass == RENDER_GRAPH_NONE)
+                resource->first_pass = i;
+            resource->last_pass = i;
+            resource->usage |= access_usage(pass->uses[j].access);
+        }
+    }
+}
+
+static _Bool lifetimes_overlap(const RenderGraphResource* a,
+                               const RenderGraphResource* b) {
+    return a->first_pass <= b->last_pass && b->first_pass <= a->last_pass;
+}
+
+// Greedy: biggest images first, each one goes into the first memory slot
+// with a compatible memory type whose current images are all dead or not
+// born yet while it lives.
+static void vk_render_graph_alias_memory(RenderGraph* graph) {
+    u32 order[RENDER_GRAPH_MAX_RESOURCES];
+    u32 count = 0;
+
+    for (u32 i = 0; i < graph->resource_count; i++) {
+        RenderGraphResource* const resource = &graph->resources[i];
+        if (resource->imported || resource->first_pass == RENDER_GRAPH_NONE)
+            continue;
+
+        const VkImageCreateInfo image_create_info = {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+            .imageType = VK_IMAGE_TYPE_2D,
+            .format = resource->format,
+            .extent = {resource->extent.width, resource->extent.height, 1},
+            .mipLevels = 1,
+            .arrayLayers = 1,
+            .samples = VK_SAMPLE_COUNT_1_BIT,
+            .tiling = VK_IMAGE_TILING_OPTIMAL,
+            .usage = resource->usage,
+            .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+            .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+        };
+        assert(!vkCreateImage(graph->device, &image_create_info, NULL,
+                              &resource->image));
+        vkGetImageMemoryRequirements(graph->device, resource->image,
+                                     &resource->requirements);
+        graph->stats.transient_bytes += resource->requirements.size;
+
+        // Insertion sort, by decreasing size
+        u32 j = count++;
+        for (; j > 0 && graph->resources[order[j - 1]].requirements.size <
+                            resource->requirements.size;
+             j--)
+            order[j] = order[j - 1];
+        order[j] = i;
+    }
+
+    for (u32 i = 0; i < count; i++) {
+        RenderGraphResource* const resource = &graph->resources[order[i]];
+        const VkMemoryRequirements* const requirements =
+            &resource->requirements;
+
+        u32 slot = RENDER_GRAPH_NONE;
+        for (u32 s = 0; s < graph->memory_slot_count; s++) {
+            if (!(graph->memory_slots[s].type_bits &
+                  requirements->memoryTypeBits))
+                continue;
+
+            _Bool available = true;
+            for (u32 j = 0; j < i; j++) {
+                const RenderGraphResource* const other =
+                    &graph->resources[order[j]];
+                if (other->memory_slot == s &&
+                    lifetimes_overlap(resource, other))
+                    available = false;
+            }
+            if (available) {
+                slot = s;
+                break;
+            }
+        }
+
+        if (slot == RENDER_GRAPH_NONE) {
+            slot = graph->memory_slot_count++;
+            graph->memory_slots[slot].type_bits = requirements->memoryTypeBits;
+        }
+
+        // Images are always bound at offset 0, only the size matters
+        RenderGraphMemorySlot* const memory_slot = &graph->memory_slots[slot];
+        memory_slot->type_bits &= requirements->memoryTypeBits;
+        memory_slot->size = requirements->size > memory_slot->size
+                                ? requirements->size
+                                : memory_slot->size;
+        resource->memory_slot = slot;
+    }
+
+    for (u32 s = 0; s < graph->memory_slot_count; s++) {
+        RenderGraphMemorySlot* const memory_slot = &graph->memory_slots[s];
+        const VkMemoryAllocateInfo memory_allocate_info = {
+            .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+            .allocationSize = memory_slot->size,
+            .memoryTypeIndex = memory_type_find(
+                &graph->memory_properties, memory_slot->type_bits,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)};
+        assert(!vkAllocateMemory(graph->device, &memory_allocate_info, NULL,
+                                 &memory_slot->memory));
+        graph->stats.allocated_bytes += memory_slot->size;
+        resource_track(RESOURCE_VK_MEMORY, (u64)memory_slot->memory,
+                       RESOURCE_RENDER_TARGET, memory_slot->size,
+                       "render_graph");
+    }
+
+    for (u32 i = 0; i < count; i++) {
+        RenderGraphResource* const resource = &graph->resources[order[i]];
+        assert(!vkBindImageMemory(
+            graph->device, resource->image,
+            graph->memory_slots[resource->memory_slot].memory, 0));
+        vk_image_view_create(&graph->device, resource->image, resource->format,
+                             resource->aspect, &resource->view);
+    }
+}
+
+// Whether a later kept pass uses the image, to decide what to store
+static _Bool used_after(const RenderGraph* graph, u32 resource, u32 pass) {
+    return graph->resources[resource].imported ||
+           graph->resources[resource].last_pass > pass;
+}
+
+static void vk_render_graph_create_render_pass(RenderGraph* graph, u32 index) {
+    RenderGraphPass* const pass = &graph->passes[index];
+
+    VkAttachmentDescription attachments[RENDER_GRAPH_MAX_USES];
+    VkAttachmentReference color_references[RENDER_GRAPH_MAX_USES];
+    VkAttachmentReference depth_reference;
+    u32 attachment_count = 0, color_count = 0;
+    _Bool has_depth = false;
+
+    for (u32 i = 0; i < pass->use_count; i++) {
+        const RenderGraphUse* const use = &pass->uses[i];
+        if (!use->attachment) continue;
+
+        // The layout transitions are done by the graph barriers, never by
+        // the render pass itself
+        const VkImageLayout layout = access_info(use->access).layout;
+        const VkAttachmentStoreOp store_op =
+            used_after(graph, use->resource, index)
+                ? VK_ATTACHMENT_STORE_OP_STORE
+                : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        attachments[attachment_count] = (VkAttachmentDescription){
+            .format = graph->resources[use->resource].format,
+            .samples = VK_SAMPLE_COUNT_1_BIT,
+            .loadOp = use->load_op,
+            .storeOp = store_op,
+            .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+            .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+            .initialLayout = layout,
+            .finalLayout = layout,
+        };
+
+        const VkAttachmentReference reference = {.attachment = attachment_count,
+                                                 .layout = layout};
+        if (use->access == RENDER_GRAPH_DEPTH_ATTACHMENT) {
+            assert(!has_depth);
+            has_depth = true;
+            depth_reference = reference;
+        } else {
+            color_references[color_count++] = reference;
+        }
+        attachment_count += 1;
+    }
+
+    const VkSubpassDescription subpass = {
+        .pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
+        .colorAttachmentCount = color_count,
+        .pColorAttachments = color_references,
+        .pDepthStencilAttachment = has_depth ? &depth_reference : NULL,
+    };
+
+    const VkRenderPassCreateInfo render_pass_info = {
+        .sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
+        .attachmentCount = attachment_count,
+        .pAttachments = attachments,
+        .subpassCount = 1,
+        .pSubpasses = &subpass,
+    };
+    assert(!vkCreateRenderPass(graph->device, &render_pass_info, NULL,
+                               &pass->render_pass));
+}
+
+// What is known of an image at a point of the frame
+typedef struct {
+    VkImageLayout layout;
+    // Last write, and the reads since then which must finish before the
+    // next write
+    VkPipelineStageFlags write_stages, read_stages;
+    VkAccessFlags write_access;
+    // Stages the last write has already been made visible to
+    VkPipelineStageFlags visible_stages;
+} ResourceState;
+
+typedef struct {
+    VkPipelineStageFlags src_stages, dst_stages;
+    u32 count;
+} BarrierBatch;
+
+static void vk_render_graph_transition(RenderGraph* graph, BarrierBatch* batch,
+                                       ResourceState* state, u32 resource,
+                                       AccessInfo next) {
+    const _Bool layout_change = state->layout != next.layout;
+    // Write after anything, or read of a write not yet visible to the stage
+    const _Bool hazard =
+        next.write ? (state->write_stages | state->read_stages) != 0
+                   : state->write_stages != 0 &&
+                         (next.stages & ~state->visible_stages) != 0;
+
+    if (layout_change || hazard) {
+        assert(graph->barrier_count < RENDER_GRAPH_MAX_BARRIERS);
+        graph->barriers[graph->barrier_count++] = (RenderGraphBarrier){
+            .resource = resource,
+            .src_access = state->write_access,
+            .dst_access = next.access,
+            .old_layout = state->layout,
+            .new_layout = next.layout,
+        };
+        // Read after read only waits for the reads when the layout changes
+        batch->src_stages |= state->write_stages | state->read_stages;
+        batch->dst_stages |= next.stages;
+        batch->count += 1;
+    }
+
+    if (next.write || layout_change) {
+        // A layout transition is itself a write all later uses wait for
+        state->write_stages = next.stages;
+        state->write_access = next.write ? next.access : 0;
+        state->read_stages = 0;
+        state->visible_stages = next.stages;
+    } else {
+        state->read_stages |= next.stages;
+        state->visible_stages |= next.stages;
+    }
+    state->layout = next.layout;
+}
+
+static void vk_render_graph_barriers(RenderGraph* graph) {
+    ResourceState states[RENDER_GRAPH_MAX_RESOURCES] = {0};
+
+    // Transient images start undefined every frame but their memory may
+    // still be in use by the previous frame, or by the images sharing it
+    VkPipelineStageFlags slot_stages[RENDER_GRAPH_MAX_RESOURCES] = {0};
+    VkAccessFlags slot_access[RENDER_GRAPH_MAX_RESOURCES] = {0};
+    for (u32 i = 0; i < graph->pass_count; i++) {
+        const RenderGraphPass* const pass = &graph->passes[i];
+        if (pass->culled) continue;
+        for (u32 j = 0; j < pass->use_count; j++) {
+            const RenderGraphResource* const resource =
+                &graph->resources[pass->uses[j].resource];
+            if (resource->imported) continue;
+            const AccessInfo info = access_info(pass->uses[j].access);
+            slot_stages[resource->memory_slot] |= info.stages;
+            if (info.write) slot_access[resource->memory_slot] |= info.access;
+        }
+    }
+
+    for (u32 i = 0; i < graph->resource_count; i++) {
+        const RenderGraphResource* const resource = &graph->resources[i];
+        if (resource->first_pass == RENDER_GRAPH_NONE) continue;
+
+        states[i].layout = VK_IMAGE_LAYOUT_UNDEFINED;
+        if (resource->imported) {
+            // Whatever made the image available (e.g. the acquire semaphore)
+            // waits at the stage of its first use
+            const RenderGraphPass* const first =
+                &graph->passes[resource->first_pass];
+            for (u32 j = 0; j < first->use_count; j++) {
+                if (first->uses[j].resource != i) continue;
+                assert(!use_reads(&first->uses[j]));
+                states[i].write_stages =
+                    access_info(first->uses[j].access).stages;
+            }
+        } else {
+            states[i].write_stages = slot_stages[resource->memory_slot];
+            states[i].write_access = slot_access[resource->memory_slot];
+        }
+    }
+
+    for (u32 i = 0; i < graph->pass_count; i++) {
+        RenderGraphPass* const pass = &graph->passes[i];
+        if (pass->culled) continue;
+
+        BarrierBatch batch = {0};
+        pass->barrier_first = graph->barrier_count;
+        for (u32 j = 0; j < pass->use_count; j++) {
+            const u32 resource = pass->uses[j].resource;
+            vk_render_graph_transition(graph, &batch, &states[resource],
+                                       resource,
+                                       access_info(pass->uses[j].access));
+        }
+        pass->barrier_count = batch.count;
+        pass->src_stages = batch.src_stages;
+        pass->dst_stages = batch.dst_stages;
+
+        graph->stats.naive_barrier_count += pass->use_count;
+        graph->stats.barrier_count += batch.count;
+        graph->stats.batch_count += batch.count > 0;
+    }
+
+    BarrierBatch batch = {0};
+    graph->final_barrier_first = graph->barrier_count;
+    for (u32 i = 0; i < graph->resource_count; i++) {
+        const RenderGraphResource* const resource = &graph->resources[i];
+        if (!resource->imported || resource->first_pass == RENDER_GRAPH_NONE ||
+            states[i].layout == resource->final_layout)
+            continue;
+
+        // Handed over outside of the command buffer (semaphore, fence)
+        const AccessInfo final = {.layout = resource->final_layout,
+                                  .stages =
+                                      VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT};
+        vk_render_graph_transition(graph, &batch, &states[i], i, final);
+        graph->stats.naive_barrier_count += 1;
+    }
+    graph->final_barrier_count = batch.count;
+    graph->final_src_stages = batch.src_stages;
+    graph->final_dst_stages = batch.dst_stages;
+    graph->stats.barrier_count += batch.count;
+    graph->stats.batch_count += batch.count > 0;
+}
+
+void vk_render_graph_compile(RenderGraph* graph) {
+    assert(!graph->compiled);
+
+    vk_render_graph_cull(graph);
+    vk_render_graph_lifetimes(graph);
+    vk_render_graph_alias_memory(graph);
+
+    for (u32 i = 0; i < graph->pass_count; i++) {
+        graph->stats.pass_count += 1;
+        if (graph->passes[i].culled) {
+            graph->stats.culled_pass_count += 1;
+            printf("Render graph: culled pass %s\n", graph->passes[i].name);
+            continue;
+        }
+        if (graph->passes[i].flags & RENDER_GRAPH_PASS_GRAPHICS)
+            vk_render_graph_create_render_pass(graph, i);
+    }
+
+    vk_render_graph_barriers(graph);
+    graph->compiled = true;
+}
+
+void vk_render_graph_print_stats(const RenderGraph* graph) {
+    const RenderGraphStats* const stats = &graph->stats;
+    printf(
+        "Render graph: passes=%u culled=%u barriers=%u batches=%u "
+        "naive_barriers=%u\n",
+        stats->pass_count, stats->culled_pass_count, stats->barrier_count,
+        stats->batch_count, stats->naive_barrier_count);
+    printf("Render graph: transient=%" PRIu64 "B allocated=%" PRIu64
+           "B saved=%" PRIu64 "B memory_slots=%u\n",
+           (u64)stats->transient_bytes, (u64)stats->allocated_bytes,
+           (u64)(stats->transient_bytes - stats->allocated_bytes),
+           graph->memory_slot_count);
+}
+
+//
+// Execution
+//
+VkRenderPass vk_render_graph_render_pass(const RenderGraph* graph, u32 pass) {
+    assert(graph->compiled);
+    return graph->passes[pass].render_pass;
+}
+
+void vk_render_graph_set_image(RenderGraph* graph, u32 resource, VkImage image,
+                               VkImageView view) {
+    assert(graph->resources[resource].imported);
+    graph->resources[resource].image = image;
+    graph->resources[resource].view = view;
+}
+
+VkImage vk_render_graph_image(const RenderGraph* graph, u32 resource) {
+    return graph->resources[resource].image;
+}
+
+static void vk_render_graph_emit_barriers(const RenderGraph* graph,
+                                          VkCommandBuffer cmd, u32 first,
+                                          u32 count,
+                                          VkPipelineStageFlags src_stages,
+                                          VkPipelineStageFlags dst_stages) {
+    if (count == 0) return;
+
+    VkImageMemoryBarrier barriers[RENDER_GRAPH_MAX_BARRIERS];
+    for (u32 i = 0; i < count; i++) {
+        const RenderGraphBarrier* const barrier = &graph->barriers[first + i];
+        const RenderGraphResource* const resource =
+            &graph->resources[barrier->resource];
+        assert(resource->image);
+
+        barriers[i] = (VkImageMemoryBarrier){
+            .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+            .srcAccessMask = barrier->src_access,
+            .dstAccessMask = barrier->dst_access,
+            .oldLayout = barrier->old_layout,
+            .newLayout = barrier->new_layout,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .image = resource->image,
+            .subresourceRange =
+                {
+                    .aspectMask = resource->aspect,
+                    .levelCount = 1,
+                    .layerCount = 1,
+                },
+        };
+    }
+
+    vkCmdPipelineBarrier(
+        cmd, src_stages ? src_stages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+        dst_stages, 0, 0, NULL, 0, NULL, count, barriers);
+}
+
+// Frame buffers are created on first use and kept, the imported images
+// usually cycle through a small set (swapchain images, offscreen targets)
+static VkFramebuffer vk_render_graph_frame_buffer(RenderGraph* graph,
+                                                  const RenderGraphPass* pass,
+                                                  VkExtent2D* extent) {
+    VkImageView views[RENDER_GRAPH_MAX_USES];
+    u32 view_count = 0;
+    for (u32 i = 0; i < pass->use_count; i++) {
+        if (!pass->uses[i].attachment) continue;
+        const RenderGraphResource* const resource =
+            &graph->resources[pass->uses[i].resource];
+        assert(resource->view);
+        views[view_count++] = resource->view;
+        *extent = resource->extent;
+    }
+
+    for (u32 i = 0; i < graph->frame_buffer_count; i++) {
+        const RenderGraphFrameBuffer* const frame_buffer =
+            &graph->frame_buffers[i];
+        if (frame_buffer->render_pass == pass->render_pass &&
+            frame_buffer->view_count == view_count &&
+            !memcmp(frame_buffer->views, views,
+                    view_count * sizeof(VkImageView)))
+            return frame_buffer->frame_buffer;
+    }
+
+    assert(graph->frame_buffer_count < RENDER_GRAPH_MAX_FRAME_BUFFERS);
+    RenderGraphFrameBuffer* const frame_buffer =
+        &graph->frame_buffers[graph->frame_buffer_count++];
+    frame_buffer->render_pass = pass->render_pass;
+    frame_buffer->view_count = view_count;
+    memcpy(frame_buffer->views, views, view_count * sizeof(VkImageView));
+
+    const VkFramebufferCreateInfo frame_buffer_create_info = {
+        .sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
+        .renderPass = pass->render_pass,
+        .attachmentCount = view_count,
+        .pAttachments = views,
+        .width = extent->width,
+        .height = extent->height,
+        .layers = 1,
+    };
+    assert(!vkCreateFramebuffer(graph->device, &frame_buffer_create_info,
+                                NULL, &frame_buffer->frame_buffer));
+    return frame_buffer->frame_buffer;
+}
+
+void vk_render_graph_execute(RenderGraph* graph, VkCommandBuffer cmd,
+                             Profiler* profiler) {
+    assert(graph->compiled);
+
+    for (u32 i = 0; i < graph->pass_count; i++) {
+        const RenderGraphPass* const pass = &graph->passes[i];
+        if (pass->culled) continue;
+
+        const u32 region = vk_profiler_region_begin(profiler, cmd, pass->name);
+        vk_render_graph_emit_barriers(graph, cmd, pass->barrier_first,
+                                      pass->barrier_count, pass->src_stages,
+                                      pass->dst_stages);
+
+        if (!(pass->flags & RENDER_GRAPH_PASS_GRAPHICS)) {
+            pass->record(graph, cmd, pass->user_data);
+            vk_profiler_region_end(profiler, cmd, region);
+            continue;
+        }
+
+        VkClearValue clear_values[RENDER_GRAPH_MAX_USES];
+        u32 clear_value_count = 0;
+        for (u32 j = 0; j < pass->use_count; j++) {
+            if (pass->uses[j].attachment)
+                clear_values[clear_value_count++] = pass->uses[j].clear_value;
+        }
+
+        VkExtent2D extent = {0};
+        const VkFramebuffer frame_buffer =
+            vk_render_graph_frame_buffer(graph, pass, &extent);
+        const VkRenderPassBeginInfo render_pass_begin_info = {
+            .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+            .renderPass = pass->render_pass,
+            .framebuffer = frame_buffer,
+            .renderArea.extent = extent,
+            .clearValueCount = clear_value_count,
+            .pClearValues = clear_values,
+        };
+        vkCmdBeginRenderPass(cmd, &render_pass_begin_info,
+                             VK_SUBPASS_CONTENTS_INLINE);
+        pass->record(graph, cmd, pass->user_data);
+        vkCmdEndRenderPass(cmd);
+
+        vk_profiler_region_end(profiler, cmd, region);
+    }
+
+    vk_render_graph_emit_barriers(graph, cmd, graph->final_barrier_first,
+                                  graph->final_barrier_count,
+                                  graph->final_src_stages,
+                                  graph->final_dst_stages);
+}
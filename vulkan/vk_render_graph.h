@@ -0,0 +1,187 @@
+#pragma once
+#include <vulkan/vulkan.h>
+
+#include "../utils.h"
+#include "vk_profiler.h"
+
+// Passes declare which images they read and write, in execution order. On
+// compile the graph:
+// - culls the passes whose results are never used,
+// - computes the layout transitions and the minimal set of pipeline
+//   barriers, batched in one vkCmdPipelineBarrier per pass,
+// - creates the transient images and lets the ones whose lifetimes do not
+//   overlap share the same memory.
+// Imported images (swapchain, offscreen targets) are owned by the caller and
+// can change every frame.
+
+#define RENDER_GRAPH_MAX_RESOURCES 16
+#define RENDER_GRAPH_MAX_PASSES 16
+#define RENDER_GRAPH_MAX_USES 8
+#define RENDER_GRAPH_MAX_BARRIERS \
+    (RENDER_GRAPH_MAX_PASSES * RENDER_GRAPH_MAX_USES + \
+     RENDER_GRAPH_MAX_RESOURCES)
+#define RENDER_GRAPH_MAX_FRAME_BUFFERS 16
+#define RENDER_GRAPH_NONE UINT32_MAX
+
+typedef enum {
+    RENDER_GRAPH_COLOR_ATTACHMENT,
+    RENDER_GRAPH_DEPTH_ATTACHMENT,
+    RENDER_GRAPH_SAMPLED,  // Read in the fragment shader
+    RENDER_GRAPH_TRANSFER_SRC,
+    RENDER_GRAPH_TRANSFER_DST,
+} RenderGraphAccess;
+
+typedef enum {
+    // Recorded inside a render pass made of the pass' attachments
+    RENDER_GRAPH_PASS_GRAPHICS = 1 << 0,
+    // Never culled, e.g. copies to host memory
+    RENDER_GRAPH_PASS_SIDE_EFFECTS = 1 << 1,
+} RenderGraphPassFlags;
+
+typedef struct RenderGraph RenderGraph;
+
+typedef void (*RenderGraphRecordFn)(RenderGraph* graph, VkCommandBuffer cmd,
+                                    void* user_data);
+
+typedef struct {
+    const char* name;
+    VkFormat format;
+    VkExtent2D extent;
+    VkImageAspectFlags aspect;
+    _Bool imported;
+    VkImageLayout final_layout;  // Imported only
+
+    // Lifetime in pass indices, RENDER_GRAPH_NONE when unused
+    u32 first_pass, last_pass;
+
+    // Transient only
+    VkImageUsageFlags usage;
+    VkMemoryRequirements requirements;
+    u32 memory_slot;
+    VkImage image;
+    VkImageView view;
+} RenderGraphResource;
+
+typedef struct {
+    u32 resource;
+    RenderGraphAccess access;
+    _Bool attachment;
+    VkAttachmentLoadOp load_op;
+    VkClearValue clear_value;
+} RenderGraphUse;
+
+typedef struct {
+    const char* name;
+    u32 flags;
+    RenderGraphRecordFn record;
+    void* user_data;
+    RenderGraphUse uses[RENDER_GRAPH_MAX_USES];
+    u32 use_count;
+
+    // Compiled
+    _Bool culled;
+    VkRenderPass render_pass;
+    u32 barrier_first, barrier_count;
+    VkPipelineStageFlags src_stages, dst_stages;
+} RenderGraphPass;
+
+typedef struct {
+    u32 resource;
+    VkAccessFlags src_access, dst_access;
+    VkImageLayout old_layout, new_layout;
+} RenderGraphBarrier;
+
+typedef struct {
+    VkDeviceMemory memory;
+    VkDeviceSize size;
+    u32 type_bits;
+} RenderGraphMemorySlot;
+
+typedef struct {
+    VkRenderPass render_pass;
+    VkImageView views[RENDER_GRAPH_MAX_USES];
+    u32 view_count;
+    VkFramebuffer frame_buffer;
+} RenderGraphFrameBuffer;
+
+typedef struct {
+    u32 pass_count, culled_pass_count;
+    // Per frame
+    u32 barrier_count, batch_count;
+    // One barrier call before every use of an image
+    u32 naive_barrier_count;
+    // If every transient image had its own memory
+    VkDeviceSize transient_bytes;
+    VkDeviceSize allocated_bytes;
+} RenderGraphStats;
+
+struct RenderGraph {
+    VkDevice device;
+    VkPhysicalDeviceMemoryProperties memory_properties;
+
+    RenderGraphResource resources[RENDER_GRAPH_MAX_RESOURCES];
+    u32 resource_count;
+    RenderGraphPass passes[RENDER_GRAPH_MAX_PASSES];
+    u32 pass_count;
+
+    RenderGraphBarrier barriers[RENDER_GRAPH_MAX_BARRIERS];
+    u32 barrier_count;
+    // Transitions of the imported images to their final layout
+    u32 final_barrier_first, final_barrier_count;
+    VkPipelineStageFlags final_src_stages, final_dst_stages;
+
+    RenderGraphMemorySlot memory_slots[RENDER_GRAPH_MAX_RESOURCES];
+    u32 memory_slot_count;
+
+    RenderGraphFrameBuffer frame_buffers[RENDER_GRAPH_MAX_FRAME_BUFFERS];
+    u32 frame_buffer_count;
+
+    _Bool compiled;
+    RenderGraphStats stats;
+};
+
+void vk_render_graph_init(RenderGraph* graph, VkDevice* device,
+                          VkPhysicalDeviceMemoryProperties* memory_properties);
+void vk_render_graph_destroy(RenderGraph* graph);
+
+//
+// Declaration, before compiling
+//
+// Imported images start every frame undefined, their first use must not load
+u32 vk_render_graph_import(RenderGraph* graph, const char* name,
+                           VkFormat format, VkExtent2D extent,
+                           VkImageAspectFlags aspect,
+                           VkImageLayout final_layout);
+u32 vk_render_graph_transient(RenderGraph* graph, const char* name,
+                              VkFormat format, VkExtent2D extent,
+                              VkImageAspectFlags aspect);
+
+u32 vk_render_graph_pass(RenderGraph* graph, const char* name, u32 flags,
+                         RenderGraphRecordFn record, void* user_data);
+void vk_render_graph_use(RenderGraph* graph, u32 pass, u32 resource,
+                         RenderGraphAccess access);
+void vk_render_graph_attachment(RenderGraph* graph, u32 pass, u32 resource,
+                                RenderGraphAccess access,
+                                VkAttachmentLoadOp load_op,
+                                VkClearValue clear_value);
+
+void vk_render_graph_compile(RenderGraph* graph);
+void vk_render_graph_print_stats(const RenderGraph* graph);
+
+//
+// After compiling
+//
+// For pipeline creation, NULL handle when the pass was culled
+VkRenderPass vk_render_graph_render_pass(const RenderGraph* graph, u32 pass);
+
+// Must be called every frame for every imported image
+void vk_render_graph_set_image(RenderGraph* graph, u32 resource, VkImage image,
+                               VkImageView view);
+VkImage vk_render_graph_image(const RenderGraph* graph, u32 resource);
+// Also valid after compiling, e.g. for a clear color changing every frame
+void vk_render_graph_set_clear_value(RenderGraph* graph, u32 pass,
+                                     u32 resource, VkClearValue clear_value);
+
+// Records every pass, each one in its own profiler region
+void vk_render_graph_execute(RenderGraph* graph, VkCommandBuffer cmd,
+                             Profiler* profiler);
@@ -0,0 +1,831 @@
+#include <SDL2/SDL_vulkan.h>
+#include <assert.h>
+#include <stdio.h>
+
+#include "../renderer.h"
+#include "../resource_registry.h"
+#include "../trace.h"
+#include "vk_device.h"
+#include "vk_pipeline.h"
+#include "vk_profiler.h"
+#include "vk_render_graph.h"
+#include "vk_utils.h"
+
+// Vulkan backend of the shared renderer. Draws are only recorded into a list
+// between frame begin and submit, the main pass of the render graph replays
+// them into the command buffer of the frame.
+//
+// Lights, the ranges of the clusters and their light indices are storage
+// buffers of descriptor set 1, one set per frame in flight, persistently
+// mapped. The fragment stage push constants follow the view projection.
+//
+// No particles yet: they are simulated with transform feedback in OpenGL,
+// here they would need a compute pass of the render graph.
+
+// Render packets are pooled by this many
+#define VK_RENDERER_PACKETS_PER_CHUNK 256
+
+typedef struct {
+    VkBuffer buffer;
+    VkDeviceMemory memory;
+    RendererBufferUsage usage;
+    // Instance buffers hold one region per frame in flight, persistently
+    // mapped
+    VkDeviceSize region_size;
+    u8* data;
+} VkRendererBuffer;
+
+typedef struct {
+    VkImage image;
+    VkDeviceMemory memory;
+    VkImageView view;
+    VkDescriptorSet set;
+} VkRendererTexture;
+
+// A deferred draw
+typedef struct VkDrawPacket {
+    RendererDraw draw;
+    struct VkDrawPacket* next;
+} VkDrawPacket;
+
+typedef struct {
+    VkInstance instance;
+    VkSurfaceKHR surface;
+    VkPhysicalDevice gpu;
+    VkPhysicalDeviceMemoryProperties memory_properties;
+    VkDevice device;
+    VkQueue queue;
+    VkCommandPool command_pool;
+    Swapchain swapchain;
+    // Headless only, replaces the swapchain images
+    VkImage offscreen_image;
+    VkDeviceMemory offscreen_memory;
+    VkImageView offscreen_view;
+
+    RenderGraph graph;
+    u32 color, main_pass;
+    // GPU time of every pass with PROFILE or when tracing, else disabled
+    Profiler profiler;
+
+    VkSampler sampler;
+    VkDescriptorSetLayout texture_layout;
+    VkDescriptorSetLayout light_layout;
+    VkDescriptorPool descriptor_pool;
+    VkPipelineLayout pipeline_layout;
+
+    VkCommandBuffer command_buffers[MAX_FRAMES_IN_FLIGHT];
+    VkSemaphore image_available[MAX_FRAMES_IN_FLIGHT];
+    VkSemaphore render_finished[MAX_FRAMES_IN_FLIGHT];
+    VkFence in_flight_fences[MAX_FRAMES_IN_FLIGHT];
+    VkFence images_in_flight_fences[MAX_SWAPCHAIN_IMAGES];
+    u32 current_frame, current_image;
+
+    VkRendererBuffer buffers[RENDERER_MAX_BUFFERS];
+    u32 buffer_count;
+    VkRendererTexture textures[RENDERER_MAX_TEXTURES];
+    u32 texture_count;
+    // Lights, cluster ranges, light indices, created on the first update
+    VkRendererBuffer light_buffers[MAX_FRAMES_IN_FLIGHT][3];
+    VkDescriptorSet light_sets[MAX_FRAMES_IN_FLIGHT];
+    _Bool lights_created;
+    // Updated in the current frame
+    _Bool lights;
+    vec4 light_constants[2];  // Depth plane, cluster scale
+
+    VkPipeline pipelines[RENDERER_MAX_PIPELINES];
+    VkShaderModule shader_modules[RENDERER_MAX_PIPELINES][2];
+    u32 pipeline_count;
+
+    // Current frame, in submission order
+    mat4 view_projection;
+    Pool packets;
+    VkDrawPacket *first_packet, *last_packet;
+} VkRenderer;
+
+static VkRenderer* vk_renderer(Renderer* renderer) { return renderer->data; }
+
+static void vk_renderer_main_pass_record(RenderGraph* graph,
+                                         VkCommandBuffer cmd,
+                                         void* user_data) {
+    (void)graph;
+    Renderer* const renderer = user_data;
+    VkRenderer* const vk = vk_renderer(renderer);
+
+    const VkViewport viewport = {
+        .width = (f32)renderer->width,
+        .height = (f32)renderer->height,
+        .maxDepth = 1.0f,
+    };
+    vkCmdSetViewport(cmd, 0, 1, &viewport);
+    const VkRect2D scissor = {
+        .extent = {.width = renderer->width, .height = renderer->height}};
+    vkCmdSetScissor(cmd, 0, 1, &scissor);
+
+    // Every pipeline shares the layout, so the push constants survive
+    // pipeline changes
+    vkCmdPushConstants(cmd, vk->pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT, 0,
+                       sizeof(mat4), vk->view_projection);
+    if (vk->lights) {
+        vkCmdPushConstants(cmd, vk->pipeline_layout,
+                           VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(mat4),
+                           sizeof(vk->light_constants), vk->light_constants);
+        vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                vk->pipeline_layout, 1, 1,
+                                &vk->light_sets[vk->current_frame], 0, NULL);
+    }
+
+    RendererPipeline bound_pipeline = 0;
+    RendererTexture bound_texture = 0;
+    for (const VkDrawPacket* packet = vk->first_packet; packet;
+         packet = packet->next) {
+        const RendererDraw* const draw = &packet->draw;
+
+        if (draw->pipeline != bound_pipeline) {
+            vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                              vk->pipelines[draw->pipeline - 1]);
+            bound_pipeline = draw->pipeline;
+        }
+        if (draw->texture != bound_texture) {
+            vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                    vk->pipeline_layout, 0, 1,
+                                    &vk->textures[draw->texture - 1].set, 0,
+                                    NULL);
+            bound_texture = draw->texture;
+        }
+
+        const VkRendererBuffer* const instances =
+            &vk->buffers[draw->instances - 1];
+        VkBuffer vertex_buffers[4] = {
+            vk->buffers[draw->positions - 1].buffer,
+            vk->buffers[draw->uvs - 1].buffer,
+            instances->buffer,
+        };
+        const VkDeviceSize offsets[4] = {
+            0,
+            0,
+            instances->region_size * vk->current_frame,
+            0,
+        };
+        // Indexed by instance too, uploaded once
+        if (draw->materials)
+            vertex_buffers[3] = vk->buffers[draw->materials - 1].buffer;
+        vkCmdBindVertexBuffers(cmd, 0, draw->materials ? 4 : 3,
+                               vertex_buffers, offsets);
+        vkCmdDraw(cmd, draw->vertex_count, draw->instance_count,
+                  draw->first_vertex, draw->first_instance);
+    }
+}
+
+static void vk_renderer_descriptors_init(VkRenderer* vk) {
+    const VkDescriptorSetLayoutBinding binding = {
+        .binding = 0,
+        .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+        .descriptorCount = 1,
+        .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+    };
+    const VkDescriptorSetLayoutCreateInfo layout_create_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .bindingCount = 1,
+        .pBindings = &binding,
+    };
+    assert(!vkCreateDescriptorSetLayout(vk->device, &layout_create_info, NULL,
+                                        &vk->texture_layout));
+
+    VkDescriptorSetLayoutBinding light_bindings[3];
+    for (u32 i = 0; i < 3; i++) {
+        light_bindings[i] = (VkDescriptorSetLayoutBinding){
+            .binding = i,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .descriptorCount = 1,
+            .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+        };
+    }
+    const VkDescriptorSetLayoutCreateInfo light_layout_create_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .bindingCount = 3,
+        .pBindings = light_bindings,
+    };
+    assert(!vkCreateDescriptorSetLayout(vk->device, &light_layout_create_info,
+                                        NULL, &vk->light_layout));
+
+    // The unlit pipelines ignore the lights
+    const VkPushConstantRange push_constant_ranges[2] = {
+        {
+            .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
+            .offset = 0,
+            .size = sizeof(mat4),
+        },
+        {
+            .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+            .offset = sizeof(mat4),
+            .size = sizeof(vk->light_constants),
+        },
+    };
+    const VkDescriptorSetLayout set_layouts[2] = {vk->texture_layout,
+                                                  vk->light_layout};
+    const VkPipelineLayoutCreateInfo pipeline_layout_create_info = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        .setLayoutCount = 2,
+        .pSetLayouts = set_layouts,
+        .pushConstantRangeCount = 2,
+        .pPushConstantRanges = push_constant_ranges,
+    };
+    assert(!vkCreatePipelineLayout(vk->device, &pipeline_layout_create_info,
+                                   NULL, &vk->pipeline_layout));
+
+    // One set per texture and per frame in flight for the lights, never
+    // freed
+    const VkDescriptorPoolSize pool_sizes[2] = {
+        {
+            .type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            .descriptorCount = RENDERER_MAX_TEXTURES,
+        },
+        {
+            .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .descriptorCount = 3 * MAX_FRAMES_IN_FLIGHT,
+        },
+    };
+    const VkDescriptorPoolCreateInfo pool_create_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .maxSets = RENDERER_MAX_TEXTURES + MAX_FRAMES_IN_FLIGHT,
+        .poolSizeCount = 2,
+        .pPoolSizes = pool_sizes,
+    };
+    assert(!vkCreateDescriptorPool(vk->device, &pool_create_info, NULL,
+                                   &vk->descriptor_pool));
+
+    vk_sampler_create(&vk->device, &vk->sampler);
+}
+
+static void vk_renderer_sync_init(VkRenderer* vk) {
+    const VkCommandBufferAllocateInfo allocate_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+        .commandPool = vk->command_pool,
+        .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+        .commandBufferCount = MAX_FRAMES_IN_FLIGHT,
+    };
+    assert(!vkAllocateCommandBuffers(vk->device, &allocate_info,
+                                     vk->command_buffers));
+
+    const VkSemaphoreCreateInfo semaphore_create_info = {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+    };
+    const VkFenceCreateInfo fence_create_info = {
+        .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+        .flags = VK_FENCE_CREATE_SIGNALED_BIT};
+
+    for (u32 i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        assert(!vkCreateSemaphore(vk->device, &semaphore_create_info, NULL,
+                                  &vk->image_available[i]));
+        assert(!vkCreateSemaphore(vk->device, &semaphore_create_info, NULL,
+                                  &vk->render_finished[i]));
+        assert(!vkCreateFence(vk->device, &fence_create_info, NULL,
+                              &vk->in_flight_fences[i]));
+    }
+}
+
+static _Bool vk_renderer_init(Renderer* renderer) {
+    VkRenderer* const vk = ogl_malloc(sizeof(VkRenderer));
+    memset(vk, 0, sizeof(VkRenderer));
+    renderer->data = vk;
+    pool_init(&vk->packets, "draw_packets", sizeof(VkDrawPacket),
+              VK_RENDERER_PACKETS_PER_CHUNK);
+
+    const _Bool headless = renderer->headless;
+    renderer->window = headless ? NULL : vk_window_create();
+
+    u32 extension_count = 0;
+    const char* extension_names[MAX_EXTENSIONS] = {0};
+    if (!headless)
+        vk_get_extensions(renderer->window, extension_names, &extension_count);
+
+    const char* validation_layer = "VK_LAYER_KHRONOS_validation";
+    const char* const debug = getenv("DEBUG");
+    if (debug) vk_get_validation_layers(validation_layer);
+
+    vk_create_instance(&vk->instance, extension_names, extension_count,
+                       debug ? validation_layer : NULL, debug ? 1 : 0);
+
+    if (!headless && !SDL_Vulkan_CreateSurface(renderer->window, vk->instance,
+                                               &vk->surface)) {
+        fprintf(stderr, "SDL_Vulkan_CreateSurface failed: %s\n",
+                SDL_GetError());
+        return false;
+    }
+
+    vk_create_physical_device(&vk->instance, &vk->gpu);
+    vkGetPhysicalDeviceMemoryProperties(vk->gpu, &vk->memory_properties);
+    const u32 queue_family_index =
+        vk_find_queue_family(&vk->gpu, headless ? NULL : &vk->surface);
+    vk_create_logical_device(&vk->gpu, queue_family_index, !headless,
+                             &vk->device);
+    vkGetDeviceQueue(vk->device, queue_family_index, 0, &vk->queue);
+    vk_create_command_pool(&vk->device, queue_family_index,
+                           &vk->command_pool);
+
+    // The graph gives each pass its own region, reported every 120 frames
+    const char* const profile = getenv("PROFILE");
+    if (profile || trace_enabled)
+        vk_profiler_init(&vk->profiler, &vk->gpu, &vk->device,
+                         queue_family_index, profile ? 120 : 0);
+
+    VkFormat format = VK_FORMAT_B8G8R8A8_UNORM;
+    VkExtent2D extent = {.width = 1024, .height = 768};
+    if (headless) {
+        vk_image_create(&vk->device, &vk->memory_properties, format, extent,
+                        VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
+                        VK_IMAGE_ASPECT_COLOR_BIT, &vk->offscreen_image,
+                        &vk->offscreen_memory, &vk->offscreen_view);
+    } else {
+        u32 format_count;
+        VkColorSpaceKHR color_space;
+        vk_get_color_info(&vk->gpu, &vk->surface, &format, &format_count,
+                          &color_space);
+        vk_swapchain_create(&vk->device, &vk->gpu, vk->surface,
+                            renderer->window, format, color_space,
+                            &vk->swapchain);
+        extent = vk->swapchain.extent;
+    }
+    renderer->width = extent.width;
+    renderer->height = extent.height;
+
+    //
+    // Render graph: one pass into the swapchain or offscreen image
+    //
+    const VkClearValue clear_color = {{{0.0f, 0.0f, 0.0f, 1.0f}}};
+    const VkClearValue clear_depth = {.depthStencil = {1.0f, 0}};
+
+    RenderGraph* const graph = &vk->graph;
+    vk_render_graph_init(graph, &vk->device, &vk->memory_properties);
+    vk->color = vk_render_graph_import(
+        graph, "color", format, extent, VK_IMAGE_ASPECT_COLOR_BIT,
+        headless ? VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
+                 : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+    const u32 depth =
+        vk_render_graph_transient(graph, "depth", VK_FORMAT_D32_SFLOAT,
+                                  extent, VK_IMAGE_ASPECT_DEPTH_BIT);
+
+    vk->main_pass =
+        vk_render_graph_pass(graph, "main", RENDER_GRAPH_PASS_GRAPHICS,
+                             vk_renderer_main_pass_record, renderer);
+    vk_render_graph_attachment(graph, vk->main_pass, vk->color,
+                               RENDER_GRAPH_COLOR_ATTACHMENT,
+                               VK_ATTACHMENT_LOAD_OP_CLEAR, clear_color);
+    vk_render_graph_attachment(graph, vk->main_pass, depth,
+                               RENDER_GRAPH_DEPTH_ATTACHMENT,
+                               VK_ATTACHMENT_LOAD_OP_CLEAR, clear_depth);
+    vk_render_graph_compile(graph);
+
+    vk_renderer_descriptors_init(vk);
+    vk_renderer_sync_init(vk);
+
+    return true;
+}
+
+static void vk_renderer_destroy(Renderer* renderer) {
+    VkRenderer* const vk = vk_renderer(renderer);
+    const VkDevice device = vk->device;
+    vkDeviceWaitIdle(device);
+
+    for (u32 i = 0; i < vk->pipeline_count; i++) {
+        vkDestroyPipeline(device, vk->pipelines[i], NULL);
+        for (u32 j = 0; j < 2; j++) {
+            resource_untrack(RESOURCE_VK_SHADER_MODULE,
+                             (u64)vk->shader_modules[i][j]);
+            vkDestroyShaderModule(device, vk->shader_modules[i][j], NULL);
+        }
+    }
+    for (u32 i = 0; i < vk->texture_count; i++) {
+        vkDestroyImageView(device, vk->textures[i].view, NULL);
+        vkDestroyImage(device, vk->textures[i].image, NULL);
+        vk_memory_free(device, vk->textures[i].memory);
+    }
+    for (u32 i = 0; i < vk->buffer_count; i++) {
+        vkDestroyBuffer(device, vk->buffers[i].buffer, NULL);
+        vk_memory_free(device, vk->buffers[i].memory);
+    }
+    for (u32 i = 0; vk->lights_created && i < MAX_FRAMES_IN_FLIGHT; i++) {
+        for (u32 j = 0; j < 3; j++) {
+            vkDestroyBuffer(device, vk->light_buffers[i][j].buffer, NULL);
+            vk_memory_free(device, vk->light_buffers[i][j].memory);
+        }
+    }
+    for (u32 i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        vkDestroySemaphore(device, vk->image_available[i], NULL);
+        vkDestroySemaphore(device, vk->render_finished[i], NULL);
+        vkDestroyFence(device, vk->in_flight_fences[i], NULL);
+    }
+
+    vkDestroySampler(device, vk->sampler, NULL);
+    vkDestroyDescriptorPool(device, vk->descriptor_pool, NULL);
+    vkDestroyPipelineLayout(device, vk->pipeline_layout, NULL);
+    vkDestroyDescriptorSetLayout(device, vk->texture_layout, NULL);
+    vkDestroyDescriptorSetLayout(device, vk->light_layout, NULL);
+    vk_render_graph_destroy(&vk->graph);
+    vk_profiler_destroy(&vk->profiler);
+    if (renderer->headless) {
+        vkDestroyImageView(device, vk->offscreen_view, NULL);
+        vkDestroyImage(device, vk->offscreen_image, NULL);
+        vk_memory_free(device, vk->offscreen_memory);
+    } else {
+        vk_swapchain_destroy(&vk->device, &vk->swapchain);
+    }
+    vkDestroyCommandPool(device, vk->command_pool, NULL);
+    vkDestroyDevice(device, NULL);
+    if (vk->surface != VK_NULL_HANDLE)
+        vkDestroySurfaceKHR(vk->instance, vk->surface, NULL);
+    vkDestroyInstance(vk->instance, NULL);
+
+    if (renderer->window) {
+        SDL_DestroyWindow(renderer->window);
+        SDL_Quit();
+    }
+    pool_print(&vk->packets);
+    pool_destroy(&vk->packets);
+    free(vk);
+}
+
+static RendererBuffer vk_renderer_buffer_create(Renderer* renderer,
+                                                RendererBufferUsage usage,
+                                                const void* data,
+                                                usize size) {
+    VkRenderer* const vk = vk_renderer(renderer);
+    assert(vk->buffer_count < RENDERER_MAX_BUFFERS);
+
+    VkRendererBuffer* const buffer = &vk->buffers[vk->buffer_count];
+    buffer->usage = usage;
+    buffer->region_size = size;
+    const u32 region_count =
+        usage == RENDERER_BUFFER_INSTANCE ? MAX_FRAMES_IN_FLIGHT : 1;
+
+    // Host visible like the buffers of the cube scene: the instance data is
+    // rewritten every frame and the vertex data is small
+    vk_buffer_create(&vk->device, &vk->memory_properties,
+                     size * region_count, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                     VK_MEMORY_PROPERTY_HOST_COHERENT_BIT |
+                         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+                     &buffer->buffer, &buffer->memory);
+
+    void* mapped;
+    assert(!vkMapMemory(vk->device, buffer->memory, 0, VK_WHOLE_SIZE, 0,
+                        &mapped));
+    for (u32 i = 0; i < region_count; i++)
+        memcpy((u8*)mapped + i * size, data, size);
+
+    if (usage == RENDERER_BUFFER_INSTANCE)
+        buffer->data = mapped;
+    else
+        vkUnmapMemory(vk->device, buffer->memory);
+
+    return ++vk->buffer_count;
+}
+
+static void vk_renderer_buffer_update(Renderer* renderer,
+                                      RendererBuffer buffer, const void* data,
+                                      usize size) {
+    VkRenderer* const vk = vk_renderer(renderer);
+    assert(buffer > 0 && buffer <= vk->buffer_count);
+
+    // The region of the current frame is not read by the GPU anymore since
+    // frame begin waited for its fence
+    VkRendererBuffer* const b = &vk->buffers[buffer - 1];
+    assert(b->usage == RENDERER_BUFFER_INSTANCE && size <= b->region_size);
+    memcpy(b->data + b->region_size * vk->current_frame, data, size);
+}
+
+// Allocates and writes the descriptor set of a created texture
+static RendererTexture vk_renderer_texture_add(VkRenderer* vk) {
+    VkRendererTexture* const texture = &vk->textures[vk->texture_count];
+
+    const VkDescriptorSetAllocateInfo allocate_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .descriptorPool = vk->descriptor_pool,
+        .descriptorSetCount = 1,
+        .pSetLayouts = &vk->texture_layout,
+    };
+    assert(!vkAllocateDescriptorSets(vk->device, &allocate_info,
+                                     &texture->set));
+
+    const VkDescriptorImageInfo image_info = {
+        .sampler = vk->sampler,
+        .imageView = texture->view,
+        .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+    };
+    const VkWriteDescriptorSet write = {
+        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .dstSet = texture->set,
+        .dstBinding = 0,
+        .descriptorCount = 1,
+        .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+        .pImageInfo = &image_info,
+    };
+    vkUpdateDescriptorSets(vk->device, 1, &write, 0, NULL);
+
+    return ++vk->texture_count;
+}
+
+static RendererTexture vk_renderer_texture_create(Renderer* renderer,
+                                                  u32 width, u32 height,
+                                                  const u8* bgr) {
+    VkRenderer* const vk = vk_renderer(renderer);
+    assert(vk->texture_count < RENDERER_MAX_TEXTURES);
+
+    VkRendererTexture* const texture = &vk->textures[vk->texture_count];
+    vk_texture_create_bgr(&vk->device, &vk->memory_properties,
+                          vk->command_pool, vk->queue, width, height, bgr,
+                          &texture->image, &texture->memory, &texture->view);
+    return vk_renderer_texture_add(vk);
+}
+
+static RendererTexture vk_renderer_texture_array_create(Renderer* renderer,
+                                                        u32 width, u32 height,
+                                                        u32 layer_count,
+                                                        const u8* bgr) {
+    VkRenderer* const vk = vk_renderer(renderer);
+    assert(vk->texture_count < RENDERER_MAX_TEXTURES);
+
+    VkRendererTexture* const texture = &vk->textures[vk->texture_count];
+    vk_texture_array_create_bgr(&vk->device, &vk->memory_properties,
+                                vk->command_pool, vk->queue, width, height,
+                                layer_count, bgr, &texture->image,
+                                &texture->memory, &texture->view);
+    return vk_renderer_texture_add(vk);
+}
+
+static RendererPipeline vk_renderer_pipeline_create(
+    Renderer* renderer, const char* name, RendererPipelineInputs inputs,
+    RendererVertexFormat vertex_format) {
+    VkRenderer* const vk = vk_renderer(renderer);
+    assert(vk->pipeline_count < RENDERER_MAX_PIPELINES);
+
+    char vert_path[256], frag_path[256];
+    snprintf(vert_path, sizeof(vert_path), "vulkan/resources/%s_vert.spv",
+             name);
+    snprintf(frag_path, sizeof(frag_path), "vulkan/resources/%s_frag.spv",
+             name);
+
+    const usize buffer_capacity = 10 * 1000;
+    const ArenaMark mark = arena_mark(&renderer->frame_arena);
+    u8* const buffer = arena_alloc(&renderer->frame_arena, buffer_capacity);
+    usize buffer_len;
+    VkShaderModule* const modules = vk->shader_modules[vk->pipeline_count];
+    const char* const paths[2] = {vert_path, frag_path};
+    for (u32 i = 0; i < 2; i++) {
+        vk_create_shader_module(&vk->device, paths[i], buffer,
+                                buffer_capacity, &buffer_len, &modules[i]);
+        resource_track(RESOURCE_VK_SHADER_MODULE, (u64)modules[i],
+                       RESOURCE_SHADER, buffer_len, NULL);
+    }
+    arena_release(&renderer->frame_arena, mark);
+
+    VkPipelineShaderStageCreateInfo shader_stages[2];
+    vk_create_shader_stages(&modules[0], &modules[1], shader_stages);
+    vk_pipeline_create(&vk->device, shader_stages,
+                       vk_render_graph_render_pass(&vk->graph, vk->main_pass),
+                       vk->pipeline_layout, NULL,
+                       inputs == RENDERER_PIPELINE_INSTANCE_MATERIALS
+                           ? PIPELINE_STREAMS_INSTANCE_MATERIALS
+                           : PIPELINE_STREAMS_INSTANCED,
+                       vertex_format == RENDERER_VERTEX_QUANTIZED,
+                       VK_NULL_HANDLE, &vk->pipelines[vk->pipeline_count]);
+
+    return ++vk->pipeline_count;
+}
+
+static void vk_renderer_frame_begin(Renderer* renderer,
+                                    const RendererFrame* frame) {
+    VkRenderer* const vk = vk_renderer(renderer);
+    const u32 current_frame = vk->current_frame;
+
+    vkWaitForFences(vk->device, 1, &vk->in_flight_fences[current_frame],
+                    VK_TRUE, UINT64_MAX);
+
+    if (!renderer->headless) {
+        vkAcquireNextImageKHR(vk->device, vk->swapchain.swapchain, UINT64_MAX,
+                              vk->image_available[current_frame],
+                              VK_NULL_HANDLE, &vk->current_image);
+
+        VkFence* const image_fence =
+            &vk->images_in_flight_fences[vk->current_image];
+        if (*image_fence != VK_NULL_HANDLE)
+            vkWaitForFences(vk->device, 1, image_fence, VK_TRUE, UINT64_MAX);
+        *image_fence = vk->in_flight_fences[current_frame];
+    }
+
+    glm_mat4_copy((vec4*)frame->view_projection, vk->view_projection);
+    vk_projection_from_gl(vk->view_projection);
+
+    VkClearValue clear_color;
+    memcpy(clear_color.color.float32, frame->clear_color, sizeof(vec4));
+    vk_render_graph_set_clear_value(&vk->graph, vk->main_pass, vk->color,
+                                    clear_color);
+    vk->first_packet = vk->last_packet = NULL;
+    vk->lights = false;
+}
+
+// Buffers of the largest lights update, and their descriptor sets
+static void vk_renderer_lights_create(VkRenderer* vk) {
+    const VkDeviceSize sizes[3] = {
+        sizeof(RendererLight) * RENDERER_MAX_LIGHTS,
+        sizeof(u32) * 2 * RENDERER_CLUSTER_COUNT,
+        sizeof(u16) * RENDERER_MAX_LIGHT_INDICES,
+    };
+
+    for (u32 i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        const VkDescriptorSetAllocateInfo allocate_info = {
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+            .descriptorPool = vk->descriptor_pool,
+            .descriptorSetCount = 1,
+            .pSetLayouts = &vk->light_layout,
+        };
+        assert(!vkAllocateDescriptorSets(vk->device, &allocate_info,
+                                         &vk->light_sets[i]));
+
+        VkDescriptorBufferInfo buffer_infos[3];
+        VkWriteDescriptorSet writes[3];
+        for (u32 j = 0; j < 3; j++) {
+            VkRendererBuffer* const buffer = &vk->light_buffers[i][j];
+            buffer->region_size = sizes[j];
+            vk_buffer_create(&vk->device, &vk->memory_properties, sizes[j],
+                             VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                             VK_MEMORY_PROPERTY_HOST_COHERENT_BIT |
+                                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+                             &buffer->buffer, &buffer->memory);
+            void* mapped;
+            assert(!vkMapMemory(vk->device, buffer->memory, 0, VK_WHOLE_SIZE,
+                                0, &mapped));
+            buffer->data = mapped;
+
+            buffer_infos[j] = (VkDescriptorBufferInfo){
+                .buffer = buffer->buffer,
+                .range = VK_WHOLE_SIZE,
+            };
+            writes[j] = (VkWriteDescriptorSet){
+                .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                .dstSet = vk->light_sets[i],
+                .dstBinding = j,
+                .descriptorCount = 1,
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .pBufferInfo = &buffer_infos[j],
+            };
+        }
+        vkUpdateDescriptorSets(vk->device, 3, writes, 0, NULL);
+    }
+    vk->lights_created = true;
+}
+
+static void vk_renderer_lights_update(Renderer* renderer,
+                                      const RendererLights* lights) {
+    VkRenderer* const vk = vk_renderer(renderer);
+    if (!vk->lights_created) vk_renderer_lights_create(vk);
+
+    // Like the instance buffers, frame begin waited for the GPU to be done
+    // with the buffers of the current frame
+    VkRendererBuffer* const buffers = vk->light_buffers[vk->current_frame];
+    memcpy(buffers[0].data, lights->lights,
+           sizeof(RendererLight) * lights->light_count);
+    memcpy(buffers[1].data, lights->ranges,
+           sizeof(u32) * 2 * RENDERER_CLUSTER_COUNT);
+    memcpy(buffers[2].data, lights->indices,
+           sizeof(u16) * lights->index_count);
+
+    glm_vec4_copy((f32*)lights->depth_plane, vk->light_constants[0]);
+    vk->light_constants[1][0] =
+        (f32)RENDERER_CLUSTERS_X / (f32)renderer->width;
+    vk->light_constants[1][1] =
+        (f32)RENDERER_CLUSTERS_Y / (f32)renderer->height;
+    vk->light_constants[1][2] = lights->slice_scale;
+    vk->light_constants[1][3] = lights->slice_bias;
+    vk->lights = true;
+}
+
+static _Bool vk_renderer_particles_create(Renderer* renderer,
+                                          u32 capacity) {
+    (void)renderer;
+    printf("Vulkan: no GPU particles, %u not created\n", capacity);
+    return false;
+}
+
+static void vk_renderer_particles_draw(Renderer* renderer,
+                                       const RendererParticles* particles) {
+    (void)renderer;
+    (void)particles;
+    assert(!"No particles were created");
+}
+
+static void vk_renderer_draw(Renderer* renderer, const RendererDraw* draw) {
+    VkRenderer* const vk = vk_renderer(renderer);
+
+    VkDrawPacket* const packet = pool_alloc(&vk->packets);
+    packet->draw = *draw;
+    packet->next = NULL;
+    if (vk->last_packet)
+        vk->last_packet->next = packet;
+    else
+        vk->first_packet = packet;
+    vk->last_packet = packet;
+}
+
+static void vk_renderer_frame_submit(Renderer* renderer) {
+    VkRenderer* const vk = vk_renderer(renderer);
+    const u32 current_frame = vk->current_frame;
+    const VkCommandBuffer cmd = vk->command_buffers[current_frame];
+
+    // The frames in flight share the offscreen image, the barrier of the
+    // graph before its first pass waits for the color writes of the previous
+    // frame (vk_render_graph_barriers)
+    if (renderer->headless)
+        vk_render_graph_set_image(&vk->graph, vk->color, vk->offscreen_image,
+                                  vk->offscreen_view);
+    else
+        vk_render_graph_set_image(&vk->graph, vk->color,
+                                  vk->swapchain.images[vk->current_image],
+                                  vk->swapchain.views[vk->current_image]);
+
+    assert(!vkResetCommandBuffer(cmd, 0));
+    const VkCommandBufferBeginInfo begin_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+    };
+    const u64 record_start = vk_profiler_cpu_now();
+    assert(!vkBeginCommandBuffer(cmd, &begin_info));
+    vk_profiler_frame_begin(&vk->profiler, cmd);
+    vk_render_graph_execute(&vk->graph, cmd, &vk->profiler);
+    vk_profiler_frame_end(&vk->profiler, cmd);
+    assert(!vkEndCommandBuffer(cmd));
+    vk_profiler_cpu_add(&vk->profiler, PROFILER_CPU_RECORD, record_start);
+
+    // Recorded, back to the pool for the next frame
+    VkDrawPacket* packet = vk->first_packet;
+    while (packet) {
+        VkDrawPacket* const next = packet->next;
+        pool_free(&vk->packets, packet);
+        packet = next;
+    }
+    vk->first_packet = vk->last_packet = NULL;
+
+    const VkPipelineStageFlags wait_stages =
+        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    // Nothing to acquire nor present when headless
+    const u32 semaphore_count = renderer->headless ? 0 : 1;
+    const VkSubmitInfo submit_info = {
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .waitSemaphoreCount = semaphore_count,
+        .pWaitSemaphores = &vk->image_available[current_frame],
+        .pWaitDstStageMask = &wait_stages,
+        .commandBufferCount = 1,
+        .pCommandBuffers = &cmd,
+        .signalSemaphoreCount = semaphore_count,
+        .pSignalSemaphores = &vk->render_finished[current_frame],
+    };
+    const u64 submit_start = vk_profiler_cpu_now();
+    vkResetFences(vk->device, 1, &vk->in_flight_fences[current_frame]);
+    assert(!vkQueueSubmit(vk->queue, 1, &submit_info,
+                          vk->in_flight_fences[current_frame]));
+    vk_profiler_cpu_add(&vk->profiler, PROFILER_CPU_SUBMIT, submit_start);
+
+    ProfilerResults profiler_results;
+    if (vk_profiler_results(&vk->profiler, &profiler_results))
+        vk_profiler_print(&profiler_results);
+}
+
+static void vk_renderer_frame_end(Renderer* renderer) {
+    VkRenderer* const vk = vk_renderer(renderer);
+
+    if (!renderer->headless) {
+        const VkPresentInfoKHR present_info = {
+            .sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
+            .waitSemaphoreCount = 1,
+            .pWaitSemaphores = &vk->render_finished[vk->current_frame],
+            .swapchainCount = 1,
+            .pSwapchains = &vk->swapchain.swapchain,
+            .pImageIndices = &vk->current_image,
+        };
+        vkQueuePresentKHR(vk->queue, &present_info);
+    }
+
+    vk->current_frame = (vk->current_frame + 1) % MAX_FRAMES_IN_FLIGHT;
+}
+
+static void vk_renderer_finish(Renderer* renderer) {
+    vkDeviceWaitIdle(vk_renderer(renderer)->device);
+}
+
+const RendererFunctions vk_renderer_functions = {
+    .name = "vulkan",
+    .init = vk_renderer_init,
+    .destroy = vk_renderer_destroy,
+    .buffer_create = vk_renderer_buffer_create,
+    .buffer_update = vk_renderer_buffer_update,
+    .texture_create = vk_renderer_texture_create,
+    .texture_array_create = vk_renderer_texture_array_create,
+    .pipeline_create = vk_renderer_pipeline_create,
+    .frame_begin = vk_renderer_frame_begin,
+    .lights_update = vk_renderer_lights_update,
+    .draw = vk_renderer_draw,
+    .particles_create = vk_renderer_particles_create,
+    .particles_draw = vk_renderer_particles_draw,
+    .frame_submit = vk_renderer_frame_submit,
+    .frame_end = vk_renderer_frame_end,
+    .finish = vk_renderer_finish,
+};
@@ -0,0 +1,199 @@
+#include "vk_scene.h"
+
+#include <assert.h>
+#include <stdio.h>
+
+#include "../bmp.h"
+#include "../cube.h"
+#include "../texture_uv.h"
+
+// Same as `gl_loop`, the rest of the cubes are laid out on a grid behind
+static const vec3 default_positions[] = {
+    {0.0f, 0.0f, 0.0f},    {2.0f, 5.0f, -15.0f}, {-1.5f, -2.2f, -2.5f},
+    {-3.8f, -2.0f, -9.3f}, {2.4f, -0.4f, -3.5f}, {-1.7f, 3.0f, -7.5f},
+    {4.3f, -2.0f, -2.5f},  {1.5f, 6.0f, -2.5f},  {1.5f, 5.2f, -1.5f},
+    {-1.3f, 3.0f, -1.5f}};
+
+static void vk_scene_positions(CubeScene* scene) {
+    scene->positions = ogl_malloc(sizeof(vec3) * scene->object_count);
+
+    for (u32 i = 0; i < scene->object_count; i++) {
+        if (i < ARR_SIZE(default_positions)) {
+            glm_vec3_copy((f32*)default_positions[i], scene->positions[i]);
+            continue;
+        }
+
+        const u32 j = i - (u32)ARR_SIZE(default_positions);
+        scene->positions[i][0] = ((f32)(j % 32) - 16.0f) * 3.0f;
+        scene->positions[i][1] = ((f32)((j / 32) % 32) - 16.0f) * 3.0f;
+        scene->positions[i][2] = -20.0f - (f32)(j / 1024) * 3.0f;
+    }
+}
+
+static void vk_scene_vertex_buffer(
+    CubeScene* scene, VkDevice* device,
+    VkPhysicalDeviceMemoryProperties* memory_properties) {
+    scene->uv_offset = sizeof(cube_vertex_buffer_data);
+    const VkDeviceSize size =
+        sizeof(cube_vertex_buffer_data) + sizeof(texture_uv_buffer_data);
+
+    vk_buffer_create(device, memory_properties, size,
+                     VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                     VK_MEMORY_PROPERTY_HOST_COHERENT_BIT |
+                         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+                     &scene->vertex_buffer, &scene->vertex_memory);
+
+    void* data;
+    assert(!vkMapMemory(*device, scene->vertex_memory, 0, size, 0, &data));
+    memcpy(data, cube_vertex_buffer_data, sizeof(cube_vertex_buffer_data));
+    memcpy((u8*)data + scene->uv_offset, texture_uv_buffer_data,
+           sizeof(texture_uv_buffer_data));
+    vkUnmapMemory(*device, scene->vertex_memory);
+}
+
+static void vk_scene_texture(
+    CubeScene* scene, VkDevice* device,
+    VkPhysicalDeviceMemoryProperties* memory_properties,
+    VkCommandPool command_pool, VkQueue queue) {
+    const usize data_capacity = 10 * 1000 * 1000;
+    u8* data = ogl_malloc(data_capacity);
+    usize data_len = 0, width = 0, height = 0, img_size = 0, data_pos = 0;
+
+    bmp_load("../resources/crate.bmp", &data, data_capacity, &data_len, &width,
+             &height, &img_size, &data_pos);
+    const u8* const img_data = data + data_pos;
+
+    vk_texture_create_bgr(device, memory_properties, command_pool, queue,
+                          (u32)width, (u32)height, img_data, &scene->texture,
+                          &scene->texture_memory, &scene->texture_view);
+    free(data);
+    vk_sampler_create(device, &scene->sampler);
+
+    printf("Uploaded texture: width=%zu height=%zu\n", width, height);
+}
+
+void vk_scene_create(CubeScene* scene, VkDevice* device, VkPhysicalDevice* gpu,
+                     VkPhysicalDeviceMemoryProperties* memory_properties,
+                     VkCommandPool command_pool, VkQueue queue,
+                     Descriptors* descriptors, u32 object_count) {
+    memset(scene, 0, sizeof(CubeScene));
+    scene->device = *device;
+    scene->object_count = object_count;
+
+    vk_scene_positions(scene);
+    vk_scene_vertex_buffer(scene, device, memory_properties);
+    vk_scene_texture(scene, device, memory_properties, command_pool, queue);
+
+    //
+    // Per frame buffers
+    //
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(*gpu, &properties);
+
+    scene->uniform_stride =
+        ALIGN_UP(sizeof(FrameUniforms),
+                 properties.limits.minUniformBufferOffsetAlignment);
+    vk_buffer_create(device, memory_properties,
+                     scene->uniform_stride * MAX_FRAMES_IN_FLIGHT,
+                     VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+                     VK_MEMORY_PROPERTY_HOST_COHERENT_BIT |
+                         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+                     &scene->uniform_buffer, &scene->uniform_memory);
+    void* data;
+    assert(!vkMapMemory(*device, scene->uniform_memory, 0, VK_WHOLE_SIZE, 0,
+                        &data));
+    scene->uniform_data = data;
+
+    scene->object_stride =
+        ALIGN_UP(sizeof(mat4) * object_count,
+                 properties.limits.minStorageBufferOffsetAlignment);
+    vk_buffer_create(device, memory_properties,
+                     scene->object_stride * MAX_FRAMES_IN_FLIGHT,
+                     VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                     VK_MEMORY_PROPERTY_HOST_COHERENT_BIT |
+                         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+                     &scene->object_buffer, &scene->object_memory);
+    assert(!vkMapMemory(*device, scene->object_memory, 0, VK_WHOLE_SIZE, 0,
+                        &data));
+    scene->object_data = data;
+
+    scene->material_set = vk_descriptors_material_set(
+        descriptors, scene->texture_view, scene->sampler);
+
+    printf("Created cube scene: objects=%u\n", object_count);
+}
+
+void vk_scene_destroy(CubeScene* scene) {
+    const VkDevice device = scene->device;
+
+    vkDestroySampler(device, scene->sampler, NULL);
+    vkDestroyImageView(device, scene->texture_view, NULL);
+    vkDestroyImage(device, scene->texture, NULL);
+    vk_memory_free(device, scene->texture_memory);
+
+    vkDestroyBuffer(device, scene->object_buffer, NULL);
+    vk_memory_free(device, scene->object_memory);
+    vkDestroyBuffer(device, scene->uniform_buffer, NULL);
+    vk_memory_free(device, scene->uniform_memory);
+    vkDestroyBuffer(device, scene->vertex_buffer, NULL);
+    vk_memory_free(device, scene->vertex_memory);
+
+    free(scene->positions);
+}
+
+void vk_scene_update(CubeScene* scene, u32 frame, VkExtent2D extent) {
+    scene->angle += 0.01f;
+
+    mat4 view, projection;
+    glm_mat4_identity(view);
+    vec3 translation = {0, 0, -10.0f};
+    glm_translate(view, translation);
+
+    glm_perspective(glm_rad(45.0f), (f32)extent.width / (f32)extent.height,
+                    0.1f, 100.0f, projection);
+
+    vk_projection_from_gl(projection);
+
+    FrameUniforms* const uniforms =
+        (FrameUniforms*)(scene->uniform_data + frame * scene->uniform_stride);
+    glm_mat4_mul(projection, view, uniforms->view_projection);
+
+    mat4* const models =
+        (mat4*)(scene->object_data + frame * scene->object_stride);
+    vec3 rotation_axis = {1.0f, 0.3f, 0.5f};
+    for (u32 i = 0; i < scene->object_count; i++) {
+        glm_mat4_identity(models[i]);
+        glm_translate(models[i], scene->positions[i]);
+        glm_rotate(models[i], glm_rad((0.8f + i) * scene->angle * 20.0f),
+                   rotation_axis);
+    }
+}
+
+void vk_scene_record(CubeScene* scene, VkCommandBuffer command_buffer,
+                     Descriptors* descriptors, u32 frame) {
+    // One descriptor set allocation and bind per frame, everything else
+    // varies through the dynamic offset and push constants
+    const VkDescriptorSet sets[2] = {
+        [DESCRIPTOR_SET_FRAME] = vk_descriptors_frame_set(
+            descriptors, frame, scene->uniform_buffer,
+            frame * scene->uniform_stride, sizeof(FrameUniforms),
+            scene->object_buffer, sizeof(mat4) * scene->object_count),
+        [DESCRIPTOR_SET_MATERIAL] = scene->material_set,
+    };
+    const u32 object_offset = (u32)(frame * scene->object_stride);
+    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                            descriptors->pipeline_layout, 0, ARR_SIZE(sets),
+                            sets, 1, &object_offset);
+
+    const VkBuffer vertex_buffers[2] = {scene->vertex_buffer,
+                                        scene->vertex_buffer};
+    const VkDeviceSize offsets[2] = {0, scene->uv_offset};
+    vkCmdBindVertexBuffers(command_buffer, 0, 2, vertex_buffers, offsets);
+
+    // All the cubes share the mesh and the material: a single instanced draw
+    const DrawPushConstants push_constants = {.object_index = 0};
+    vkCmdPushConstants(command_buffer, descriptors->pipeline_layout,
+                       VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(DrawPushConstants),
+                       &push_constants);
+    vkCmdDraw(command_buffer, CUBE_VERTEX_COUNT, scene->object_count, 0, 0);
+}
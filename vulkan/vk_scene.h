@@ -0,0 +1,58 @@
+#pragma once
+#include <cglm/cglm.h>
+#include <vulkan/vulkan.h>
+
+#include "../utils.h"
+#include "vk_descriptors.h"
+#include "vk_utils.h"
+
+// 6 squares = 12 triangles = 12*3 vertices
+#define CUBE_VERTEX_COUNT (12 * 3)
+
+typedef struct {
+    mat4 view_projection;
+} FrameUniforms;
+
+// The same textured, rotating cube field as `gl_loop`
+typedef struct {
+    VkDevice device;
+
+    u32 object_count;
+    vec3* positions;
+    f32 angle;
+
+    // Positions, then UVs
+    VkBuffer vertex_buffer;
+    VkDeviceMemory vertex_memory;
+    VkDeviceSize uv_offset;
+
+    // One region per frame in flight, persistently mapped
+    VkBuffer uniform_buffer;
+    VkDeviceMemory uniform_memory;
+    u8* uniform_data;
+    VkDeviceSize uniform_stride;
+
+    VkBuffer object_buffer;
+    VkDeviceMemory object_memory;
+    u8* object_data;
+    VkDeviceSize object_stride;
+
+    VkImage texture;
+    VkDeviceMemory texture_memory;
+    VkImageView texture_view;
+    VkSampler sampler;
+    VkDescriptorSet material_set;
+} CubeScene;
+
+void vk_scene_create(CubeScene* scene, VkDevice* device, VkPhysicalDevice* gpu,
+                     VkPhysicalDeviceMemoryProperties* memory_properties,
+                     VkCommandPool command_pool, VkQueue queue,
+                     Descriptors* descriptors, u32 object_count);
+void vk_scene_destroy(CubeScene* scene);
+
+// Advance the animation and write this frame's matrices
+void vk_scene_update(CubeScene* scene, u32 frame, VkExtent2D extent);
+
+// Must be called inside the render pass, with the pipeline bound
+void vk_scene_record(CubeScene* scene, VkCommandBuffer command_buffer,
+                     Descriptors* descriptors, u32 frame);
@@ -0,0 +1,316 @@
+#include "vk_utils.h"
+
+#include <assert.h>
+
+#include "../resource_registry.h"
+
+u32 memory_type_find(VkPhysicalDeviceMemoryProperties* memory_properties,
+                     u32 type_flag, VkMemoryPropertyFlags properties_flag) {
+    for (u32 i = 0; i < memory_properties->memoryTypeCount; i++) {
+        if ((type_flag & (1 << i)) &&
+            (memory_properties->memoryTypes[i].propertyFlags &
+             properties_flag) == properties_flag)
+            return i;
+    }
+    assert(0);
+}
+
+void vk_buffer_create(VkDevice* device,
+                      VkPhysicalDeviceMemoryProperties* memory_properties,
+                      VkDeviceSize size, VkBufferUsageFlags usage,
+                      VkMemoryPropertyFlags properties, VkBuffer* buffer,
+                      VkDeviceMemory* memory) {
+    const VkBufferCreateInfo buffer_create_info = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .size = size,
+        .usage = usage,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE};
+    assert(!vkCreateBuffer(*device, &buffer_create_info, NULL, buffer));
+
+    VkMemoryRequirements memory_requirements;
+    vkGetBufferMemoryRequirements(*device, *buffer, &memory_requirements);
+
+    const VkMemoryAllocateInfo memory_allocate_info = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+        .allocationSize = memory_requirements.size,
+        .memoryTypeIndex =
+            memory_type_find(memory_properties,
+                             memory_requirements.memoryTypeBits, properties)};
+    assert(!vkAllocateMemory(*device, &memory_allocate_info, NULL, memory));
+    assert(!vkBindBufferMemory(*device, *buffer, *memory, 0));
+
+    const VkBufferUsageFlags transfer =
+        VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    resource_track(RESOURCE_VK_MEMORY, (u64)*memory,
+                   usage & ~transfer ? RESOURCE_BUFFER : RESOURCE_STAGING,
+                   memory_requirements.size, NULL);
+}
+
+// Of every layer, VK_IMAGE_VIEW_TYPE_2D_ARRAY for texture arrays
+static void vk_image_view_create_layers(VkDevice* device, VkImage image,
+                                        VkFormat format,
+                                        VkImageAspectFlags aspect,
+                                        u32 layer_count,
+                                        VkImageViewType view_type,
+                                        VkImageView* view) {
+    const VkImageViewCreateInfo view_create_info = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+        .format = format,
+        .components =
+            {
+                .r = VK_COMPONENT_SWIZZLE_IDENTITY,
+                .g = VK_COMPONENT_SWIZZLE_IDENTITY,
+                .b = VK_COMPONENT_SWIZZLE_IDENTITY,
+                .a = VK_COMPONENT_SWIZZLE_IDENTITY,
+            },
+        .subresourceRange =
+            {
+                .aspectMask = aspect,
+                .baseMipLevel = 0,
+                .levelCount = 1,
+                .baseArrayLayer = 0,
+                .layerCount = layer_count,
+            },
+        .viewType = view_type,
+        .image = image,
+    };
+    assert(!vkCreateImageView(*device, &view_create_info, NULL, view));
+}
+
+void vk_image_view_create(VkDevice* device, VkImage image, VkFormat format,
+                          VkImageAspectFlags aspect, VkImageView* view) {
+    vk_image_view_create_layers(device, image, format, aspect, 1,
+                                VK_IMAGE_VIEW_TYPE_2D, view);
+}
+
+static void vk_image_create_layers(
+    VkDevice* device, VkPhysicalDeviceMemoryProperties* memory_properties,
+    VkFormat format, VkExtent2D extent, u32 layer_count,
+    VkImageViewType view_type, VkImageUsageFlags usage,
+    VkImageAspectFlags aspect, VkImage* image, VkDeviceMemory* memory,
+    VkImageView* view) {
+    const VkImageCreateInfo image_create_info = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+        .imageType = VK_IMAGE_TYPE_2D,
+        .format = format,
+        .extent = {extent.width, extent.height, 1},
+        .mipLevels = 1,
+        .arrayLayers = layer_count,
+        .samples = VK_SAMPLE_COUNT_1_BIT,
+        .tiling = VK_IMAGE_TILING_OPTIMAL,
+        .usage = usage,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+        .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+    };
+    assert(!vkCreateImage(*device, &image_create_info, NULL, image));
+
+    VkMemoryRequirements memory_requirements;
+    vkGetImageMemoryRequirements(*device, *image, &memory_requirements);
+
+    const VkMemoryAllocateInfo memory_allocate_info = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+        .allocationSize = memory_requirements.size,
+        .memoryTypeIndex = memory_type_find(
+            memory_properties, memory_requirements.memoryTypeBits,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)};
+    assert(!vkAllocateMemory(*device, &memory_allocate_info, NULL, memory));
+    assert(!vkBindImageMemory(*device, *image, *memory, 0));
+
+    const VkImageUsageFlags attachment =
+        VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+        VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+    resource_track(RESOURCE_VK_MEMORY, (u64)*memory,
+                   usage & attachment ? RESOURCE_RENDER_TARGET
+                                      : RESOURCE_TEXTURE,
+                   memory_requirements.size, NULL);
+
+    vk_image_view_create_layers(device, *image, format, aspect, layer_count,
+                                view_type, view);
+}
+
+void vk_image_create(VkDevice* device,
+                     VkPhysicalDeviceMemoryProperties* memory_properties,
+                     VkFormat format, VkExtent2D extent,
+                     VkImageUsageFlags usage, VkImageAspectFlags aspect,
+                     VkImage* image, VkDeviceMemory* memory,
+                     VkImageView* view) {
+    vk_image_create_layers(device, memory_properties, format, extent, 1,
+                           VK_IMAGE_VIEW_TYPE_2D, usage, aspect, image, memory,
+                           view);
+}
+
+VkCommandBuffer vk_one_time_commands_begin(VkDevice* device,
+                                           VkCommandPool command_pool) {
+    const VkCommandBufferAllocateInfo allocate_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+        .commandPool = command_pool,
+        .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+        .commandBufferCount = 1,
+    };
+
+    VkCommandBuffer command_buffer;
+    assert(!vkAllocateCommandBuffers(*device, &allocate_info, &command_buffer));
+
+    const VkCommandBufferBeginInfo begin_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT};
+    assert(!vkBeginCommandBuffer(command_buffer, &begin_info));
+
+    return command_buffer;
+}
+
+void vk_one_time_commands_end(VkDevice* device, VkCommandPool command_pool,
+                              VkQueue queue, VkCommandBuffer command_buffer) {
+    assert(!vkEndCommandBuffer(command_buffer));
+
+    const VkSubmitInfo submit_info = {
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .commandBufferCount = 1,
+        .pCommandBuffers = &command_buffer,
+    };
+    assert(!vkQueueSubmit(queue, 1, &submit_info, VK_NULL_HANDLE));
+    assert(!vkQueueWaitIdle(queue));
+
+    vkFreeCommandBuffers(*device, command_pool, 1, &command_buffer);
+}
+
+// Layers one after the other in `bgr` and in the staging buffer
+static void vk_texture_create_layers_bgr(
+    VkDevice* device, VkPhysicalDeviceMemoryProperties* memory_properties,
+    VkCommandPool command_pool, VkQueue queue, u32 width, u32 height,
+    u32 layer_count, VkImageViewType view_type, const u8* bgr, VkImage* image,
+    VkDeviceMemory* memory, VkImageView* view) {
+    // Staging buffer, BGR rows padded to 4 bytes are expanded to BGRA
+    const VkDeviceSize size = (VkDeviceSize)width * height * 4 * layer_count;
+    VkBuffer staging_buffer;
+    VkDeviceMemory staging_memory;
+    vk_buffer_create(device, memory_properties, size,
+                     VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                     VK_MEMORY_PROPERTY_HOST_COHERENT_BIT |
+                         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+                     &staging_buffer, &staging_memory);
+
+    void* staging_data;
+    assert(!vkMapMemory(*device, staging_memory, 0, size, 0, &staging_data));
+    const usize row_size = ALIGN_UP(width * 3, 4);
+    for (u32 y = 0; y < height * layer_count; y++) {
+        const u8* const src = bgr + y * row_size;
+        u8* const dst = (u8*)staging_data + (usize)y * width * 4;
+        for (u32 x = 0; x < width; x++) {
+            dst[x * 4 + 0] = src[x * 3 + 0];
+            dst[x * 4 + 1] = src[x * 3 + 1];
+            dst[x * 4 + 2] = src[x * 3 + 2];
+            dst[x * 4 + 3] = 255;
+        }
+    }
+    vkUnmapMemory(*device, staging_memory);
+
+    const VkExtent2D extent = {.width = width, .height = height};
+    vk_image_create_layers(
+        device, memory_properties, VK_FORMAT_B8G8R8A8_UNORM, extent,
+        layer_count, view_type,
+        VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+        VK_IMAGE_ASPECT_COLOR_BIT, image, memory, view);
+
+    //
+    // Upload
+    //
+    const VkCommandBuffer command_buffer =
+        vk_one_time_commands_begin(device, command_pool);
+
+    VkImageMemoryBarrier barrier = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .srcAccessMask = 0,
+        .dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+        .newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = *image,
+        .subresourceRange =
+            {
+                .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                .levelCount = 1,
+                .layerCount = layer_count,
+            },
+    };
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 0, NULL,
+                         1, &barrier);
+
+    const VkBufferImageCopy copy_region = {
+        .imageSubresource =
+            {
+                .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                .layerCount = layer_count,
+            },
+        .imageExtent = {extent.width, extent.height, 1},
+    };
+    vkCmdCopyBufferToImage(command_buffer, staging_buffer, *image,
+                           VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1,
+                           &copy_region);
+
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, NULL, 0,
+                         NULL, 1, &barrier);
+
+    vk_one_time_commands_end(device, command_pool, queue, command_buffer);
+
+    vkDestroyBuffer(*device, staging_buffer, NULL);
+    vk_memory_free(*device, staging_memory);
+}
+
+void vk_texture_create_bgr(VkDevice* device,
+                           VkPhysicalDeviceMemoryProperties* memory_properties,
+                           VkCommandPool command_pool, VkQueue queue,
+                           u32 width, u32 height, const u8* bgr,
+                           VkImage* image, VkDeviceMemory* memory,
+                           VkImageView* view) {
+    vk_texture_create_layers_bgr(device, memory_properties, command_pool,
+                                 queue, width, height, 1,
+                                 VK_IMAGE_VIEW_TYPE_2D, bgr, image, memory,
+                                 view);
+}
+
+void vk_texture_array_create_bgr(
+    VkDevice* device, VkPhysicalDeviceMemoryProperties* memory_properties,
+    VkCommandPool command_pool, VkQueue queue, u32 width, u32 height,
+    u32 layer_count, const u8* bgr, VkImage* image, VkDeviceMemory* memory,
+    VkImageView* view) {
+    vk_texture_create_layers_bgr(device, memory_properties, command_pool,
+                                 queue, width, height, layer_count,
+                                 VK_IMAGE_VIEW_TYPE_2D_ARRAY, bgr, image,
+                                 memory, view);
+}
+
+void vk_memory_free(VkDevice device, VkDeviceMemory memory) {
+    resource_untrack(RESOURCE_VK_MEMORY, (u64)memory);
+    vkFreeMemory(device, memory, NULL);
+}
+
+void vk_sampler_create(VkDevice* device, VkSampler* sampler) {
+    const VkSamplerCreateInfo sampler_create_info = {
+        .sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+        .magFilter = VK_FILTER_LINEAR,
+        .minFilter = VK_FILTER_LINEAR,
+        .mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR,
+        .addressModeU = VK_SAMPLER_ADDRESS_MODE_MIRRORED_REPEAT,
+        .addressModeV = VK_SAMPLER_ADDRESS_MODE_MIRRORED_REPEAT,
+        .addressModeW = VK_SAMPLER_ADDRESS_MODE_MIRRORED_REPEAT,
+        .maxLod = 1.0f,
+    };
+    assert(!vkCreateSampler(*device, &sampler_create_info, NULL, sampler));
+}
+
+void vk_projection_from_gl(mat4 projection) {
+    // OpenGL clip space to Vulkan's: y points down and z is in [0, 1]
+    mat4 clip = {{1.0f, 0.0f, 0.0f, 0.0f},
+                 {0.0f, -1.0f, 0.0f, 0.0f},
+                 {0.0f, 0.0f, 0.5f, 0.0f},
+                 {0.0f, 0.0f, 0.5f, 1.0f}};
+    glm_mat4_mul(clip, projection, projection);
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include <cglm/cglm.h>
+#include <vulkan/vulkan.h>
+
+#include "../utils.h"
+
+#define MAX_FRAMES_IN_FLIGHT 2
+
+#define ALIGN_UP(x, alignment) \
+    (((x) + (alignment)-1) / (alignment) * (alignment))
+
+u32 memory_type_find(VkPhysicalDeviceMemoryProperties* memory_properties,
+                     u32 type_flag, VkMemoryPropertyFlags properties_flag);
+
+void vk_buffer_create(VkDevice* device,
+                      VkPhysicalDeviceMemoryProperties* memory_properties,
+                      VkDeviceSize size, VkBufferUsageFlags usage,
+                      VkMemoryPropertyFlags properties, VkBuffer* buffer,
+                      VkDeviceMemory* memory);
+
+void vk_image_view_create(VkDevice* device, VkImage image, VkFormat format,
+                          VkImageAspectFlags aspect, VkImageView* view);
+
+// 2D image with a single mip level and its view
+void vk_image_create(VkDevice* device,
+                     VkPhysicalDeviceMemoryProperties* memory_properties,
+                     VkFormat format, VkExtent2D extent,
+                     VkImageUsageFlags usage, VkImageAspectFlags aspect,
+                     VkImage* image, VkDeviceMemory* memory,
+                     VkImageView* view);
+
+// Memory of the two functions above, or tracked by the caller in the
+// resource registry
+void vk_memory_free(VkDevice device, VkDeviceMemory memory);
+
+// For uploads at load time: records into a fresh command buffer, then
+// submits and waits for the queue to be idle
+VkCommandBuffer vk_one_time_commands_begin(VkDevice* device,
+                                           VkCommandPool command_pool);
+void vk_one_time_commands_end(VkDevice* device, VkCommandPool command_pool,
+                              VkQueue queue, VkCommandBuffer command_buffer);
+
+// Device local BGRA texture from 24 bits BGR rows padded to 4 bytes (BMP),
+// ready to be sampled
+void vk_texture_create_bgr(VkDevice* device,
+                           VkPhysicalDeviceMemoryProperties* memory_properties,
+                           VkCommandPool command_pool, VkQueue queue,
+                           u32 width, u32 height, const u8* bgr,
+                           VkImage* image, VkDeviceMemory* memory,
+                           VkImageView* view);
+// Same with `layer_count` layers of BGR rows one after the other, viewed as
+// a 2D array
+void vk_texture_array_create_bgr(
+    VkDevice* device, VkPhysicalDeviceMemoryProperties* memory_properties,
+    VkCommandPool command_pool, VkQueue queue, u32 width, u32 height,
+    u32 layer_count, const u8* bgr, VkImage* image, VkDeviceMemory* memory,
+    VkImageView* view);
+// Linear, mirrored repeat, like the OpenGL texture
+void vk_sampler_create(VkDevice* device, VkSampler* sampler);
+
+// Projections are built with OpenGL conventions
+void vk_projection_from_gl(mat4 projection);
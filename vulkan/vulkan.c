@@ -11,283 +11,349 @@
 #include <vulkan/vulkan.h>
 #include <vulkan/vulkan_core.h>
 
+#include "../resource_registry.h"
+#include "../trace.h"
 #include "../utils.h"
+#include "vk_descriptors.h"
+#include "vk_device.h"
+#include "vk_pipeline.h"
+#include "vk_profiler.h"
+#include "vk_render_graph.h"
+#include "vk_scene.h"
+#include "vk_utils.h"
+
+// Headless rendering targets, one per frame in flight
+typedef struct {
+    VkImage image;
+    VkDeviceMemory memory;
+    VkImageView view;
+
+    // Only set when reading back
+    VkBuffer readback_buffer;
+    VkDeviceMemory readback_memory;
+    u8* readback_data;
+} OffscreenTarget;
+
+// Inputs of the frame graph passes, updated before recording every frame
+typedef struct {
+    PipelineVariants variants;
+    PipelineVariantKey variant;  // Requested specialization
+    CubeScene* scene;
+    Descriptors* descriptors;
+    VkExtent2D extent;
+    u32 frame;
+    u32 color;  // Graph resource of the color target
+    OffscreenTarget* readback_target;
+} FrameContext;
+
+static void vk_main_pass_record(RenderGraph* graph, VkCommandBuffer cmd,
+                                void* user_data) {
+    (void)graph;
+    FrameContext* const context = user_data;
+
+    vkCmdBindPipeline(
+        cmd, VK_PIPELINE_BIND_POINT_GRAPHICS,
+        vk_pipeline_variants_get(&context->variants, &context->variant));
+
+    const VkViewport viewport = {
+        .width = context->extent.width,
+        .height = context->extent.height,
+        .minDepth = 0.0f,
+        .maxDepth = 1.0f,
+    };
 
-#define MAX_EXTENSIONS 64
-#define MAX_LAYERS 64
-
-#define MAX_FRAMES_IN_FLIGHT 2
-
-static SDL_Window* window_create() {
-    SDL_SetHint(SDL_HINT_FRAMEBUFFER_ACCELERATION, "1");
-    if (SDL_Init(SDL_INIT_VIDEO) < 0) {
-        fprintf(stderr, "Unable to initialize SDL: %s", SDL_GetError());
-        exit(1);
-    }
-
-    u32 flags = SDL_WINDOW_SHOWN | SDL_WINDOW_RESIZABLE | SDL_WINDOW_VULKAN;
-    const char window_title[] = "hello";
-    const u16 window_width = 1024;
-    const u16 window_height = 768;
-    SDL_Window* window = SDL_CreateWindow(window_title, SDL_WINDOWPOS_CENTERED,
-                                          SDL_WINDOWPOS_CENTERED, window_width,
-                                          window_height, flags);
-
-    if (!window) {
-        fprintf(stderr, "Unable to create window: %s", SDL_GetError());
-        exit(1);
-    }
-
-    return window;
+    const VkRect2D scissor = {.extent = context->extent};
+    vkCmdSetViewport(cmd, 0, 1, &viewport);
+    vkCmdSetScissor(cmd, 0, 1, &scissor);
+    vk_scene_record(context->scene, cmd, context->descriptors, context->frame);
 }
 
-static void vk_get_extensions(SDL_Window* window,
-                              const char* extension_names[MAX_EXTENSIONS],
-                              u32* extension_count) {
-    extension_names[*extension_count] = VK_KHR_SURFACE_EXTENSION_NAME;
-    *extension_count = *extension_count + 1;
-
-    u32 detected_extension_count = 64 - *extension_count;
-    if (!SDL_Vulkan_GetInstanceExtensions(window, &detected_extension_count,
-                                          &extension_names[*extension_count])) {
-        fprintf(stderr, "SDL_GetVulkanInstanceExtensions failed: %s\n",
-                SDL_GetError());
-        exit(1);
-    }
-    *extension_count += detected_extension_count;
-
-    printf("Instance extensions: count=%u\n", *extension_count);
-    for (u32 i = 0; i < *extension_count; i++) {
-        printf("Extension: %s\n", extension_names[i]);
-    }
+static void vk_readback_pass_record(RenderGraph* graph, VkCommandBuffer cmd,
+                                    void* user_data) {
+    FrameContext* const context = user_data;
+    OffscreenTarget* const target = context->readback_target;
+
+    const VkBufferImageCopy copy_region = {
+        .imageSubresource =
+            {
+                .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                .layerCount = 1,
+            },
+        .imageExtent = {context->extent.width, context->extent.height, 1},
+    };
+    vkCmdCopyImageToBuffer(cmd, vk_render_graph_image(graph, context->color),
+                           VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                           target->readback_buffer, 1, &copy_region);
+
+    const VkBufferMemoryBarrier host_barrier = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_HOST_READ_BIT,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .buffer = target->readback_buffer,
+        .size = VK_WHOLE_SIZE,
+    };
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_HOST_BIT, 0, 0, NULL, 1,
+                         &host_barrier, 0, NULL);
 }
 
-static void vk_get_validation_layers(const char* validation_layer) {
-    VkLayerProperties layers[MAX_LAYERS];
-    u32 layer_count;
-
-    vkEnumerateInstanceLayerProperties(&layer_count, NULL);
-    assert(layer_count < MAX_LAYERS);
-    printf("Available layers: %u\n", layer_count);
-
-    vkEnumerateInstanceLayerProperties(&layer_count, layers);
+// The main pass draws the cube scene into the color target with a transient
+// depth buffer, the optional readback pass copies the color target to host
+// memory. Also creates the pipeline variants, against the compiled main pass.
+static void vk_create_frame_graph(
+    RenderGraph* graph, VkDevice* device,
+    VkPhysicalDeviceMemoryProperties* memory_properties, VkFormat format,
+    VkFormat depth_format, VkExtent2D extent, VkImageLayout final_layout,
+    _Bool readback, VkPipelineShaderStageCreateInfo shader_stages[2],
+    FrameContext* context) {
+    vk_render_graph_init(graph, device, memory_properties);
+
+    context->extent = extent;
+    context->color = vk_render_graph_import(graph, "color", format, extent,
+                                            VK_IMAGE_ASPECT_COLOR_BIT,
+                                            final_layout);
+    const u32 depth = vk_render_graph_transient(
+        graph, "depth", depth_format, extent, VK_IMAGE_ASPECT_DEPTH_BIT);
+
+    const u32 main_pass =
+        vk_render_graph_pass(graph, "main_pass", RENDER_GRAPH_PASS_GRAPHICS,
+                             vk_main_pass_record, context);
+    vk_render_graph_attachment(
+        graph, main_pass, context->color, RENDER_GRAPH_COLOR_ATTACHMENT,
+        VK_ATTACHMENT_LOAD_OP_CLEAR,
+        (VkClearValue){.color.float32 = {0.15f, 0.15f, 0.15f, 1.0f}});
+    vk_render_graph_attachment(
+        graph, main_pass, depth, RENDER_GRAPH_DEPTH_ATTACHMENT,
+        VK_ATTACHMENT_LOAD_OP_CLEAR,
+        (VkClearValue){.depthStencil = {.depth = 1.0f, .stencil = 0}});
+
+    if (readback) {
+        const u32 readback_pass = vk_render_graph_pass(
+            graph, "readback", RENDER_GRAPH_PASS_SIDE_EFFECTS,
+            vk_readback_pass_record, context);
+        vk_render_graph_use(graph, readback_pass, context->color,
+                            RENDER_GRAPH_TRANSFER_SRC);
+    }
 
-    _Bool found = false;
-    for (u32 i = 0; i < layer_count; i++) {
-        printf("Available layer: %s\n", layers[i].layerName);
+    vk_render_graph_compile(graph);
+    vk_render_graph_print_stats(graph);
 
-        if (strcmp(validation_layer, layers[i].layerName) == 0) {
-            found = true;
-            break;
-        }
-    }
-    if (!found) {
-        fprintf(stderr, "Validation layer not found\n");
-    }
-    printf("Validation layer found, activating\n");
+    const PipelineVariantKey default_variant = {
+        .values = {[SPEC_TEXTURED] = VK_TRUE,
+                   [SPEC_INSTANCE_COLORS] = VK_FALSE}};
+    vk_pipeline_variants_init(&context->variants, device, shader_stages,
+                              vk_render_graph_render_pass(graph, main_pass),
+                              context->descriptors->pipeline_layout,
+                              &default_variant);
 }
 
-static void vk_create_instance(VkInstance* instance,
-                               const char* extension_names[MAX_EXTENSIONS],
-                               u32 extension_count,
-                               const char* validation_layer,
-                               u32 validation_layer_count) {
-    const VkApplicationInfo app_info = {
-        .sType = VK_STRUCTURE_TYPE_APPLICATION_INFO,
-        .apiVersion = VK_MAKE_VERSION(1, 0, 0)};
-
-    const VkInstanceCreateInfo instance_create_info = {
-        .sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO,
-        .pApplicationInfo = &app_info,
-        .enabledExtensionCount = extension_count,
-        .ppEnabledExtensionNames = extension_names,
-        .enabledLayerCount = validation_layer_count,
-        .ppEnabledLayerNames = &validation_layer};
-
-    assert(!vkCreateInstance(&instance_create_info, NULL, instance));
+static void vk_record_command_buffer(VkCommandBuffer command_buffer,
+                                     RenderGraph* graph, Profiler* profiler) {
+    const VkCommandBufferBeginInfo command_buffer_begin_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT};
+
+    assert(!vkBeginCommandBuffer(command_buffer, &command_buffer_begin_info));
+    vk_profiler_frame_begin(profiler, command_buffer);
+    vk_render_graph_execute(graph, command_buffer, profiler);
+    vk_profiler_frame_end(profiler, command_buffer);
+    assert(!vkEndCommandBuffer(command_buffer));
 }
 
-static void vk_create_physical_device(VkInstance* instance,
-                                      VkPhysicalDevice* gpu) {
-    u32 gpu_count;
-    assert(!vkEnumeratePhysicalDevices(*instance, &gpu_count, NULL));
-
-    if (gpu_count == 0) {
-        fprintf(stderr, "No GPUs detected\n");
-        exit(1);
-    } else {
-        VkPhysicalDevice gpus[gpu_count];
-        assert(!vkEnumeratePhysicalDevices(*instance, &gpu_count, gpus));
-        *gpu = gpus[0];
-    }
-    printf("GPUs detected: %u\n", gpu_count);
+static void vk_create_offscreen_target(
+    VkDevice* device, VkPhysicalDeviceMemoryProperties* memory_properties,
+    VkFormat format, VkExtent2D extent, _Bool readback,
+    OffscreenTarget* target) {
+    memset(target, 0, sizeof(OffscreenTarget));
+
+    vk_image_create(device, memory_properties, format, extent,
+                    VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+                        VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+                    VK_IMAGE_ASPECT_COLOR_BIT, &target->image, &target->memory,
+                    &target->view);
+
+    if (!readback) return;
+
+    // 4 bytes per pixel, the format is always a 8 bit BGRA one
+    vk_buffer_create(device, memory_properties,
+                     (VkDeviceSize)extent.width * extent.height * 4,
+                     VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                     VK_MEMORY_PROPERTY_HOST_COHERENT_BIT |
+                         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+                     &target->readback_buffer, &target->readback_memory);
+
+    // Stays mapped for the whole run
+    void* data = NULL;
+    assert(!vkMapMemory(*device, target->readback_memory, 0, VK_WHOLE_SIZE, 0,
+                        &data));
+    target->readback_data = data;
 }
 
-static u32 vk_find_queue_family(VkPhysicalDevice* gpu, VkSurfaceKHR* surface) {
-    u32 queue_family_index = UINT32_MAX;
-    u32 queue_count;
-
-    vkGetPhysicalDeviceQueueFamilyProperties(*gpu, &queue_count, NULL);
-    VkQueueFamilyProperties queue_properties[queue_count];
-    vkGetPhysicalDeviceQueueFamilyProperties(*gpu, &queue_count,
-
-                                             queue_properties);
+typedef struct {
+    f64 sum_ms, min_ms, max_ms;
+    u32 count;
+} LatencyStats;
 
-    if (queue_count == 0) {
-        fprintf(stderr, "No queue family properties were found\n");
-        exit(1);
-    }
-    printf("Found %u family properties\n", queue_count);
-
-    for (u32 i = 0; i < queue_count; i++) {
-        VkBool32 supported;
-        vkGetPhysicalDeviceSurfaceSupportKHR(*gpu, i, *surface, &supported);
-
-        if (supported &&
-            (queue_properties[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) != 0) {
-            queue_family_index = i;
-            break;
-        }
-    }
-
-    if (queue_family_index == UINT32_MAX) {
-        fprintf(stderr, "No proper queue family found\n");
-        exit(1);
-    }
-
-    return queue_family_index;
+static f64 ticks_to_ms(u64 ticks) {
+    return (f64)ticks * 1000.0 / (f64)SDL_GetPerformanceFrequency();
 }
 
-static void vk_create_logical_device(VkPhysicalDevice* gpu,
-                                     u32 queue_family_index, VkDevice* device) {
-    u32 extension_count = 0;
+static void latency_stats_add(LatencyStats* stats, u64 submit_time) {
+    const f64 ms = ticks_to_ms(SDL_GetPerformanceCounter() - submit_time);
+    stats->sum_ms += ms;
+    stats->min_ms = stats->count == 0 ? ms : fmin(stats->min_ms, ms);
+    stats->max_ms = fmax(stats->max_ms, ms);
+    stats->count += 1;
+}
 
-    const char* extension_names[MAX_EXTENSIONS];
-    extension_names[extension_count++] = VK_KHR_SWAPCHAIN_EXTENSION_NAME;
-
-    f32 queue_priorities[1] = {0.0};
-    const VkDeviceQueueCreateInfo queue_info = {
-        .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
-        .queueFamilyIndex = queue_family_index,
-        .queueCount = 1,
-        .pQueuePriorities = queue_priorities};
-
-    const VkDeviceCreateInfo device_create_info = {
-        .sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
-        .queueCreateInfoCount = 1,
-        .pQueueCreateInfos = &queue_info,
-        .enabledExtensionCount = extension_count,
-        .ppEnabledExtensionNames = extension_names,
-    };
+// Render `frame_count` frames into offscreen images without any window,
+// surface or swapchain, as fast as possible, and report throughput and
+// latency (submit to fence signaled).
+static void vk_run_headless(
+    VkDevice* device, VkQueue queue,
+    VkPhysicalDeviceMemoryProperties* memory_properties,
+    RenderGraph* graph, FrameContext* context, VkFormat format,
+    VkExtent2D extent, VkCommandBuffer command_buffers[MAX_FRAMES_IN_FLIGHT],
+    Profiler* profiler, u32 frame_count, _Bool readback) {
+    OffscreenTarget targets[MAX_FRAMES_IN_FLIGHT];
+    VkFence in_flight_fences[MAX_FRAMES_IN_FLIGHT];
+    u64 submit_times[MAX_FRAMES_IN_FLIGHT] = {0};
+    _Bool pending[MAX_FRAMES_IN_FLIGHT] = {0};
 
-    assert(!vkCreateDevice(*gpu, &device_create_info, NULL, device));
-}
+    const VkFenceCreateInfo fence_create_info = {
+        .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+        .flags = VK_FENCE_CREATE_SIGNALED_BIT};
 
-static void vk_create_command_pool(VkDevice* device, u32 queue_family_index,
-                                   VkCommandPool* command_pool) {
-    const VkCommandPoolCreateInfo command_pool_create_info = {
+    for (u32 i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        vk_create_offscreen_target(device, memory_properties, format, extent,
+                                   readback, &targets[i]);
+        assert(!vkCreateFence(*device, &fence_create_info, NULL,
+                              &in_flight_fences[i]));
+    }
+    printf("Headless: rendering %u frames of %ux%u readback=%d\n",
+           frame_count, extent.width, extent.height, readback);
 
-        .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
-        .queueFamilyIndex = queue_family_index,
-        .flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT};
+    LatencyStats latency = {0};
+    const u64 start = SDL_GetPerformanceCounter();
 
-    assert(!vkCreateCommandPool(*device, &command_pool_create_info, NULL,
-                                command_pool));
-}
+    for (u32 frame = 0; frame < frame_count; frame++) {
+        const u32 current_frame = frame % MAX_FRAMES_IN_FLIGHT;
+        OffscreenTarget* const target = &targets[current_frame];
+        TRACE_BEGIN("frame");
 
-static void vk_get_color_info(VkPhysicalDevice* gpu, VkSurfaceKHR* surface,
-                              VkFormat* format, u32* format_count,
-                              VkColorSpaceKHR* color_space) {
-    assert(!vkGetPhysicalDeviceSurfaceFormatsKHR(*gpu, *surface, format_count,
-                                                 NULL));
+        TRACE_BEGIN("wait");
+        vkWaitForFences(*device, 1, &in_flight_fences[current_frame], VK_TRUE,
+                        UINT64_MAX);
+        TRACE_END();
+        if (pending[current_frame]) {
+            latency_stats_add(&latency, submit_times[current_frame]);
+            pending[current_frame] = false;
+        }
 
-    printf("Found %d formats\n", *format_count);
+        TRACE_BEGIN("record");
+        const u64 record_start = vk_profiler_cpu_now();
+        vk_descriptors_frame_begin(context->descriptors, current_frame);
+        vk_scene_update(context->scene, current_frame, extent);
+        context->frame = current_frame;
+        context->readback_target = target;
+        vk_render_graph_set_image(graph, context->color, target->image,
+                                  target->view);
+        assert(!vkResetCommandBuffer(command_buffers[current_frame], 0));
+        vk_record_command_buffer(command_buffers[current_frame], graph,
+                                 profiler);
+        vk_profiler_cpu_add(profiler, PROFILER_CPU_RECORD, record_start);
+        TRACE_END();
 
-    VkSurfaceFormatKHR formats[*format_count];
+        const VkSubmitInfo submit_info = {
+            .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+            .commandBufferCount = 1,
+            .pCommandBuffers = &command_buffers[current_frame],
+        };
 
-    assert(!vkGetPhysicalDeviceSurfaceFormatsKHR(*gpu, *surface, format_count,
-                                                 formats));
+        TRACE_BEGIN("submit");
+        const u64 submit_start = vk_profiler_cpu_now();
+        vkResetFences(*device, 1, &in_flight_fences[current_frame]);
+        assert(!vkQueueSubmit(queue, 1, &submit_info,
+                              in_flight_fences[current_frame]));
+        vk_profiler_cpu_add(profiler, PROFILER_CPU_SUBMIT, submit_start);
+        TRACE_END();
+        submit_times[current_frame] = submit_start;
+        pending[current_frame] = true;
+
+        // Catch frames which completed early, without waiting
+        for (u32 i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+            if (i == current_frame || !pending[i]) continue;
+            if (vkGetFenceStatus(*device, in_flight_fences[i]) == VK_SUCCESS) {
+                latency_stats_add(&latency, submit_times[i]);
+                pending[i] = false;
+            }
+        }
 
-    if (*format_count == 0) {
-        fprintf(stderr, "Found zero format\n");
-        exit(1);
+        ProfilerResults profiler_results;
+        if (vk_profiler_results(profiler, &profiler_results))
+            vk_profiler_print(&profiler_results);
+        TRACE_END();
     }
 
-    if (*format_count == 1 && formats[0].format == VK_FORMAT_UNDEFINED) {
-        printf(
-            "Found only one format which is undefined,defaulting to "
-            "VK_FORMAT_B8G8R8A8_SRGB\n");
-        *format = VK_FORMAT_B8G8R8A8_SRGB;
-    } else {
-        *format = formats[0].format;
+    for (u32 i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        if (!pending[i]) continue;
+        vkWaitForFences(*device, 1, &in_flight_fences[i], VK_TRUE, UINT64_MAX);
+        latency_stats_add(&latency, submit_times[i]);
     }
-
-    *color_space = formats[0].colorSpace;
-    printf("Format: %d\n", *format);
-    printf("Color space: %d\n", *color_space);
-}
-
-static void vk_create_shader_module(VkDevice* device, const char path[],
-                                    u8* buffer, usize buffer_capacity,
-                                    usize* buffer_len,
-                                    VkShaderModule* shader_module) {
-    if (file_read(path, buffer, buffer_capacity, buffer_len) != 0) {
-        exit(errno);
+    const f64 total_ms = ticks_to_ms(SDL_GetPerformanceCounter() - start);
+
+    printf(
+        "Headless: frames=%u total=%.3fms throughput=%.1ffps "
+        "latency_mean=%.3fms latency_min=%.3fms latency_max=%.3fms\n",
+        frame_count, total_ms,
+        total_ms > 0 ? frame_count * 1000.0 / total_ms : 0.0,
+        latency.count ? latency.sum_ms / latency.count : 0.0, latency.min_ms,
+        latency.max_ms);
+
+    if (readback && frame_count > 0) {
+        // Checksum of the last frame, to compare runs and drivers
+        const OffscreenTarget* const last =
+            &targets[(frame_count - 1) % MAX_FRAMES_IN_FLIGHT];
+        u64 checksum = 0;
+        for (usize i = 0; i < (usize)extent.width * extent.height * 4; i++)
+            checksum = checksum * 31 + last->readback_data[i];
+        printf("Headless: last frame checksum=%" PRIx64 "\n", checksum);
     }
 
-    VkShaderModuleCreateInfo create_info = {
-        .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
-        .codeSize = *buffer_len,
-        .pCode = (u32*)buffer,
-    };
-
-    assert(!vkCreateShaderModule(*device, &create_info, NULL, shader_module));
-    memset(buffer, 0, buffer_capacity);
-
-    printf("Created shader module for `%s`\n", path);
-}
-
-static void vk_create_shader_stages(
-    VkShaderModule* vert_shader_module, VkShaderModule* frag_shader_module,
-    VkPipelineShaderStageCreateInfo shader_stages[2]) {
-    const VkPipelineShaderStageCreateInfo vert_shader_stage_info = {
-        .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
-        .stage = VK_SHADER_STAGE_VERTEX_BIT,
-        .module = *vert_shader_module,
-        .pName = "main"  // Entrypoint function
-    };
-
-    const VkPipelineShaderStageCreateInfo frag_shader_stage_info = {
-        .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
-        .stage = VK_SHADER_STAGE_FRAGMENT_BIT,
-        .module = *frag_shader_module,
-        .pName = "main"  // Entrypoint function
-    };
-
-    shader_stages[0] = vert_shader_stage_info;
-    shader_stages[1] = frag_shader_stage_info;
-}
-
-static u32 memory_type_find(VkPhysicalDeviceMemoryProperties* memory_properties,
-                            u32 type_flag,
-                            VkMemoryPropertyFlags properties_flag) {
-    for (u32 i = 0; i < memory_properties->memoryTypeCount; i++) {
-        if ((type_flag & (1 << i)) &&
-            (memory_properties->memoryTypes[i].propertyFlags &
-             properties_flag) == properties_flag)
-            return i;
+    for (u32 i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        vkDestroyFence(*device, in_flight_fences[i], NULL);
+        vkDestroyImageView(*device, targets[i].view, NULL);
+        vkDestroyImage(*device, targets[i].image, NULL);
+        vk_memory_free(*device, targets[i].memory);
+        if (readback) {
+            vkDestroyBuffer(*device, targets[i].readback_buffer, NULL);
+            vk_memory_free(*device, targets[i].readback_memory);
+        }
     }
-    assert(0);
 }
 
 int main() {
+    // `TRACE=<path>` records a trace of the CPU and GPU (timestamps) zones,
+    // written on exit and on F12
+    trace_init();
+    trace_thread_name("main");
+
+    // `HEADLESS=<frames>` renders offscreen without a window and exits,
+    // `READBACK=1` additionally copies every frame to a host buffer
+    const char* const headless = getenv("HEADLESS");
+    const u32 headless_frames =
+        headless ? (u32)strtoul(headless, NULL, 10) : 0;
+    const _Bool readback = headless && getenv("READBACK");
+
     // Create window
-    SDL_Window* window = window_create();
+    SDL_Window* window = headless ? NULL : vk_window_create();
 
     // get extensions
     u32 extension_count = 0;
     const char* extension_names[MAX_EXTENSIONS] = {0};
-    vk_get_extensions(window, extension_names, &extension_count);
+    if (!headless) vk_get_extensions(window, extension_names, &extension_count);
 
     // Get validation layers
     const char* validation_layer = "VK_LAYER_KHRONOS_validation";
@@ -300,8 +366,8 @@ int main() {
                        debug ? validation_layer : NULL, debug ? 1 : 0);
 
     // Create Vulkan surface
-    VkSurfaceKHR surface;
-    if (!SDL_Vulkan_CreateSurface(window, instance, &surface)) {
+    VkSurfaceKHR surface = VK_NULL_HANDLE;
+    if (!headless && !SDL_Vulkan_CreateSurface(window, instance, &surface)) {
         fprintf(stderr, "SDL_Vulkan_CreateSurface failed: %s\n",
                 SDL_GetError());
         exit(1);
@@ -312,11 +378,12 @@ int main() {
     vk_create_physical_device(&instance, &gpu);
 
     // Find appropriate queue family
-    const u32 queue_family_index = vk_find_queue_family(&gpu, &surface);
+    const u32 queue_family_index =
+        vk_find_queue_family(&gpu, headless ? NULL : &surface);
 
     // Create logical device
     VkDevice device;
-    vk_create_logical_device(&gpu, queue_family_index, &device);
+    vk_create_logical_device(&gpu, queue_family_index, !headless, &device);
 
     // Create queue
     VkQueue queue;
@@ -327,10 +394,12 @@ int main() {
     vk_create_command_pool(&device, queue_family_index, &command_pool);
 
     // Get color format
-    VkFormat format;
+    VkFormat format = VK_FORMAT_B8G8R8A8_UNORM;
     u32 format_count;
     VkColorSpaceKHR color_space;
-    vk_get_color_info(&gpu, &surface, &format, &format_count, &color_space);
+    if (!headless)
+        vk_get_color_info(&gpu, &surface, &format, &format_count,
+                          &color_space);
 
     // Set up shaders
     VkPipelineShaderStageCreateInfo shader_stages[2];
@@ -339,300 +408,118 @@ int main() {
     usize buffer_len;
 
     VkShaderModule vert_shader_module;
-    vk_create_shader_module(&device, "resources/triangle_vert.spv", buffer,
+    vk_create_shader_module(&device, "resources/cube_vert.spv", buffer,
                             buffer_capacity, &buffer_len, &vert_shader_module);
 
     VkShaderModule frag_shader_module;
-    vk_create_shader_module(&device, "resources/triangle_frag.spv", buffer,
+    vk_create_shader_module(&device, "resources/cube_frag.spv", buffer,
                             buffer_capacity, &buffer_len, &frag_shader_module);
 
     vk_create_shader_stages(&vert_shader_module, &frag_shader_module,
                             shader_stages);
+    free(buffer);
 
-    VkSurfaceCapabilitiesKHR surface_capabilities;
-    assert(!vkGetPhysicalDeviceSurfaceCapabilitiesKHR(gpu, surface,
-                                                      &surface_capabilities));
     //
-    // Swap chain
+    // Attachments
     //
-    VkSwapchainKHR swapchain;
-    u32 swapchain_image_count;
-    VkExtent2D swapchain_extent;
-
-    // Get drawing surface dimensions
-    if (surface_capabilities.currentExtent.width == (UINT32_MAX)) {
-        i32 w, h;
-        SDL_GetWindowSize(window, &w, &h);
-        printf("Window size as reported by the SDL: w=%d h=%d\n", w, h);
-        swapchain_extent.width = (u32)w;
-        swapchain_extent.height = (u32)h;
-    } else {
-        swapchain_extent = surface_capabilities.currentExtent;
-        printf("Window size as reported by Vulkan: w=%u h=%u\n",
-               swapchain_extent.width, swapchain_extent.height);
-    }
-
-    swapchain_image_count = surface_capabilities.minImageCount + 1;
+    VkImageLayout final_layout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    if (readback)
+        final_layout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    else if (headless)
+        final_layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
-    if ((surface_capabilities.maxImageCount > 0) &&
-        (swapchain_image_count > surface_capabilities.maxImageCount)) {
-        swapchain_image_count = surface_capabilities.maxImageCount;
-    }
+    // Depth: D32_SFLOAT is supported as a depth attachment by every desktop
+    // implementation
+    const VkFormat depth_format = VK_FORMAT_D32_SFLOAT;
 
-    const VkSwapchainCreateInfoKHR swapchain_create_info = {
-        .sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR,
-        .surface = surface,
-        .minImageCount = swapchain_image_count,
-        .imageFormat = format,
-        .imageColorSpace = color_space,
-        .imageExtent = swapchain_extent,
-        .imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
-        .preTransform = surface_capabilities.currentTransform,
-        .compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR,
-        .imageArrayLayers = 1,
-        .imageSharingMode = VK_SHARING_MODE_EXCLUSIVE,
-        .presentMode = VK_PRESENT_MODE_FIFO_KHR,
-        .clipped = 1};
-
-    assert(!vkCreateSwapchainKHR(device, &swapchain_create_info, NULL,
-                                 &swapchain));
-
-    printf("Swapchain image count: %u\n", swapchain_image_count);
+    Descriptors descriptors;
+    vk_descriptors_init(&descriptors, &device);
 
     //
-    // Fixed functions
+    // Scene
     //
+    VkPhysicalDeviceMemoryProperties memory_properties;
+    vkGetPhysicalDeviceMemoryProperties(gpu, &memory_properties);
 
-    const VkPipelineViewportStateCreateInfo viewport_state = {
-        .sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
-        .viewportCount = 1,
-        .scissorCount = 1,
-    };
-
-    const VkPipelineRasterizationStateCreateInfo rasterizer = {
-        .sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
-        .polygonMode = VK_POLYGON_MODE_FILL,
-        .lineWidth = 1.0f,
-        .cullMode = VK_CULL_MODE_BACK_BIT,
-        .frontFace = VK_FRONT_FACE_CLOCKWISE,
-    };
-
-    const VkPipelineMultisampleStateCreateInfo multisampling = {
-        .sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
-        .rasterizationSamples = VK_SAMPLE_COUNT_1_BIT,
-        .minSampleShading = 1.0f,
-    };
-
-    const VkPipelineColorBlendAttachmentState color_blend_attachment = {
-        .colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
-                          VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_B_BIT,
-        .srcColorBlendFactor = VK_BLEND_FACTOR_ONE,
-        .dstColorBlendFactor = VK_BLEND_FACTOR_ZERO,
-        .colorBlendOp = VK_BLEND_OP_ADD,
-        .srcAlphaBlendFactor = VK_BLEND_FACTOR_ZERO,
-        .dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO,
-        .alphaBlendOp = VK_BLEND_OP_ADD,
-    };
-
-    const VkPipelineColorBlendStateCreateInfo color_blending = {
-        .sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
-        .logicOp = VK_LOGIC_OP_COPY,
-        .attachmentCount = 1,
-        .pAttachments = &color_blend_attachment,
-    };
-
-    const VkPipelineLayoutCreateInfo pipeline_layout_create_info = {
-        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
-    };
-
-    VkPipelineLayout pipeline_layout;
-
-    // Per vertex data
-    struct Vertex {
-        vec2 position;
-        vec3 color;
-    } vertices[] = {{{0.0f, -0.5f}, {1.0f, 0.0f, 0.0f}},
-                    {{0.5f, 0.5f}, {0.0f, 1.0f, 0.0f}},
-                    {{-0.5f, 0.5f}, {0.0f, 0.0f, 1.0f}}};
-
-    VkVertexInputBindingDescription vertex_binding_description = {
-        .binding = 0,
-        .stride = sizeof(struct Vertex),
-        .inputRate = VK_VERTEX_INPUT_RATE_VERTEX};
-
-    VkVertexInputAttributeDescription vertex_attribute_descriptions[2] = {
-        // Metadata about the `position` field
-        {.format = VK_FORMAT_R32G32_SFLOAT,
-         .binding = 0,
-         .location = 0,
-         .offset = offsetof(struct Vertex, position)},
-
-        // Metadata about the `color` field
-        {.location = 1,
-         .binding = 0,
-         .format = VK_FORMAT_R32G32B32_SFLOAT,
-         .offset = offsetof(struct Vertex, color)}};
-
-    // Shader input
-    const VkPipelineVertexInputStateCreateInfo vertex_input_info = {
-        .sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
-        .vertexBindingDescriptionCount = 1,
-        .vertexAttributeDescriptionCount = 2,
-        .pVertexBindingDescriptions = &vertex_binding_description,
-        .pVertexAttributeDescriptions = vertex_attribute_descriptions,
-    };
+    // `CUBES=<count>` sets the number of instanced cubes
+    const char* const cubes = getenv("CUBES");
+    const u32 cube_count = cubes ? (u32)strtoul(cubes, NULL, 10) : 10;
 
-    const VkPipelineInputAssemblyStateCreateInfo input_assembly = {
-        .sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
-        .topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
-        .primitiveRestartEnable = VK_FALSE,
-    };
-    assert(!vkCreatePipelineLayout(device, &pipeline_layout_create_info, NULL,
-                                   &pipeline_layout));
-
-    VkImage images[swapchain_image_count];
-    VkImageView views[swapchain_image_count];
-    VkFramebuffer frame_buffers[swapchain_image_count];
-
-    assert(
-        !vkGetSwapchainImagesKHR(device, swapchain, &swapchain_image_count, 0));
-
-    VkImage swapchain_images[swapchain_image_count];
-    assert(!vkGetSwapchainImagesKHR(device, swapchain, &swapchain_image_count,
-                                    swapchain_images));
-
-    for (u32 i = 0; i < swapchain_image_count; i++)
-        images[i] = swapchain_images[i];
-
-    for (u32 i = 0; i < swapchain_image_count; i++) {
-        VkImageViewCreateInfo color_attachment_view = {
-            .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
-            .format = format,
-            .components =
-                {
-                    .r = VK_COMPONENT_SWIZZLE_IDENTITY,
-                    .g = VK_COMPONENT_SWIZZLE_IDENTITY,
-                    .b = VK_COMPONENT_SWIZZLE_IDENTITY,
-                    .a = VK_COMPONENT_SWIZZLE_IDENTITY,
-                },
-            .subresourceRange =
-                {
-                    .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-                    .baseMipLevel = 0,
-                    .levelCount = 1,
-                    .baseArrayLayer = 0,
-                    .layerCount = 1,
-                },
-            .viewType = VK_IMAGE_VIEW_TYPE_2D,
-            .image = images[i],
-        };
+    CubeScene scene;
+    vk_scene_create(&scene, &device, &gpu, &memory_properties, command_pool,
+                    queue, &descriptors, cube_count > 0 ? cube_count : 1);
 
-        assert(!vkCreateImageView(device, &color_attachment_view, NULL,
-                                  &views[i]));
+    RenderGraph graph;
+    FrameContext frame_context = {.scene = &scene,
+                                  .descriptors = &descriptors};
 
-        printf("Initialized image view #%u\n", i);
-    }
+    // `TEXTURED=0` and `INSTANCE_COLORS=1` select the initial pipeline
+    // variant, T and C toggle them in the window
+    const char* const textured = getenv("TEXTURED");
+    const char* const instance_colors = getenv("INSTANCE_COLORS");
+    frame_context.variant.values[SPEC_TEXTURED] =
+        textured ? strtoul(textured, NULL, 10) != 0 : VK_TRUE;
+    frame_context.variant.values[SPEC_INSTANCE_COLORS] =
+        instance_colors ? strtoul(instance_colors, NULL, 10) != 0 : VK_FALSE;
 
     //
-    // Attachments
+    // Command buffers
     //
-    const VkAttachmentDescription attachment = {
-        .format = format,
-        .samples = VK_SAMPLE_COUNT_1_BIT,
-        .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
-        .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
-        .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
-        .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-        .finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
-    };
-
-    const VkAttachmentReference color_reference = {
-        .layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
-
-    const VkSubpassDescription subpass = {
-        .pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
-        .colorAttachmentCount = 1,
-        .pColorAttachments = &color_reference,
-    };
-
-    const VkSubpassDependency dependency = {
-        .srcSubpass = VK_SUBPASS_EXTERNAL,
-        .srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-        .dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-        .dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT};
-
-    const VkRenderPassCreateInfo render_pass_info = {
-        .sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
-        .attachmentCount = 1,
-        .pAttachments = &attachment,
-        .subpassCount = 1,
-        .pSubpasses = &subpass,
-        .dependencyCount = 1,
-        .pDependencies = &dependency,
+    // Re-recorded every frame, one per frame in flight
+    const VkCommandBufferAllocateInfo allocate_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+        .commandPool = command_pool,
+        .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+        .commandBufferCount = MAX_FRAMES_IN_FLIGHT,
     };
 
-    VkRenderPass render_pass;
-    assert(!vkCreateRenderPass(device, &render_pass_info, NULL, &render_pass));
-
-    printf("Created render pass\n");
-
-    // Dynamic state
-    const VkDynamicState dynamic_states[2] = {VK_DYNAMIC_STATE_VIEWPORT,
-                                              VK_DYNAMIC_STATE_SCISSOR};
-
-    VkPipelineDynamicStateCreateInfo dynamic_states_create_info = {
-        .sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
-        .pDynamicStates = dynamic_states,
-        .dynamicStateCount = ARR_SIZE(dynamic_states),
-    };
+    VkCommandBuffer command_buffers[MAX_FRAMES_IN_FLIGHT];
+    assert(!vkAllocateCommandBuffers(device, &allocate_info, command_buffers));
 
     //
-    // Graphics pipeline
+    // Profiler
     //
-    VkPipeline graphics_pipeline;
-    const VkGraphicsPipelineCreateInfo pipeline_info = {
-        .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
-        .stageCount = 2,
-        .pStages = shader_stages,
-        .pVertexInputState = &vertex_input_info,
-        .pInputAssemblyState = &input_assembly,
-        .pViewportState = &viewport_state,
-        .pRasterizationState = &rasterizer,
-        .pMultisampleState = &multisampling,
-        .pColorBlendState = &color_blending,
-        .layout = pipeline_layout,
-        .renderPass = render_pass,
-        .pDynamicState = &dynamic_states_create_info,
-    };
-
-    assert(!vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipeline_info,
-                                      NULL, &graphics_pipeline));
-    printf("Created graphics pipeline\n");
+    Profiler profiler = {0};
+    const char* const profile = getenv("PROFILE");
+    if (profile || trace_enabled)
+        vk_profiler_init(&profiler, &gpu, &device, queue_family_index,
+                         profile ? 120 : 0);
+
+    if (headless) {
+        const VkExtent2D extent = {.width = 1024, .height = 768};
+        vk_create_frame_graph(&graph, &device, &memory_properties, format,
+                              depth_format, extent, final_layout, readback,
+                              shader_stages, &frame_context);
+
+        vk_run_headless(&device, queue, &memory_properties, &graph,
+                        &frame_context, format, extent, command_buffers,
+                        &profiler, headless_frames, readback);
+
+        vkDeviceWaitIdle(device);
+        vk_pipeline_variants_print(&frame_context.variants);
+        vk_pipeline_variants_destroy(&frame_context.variants);
+        vk_render_graph_destroy(&graph);
+        vk_scene_destroy(&scene);
+        vk_descriptors_destroy(&descriptors);
+        vk_profiler_destroy(&profiler);
+        trace_shutdown();
+        return 0;
+    }
 
     //
-    // Frame buffers
+    // Swap chain
     //
-    for (u32 i = 0; i < swapchain_image_count; i++) {
-        VkImageView attachments[1] = {
-            [0] = views[i],
-        };
-
-        const VkFramebufferCreateInfo frame_buffer_create_info = {
-
-            .sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
-            .renderPass = render_pass,
-            .attachmentCount = 1,
-            .pAttachments = attachments,
-            .width = swapchain_extent.width,
-            .height = swapchain_extent.height,
-            .layers = 1,
-        };
-
-        assert(!vkCreateFramebuffer(device, &frame_buffer_create_info, NULL,
-                                    &frame_buffers[i]));
+    Swapchain swapchain;
+    vk_swapchain_create(&device, &gpu, surface, window, format, color_space,
+                        &swapchain);
+    const VkExtent2D swapchain_extent = swapchain.extent;
 
-        printf("Created frame buffer #%u\n", i);
-    }
+    //
+    // Render graph, the frame buffers are created on first use
+    //
+    vk_create_frame_graph(&graph, &device, &memory_properties, format,
+                          depth_format, swapchain_extent, final_layout, false,
+                          shader_stages, &frame_context);
 
     //
     // Create semaphores
@@ -649,7 +536,9 @@ int main() {
         .flags = VK_FENCE_CREATE_SIGNALED_BIT};
 
     VkFence in_flight_fences[MAX_FRAMES_IN_FLIGHT];
-    VkFence images_in_flight_fences[MAX_FRAMES_IN_FLIGHT] = {VK_NULL_HANDLE};
+    VkFence images_in_flight_fences[MAX_SWAPCHAIN_IMAGES];
+    for (u32 i = 0; i < swapchain.image_count; i++)
+        images_in_flight_fences[i] = VK_NULL_HANDLE;
 
     for (u32 i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
         assert(!vkCreateSemaphore(device, &semaphore_create_info, NULL,
@@ -665,106 +554,6 @@ int main() {
         printf("Created fence #%u\n", i);
     }
 
-    //
-    // Vertex buffers
-    //
-    const VkBufferCreateInfo buffer_create_info = {
-        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
-        .size = sizeof(vertices),
-        .usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-        .sharingMode = VK_SHARING_MODE_EXCLUSIVE};
-    VkBuffer vertex_buffer;
-    assert(!vkCreateBuffer(device, &buffer_create_info, NULL, &vertex_buffer));
-
-    // Get memory requirements
-    VkMemoryRequirements memory_requirements;
-    vkGetBufferMemoryRequirements(device, vertex_buffer, &memory_requirements);
-
-    VkPhysicalDeviceMemoryProperties memory_properties;
-    vkGetPhysicalDeviceMemoryProperties(gpu, &memory_properties);
-    const VkMemoryAllocateInfo memory_allocate_info = {
-        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
-        .allocationSize = memory_requirements.size,
-        .memoryTypeIndex = memory_type_find(
-            &memory_properties, memory_requirements.memoryTypeBits,
-            VK_MEMORY_PROPERTY_HOST_COHERENT_BIT |
-                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)};
-
-    // Allocate
-    VkDeviceMemory vertex_buffer_memory;
-    assert(!vkAllocateMemory(device, &memory_allocate_info, NULL,
-                             &vertex_buffer_memory));
-    /* printf("Allocated memory for the vertex buffer: size=%lld\n", */
-    /*        memory_requirements.size); */
-    vkBindBufferMemory(device, vertex_buffer, vertex_buffer_memory, 0);
-
-    // Fill the memory
-    void* data;
-    vkMapMemory(device, vertex_buffer_memory, 0, buffer_create_info.size, 0,
-                &data);
-    assert(data != NULL);
-    memcpy(data, vertices, buffer_create_info.size);
-    vkUnmapMemory(device, vertex_buffer_memory);
-
-    //
-    // Command buffers
-    //
-    const VkCommandBufferAllocateInfo allocate_info = {
-        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
-        .commandPool = command_pool,
-        .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
-        .commandBufferCount = swapchain_image_count,
-    };
-
-    VkCommandBuffer command_buffers[swapchain_image_count];
-    assert(!vkAllocateCommandBuffers(device, &allocate_info, command_buffers));
-
-    const VkCommandBufferBeginInfo command_buffer_begin_info = {
-        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
-    const VkClearValue clear_color = {
-        .color.float32 = {0.15f, 0.15f, 0.15f, 1.0f}};
-
-    for (usize i = 0; i < swapchain_image_count; i++) {
-        const VkRenderPassBeginInfo render_pass_begin_info = {
-            .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
-            .renderPass = render_pass,
-            .framebuffer = frame_buffers[i],
-            .renderArea.extent = swapchain_extent,
-            .clearValueCount = 1,
-            .pClearValues = &clear_color,
-        };
-
-        assert(!vkBeginCommandBuffer(command_buffers[i],
-                                     &command_buffer_begin_info));
-
-        vkCmdBeginRenderPass(command_buffers[i], &render_pass_begin_info,
-                             VK_SUBPASS_CONTENTS_INLINE);
-
-        vkCmdBindPipeline(command_buffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS,
-                          graphics_pipeline);
-
-        const VkDeviceSize offsets[] = {0};
-        vkCmdBindVertexBuffers(command_buffers[i], 0, 1, &vertex_buffer,
-                               offsets);
-
-        const VkViewport viewport = {
-            .width = swapchain_extent.width,
-            .height = swapchain_extent.height,
-            .minDepth = 0.0f,
-            .maxDepth = 1.0f,
-        };
-        printf("Viewport: w=%u h=%u\n", (u32)viewport.width,
-               (u32)viewport.height);
-
-        const VkRect2D scissor = {.extent = swapchain_extent};
-        vkCmdSetViewport(command_buffers[i], 0, 1, &viewport);
-        vkCmdSetScissor(command_buffers[i], 0, 1, &scissor);
-        vkCmdDraw(command_buffers[i], /* FIXME */ 3, 1, 0, 0);
-        vkCmdEndRenderPass(command_buffers[i]);
-
-        assert(!vkEndCommandBuffer(command_buffers[i]));
-    }
-
     //
     // Main loop
     //
@@ -773,6 +562,7 @@ int main() {
 
     usize current_frame = 0;
     for (;;) {
+        TRACE_BEGIN("frame");
         // Inputs
         {
             SDL_Event event;
@@ -787,57 +577,102 @@ int main() {
 
                         if (event.key.keysym.scancode == SDL_SCANCODE_ESCAPE)
                             done = SDL_TRUE;
+                        if (event.key.keysym.scancode == SDL_SCANCODE_T)
+                            frame_context.variant.values[SPEC_TEXTURED] ^= 1;
+                        if (event.key.keysym.scancode == SDL_SCANCODE_C)
+                            frame_context.variant
+                                .values[SPEC_INSTANCE_COLORS] ^= 1;
+                        if (event.key.keysym.scancode == SDL_SCANCODE_F12)
+                            trace_dump(getenv("TRACE"));
                         break;
                 }
             }
-            if (done) break;
+            if (done) {
+                TRACE_END();
+                break;
+            }
         }
 
         //
         // Draw
         //
+        TRACE_BEGIN("wait");
         vkWaitForFences(device, 1, &in_flight_fences[current_frame], VK_TRUE,
                         UINT64_MAX);
+        TRACE_END();
 
         u32 current_image;
 
-        vkAcquireNextImageKHR(device, swapchain, UINT64_MAX,
+        TRACE_BEGIN("acquire");
+        vkAcquireNextImageKHR(device, swapchain.swapchain, UINT64_MAX,
                               image_available_semaphore[current_frame],
                               VK_NULL_HANDLE, &current_image);
+        TRACE_END();
 
         if (images_in_flight_fences[current_image] != VK_NULL_HANDLE) {
-            vkWaitForFences(device, 1, &images_in_flight_fences[current_frame],
+            vkWaitForFences(device, 1, &images_in_flight_fences[current_image],
                             VK_TRUE, UINT64_MAX);
         }
         images_in_flight_fences[current_image] =
             in_flight_fences[current_frame];
 
+        TRACE_BEGIN("record");
+        const u64 record_start = vk_profiler_cpu_now();
+        vk_descriptors_frame_begin(&descriptors, (u32)current_frame);
+        vk_scene_update(&scene, (u32)current_frame, swapchain_extent);
+        frame_context.frame = (u32)current_frame;
+        vk_render_graph_set_image(&graph, frame_context.color,
+                                  swapchain.images[current_image],
+                                  swapchain.views[current_image]);
+        assert(!vkResetCommandBuffer(command_buffers[current_frame], 0));
+        vk_record_command_buffer(command_buffers[current_frame], &graph,
+                                 &profiler);
+        vk_profiler_cpu_add(&profiler, PROFILER_CPU_RECORD, record_start);
+        TRACE_END();
+
         const VkSubmitInfo submit_info = {
             .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
             .waitSemaphoreCount = 1,
             .pWaitSemaphores = &image_available_semaphore[current_frame],
             .pWaitDstStageMask = &wait_stages,
             .commandBufferCount = 1,
-            .pCommandBuffers = &command_buffers[current_image],
+            .pCommandBuffers = &command_buffers[current_frame],
             .signalSemaphoreCount = 1,
             .pSignalSemaphores = &render_finished_semaphore[current_frame],
         };
 
+        TRACE_BEGIN("submit");
+        const u64 submit_start = vk_profiler_cpu_now();
         vkResetFences(device, 1, &in_flight_fences[current_frame]);
         assert(!vkQueueSubmit(queue, 1, &submit_info,
                               in_flight_fences[current_frame]));
+        vk_profiler_cpu_add(&profiler, PROFILER_CPU_SUBMIT, submit_start);
+        TRACE_END();
 
         const VkPresentInfoKHR present_info = {
             .sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
             .waitSemaphoreCount = 1,
             .pWaitSemaphores = &render_finished_semaphore[current_frame],
             .swapchainCount = 1,
-            .pSwapchains = &swapchain,
+            .pSwapchains = &swapchain.swapchain,
             .pImageIndices = &current_image,
         };
 
+        TRACE_BEGIN("present");
         vkQueuePresentKHR(queue, &present_info);
+        TRACE_END();
+
+        ProfilerResults profiler_results;
+        if (vk_profiler_results(&profiler, &profiler_results))
+            vk_profiler_print(&profiler_results);
+        TRACE_END();
 
         current_frame = (current_frame + 1) % MAX_FRAMES_IN_FLIGHT;
     }
+
+    vkDeviceWaitIdle(device);
+    vk_pipeline_variants_print(&frame_context.variants);
+    vk_pipeline_variants_destroy(&frame_context.variants);
+    resource_registry_print(8);
+    trace_shutdown();
 }
@@ -0,0 +1,332 @@
+#define _DEFAULT_SOURCE 1
+
+#include "world_file.h"
+
+#include <assert.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Of a cube of side 2 around its center
+#define WORLD_CUBE_RADIUS 1.7320508f
+// Height of the instances above the ground, at most
+#define WORLD_HEIGHT 6.0f
+
+static usize world_align(usize size, usize alignment) {
+    return (size + alignment - 1) / alignment * alignment;
+}
+
+i32 world_file_open(WorldFile* file, const char* path) {
+    memset(file, 0, sizeof(WorldFile));
+    const int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Could not open the file `%s`: errno=%d error=%s\n",
+                path, errno, strerror(errno));
+        return errno;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        const i32 err = errno;
+        close(fd);
+        return err;
+    }
+    if ((usize)st.st_size < sizeof(WorldHeader)) {
+        fprintf(stderr, "Not a world file: `%s`\n", path);
+        close(fd);
+        return EINVAL;
+    }
+
+    // The mapping stays valid once the file is closed
+    void* const data =
+        mmap(NULL, (usize)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        fprintf(stderr, "Could not map the file `%s`: errno=%d error=%s\n",
+                path, errno, strerror(errno));
+        return errno;
+    }
+    file->data = data;
+    file->size = (usize)st.st_size;
+    file->header = (const WorldHeader*)file->data;
+
+    // Only the index, the chunks are checked when loaded
+    const WorldHeader* const h = file->header;
+    const u64 chunk_count = (u64)h->grid_width * h->grid_depth;
+    _Bool valid =
+        memcmp(h->magic, WORLD_MAGIC, sizeof(h->magic)) == 0 &&
+        h->version == WORLD_VERSION && h->chunk_size > 0.0f &&
+        h->material_count <= WORLD_MAX_MATERIALS &&
+        h->meshes_offset % sizeof(u64) == 0 &&
+        h->meshes_offset + sizeof(WorldMesh) * (u64)h->mesh_count <=
+            file->size &&
+        h->chunks_offset % sizeof(u64) == 0 &&
+        h->chunks_offset + sizeof(WorldChunk) * chunk_count <= file->size;
+    file->meshes = (const WorldMesh*)(file->data + h->meshes_offset);
+    file->chunks = (const WorldChunk*)(file->data + h->chunks_offset);
+    file->chunk_count = (u32)chunk_count;
+    for (u32 i = 0; valid && i < file->chunk_count; i++) {
+        const WorldChunk* const c = &file->chunks[i];
+        valid = c->range_count <= h->max_chunk_ranges &&
+                c->instance_count <= h->max_chunk_instances &&
+                c->offset % WORLD_PAGE_SIZE == 0 && c->offset <= file->size &&
+                c->size <= file->size - c->offset &&
+                sizeof(WorldRange) * (u64)c->range_count +
+                        sizeof(WorldInstance) * (u64)c->instance_count <=
+                    c->size;
+    }
+    for (u32 i = 0; valid && i < h->mesh_count; i++)
+        valid = memchr(file->meshes[i].name, '\0',
+                       WORLD_MESH_NAME_CAPACITY) != NULL;
+
+    if (!valid) {
+        fprintf(stderr, "Invalid world file: `%s`\n", path);
+        world_file_close(file);
+        return EINVAL;
+    }
+    return 0;
+}
+
+void world_file_close(WorldFile* file) {
+    if (file->data) munmap((void*)file->data, file->size);
+    memset(file, 0, sizeof(WorldFile));
+}
+
+_Bool world_file_chunk_valid(const WorldFile* file, u32 chunk) {
+    const WorldChunk* const c = &file->chunks[chunk];
+    const WorldRange* const ranges = world_file_ranges(file, chunk);
+    // In order, so that the ranges are disjoint and their counts add up to
+    // the instances at most
+    u32 end = 0;
+    for (u32 i = 0; i < c->range_count; i++) {
+        const WorldRange* const r = &ranges[i];
+        if (r->mesh >= file->header->mesh_count ||
+            r->material >= WORLD_MAX_MATERIALS || r->first < end ||
+            r->first > c->instance_count ||
+            r->count > c->instance_count - r->first)
+            return false;
+        end = r->first + r->count;
+    }
+    return true;
+}
+
+const WorldRange* world_file_ranges(const WorldFile* file, u32 chunk) {
+    return (const WorldRange*)(file->data + file->chunks[chunk].offset);
+}
+
+const WorldInstance* world_file_instances(const WorldFile* file, u32 chunk) {
+    const WorldChunk* const c = &file->chunks[chunk];
+    return (const WorldInstance*)(file->data + c->offset +
+                                  sizeof(WorldRange) * c->range_count);
+}
+
+//
+// Generation
+//
+// xorshift32, the state must not be 0
+static u32 world_random(u32* state) {
+    u32 x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+// In [min, max)
+static f32 world_random_range(u32* state, f32 min, f32 max) {
+    const f32 unit = (f32)(world_random(state) >> 8) / (f32)(1 << 24);
+    return min + unit * (max - min);
+}
+
+// Of a cell, the same on both passes of the generation
+static u32 world_cell_state(const WorldDesc* desc, u32 cell) {
+    u32 state = (desc->seed ^ (cell * 0x9e3779b9u)) | 1;
+    for (u32 i = 0; i < 4; i++) world_random(&state);
+    return state;
+}
+
+static u32 world_cell_instance_count(const WorldDesc* desc, u32* state) {
+    const u32 min = desc->chunk_instances / 4;
+    return min + world_random(state) % (desc->chunk_instances - min + 1);
+}
+
+// The materials in contiguous ranges
+static u32 world_cell_range_count(const WorldDesc* desc, u32 instance_count) {
+    u32 count = 0;
+    for (u32 m = 0; m < desc->material_count; m++) {
+        const u32 first = instance_count * m / desc->material_count;
+        const u32 last = instance_count * (m + 1) / desc->material_count;
+        count += first != last;
+    }
+    return count;
+}
+
+static void world_cell_generate(const WorldDesc* desc, const f32 origin[3],
+                                u32 cell, WorldChunk* chunk,
+                                WorldRange* ranges,
+                                WorldInstance* instances) {
+    u32 state = world_cell_state(desc, cell);
+    const u32 count = world_cell_instance_count(desc, &state);
+    const f32 x = origin[0] + (f32)(cell % desc->grid_width) * desc->chunk_size;
+    const f32 z = origin[2] + (f32)(cell / desc->grid_width) * desc->chunk_size;
+
+    u32 range_count = 0;
+    for (u32 m = 0; m < desc->material_count; m++) {
+        const u32 first = count * m / desc->material_count;
+        const u32 last = count * (m + 1) / desc->material_count;
+        if (first == last) continue;
+        ranges[range_count++] = (WorldRange){
+            .mesh = 0,
+            .material = m,
+            .first = first,
+            .count = last - first,
+        };
+    }
+
+    for (u32 c = 0; c < 3; c++) {
+        chunk->bounds_min[c] = INFINITY;
+        chunk->bounds_max[c] = -INFINITY;
+    }
+    for (u32 i = 0; i < count; i++) {
+        WorldInstance* const instance = &instances[i];
+        instance->position[0] =
+            world_random_range(&state, x, x + desc->chunk_size);
+        instance->position[1] = world_random_range(&state, 0.0f, WORLD_HEIGHT);
+        instance->position[2] =
+            world_random_range(&state, z, z + desc->chunk_size);
+        instance->scale = world_random_range(&state, 0.5f, 1.5f);
+
+        // Around a random axis
+        f32 axis[3], length = 0.0f;
+        for (u32 c = 0; c < 3; c++) {
+            axis[c] = world_random_range(&state, -1.0f, 1.0f);
+            length += axis[c] * axis[c];
+        }
+        length = sqrtf(MAX(length, 1e-6f));
+        const f32 half = world_random_range(&state, 0.0f, 3.14159265f);
+        for (u32 c = 0; c < 3; c++)
+            instance->rotation[c] = axis[c] / length * sinf(half);
+        instance->rotation[3] = cosf(half);
+
+        const f32 radius = WORLD_CUBE_RADIUS * instance->scale;
+        for (u32 c = 0; c < 3; c++) {
+            chunk->bounds_min[c] =
+                MIN(chunk->bounds_min[c], instance->position[c] - radius);
+            chunk->bounds_max[c] =
+                MAX(chunk->bounds_max[c], instance->position[c] + radius);
+        }
+    }
+    if (!count) {
+        for (u32 c = 0; c < 3; c++)
+            chunk->bounds_min[c] = chunk->bounds_max[c] = 0.0f;
+    }
+    chunk->range_count = range_count;
+    chunk->instance_count = count;
+}
+
+static i32 world_write_failed(FILE* file, const char* path) {
+    const i32 err = errno ? errno : EIO;
+    fprintf(stderr, "Could not write the file `%s`: errno=%d error=%s\n",
+            path, err, strerror(err));
+    fclose(file);
+    return err;
+}
+
+i32 world_file_write(const char* path, const WorldDesc* desc) {
+    assert(desc->grid_width > 0 && desc->grid_depth > 0);
+    assert(desc->chunk_instances > 0 && desc->seed != 0);
+    assert(desc->material_count > 0 &&
+           desc->material_count <= WORLD_MAX_MATERIALS);
+    const u32 chunk_count = desc->grid_width * desc->grid_depth;
+    WorldHeader header = {
+        .version = WORLD_VERSION,
+        .grid_width = desc->grid_width,
+        .grid_depth = desc->grid_depth,
+        .chunk_size = desc->chunk_size,
+        // Centered on the origin, the ground at 0
+        .origin = {-0.5f * desc->chunk_size * (f32)desc->grid_width, 0.0f,
+                   -0.5f * desc->chunk_size * (f32)desc->grid_depth},
+        .mesh_count = 1,
+        .material_count = desc->material_count,
+        .meshes_offset = sizeof(WorldHeader),
+        .chunks_offset = sizeof(WorldHeader) + sizeof(WorldMesh),
+    };
+    memcpy(header.magic, WORLD_MAGIC, sizeof(header.magic));
+    const WorldMesh mesh = {.name = "cube"};
+
+    // The counts come first from the cells, to place the chunks
+    WorldChunk* const chunks = ogl_malloc(sizeof(WorldChunk) * chunk_count);
+    u64 offset = world_align(header.chunks_offset +
+                                 sizeof(WorldChunk) * (u64)chunk_count,
+                             WORLD_PAGE_SIZE);
+    for (u32 i = 0; i < chunk_count; i++) {
+        u32 state = world_cell_state(desc, i);
+        const u32 count = world_cell_instance_count(desc, &state);
+        const u32 range_count = world_cell_range_count(desc, count);
+        const u64 size = sizeof(WorldRange) * (u64)range_count +
+                         sizeof(WorldInstance) * (u64)count;
+        chunks[i] = (WorldChunk){
+            .range_count = range_count,
+            .instance_count = count,
+            .offset = count ? offset : 0,
+            .size = count ? size : 0,
+        };
+        if (count) offset += world_align(size, WORLD_PAGE_SIZE);
+        header.max_chunk_ranges = MAX(header.max_chunk_ranges, range_count);
+        header.max_chunk_instances = MAX(header.max_chunk_instances, count);
+        header.instance_count += count;
+    }
+
+    FILE* const file = fopen(path, "wb");
+    if (!file) {
+        fprintf(stderr, "Could not open the file `%s`: errno=%d error=%s\n",
+                path, errno, strerror(errno));
+        free(chunks);
+        return errno;
+    }
+
+    // The index once the chunks have their bounds
+    const usize data_size =
+        world_align(sizeof(WorldRange) * desc->material_count +
+                        sizeof(WorldInstance) * desc->chunk_instances,
+                    WORLD_PAGE_SIZE);
+    u8* const data = ogl_malloc(data_size);
+    for (u32 i = 0; i < chunk_count; i++) {
+        if (!chunks[i].size) continue;
+        WorldRange* const ranges = (WorldRange*)data;
+        world_cell_generate(desc, header.origin, i, &chunks[i], ranges,
+                            (WorldInstance*)(ranges + chunks[i].range_count));
+
+        const usize padded = world_align(chunks[i].size, WORLD_PAGE_SIZE);
+        memset(data + chunks[i].size, 0, padded - chunks[i].size);
+        if (fseek(file, (long)chunks[i].offset, SEEK_SET) != 0 ||
+            fwrite(data, 1, padded, file) != padded) {
+            free(data);
+            free(chunks);
+            return world_write_failed(file, path);
+        }
+    }
+    free(data);
+
+    const _Bool written =
+        fseek(file, 0, SEEK_SET) == 0 &&
+        fwrite(&header, sizeof(header), 1, file) == 1 &&
+        fwrite(&mesh, sizeof(mesh), 1, file) == 1 &&
+        fwrite(chunks, sizeof(WorldChunk), chunk_count, file) == chunk_count;
+    free(chunks);
+    if (!written) return world_write_failed(file, path);
+    if (fclose(file) != 0) {
+        fprintf(stderr, "Could not write the file `%s`: errno=%d error=%s\n",
+                path, errno, strerror(errno));
+        return errno;
+    }
+
+    printf("World written: path=%s chunks=%ux%u chunk_size=%.1f "
+           "instances=%" PRIu64 " max_chunk_instances=%u size_mb=%.1f\n",
+           path, desc->grid_width, desc->grid_depth, (f64)desc->chunk_size,
+           header.instance_count, header.max_chunk_instances,
+           (f64)offset / (1024.0 * 1024.0));
+    return 0;
+}
@@ -0,0 +1,91 @@
+#pragma once
+#include "utils.h"
+
+// Binary world, read in place from a memory mapping. The instances are
+// grouped into the square cells of a grid over the xz plane, one chunk per
+// cell, and the chunks are aligned to pages so that each can be paged in
+// and out on its own.
+//
+// Layout, little endian:
+//   WorldHeader
+//   WorldMesh[mesh_count]: meshes referenced by the instances, by name
+//   WorldChunk[grid_width * grid_depth]: the chunk index, row after row of
+//     cells along x, with the bounds of every chunk and where its data is
+//   Chunk data, at multiples of WORLD_PAGE_SIZE:
+//     WorldRange[range_count]: instances of one mesh and material, in the
+//       order of the instances, disjoint
+//     WorldInstance[instance_count]
+//
+// Opening a file only reads the header and the index: the chunks are read
+// when they are loaded (world_stream.h), and a world can be larger than the
+// memory.
+
+#define WORLD_MAGIC "OGLW"
+#define WORLD_VERSION 1
+#define WORLD_PAGE_SIZE 4096
+#define WORLD_MESH_NAME_CAPACITY 32
+#define WORLD_MAX_MATERIALS 64
+
+typedef struct {
+    char magic[4];
+    u32 version;
+    u32 grid_width, grid_depth;  // Cells along x and z
+    f32 chunk_size;  // Side of a cell
+    f32 origin[3];  // Minimum corner of the first cell
+    u32 mesh_count, material_count;
+    u32 max_chunk_ranges, max_chunk_instances;
+    u64 instance_count;
+    u64 meshes_offset, chunks_offset;
+} WorldHeader;
+
+typedef struct {
+    char name[WORLD_MESH_NAME_CAPACITY];  // NUL terminated
+} WorldMesh;
+
+typedef struct {
+    f32 bounds_min[3], bounds_max[3];  // Of the instances, world space
+    u32 range_count, instance_count;
+    u64 offset;  // Of the data, 0 for an empty chunk
+    u64 size;
+} WorldChunk;
+
+typedef struct {
+    u32 mesh, material;
+    u32 first, count;  // Instances of the chunk
+} WorldRange;
+
+typedef struct {
+    f32 position[3];
+    f32 scale;
+    f32 rotation[4];  // Quaternion, x y z w
+} WorldInstance;
+
+typedef struct {
+    const u8* data;
+    usize size;
+    const WorldHeader* header;
+    const WorldMesh* meshes;
+    const WorldChunk* chunks;
+    u32 chunk_count;
+} WorldFile;
+
+// What `world_file_write` generates
+typedef struct {
+    u32 grid_width, grid_depth;
+    f32 chunk_size;
+    // At most, the chunks have from a quarter of it
+    u32 chunk_instances;
+    u32 material_count;
+    u32 seed;  // Not 0
+} WorldDesc;
+
+// Maps `path` and checks its header and index, returns an errno
+i32 world_file_open(WorldFile* file, const char* path);
+void world_file_close(WorldFile* file);
+// False when the ranges of the chunk point out of it or overlap
+_Bool world_file_chunk_valid(const WorldFile* file, u32 chunk);
+const WorldRange* world_file_ranges(const WorldFile* file, u32 chunk);
+const WorldInstance* world_file_instances(const WorldFile* file, u32 chunk);
+// A random world of cubes ("cube" is its only mesh) spread over the cells,
+// written a chunk at a time. Returns an errno.
+i32 world_file_write(const char* path, const WorldDesc* desc);
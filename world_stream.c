@@ -0,0 +1,444 @@
+#define _DEFAULT_SOURCE 1
+
+#include "world_stream.h"
+
+#include <assert.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "trace.h"
+
+#define WORLD_STREAM_NO_SLOT UINT32_MAX
+
+static f64 world_stream_ms(u64 start, u64 end) {
+    return (f64)(end - start) * 1000.0 / (f64)SDL_GetPerformanceFrequency();
+}
+
+// Translation, rotation and scale, then the mesh transform
+static void world_stream_model(const WorldInstance* instance,
+                               mat4 mesh_transform, mat4 model) {
+    versor rotation;
+    glm_vec4_copy((f32*)instance->rotation, rotation);
+    glm_quat_mat4(rotation, model);
+    for (u32 column = 0; column < 3; column++)
+        glm_vec3_scale(model[column], instance->scale, model[column]);
+    glm_vec3_copy((f32*)instance->position, model[3]);
+    glm_mat4_mul(model, mesh_transform, model);
+}
+
+// Worker thread: the ranges of the drawn mesh and the models of their
+// instances, where the pages of the chunk are read
+static void world_stream_load(WorldStream* stream, u32 slot_index) {
+    WorldStreamSlot* const slot = &stream->slots[slot_index];
+    const WorldHeader* const header = stream->file.header;
+    slot->range_count = 0;
+    slot->skipped_ranges = 0;
+    slot->invalid = !world_file_chunk_valid(&stream->file, slot->chunk);
+    if (slot->invalid) return;
+
+    const WorldChunk* const chunk = &stream->file.chunks[slot->chunk];
+    const WorldRange* const ranges =
+        world_file_ranges(&stream->file, slot->chunk);
+    const WorldInstance* const instances =
+        world_file_instances(&stream->file, slot->chunk);
+    WorldRange* const slot_ranges =
+        &stream->slot_ranges[(usize)slot_index * header->max_chunk_ranges];
+    mat4* const models =
+        &stream->slot_models[(usize)slot_index * header->max_chunk_instances];
+    for (u32 i = 0; i < chunk->range_count; i++) {
+        const WorldRange* const range = &ranges[i];
+        if (range->mesh != stream->mesh) {
+            slot->skipped_ranges += 1;
+            continue;
+        }
+
+        WorldRange* const slot_range = &slot_ranges[slot->range_count++];
+        *slot_range = *range;
+        slot_range->material = range->material % stream->material_count;
+        for (u32 j = range->first; j < range->first + range->count; j++)
+            world_stream_model(&instances[j], stream->mesh_transform,
+                               models[j]);
+    }
+}
+
+static int world_stream_worker(void* data) {
+    WorldStream* const stream = data;
+    trace_thread_name("world_stream");
+
+    for (;;) {
+        SDL_LockMutex(stream->mutex);
+        while (!stream->request_count && SDL_AtomicGet(&stream->running))
+            SDL_CondWait(stream->cond, stream->mutex);
+        // Stopped once every request was loaded
+        if (!stream->request_count) {
+            SDL_UnlockMutex(stream->mutex);
+            return 0;
+        }
+        const u32 slot = stream->requests[stream->request_first];
+        stream->request_first =
+            (stream->request_first + 1) % WORLD_STREAM_MAX_REQUESTS;
+        stream->request_count -= 1;
+        SDL_UnlockMutex(stream->mutex);
+
+        TRACE_BEGIN("world_stream_load");
+        world_stream_load(stream, slot);
+        TRACE_END();
+        SDL_AtomicSet(&stream->slots[slot].state, WORLD_STREAM_READY);
+    }
+}
+
+void world_stream_open(WorldStream* stream, const char* path, usize budget,
+                       f32 radius, const char* mesh_name,
+                       mat4 mesh_transform, u32 material_count) {
+    assert(material_count > 0 && material_count <= WORLD_MAX_MATERIALS);
+    memset(stream, 0, sizeof(WorldStream));
+    const i32 err = world_file_open(&stream->file, path);
+    if (err) exit(err);
+
+    const WorldHeader* const header = stream->file.header;
+    stream->mesh = UINT32_MAX;
+    for (u32 i = 0; i < header->mesh_count; i++)
+        if (strcmp(stream->file.meshes[i].name, mesh_name) == 0)
+            stream->mesh = i;
+    if (stream->mesh == UINT32_MAX) {
+        fprintf(stderr, "No mesh `%s` in the world file `%s`\n", mesh_name,
+                path);
+        exit(EINVAL);
+    }
+    glm_mat4_copy(mesh_transform, stream->mesh_transform);
+    stream->radius = radius;
+    stream->material_count = material_count;
+    stream->page_size = (usize)sysconf(_SC_PAGESIZE);
+
+    // Cells overlapping the square around the camera
+    const u32 chunk_count = stream->file.chunk_count;
+    const u32 side = (u32)ceilf(2.0f * radius / header->chunk_size) + 2;
+    stream->candidate_capacity = MIN(side * side, chunk_count);
+
+    // The culled models of the chunks within the radius, the slots in the
+    // rest of the budget
+    const u32 max_instances = MAX(header->max_chunk_instances, 1);
+    const u32 max_ranges = MAX(header->max_chunk_ranges, 1);
+    const usize visible_size =
+        (sizeof(mat4) * max_instances + sizeof(u32)) *
+        stream->candidate_capacity;
+    const usize slot_size = sizeof(mat4) * max_instances +
+                            sizeof(WorldRange) * max_ranges +
+                            sizeof(WorldStreamSlot) + sizeof(u32);
+    const usize slot_budget = budget > visible_size ? budget - visible_size : 0;
+    stream->slot_count =
+        (u32)CLAMP(slot_budget / slot_size, 1, MAX(chunk_count, 1));
+    stream->visible_capacity =
+        MIN(stream->candidate_capacity, stream->slot_count);
+    stream->model_capacity = stream->visible_capacity * max_instances;
+
+    const u32 slot_count = stream->slot_count;
+    arena_init(&stream->arena, "world_stream",
+               slot_size * slot_count + sizeof(u32) * chunk_count +
+                   sizeof(WorldStreamCandidate) *
+                       stream->candidate_capacity +
+                   6 * ARENA_ALIGNMENT);
+    stream->slots = ARENA_ALLOC(&stream->arena, WorldStreamSlot, slot_count);
+    stream->slot_models = ARENA_ALLOC(&stream->arena, mat4,
+                                      (usize)slot_count * max_instances);
+    stream->slot_ranges = ARENA_ALLOC(&stream->arena, WorldRange,
+                                      (usize)slot_count * max_ranges);
+    stream->free_slots = ARENA_ALLOC(&stream->arena, u32, slot_count);
+    stream->chunk_slots = ARENA_ALLOC(&stream->arena, u32, chunk_count);
+    stream->candidates = ARENA_ALLOC(&stream->arena, WorldStreamCandidate,
+                                     stream->candidate_capacity);
+
+    memset(stream->slots, 0, sizeof(WorldStreamSlot) * slot_count);
+    for (u32 i = 0; i < slot_count; i++)
+        stream->free_slots[i] = slot_count - 1 - i;
+    stream->free_count = slot_count;
+    for (u32 i = 0; i < chunk_count; i++)
+        stream->chunk_slots[i] = WORLD_STREAM_NO_SLOT;
+
+    stream->mutex = SDL_CreateMutex();
+    stream->cond = SDL_CreateCond();
+    SDL_AtomicSet(&stream->running, 1);
+    stream->thread =
+        SDL_CreateThread(world_stream_worker, "world_stream", stream);
+    if (!stream->mutex || !stream->cond || !stream->thread) {
+        fprintf(stderr, "Could not start the world stream worker: %s\n",
+                SDL_GetError());
+        exit(1);
+    }
+
+    printf("World: path=%s chunks=%ux%u chunk_size=%.1f instances=%" PRIu64
+           " slots=%u budget_mb=%.1f radius=%.1f\n",
+           path, header->grid_width, header->grid_depth,
+           (f64)header->chunk_size, header->instance_count, slot_count,
+           (f64)budget / (1024.0 * 1024.0), (f64)radius);
+}
+
+void world_stream_close(WorldStream* stream) {
+    SDL_LockMutex(stream->mutex);
+    SDL_AtomicSet(&stream->running, 0);
+    SDL_CondBroadcast(stream->cond);
+    SDL_UnlockMutex(stream->mutex);
+    SDL_WaitThread(stream->thread, NULL);
+    SDL_DestroyCond(stream->cond);
+    SDL_DestroyMutex(stream->mutex);
+
+    arena_print(&stream->arena);
+    arena_destroy(&stream->arena);
+    world_file_close(&stream->file);
+}
+
+static f32 world_stream_distance(const WorldChunk* chunk, vec3 camera) {
+    const f32 dx = MAX(MAX(chunk->bounds_min[0] - camera[0], 0.0f),
+                       camera[0] - chunk->bounds_max[0]);
+    const f32 dz = MAX(MAX(chunk->bounds_min[2] - camera[2], 0.0f),
+                       camera[2] - chunk->bounds_max[2]);
+    return sqrtf(dx * dx + dz * dz);
+}
+
+static int world_stream_candidate_compare(const void* a, const void* b) {
+    const f32 x = ((const WorldStreamCandidate*)a)->distance;
+    const f32 y = ((const WorldStreamCandidate*)b)->distance;
+    return (x > y) - (x < y);
+}
+
+// The chunks within the radius of `camera`, nearest first
+static void world_stream_plan(WorldStream* stream, vec3 camera) {
+    const WorldHeader* const header = stream->file.header;
+    const f32 size = header->chunk_size;
+    // Cells of the square around the camera, the instances of a chunk do
+    // not leave their cell by more than their size
+    const i32 first_x =
+        (i32)floorf((camera[0] - stream->radius - header->origin[0]) / size) -
+        1;
+    const i32 first_z =
+        (i32)floorf((camera[2] - stream->radius - header->origin[2]) / size) -
+        1;
+    const i32 last_x = first_x + (i32)ceilf(2.0f * stream->radius / size) + 2;
+    const i32 last_z = first_z + (i32)ceilf(2.0f * stream->radius / size) + 2;
+
+    stream->candidate_count = 0;
+    for (i32 z = MAX(first_z, 0); z <= last_z; z++) {
+        if (z >= (i32)header->grid_depth) break;
+        for (i32 x = MAX(first_x, 0); x <= last_x; x++) {
+            if (x >= (i32)header->grid_width) break;
+            const u32 chunk = (u32)z * header->grid_width + (u32)x;
+            const WorldChunk* const c = &stream->file.chunks[chunk];
+            if (!c->instance_count) continue;
+
+            const f32 distance = world_stream_distance(c, camera);
+            if (distance > stream->radius ||
+                stream->candidate_count == stream->candidate_capacity)
+                continue;
+            stream->candidates[stream->candidate_count++] =
+                (WorldStreamCandidate){distance, chunk};
+        }
+    }
+    qsort(stream->candidates, stream->candidate_count,
+          sizeof(WorldStreamCandidate), world_stream_candidate_compare);
+    glm_vec3_copy(camera, stream->planned);
+    stream->planned_once = true;
+}
+
+// The pages of the chunk fully inside it, the others are shared
+static void world_stream_release_pages(WorldStream* stream, u32 chunk) {
+    const WorldChunk* const c = &stream->file.chunks[chunk];
+    const usize page = stream->page_size;
+    const usize first = ((usize)c->offset + page - 1) / page * page;
+    const usize last = (usize)(c->offset + c->size) / page * page;
+    if (last > first)
+        madvise((void*)(stream->file.data + first), last - first,
+                MADV_DONTNEED);
+}
+
+// The farthest resident chunk, if farther than `distance`
+static u32 world_stream_evict(WorldStream* stream, vec3 camera,
+                              f32 distance) {
+    u32 farthest = WORLD_STREAM_NO_SLOT;
+    for (u32 i = 0; i < stream->slot_count; i++) {
+        WorldStreamSlot* const slot = &stream->slots[i];
+        if (SDL_AtomicGet(&slot->state) != WORLD_STREAM_RESIDENT) continue;
+        const f32 d =
+            world_stream_distance(&stream->file.chunks[slot->chunk], camera);
+        if (d <= distance) continue;
+        distance = d;
+        farthest = i;
+    }
+    if (farthest == WORLD_STREAM_NO_SLOT) return farthest;
+
+    WorldStreamSlot* const slot = &stream->slots[farthest];
+    stream->chunk_slots[slot->chunk] = WORLD_STREAM_NO_SLOT;
+    world_stream_release_pages(stream, slot->chunk);
+    SDL_AtomicSet(&slot->state, WORLD_STREAM_FREE);
+    stream->evictions += 1;
+    return farthest;
+}
+
+void world_stream_update(WorldStream* stream, vec3 camera) {
+    TRACE_BEGIN("world_stream_update");
+    const u64 now = SDL_GetPerformanceCounter();
+    u32 resident = 0;
+    for (u32 i = 0; i < stream->slot_count; i++) {
+        WorldStreamSlot* const slot = &stream->slots[i];
+        const i32 state = SDL_AtomicGet(&slot->state);
+        if (state == WORLD_STREAM_READY) {
+            const f64 ms = world_stream_ms(slot->requested, now);
+            stream->loads += 1;
+            stream->total_load_ms += ms;
+            stream->max_load_ms = MAX(stream->max_load_ms, ms);
+            stream->skipped_ranges += slot->skipped_ranges;
+            stream->invalid_chunks += slot->invalid;
+            SDL_AtomicSet(&slot->state, WORLD_STREAM_RESIDENT);
+        }
+        resident += state == WORLD_STREAM_READY ||
+                    state == WORLD_STREAM_RESIDENT;
+    }
+
+    const f32 replan =
+        WORLD_STREAM_REPLAN_DISTANCE * stream->file.header->chunk_size;
+    if (!stream->planned_once ||
+        glm_vec3_distance(camera, stream->planned) > replan)
+        world_stream_plan(stream, camera);
+
+    // Nearest first, as long as there is room in the requests
+    for (u32 i = 0; i < stream->candidate_count; i++) {
+        const WorldStreamCandidate* const candidate = &stream->candidates[i];
+        if (stream->chunk_slots[candidate->chunk] != WORLD_STREAM_NO_SLOT)
+            continue;
+        // Only this thread adds requests, there is still room after
+        SDL_LockMutex(stream->mutex);
+        const _Bool full = stream->request_count == WORLD_STREAM_MAX_REQUESTS;
+        SDL_UnlockMutex(stream->mutex);
+        if (full) break;
+
+        u32 slot_index =
+            stream->free_count ? stream->free_slots[--stream->free_count]
+                               : world_stream_evict(stream, camera,
+                                                    candidate->distance);
+        if (slot_index == WORLD_STREAM_NO_SLOT) {
+            // Every slot holds a nearer chunk
+            stream->budget_stalls += 1;
+            break;
+        }
+
+        WorldStreamSlot* const slot = &stream->slots[slot_index];
+        slot->chunk = candidate->chunk;
+        slot->requested = now;
+        SDL_AtomicSet(&slot->state, WORLD_STREAM_LOADING);
+        stream->chunk_slots[candidate->chunk] = slot_index;
+
+        SDL_LockMutex(stream->mutex);
+        const u32 last = (stream->request_first + stream->request_count) %
+                         WORLD_STREAM_MAX_REQUESTS;
+        stream->requests[last] = slot_index;
+        stream->request_count += 1;
+        SDL_CondSignal(stream->cond);
+        SDL_UnlockMutex(stream->mutex);
+    }
+
+    stream->update_count += 1;
+    stream->total_resident += resident;
+    TRACE_END();
+}
+
+usize world_stream_frame_size(const WorldStream* stream) {
+    return sizeof(u32) * stream->visible_capacity +
+           sizeof(mat4) * stream->model_capacity + 2 * ARENA_ALIGNMENT;
+}
+
+u32 world_stream_cull(WorldStream* stream, mat4 view_projection,
+                      Arena* frame) {
+    TRACE_BEGIN("world_stream_cull");
+    const WorldHeader* const header = stream->file.header;
+    vec4 planes[6];
+    glm_frustum_planes(view_projection, planes);
+
+    // The visible chunks and the instances of every material
+    u32 counts[WORLD_MAX_MATERIALS] = {0};
+    u32 visible = 0;
+    u64 model_count = 0;
+    stream->visible_slots = ARENA_ALLOC(frame, u32, stream->visible_capacity);
+    for (u32 i = 0; i < stream->slot_count; i++) {
+        WorldStreamSlot* const slot = &stream->slots[i];
+        if (SDL_AtomicGet(&slot->state) != WORLD_STREAM_RESIDENT) continue;
+        const WorldChunk* const chunk = &stream->file.chunks[slot->chunk];
+        vec3 box[2];
+        glm_vec3_copy((f32*)chunk->bounds_min, box[0]);
+        glm_vec3_copy((f32*)chunk->bounds_max, box[1]);
+        if (!glm_aabb_frustum(box, planes)) continue;
+        const WorldRange* const ranges =
+            &stream->slot_ranges[(usize)i * header->max_chunk_ranges];
+        u64 instance_count = 0;
+        for (u32 j = 0; j < slot->range_count; j++)
+            instance_count += ranges[j].count;
+        // Only when the budget holds less than the radius: the loads
+        // validated the ranges, a chunk never has more instances than a slot
+        if (visible == stream->visible_capacity ||
+            model_count + instance_count > stream->model_capacity) {
+            stream->dropped_chunks += 1;
+            continue;
+        }
+
+        stream->visible_slots[visible++] = i;
+        model_count += instance_count;
+        for (u32 j = 0; j < slot->range_count; j++)
+            counts[ranges[j].material] += ranges[j].count;
+    }
+
+    u32 offsets[WORLD_MAX_MATERIALS];
+    stream->model_count = 0;
+    stream->draw_count = 0;
+    for (u32 m = 0; m < stream->material_count; m++) {
+        offsets[m] = stream->model_count;
+        if (counts[m]) {
+            stream->draws[stream->draw_count++] = (WorldStreamDraw){
+                .material = m,
+                .first_instance = stream->model_count,
+                .instance_count = counts[m],
+            };
+        }
+        stream->model_count += counts[m];
+    }
+    stream->models = ARENA_ALLOC(frame, mat4, stream->model_count);
+
+    for (u32 i = 0; i < visible; i++) {
+        const u32 slot = stream->visible_slots[i];
+        const WorldRange* const ranges =
+            &stream->slot_ranges[(usize)slot * header->max_chunk_ranges];
+        mat4* const models =
+            &stream->slot_models[(usize)slot * header->max_chunk_instances];
+        for (u32 j = 0; j < stream->slots[slot].range_count; j++) {
+            const WorldRange* const range = &ranges[j];
+            assert(offsets[range->material] + range->count <=
+                       stream->model_count &&
+                   range->first + range->count <= header->max_chunk_instances);
+            memcpy(&stream->models[offsets[range->material]],
+                   &models[range->first], sizeof(mat4) * range->count);
+            offsets[range->material] += range->count;
+        }
+    }
+
+    stream->total_visible_chunks += visible;
+    stream->total_visible_instances += stream->model_count;
+    TRACE_END();
+    return stream->model_count;
+}
+
+void world_stream_print(const WorldStream* stream) {
+    const f64 updates =
+        stream->update_count ? (f64)stream->update_count : 1.0;
+    const f64 loads = stream->loads ? (f64)stream->loads : 1.0;
+    printf("World stream: slots=%u updates=%" PRIu64 " loads=%" PRIu64
+           " evictions=%" PRIu64 " load_ms_mean=%.3f load_ms_max=%.3f "
+           "budget_stalls=%" PRIu64 " invalid_chunks=%" PRIu64
+           " skipped_ranges=%" PRIu64 " dropped_chunks=%" PRIu64
+           " resident_mean=%.1f "
+           "visible_chunks_mean=%.1f visible_instances_mean=%.1f\n",
+           stream->slot_count, stream->update_count, stream->loads,
+           stream->evictions, stream->total_load_ms / loads,
+           stream->max_load_ms, stream->budget_stalls,
+           stream->invalid_chunks, stream->skipped_ranges,
+           stream->dropped_chunks,
+           (f64)stream->total_resident / updates,
+           (f64)stream->total_visible_chunks / updates,
+           (f64)stream->total_visible_instances / updates);
+}
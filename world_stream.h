@@ -0,0 +1,126 @@
+#pragma once
+#include <SDL2/SDL.h>
+#include <cglm/cglm.h>
+
+#include "allocator.h"
+#include "utils.h"
+#include "world_file.h"
+
+// Streaming of the chunks of a world file (world_file.h) around the camera.
+// The resident chunks live in slots of model matrices, as many as fit in the
+// memory budget. Every frame, on the render thread, the chunks within the
+// radius are requested nearest first, taking the slot of the farthest
+// resident chunk out of the radius once the slots run out. A worker thread
+// reads the requested chunks from the mapping, so the page faults never
+// stall a frame, and expands their instances to model matrices.
+//
+// The render thread never waits for the worker: a chunk is drawn from the
+// first frame after it is loaded. At most WORLD_STREAM_MAX_REQUESTS loads
+// are in flight, nearest first, which bounds the latency of a load whatever
+// the size of the world. The file pages of an evicted chunk are handed back
+// to the system, the memory used does not grow with the distance traveled.
+
+#define WORLD_STREAM_MAX_REQUESTS 16
+// Before the camera moves far enough to plan the loads again
+#define WORLD_STREAM_REPLAN_DISTANCE 0.25f  // Of a chunk
+
+typedef enum {
+    WORLD_STREAM_FREE,
+    WORLD_STREAM_LOADING,  // Owned by the worker
+    WORLD_STREAM_READY,  // Loaded, not seen by the render thread yet
+    WORLD_STREAM_RESIDENT,
+} WorldStreamSlotState;
+
+typedef struct {
+    SDL_atomic_t state;  // WorldStreamSlotState
+    u32 chunk;
+    u64 requested;  // Performance counter
+    // Ranges of the chunk to draw, in `slot_ranges`
+    u32 range_count;
+    u32 skipped_ranges;  // Of the other meshes
+    _Bool invalid;
+} WorldStreamSlot;
+
+typedef struct {
+    f32 distance;  // On the xz plane, from the camera to the bounds
+    u32 chunk;
+} WorldStreamCandidate;
+
+// Visible instances of one material, following each other in `models`
+typedef struct {
+    u32 material;
+    u32 first_instance, instance_count;
+} WorldStreamDraw;
+
+typedef struct {
+    WorldFile file;
+    Arena arena;
+    u32 mesh;  // Of the file, drawn; the ranges of the others are skipped
+    mat4 mesh_transform;  // Applied to the mesh before the instance
+    f32 radius;
+    u32 material_count;
+    usize page_size;  // Of the system
+
+    WorldStreamSlot* slots;
+    u32 slot_count;
+    mat4* slot_models;  // max_chunk_instances per slot
+    // max_chunk_ranges per slot, copied from the file: the drawn mesh, the
+    // materials taken modulo `material_count`
+    WorldRange* slot_ranges;
+    u32* free_slots;
+    u32 free_count;
+    u32* chunk_slots;  // Per chunk, UINT32_MAX when not in a slot
+    // Chunks within the radius, nearest first
+    WorldStreamCandidate* candidates;
+    u32 candidate_capacity, candidate_count;
+    vec3 planned;  // Camera of the candidates
+    _Bool planned_once;
+
+    // Slots to load, from the render thread to the worker
+    SDL_Thread* thread;
+    SDL_mutex* mutex;
+    SDL_cond* cond;
+    SDL_atomic_t running;
+    u32 requests[WORLD_STREAM_MAX_REQUESTS];
+    u32 request_first, request_count;
+
+    // Of the last cull, grouped by material, in its frame arena
+    u32* visible_slots;
+    u32 visible_capacity;  // Chunks, those within the radius at most
+    mat4* models;
+    u32 model_count, model_capacity;
+    WorldStreamDraw draws[WORLD_MAX_MATERIALS];
+    u32 draw_count;
+
+    // Since the open
+    u64 update_count;
+    u64 loads, evictions, invalid_chunks, skipped_ranges;
+    u64 budget_stalls;  // Chunks in the radius without a slot to take
+    u64 dropped_chunks;  // Visible, past `visible_capacity`
+    f64 total_load_ms, max_load_ms;
+    u64 total_resident, total_visible_chunks, total_visible_instances;
+} WorldStream;
+
+// Maps the world at `path`, fatal when it is not valid, and starts the
+// worker. The culled models of the chunks within `radius` and the slots fit
+// in `budget` bytes, with at least one slot. `mesh_name` is the mesh of the
+// file drawn, its instances are transformed by `mesh_transform` first, e.g.
+// a dequantization (mesh.h). The materials of the file are taken modulo
+// `material_count`.
+void world_stream_open(WorldStream* stream, const char* path, usize budget,
+                       f32 radius, const char* mesh_name,
+                       mat4 mesh_transform, u32 material_count);
+// Waits for the loads in flight
+void world_stream_close(WorldStream* stream);
+// Takes the chunks loaded since the last update and requests the ones
+// around `camera`. Render thread, once per frame.
+void world_stream_update(WorldStream* stream, vec3 camera);
+// What a cull takes from the frame arena, at most
+usize world_stream_frame_size(const WorldStream* stream);
+// Fills `models` and `draws` with the resident instances in the frustum of
+// `view_projection`, returns their count. `models` is allocated from
+// `frame`, valid until it is reset.
+u32 world_stream_cull(WorldStream* stream, mat4 view_projection,
+                      Arena* frame);
+// Loads and their latency, residency against the budget
+void world_stream_print(const WorldStream* stream);